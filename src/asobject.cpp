@@ -3073,13 +3073,15 @@ bool asAtomHandler::add(asAtom& a,asAtom &v2, SystemState* sys,bool forceint)
 	}
 	else if(isString(a) || isString(v2))
 	{
-		tiny_string sa = toString(a,sys);
-		sa += toString(v2,sys);
 		LOG_CALL("add " << toString(a,sys) << '+' << toString(v2,sys));
 		if (forceint)
+		{
+			tiny_string sa = toString(a,sys);
+			sa += toString(v2,sys);
 			setInt(a,sys,Integer::stringToASInteger(sa.raw_buf(),0));
+		}
 		else
-			a.uintval = (LIGHTSPARK_ATOM_VALTYPE)(abstract_s(sys,sa))|ATOM_STRINGPTR;
+			a.uintval = (LIGHTSPARK_ATOM_VALTYPE)(ASString::concatenate(sys,a,v2))|ATOM_STRINGPTR;
 	}
 	else
 	{
@@ -3185,14 +3187,21 @@ void asAtomHandler::addreplace(asAtom& ret, SystemState* sys,asAtom& v1, asAtom
 	}
 	else if(isString(v1) || isString(v2))
 	{
-		tiny_string sa = toString(v1,sys);
-		sa += toString(v2,sys);
 		LOG_CALL("add " << toString(v1,sys) << '+' << toString(v2,sys));
-		ASATOM_DECREF(ret);
 		if (forceint)
+		{
+			tiny_string sa = toString(v1,sys);
+			sa += toString(v2,sys);
+			ASATOM_DECREF(ret);
 			setInt(ret,sys,Integer::stringToASInteger(sa.raw_buf(),0));
+		}
 		else
-			ret.uintval = (LIGHTSPARK_ATOM_VALTYPE)(abstract_s(sys,sa))|ATOM_STRINGPTR;
+		{
+			// ret may be the same as v1, so the result has to be created before ret is released
+			ASString* res = ASString::concatenate(sys,v1,v2);
+			ASATOM_DECREF(ret);
+			ret.uintval = (LIGHTSPARK_ATOM_VALTYPE)(res)|ATOM_STRINGPTR;
+		}
 	}
 	else
 	{
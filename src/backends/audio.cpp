@@ -20,14 +20,26 @@
 #include "swf.h"
 #include "backends/audio.h"
 #include "backends/config.h"
+#include "backends/streamcache.h"
+#include "platforms/audiokernels.h"
 #include <iostream>
 #include "logger.h"
 #include <sys/time.h>
+#include <algorithm>
 
 
 using namespace lightspark;
 using namespace std;
 
+// sounds decoding to more samples are not kept in memory (about 10 seconds at 44100Hz)
+#define MAX_DECODED_SOUND_SAMPLES (2*44100*10)
+// compressed size above which sounds are not even tried to be decoded
+#define MAX_DECODED_SOUND_SOURCE_SIZE (512*1024)
+// memory budget of all decoded sounds, including their source data
+#define MAX_DECODED_SOUNDS_SIZE (64*1024*1024)
+// maximum number of cached sounds, including the ones that could not be decoded
+#define MAX_DECODED_SOUNDS_COUNT 1024
+
 uint32_t AudioStream::getPlayedTime()
 {
 	uint32_t ret;
@@ -42,8 +54,8 @@ uint32_t AudioStream::getPlayedTime()
 bool AudioStream::init()
 {
 	unmutevolume = curvolume = 1.0;
-	mixer_channel = manager->engineData->audio_StreamInit(this);
-	manager->engineData->audio_StreamSetVolume(mixer_channel, curvolume);
+	panning[0] = panning[3] = 1.0;
+	panning[1] = panning[2] = 0.0;
 	isPaused = false;
 	return true;
 }
@@ -56,6 +68,27 @@ void AudioStream::startMixing()
 	gettimeofday(&starttime, nullptr);
 }
 
+uint32_t AudioStream::fillBuffer(int16_t* dest, uint32_t len)
+{
+	uint32_t readcount = 0;
+	if (decodedSound)
+	{
+		const std::vector<int16_t>& samples = decodedSound->samples;
+		readcount = min(len/2, uint32_t(samples.size()-decodedPosition));
+		memcpy(dest, samples.data()+decodedPosition, readcount*2);
+		decodedPosition += readcount;
+		return readcount*2;
+	}
+	while (readcount < len)
+	{
+		uint32_t ret = decoder->copyFrame((int16_t *)(((unsigned char*)dest)+readcount), len-readcount);
+		if (!ret)
+			break;
+		readcount += ret;
+	}
+	return readcount;
+}
+
 void AudioStream::SetPause(bool pause_on)
 {
 	if (pause_on)
@@ -68,7 +101,6 @@ void AudioStream::SetPause(bool pause_on)
 		mixingStarted=false;
 		isPaused = false;
 	}
-	manager->engineData->audio_StreamPause(mixer_channel,pause_on);
 }
 
 bool AudioStream::ispaused()
@@ -87,113 +119,471 @@ void AudioStream::unmute()
 }
 void AudioStream::setVolume(double volume)
 {
-	manager->engineData->audio_StreamSetVolume(mixer_channel, volume);
 	curvolume = volume;
 }
+void AudioStream::setPanning(float leftToLeft, float leftToRight, float rightToLeft, float rightToRight)
+{
+	panning[0] = leftToLeft;
+	panning[1] = leftToRight;
+	panning[2] = rightToLeft;
+	panning[3] = rightToRight;
+}
 
 AudioStream::~AudioStream()
 {
-	manager->engineData->audio_StreamDeinit(mixer_channel);
 	manager->removeStream(this);
 }
 
-AudioManager::AudioManager(EngineData *engine):muteAllStreams(false),audio_available(false),mixeropened(0),engineData(engine)
+AudioManager::AudioManager(EngineData *engine):muteAllStreams(false),audio_available(false),mixeropened(0),engineData(engine),decodedSoundsSize(0),
+	mixedHistory(MIXED_HISTORY_FRAMES*2),mixedHistoryPosition(0)
 {
 	audio_available = engine->audio_ManagerInit();
 	mixeropened = 0;
 }
 void AudioManager::muteAll()
 {
+	// the streams keep their volume, the mixer just ignores it
 	Locker l(streamMutex);
 	muteAllStreams = true;
-	for ( stream_iterator it = streams.begin();it != streams.end(); ++it )
-	{
-		(*it)->mute();
-	}
 }
 void AudioManager::unmuteAll()
 {
 	Locker l(streamMutex);
 	muteAllStreams = false;
-	for ( stream_iterator it = streams.begin();it != streams.end(); ++it )
-	{
-		(*it)->unmute();
-	}
 }
 
 void AudioManager::removeStream(AudioStream *s)
 {
 	Locker l(streamMutex);
 	streams.remove(s);
-	if (streams.empty())
-	{
-		engineData->audio_ManagerCloseMixer();
-		mixeropened = false;
-	}
+}
+
+bool AudioManager::detachStream(AudioStream* s)
+{
+	Locker l(streamMutex);
+	stream_iterator it = find(streams.begin(), streams.end(), s);
+	if (it == streams.end())
+		return false;
+	streams.erase(it);
+	return true;
 }
 
 void AudioManager::stopAllSounds()
 {
 	muteAll();
-	// use temporary list of producers to avoid deadlock, as threadAbort() leads to removeStream();
+	// use temporary lists to avoid deadlock, as threadAbort() leads to removeStream();
 	list<IThreadJob*> producers;
+	list<AudioStream*> decodedStreams;
 	{
 		Locker l(streamMutex);
 		for ( stream_iterator it = streams.begin();it != streams.end(); ++it )
 		{
 			if ((*it)->producer)
 				producers.push_back((*it)->producer);
+			else if ((*it)->listener)
+				decodedStreams.push_back(*it);
 		}
+		for (auto it = decodedStreams.begin();it != decodedStreams.end(); ++it )
+			streams.remove(*it);
 	}
 	for (auto it = producers.begin();it != producers.end(); ++it )
 	{
 		(*it)->threadAbort();
 	}
+	for (auto it = decodedStreams.begin();it != decodedStreams.end(); ++it )
+		(*it)->listener->audioStreamFinished(*it,false);
 }
 
-AudioStream* AudioManager::createStream(AudioDecoder* decoder, bool startpaused, IThreadJob* producer, uint32_t playedTime)
+bool AudioManager::openMixer()
 {
-	Locker l(streamMutex);
 	if (!audio_available)
-		return NULL;
+		return false;
 	if (!mixeropened)
 	{
-		if (!engineData->audio_ManagerOpenMixer())
+		// the mixer stays open until the manager is destroyed, closing it from here
+		// could deadlock with the mixer thread waiting for streamMutex
+		if (!engineData->audio_ManagerOpenMixer(this))
 		{
 			LOG(LOG_ERROR,"Couldn't open mixer");
 			audio_available = 0;
-			return NULL;
+			return false;
 		}
 		mixeropened = 1;
 	}
+	return true;
+}
 
-	AudioStream *stream = new AudioStream(this,producer,playedTime);
-	stream->decoder = decoder;
-	if (!stream->init())
-	{
-		delete stream;
-		return NULL;
-	}
+void AudioManager::addStream(AudioStream* stream, bool startpaused)
+{
+	stream->init();
 	if (startpaused)
 		stream->pause();
 	else
 		stream->hasStarted=true;
 	streams.push_back(stream);
+}
 
+AudioStream* AudioManager::createStream(AudioDecoder* decoder, bool startpaused, IThreadJob* producer, uint32_t playedTime)
+{
+	Locker l(streamMutex);
+	if (!openMixer())
+		return NULL;
+
+	AudioStream *stream = new AudioStream(this,producer,playedTime);
+	stream->decoder = decoder;
+	addStream(stream, startpaused);
 	return stream;
 }
 
+AudioStream* AudioManager::createStream(_R<DecodedSound> sound, IAudioStreamListener* listener, uint32_t playedTime)
+{
+	Locker l(streamMutex);
+	if (!openMixer())
+		return NULL;
 
-AudioManager::~AudioManager()
+	AudioStream *stream = new AudioStream(this,nullptr,playedTime);
+	stream->decodedSound = sound;
+	stream->listener = listener;
+	uint64_t position = uint64_t(playedTime)*engineData->audio_getSampleRate()/1000*2;
+	stream->decodedPosition = min(position, uint64_t(sound->samples.size()));
+	addStream(stream, false);
+	return stream;
+}
+
+#ifdef ENABLE_LIBAVCODEC
+namespace
+{
+/*
+ * Decodes a short sound for the cache of the AudioManager
+ */
+class DecodeSoundJob: public IThreadJob
+{
+private:
+	AudioManager* manager;
+	EngineData* engineData;
+	_R<StreamCache> data;
+	AudioFormat format;
+public:
+	DecodeSoundJob(AudioManager* _manager, EngineData* _engineData, _R<StreamCache> _data, const AudioFormat& _format)
+		:manager(_manager),engineData(_engineData),data(_data),format(_format) {}
+	void execute() override
+	{
+		_NR<DecodedSound> sound = _MNR(new DecodedSound());
+		std::streambuf *sbuf = data->createReader();
+		istream s(sbuf);
+		s.exceptions ( istream::failbit | istream::badbit );
+		FFMpegStreamDecoder* streamDecoder = nullptr;
+		try
+		{
+			streamDecoder = new FFMpegStreamDecoder(nullptr,engineData,s,&format,data->getReceivedLength());
+			if (!streamDecoder->isValid())
+				sound.reset();
+			int16_t buf[4096];
+			while (sound && !threadAborting)
+			{
+				bool decoded = streamDecoder->decodeNextFrame();
+				// drain the decoder after every frame, its buffer blocks when full
+				AudioDecoder* audioDecoder = streamDecoder->audioDecoder;
+				while (audioDecoder && audioDecoder->hasDecodedFrames())
+				{
+					uint32_t len = audioDecoder->copyFrame(buf, sizeof(buf));
+					if (!len)
+						break;
+					sound->samples.insert(sound->samples.end(), buf, buf+len/2);
+				}
+				if (sound->samples.size() > MAX_DECODED_SOUND_SAMPLES)
+					sound.reset();
+				if (!decoded)
+					break;
+			}
+		}
+		catch(exception& e)
+		{
+			// the end of the data is reported as exception
+		}
+		if (sound && (sound->samples.empty() || threadAborting))
+			sound.reset();
+		delete streamDecoder;
+		delete sbuf;
+		manager->decodedSoundReady(data.getPtr(),sound);
+	}
+	void jobFence() override
+	{
+		delete this;
+	}
+};
+}
+#endif
+
+_NR<DecodedSound> AudioManager::getDecodedSound(_R<StreamCache> data, const AudioFormat& format)
+{
+	if (!audio_available || !data->hasTerminated() || data->getReceivedLength() > MAX_DECODED_SOUND_SOURCE_SIZE)
+		return NullRef;
+#ifdef ENABLE_LIBAVCODEC
+	Locker l(decodedSoundsMutex);
+	auto it = decodedSounds.find(data.getPtr());
+	if (it != decodedSounds.end())
+	{
+		decodedSoundsLRU.splice(decodedSoundsLRU.end(),decodedSoundsLRU,it->second.lruPosition);
+		return it->second.sound;
+	}
+	// the sound is played by a decoding job until the samples are available
+	DecodedSoundEntry& entry = decodedSounds[data.getPtr()];
+	entry.data = data;
+	entry.decoding = true;
+	entry.size = data->getReceivedLength();
+	entry.lruPosition = decodedSoundsLRU.insert(decodedSoundsLRU.end(),data.getPtr());
+	decodedSoundsSize += entry.size;
+	evictDecodedSounds();
+	getSys()->addJob(new DecodeSoundJob(this,engineData,data,format));
+#endif
+	return NullRef;
+}
+
+void AudioManager::decodedSoundReady(StreamCache* data, _NR<DecodedSound> sound)
+{
+	Locker l(decodedSoundsMutex);
+	auto it = decodedSounds.find(data);
+	if (it == decodedSounds.end())
+		return;
+	DecodedSoundEntry& entry = it->second;
+	entry.decoding = false;
+	if (sound)
+	{
+		entry.sound = sound;
+		entry.size += sound->samples.size()*2;
+		decodedSoundsSize += sound->samples.size()*2;
+		evictDecodedSounds();
+	}
+	else
+	{
+		// only the failure is remembered, so the sound is not decoded again
+		decodedSoundsSize -= entry.size;
+		entry.size = 0;
+		entry.data.reset();
+	}
+}
+
+/*
+ * Drops the least recently used sounds until the budget is met. Called with decodedSoundsMutex locked
+ */
+void AudioManager::evictDecodedSounds()
+{
+	auto it = decodedSoundsLRU.begin();
+	while (it != decodedSoundsLRU.end() &&
+	       (decodedSoundsSize > MAX_DECODED_SOUNDS_SIZE || decodedSounds.size() > MAX_DECODED_SOUNDS_COUNT))
+	{
+		auto entry = decodedSounds.find(*it);
+		// sounds being decoded are still referenced by their job
+		if (entry->second.decoding)
+		{
+			++it;
+			continue;
+		}
+		decodedSoundsSize -= entry->second.size;
+		decodedSounds.erase(entry);
+		it = decodedSoundsLRU.erase(it);
+	}
+}
+
+void AudioManager::mixStreams(int16_t* dest, uint32_t len)
 {
+	uint32_t samples = len/2;
+	if (mixBuffer.size() < samples)
+	{
+		mixBuffer.resize(samples);
+		streamBuffer.resize(samples);
+	}
+	fill_n(mixBuffer.begin(), samples, 0);
+	list<AudioStream*> finished;
 	Locker l(streamMutex);
-	for (stream_iterator it = streams.begin(); it != streams.end(); ++it) {
-		delete *it;
+	for (stream_iterator it = streams.begin(); it != streams.end();)
+	{
+		AudioStream* s = *it;
+		if (s->isPaused)
+		{
+			++it;
+			continue;
+		}
+		s->startMixing();
+		uint32_t read = s->fillBuffer(streamBuffer.data(), samples*2);
+		float gains[4];
+		double volume = muteAllStreams ? 0.0 : s->curvolume;
+		for (uint32_t i=0; i<4; i++)
+			gains[i] = s->panning[i]*volume;
+		audioMixRow(streamBuffer.data(), mixBuffer.data(), read/4, gains);
+		if (s->decodedSound && s->decodedPosition >= s->decodedSound->samples.size())
+		{
+			finished.push_back(s);
+			it = streams.erase(it);
+		}
+		else
+			++it;
 	}
+	l.release();
+	audioStoreRow(mixBuffer.data(), dest, samples);
+	{
+		Locker h(mixedHistoryMutex);
+		// only the end of long buffers fits into the history
+		uint32_t offset = samples > mixedHistory.size() ? samples-mixedHistory.size() : 0;
+		for (uint32_t i = offset; i < samples;)
+		{
+			uint32_t count = min(samples-i, uint32_t(mixedHistory.size()-mixedHistoryPosition));
+			memcpy(mixedHistory.data()+mixedHistoryPosition, dest+i, count*2);
+			mixedHistoryPosition = (mixedHistoryPosition+count)%mixedHistory.size();
+			i += count;
+		}
+	}
+	for (auto it = finished.begin(); it != finished.end(); ++it)
+		(*it)->listener->audioStreamFinished(*it,true);
+}
+
+void AudioManager::getMixedHistory(int16_t* dest, uint32_t frames)
+{
+	uint32_t samples = min(frames, uint32_t(MIXED_HISTORY_FRAMES))*2;
+	fill_n(dest, frames*2-samples, 0);
+	dest += frames*2-samples;
+	Locker l(mixedHistoryMutex);
+	uint32_t start = (mixedHistoryPosition+mixedHistory.size()-samples)%mixedHistory.size();
+	uint32_t count = min(samples, uint32_t(mixedHistory.size()-start));
+	memcpy(dest, mixedHistory.data()+start, count*2);
+	memcpy(dest+count, mixedHistory.data(), (samples-count)*2);
+}
+
+#ifdef ENABLE_LIBAVCODEC
+AudioExtractor::AudioExtractor(EngineData* engine, _R<StreamCache> _data, const AudioFormat& _format)
+	:engineData(engine),data(_data),format(_format),sbuf(nullptr),stream(nullptr),decoder(nullptr),bufferOffset(0),position(0),finished(false),finishedLength(0)
+{
+}
+
+AudioExtractor::~AudioExtractor()
+{
+	close();
+}
+
+bool AudioExtractor::open()
+{
+	close();
+	sbuf = data->createReader();
+	stream = new istream(sbuf);
+	stream->exceptions ( istream::failbit | istream::badbit );
+	try
+	{
+		decoder = new FFMpegStreamDecoder(nullptr,engineData,*stream,&format,data->hasTerminated() ? data->getReceivedLength() : -1);
+	}
+	catch(exception& e)
+	{
+		LOG(LOG_ERROR,"AudioExtractor: "<<e.what());
+	}
+	if (!decoder || !decoder->isValid())
+	{
+		LOG(LOG_ERROR,"invalid streamDecoder");
+		close();
+		return false;
+	}
+	return true;
+}
+
+void AudioExtractor::close()
+{
+	delete decoder;
+	decoder = nullptr;
+	delete stream;
+	stream = nullptr;
+	delete sbuf;
+	sbuf = nullptr;
+	buffer.clear();
+	bufferOffset = 0;
+	position = 0;
+	finished = false;
+}
+
+bool AudioExtractor::fillBuffer()
+{
+	buffer.clear();
+	bufferOffset = 0;
+	int16_t buf[4096];
+	while (buffer.empty() && !finished)
+	{
+		// taken before decoding, data arriving meanwhile may not have been seen by the decoder
+		uint32_t received = data->getReceivedLength();
+		bool decoded;
+		try
+		{
+			decoded = decoder->decodeNextFrame();
+		}
+		catch(exception& e)
+		{
+			// the end of the data is reported as exception
+			decoded = false;
+		}
+		// drain the decoder after every frame, its buffer blocks when full
+		AudioDecoder* audioDecoder = decoder->audioDecoder;
+		while (audioDecoder && audioDecoder->hasDecodedFrames())
+		{
+			uint32_t len = audioDecoder->copyFrame(buf, sizeof(buf));
+			if (!len)
+				break;
+			buffer.insert(buffer.end(), buf, buf+len/2);
+		}
+		if (!decoded)
+		{
+			finished = true;
+			finishedLength = received;
+		}
+	}
+	return !buffer.empty();
+}
+
+uint32_t AudioExtractor::extract(float* dest, uint32_t frames, uint64_t startPosition)
+{
+	// the end of a partially loaded sound has been reached and more data arrived since, the
+	// decoder has given up on its stream, so decoding restarts and skips to startPosition
+	bool moreData = finished && data->getReceivedLength() > finishedLength;
+	if (!decoder || startPosition < position || moreData)
+	{
+		if (!open())
+			return 0;
+	}
+	// skip the frames before startPosition
+	while (position < startPosition)
+	{
+		if (bufferOffset == buffer.size() && !fillBuffer())
+			return 0;
+		uint32_t count = min(uint64_t(buffer.size()-bufferOffset)/2, startPosition-position);
+		bufferOffset += count*2;
+		position += count;
+	}
+	uint32_t written = 0;
+	while (written < frames)
+	{
+		if (bufferOffset == buffer.size() && !fillBuffer())
+			break;
+		uint32_t count = min(uint32_t(buffer.size()-bufferOffset)/2, frames-written);
+		audioS16ToFloat(buffer.data()+bufferOffset, dest+written*2, count*2);
+		bufferOffset += count*2;
+		position += count;
+		written += count;
+	}
+	return written;
+}
+#endif
+
+AudioManager::~AudioManager()
+{
+	// close the mixer first, so the mixer thread doesn't access the streams anymore
 	if (mixeropened)
 	{
 		engineData->audio_ManagerCloseMixer();
 	}
+	list<AudioStream*> toDelete;
+	{
+		Locker l(streamMutex);
+		toDelete.swap(streams);
+	}
+	for (stream_iterator it = toDelete.begin(); it != toDelete.end(); ++it) {
+		delete *it;
+	}
 	if (audio_available)
 	{
 		engineData->audio_ManagerDeinit();
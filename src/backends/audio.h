@@ -23,13 +23,47 @@
 
 #include "compat.h"
 #include "backends/decoder.h"
+#include "smartrefs.h"
 #include <iostream>
+#include <list>
+#include <map>
+#include <vector>
 
 namespace lightspark
 {
 class AudioStream;
 class EngineData;
+class StreamCache;
 
+/*
+ * Samples of a short sound decoded once and shared by all the streams playing it,
+ * interleaved 16 bit stereo at the sample rate of the mixer
+ */
+class DecodedSound: public RefCountable
+{
+public:
+	std::vector<int16_t> samples;
+};
+
+// number of stereo frames of the mixer output kept for computeSpectrum
+#define MIXED_HISTORY_FRAMES 2048
+
+class IAudioStreamListener
+{
+public:
+	virtual ~IAudioStreamListener() {}
+	/*
+	 * Called after a stream playing a DecodedSound has been removed from the mixer, either from
+	 * the mixer thread when all samples have been played (completed is true) or by stopAllSounds.
+	 * The listener must delete the stream
+	 */
+	virtual void audioStreamFinished(AudioStream* s, bool completed)=0;
+};
+
+/*
+ * All streams are mixed by the AudioManager into the single output of the engine,
+ * mixStreams is called by the engine from its audio thread
+ */
 class AudioManager
 {
 	friend class AudioStream;
@@ -41,20 +75,110 @@ private:
 	std::list<AudioStream *> streams;
 	typedef std::list<AudioStream *>::iterator stream_iterator;
 	Mutex streamMutex;
+	// buffers of the mixer thread
+	std::vector<int32_t> mixBuffer;
+	std::vector<int16_t> streamBuffer;
+	struct DecodedSoundEntry
+	{
+		// kept while decoding or decoded, so the key is not reused. Released if decoding failed,
+		// new data at the same address is then played without the cache
+		_NR<StreamCache> data;
+		_NR<DecodedSound> sound;
+		bool decoding;
+		// bytes of the source data and the samples, counted against the budget of all sounds
+		size_t size;
+		std::list<StreamCache*>::iterator lruPosition;
+	};
+	std::map<StreamCache*,DecodedSoundEntry> decodedSounds;
+	// keys of decodedSounds, least recently used first
+	std::list<StreamCache*> decodedSoundsLRU;
+	size_t decodedSoundsSize;
+	Mutex decodedSoundsMutex;
+	void evictDecodedSounds();
+	// ring of the last mixed samples, read by computeSpectrum
+	std::vector<int16_t> mixedHistory;
+	uint32_t mixedHistoryPosition;
+	Mutex mixedHistoryMutex;
+	bool openMixer();
+	void addStream(AudioStream* stream, bool startpaused);
 public:
 	AudioManager(EngineData* engine);
 
 	AudioStream *createStream(AudioDecoder *decoder, bool startpaused, IThreadJob *producer, uint32_t playedTime);
+	/*
+	 * Creates a stream playing sound from playedTime on, the listener is notified when it is finished
+	 */
+	AudioStream *createStream(_R<DecodedSound> sound, IAudioStreamListener* listener, uint32_t playedTime);
+	/*
+	 * Returns the decoded samples of a complete embedded sound. On first use the sound is decoded
+	 * in a worker thread and NullRef is returned, as it is if the sound can't be kept in memory.
+	 * The least recently used sounds are dropped when the memory budget is exceeded
+	 */
+	_NR<DecodedSound> getDecodedSound(_R<StreamCache> data, const AudioFormat& format);
+	/*
+	 * Called by the decoding job, sound is NullRef if the data could not be decoded or is too long
+	 */
+	void decodedSoundReady(StreamCache* data, _NR<DecodedSound> sound);
+	/*
+	 * Mixes all streams into len bytes of interleaved 16 bit stereo samples
+	 */
+	void mixStreams(int16_t* dest, uint32_t len) DLL_PUBLIC;
+	/*
+	 * Copies the last frames stereo frames of the mixer output to dest, oldest first.
+	 * At most MIXED_HISTORY_FRAMES are kept, frames not mixed yet are silent
+	 */
+	void getMixedHistory(int16_t* dest, uint32_t frames);
 
 	void toggleMuteAll() { muteAllStreams ? unmuteAll() : muteAll(); }
 	bool allMuted() { return muteAllStreams; }
 	void muteAll();
 	void unmuteAll();
 	void removeStream(AudioStream* s);
+	/*
+	 * Removes the stream from the mixer, returns false if the mixer already removed it
+	 */
+	bool detachStream(AudioStream* s);
 	void stopAllSounds();
 	~AudioManager();
 };
 
+#ifdef ENABLE_LIBAVCODEC
+/*
+ * Decodes a sound sequentially for Sound.extract. The decoder is kept between calls,
+ * so consecutive extractions only decode the data once. Positions are counted in
+ * stereo frames at the sample rate of the mixer
+ */
+class AudioExtractor
+{
+private:
+	EngineData* engineData;
+	_R<StreamCache> data;
+	AudioFormat format;
+	std::streambuf* sbuf;
+	std::istream* stream;
+	FFMpegStreamDecoder* decoder;
+	// interleaved samples decoded but not extracted yet, starting at bufferOffset
+	std::vector<int16_t> buffer;
+	uint32_t bufferOffset;
+	uint64_t position;
+	bool finished;
+	// received length of the data when the decoder reached its end
+	uint32_t finishedLength;
+	bool open();
+	void close();
+	bool fillBuffer();
+public:
+	AudioExtractor(EngineData* engine, _R<StreamCache> _data, const AudioFormat& _format);
+	~AudioExtractor();
+	uint64_t getPosition() const { return position; }
+	/*
+	 * Converts up to frames stereo frames from startPosition on to interleaved floats,
+	 * returns the number of frames written to dest. Seeking backwards restarts decoding
+	 */
+	uint32_t extract(float* dest, uint32_t frames, uint64_t startPosition);
+};
+#endif
+
 class DLL_PUBLIC AudioStream
 {
 friend class AudioManager;
@@ -63,18 +187,26 @@ private:
 	AudioManager* manager;
 	AudioDecoder *decoder;
 	IThreadJob* producer;
+	_NR<DecodedSound> decodedSound;
+	IAudioStreamListener* listener;
+	uint32_t decodedPosition;
 	bool hasStarted;
 	bool isPaused;
 	bool mixingStarted;
 	double curvolume;
 	double unmutevolume;
+	// leftToLeft, leftToRight, rightToLeft, rightToRight
+	float panning[4];
 	uint64_t playedtime;
 	struct timeval starttime;
-	int mixer_channel;
+	/*
+	 * Copies up to len bytes of samples to dest, returns the number of bytes copied
+	 */
+	uint32_t fillBuffer(int16_t* dest, uint32_t len);
 public:
 	bool init();
 	void startMixing();
-	AudioStream(AudioManager* _manager,IThreadJob* _producer,uint64_t _playedtime):manager(_manager),decoder(NULL),producer(_producer),hasStarted(false),isPaused(true),mixingStarted(false),playedtime(_playedtime) { }
+	AudioStream(AudioManager* _manager,IThreadJob* _producer,uint64_t _playedtime):manager(_manager),decoder(NULL),producer(_producer),listener(NULL),decodedPosition(0),hasStarted(false),isPaused(true),mixingStarted(false),playedtime(_playedtime) { }
 
 	void SetPause(bool pause_on);
 	uint32_t getPlayedTime();
@@ -84,9 +216,11 @@ public:
 	void pause() { SetPause(true); }
 	void resume() { SetPause(false); }
 	void setVolume(double volume);
+	void setPanning(float leftToLeft, float leftToRight, float rightToLeft, float rightToRight);
 	void setPlayedTime(uint64_t p) { playedtime = p; }
 	inline double getVolume() const { return curvolume; }
 	inline AudioDecoder *getDecoder() const { return decoder; }
+	inline bool isDecodedSound() const { return !decodedSound.isNull(); }
 	~AudioStream();
 };
 
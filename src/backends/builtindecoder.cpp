@@ -21,12 +21,52 @@
 #include "scripting/flash/display/DisplayObject.h"
 #include "scripting/flash/display/flashdisplay.h"
 #include "scripting/flash/net/flashnet.h"
+#include "scripting/toplevel/Array.h"
 #include "swf.h"
 
 using namespace lightspark;
+using namespace std;
+
+static bool getMetadataValue(ASObject* o, const char* name, asAtom& ret)
+{
+	multiname m(nullptr);
+	m.name_type=multiname::NAME_STRING;
+	m.name_s_id=getSys()->getUniqueStringId(name);
+	m.ns.emplace_back(getSys(),BUILTIN_STRINGS::EMPTY,NAMESPACE);
+	m.isAttribute = false;
+	if(!o->hasPropertyByMultiname(m,true,false))
+		return false;
+	o->getVariableByMultiname(ret,m);
+	return true;
+}
+
+//The returned reference is owned by the caller
+static _NR<ASObject> getMetadataObject(ASObject* o, const char* name)
+{
+	asAtom v=asAtomHandler::invalidAtom;
+	if(!getMetadataValue(o,name,v))
+		return NullRef;
+	if(!asAtomHandler::isObject(v))
+	{
+		ASATOM_DECREF(v);
+		return NullRef;
+	}
+	return _MNR(asAtomHandler::getObjectNoCheck(v));
+}
+
+static bool getMetadataNumber(ASObject* o, const char* name, number_t& ret)
+{
+	asAtom v=asAtomHandler::invalidAtom;
+	if(!getMetadataValue(o,name,v))
+		return false;
+	ret=asAtomHandler::toNumber(v);
+	ASATOM_DECREF(v);
+	return true;
+}
 
 BuiltinStreamDecoder::BuiltinStreamDecoder(std::istream& _s, NetStream* _ns):
-	stream(_s),prevSize(0),decodedAudioBytes(0),decodedVideoFrames(0),decodedTime(0),frameRate(0.0),netstream(_ns),headerbuf(NULL),headerLen(0)
+	stream(_s),prevSize(0),decodedAudioBytes(0),decodedVideoFrames(0),decodedTime(0),frameRate(0.0),netstream(_ns),headerbuf(NULL),headerLen(0),
+	firstTagPosition(0),scannedPosition(0),seekTime(0),seekPending(false)
 {
 	STREAM_TYPE t=classifyStream(stream);
 	if(t==FLV_STREAM)
@@ -34,6 +74,9 @@ BuiltinStreamDecoder::BuiltinStreamDecoder(std::istream& _s, NetStream* _ns):
 		FLV_HEADER h(stream);
 		valid=h.isValid();
 		hasvideo=h.hasVideo();
+		//The first tag follows the header and the first PreviousTagSize
+		firstTagPosition=h.skipAmount()+4;
+		scannedPosition=firstTagPosition;
 	}
 	else
 		valid=false;
@@ -64,6 +107,17 @@ BuiltinStreamDecoder::STREAM_TYPE BuiltinStreamDecoder::classifyStream(std::istr
 
 bool BuiltinStreamDecoder::decodeNextFrame()
 {
+	seekMutex.lock();
+	bool seek=seekPending;
+	uint32_t time=seekTime;
+	seekPending=false;
+	seekMutex.unlock();
+	if(seek)
+		seekToKeyframe(time);
+
+	streampos tagPosition=stream.tellg();
+	if(tagPosition!=-1)
+		tagPosition+=4;
 	UI32_FLV PreviousTagSize;
 	stream >> PreviousTagSize;
 	// It seems that Adobe simply ignores invalid values for PreviousTagSize
@@ -145,6 +199,8 @@ bool BuiltinStreamDecoder::decodeNextFrame()
 		{
 			VideoDataTag tag(stream);
 			prevSize=tag.getTotalLen();
+			if(tagPosition!=-1 && tag.frameType==1 && !tag.isHeader())
+				addKeyframe(tag.getTimestamp(),uint32_t(tagPosition));
 			//If the framerate is known give the right timing, otherwise use decodedTime from audio
 			uint32_t frameTime=(frameRate!=0.0)?(decodedVideoFrames*1000/frameRate):decodedTime;
 
@@ -201,22 +257,17 @@ bool BuiltinStreamDecoder::decodeNextFrame()
 			prevSize=tag.getTotalLen();
 			if (tag.methodName == "onMetaData")
 			{
-				// set framerate from metadata, if available
-				multiname m(nullptr);
-				m.name_type=multiname::NAME_STRING;
-				m.name_s_id=getSys()->getUniqueStringId("framerate");
-				m.ns.emplace_back(getSys(),BUILTIN_STRINGS::EMPTY,NAMESPACE);
-				m.isAttribute = false;
+				// set framerate and keyframes from metadata, if available
 				auto it = tag.dataobjectlist.begin();
 				while (it != tag.dataobjectlist.end())
 				{
 					ASObject* o = asAtomHandler::getObject((*it));
-					if(o && o->hasPropertyByMultiname(m,true,false))
+					if(o)
 					{
-						asAtom v=asAtomHandler::invalidAtom;
-						o->getVariableByMultiname(v,m);
-						frameRate = asAtomHandler::toNumber(v);
-						break;
+						number_t framerate;
+						if(getMetadataNumber(o,"framerate",framerate))
+							frameRate = framerate;
+						addKeyframesFromMetadata(o);
 					}
 					it++;
 				}
@@ -229,11 +280,125 @@ bool BuiltinStreamDecoder::decodeNextFrame()
 			LOG(LOG_ERROR,_("Unexpected tag type ") << (int)TagType << _(" in FLV"));
 			return false;
 	}
+	//Tags read one after the other from the start of the stream don't need to be scanned when seeking
+	if(tagPosition!=-1 && uint32_t(tagPosition)==scannedPosition)
+		scannedPosition+=prevSize+4;
 	return true;
 }
 
+void BuiltinStreamDecoder::addKeyframe(uint32_t time, uint32_t position)
+{
+	if(keyframes.empty() || keyframes.back().time<time)
+	{
+		keyframes.push_back({time,position});
+		return;
+	}
+	auto it=std::lower_bound(keyframes.begin(),keyframes.end(),time,
+		[](const FLVKeyframe& k,uint32_t t) { return k.time<t; });
+	for(auto j=it;j!=keyframes.end() && j->time==time;++j)
+	{
+		if(j->position==position)
+			return;
+	}
+	keyframes.insert(it,{time,position});
+}
+
+void BuiltinStreamDecoder::addKeyframesFromMetadata(ASObject* metadata)
+{
+	//The keyframes object contains the times in seconds and the offsets of the keyframe tags
+	//The offsets may point behind the data received so far, they are checked when seeking
+	_NR<ASObject> o=getMetadataObject(metadata,"keyframes");
+	if(o.isNull())
+		return;
+	_NR<ASObject> times=getMetadataObject(o.getPtr(),"times");
+	_NR<ASObject> positions=getMetadataObject(o.getPtr(),"filepositions");
+	if(times.isNull() || positions.isNull() || !times->is<Array>() || !positions->is<Array>())
+		return;
+	Array* t=times->as<Array>();
+	Array* p=positions->as<Array>();
+	uint32_t count=min(t->size(),p->size());
+	for(uint32_t i=0;i<count;i++)
+	{
+		asAtom time=t->at(i);
+		asAtom position=p->at(i);
+		number_t pos=asAtomHandler::toNumber(position);
+		if(pos>=firstTagPosition && pos<UINT32_MAX)
+			addKeyframe(asAtomHandler::toNumber(time)*1000,pos);
+	}
+}
+
+void BuiltinStreamDecoder::scanKeyframesUntil(uint32_t time)
+{
+	//Only the tag headers are read, the data of the tags is skipped
+	uint32_t available=netstream->getReceivedLength();
+	while(scannedPosition+13<=available)
+	{
+		stream.clear();
+		stream.seekg(scannedPosition);
+		//Tag header and the first two bytes of the data
+		uint8_t header[13];
+		stream.read((char*)header,13);
+		if(stream.gcount()!=13 || (header[0]!=8 && header[0]!=9 && header[0]!=18))
+			break;
+		uint32_t dataSize=(header[1]<<16)|(header[2]<<8)|header[3];
+		uint32_t timestamp=(header[4]<<16)|(header[5]<<8)|header[6]|(header[7]<<24);
+		if(header[0]==9 && dataSize>0 && (header[11]>>4)==1)
+		{
+			//H264 keyframes must be NALUs, not sequence headers
+			if((header[11]&0xf)!=7 || (dataSize>1 && header[12]==1))
+				addKeyframe(timestamp,scannedPosition);
+		}
+		scannedPosition+=11+dataSize+4;
+		if(timestamp>time)
+			break;
+	}
+}
+
+void BuiltinStreamDecoder::seekToKeyframe(uint32_t time)
+{
+	if(keyframes.empty() || keyframes.back().time<time)
+		scanKeyframesUntil(time);
+	//Start from the first tag if there is no keyframe before the requested time
+	uint32_t keyframeTime=0;
+	uint32_t position=firstTagPosition;
+	auto it=std::upper_bound(keyframes.begin(),keyframes.end(),time,
+		[](uint32_t t,const FLVKeyframe& k) { return t<k.time; });
+	//Reading a keyframe that has not been received yet would block, use the last one available
+	uint32_t available=netstream->getReceivedLength();
+	while(it!=keyframes.begin() && std::prev(it)->position+11>available)
+		--it;
+	if(it!=keyframes.begin())
+	{
+		--it;
+		keyframeTime=it->time;
+		position=it->position;
+		stream.clear();
+		stream.seekg(position);
+		if(stream.peek()!=9)
+		{
+			LOG(LOG_ERROR,"FLV keyframe index doesn't match the stream at " << position);
+			keyframes.erase(it);
+			seekToKeyframe(time);
+			return;
+		}
+	}
+	stream.clear();
+	stream.seekg(position-4);
+	prevSize=0;
+	//Restart the timing at the keyframe and drop what has been decoded before the seek
+	decodedTime=keyframeTime;
+	decodedVideoFrames=(frameRate!=0.0)?keyframeTime*frameRate/1000:0;
+	decodedAudioBytes=audioDecoder?keyframeTime*audioDecoder->getBytesPerMSec():0;
+	if(videoDecoder)
+		videoDecoder->skipAll();
+	if(audioDecoder)
+		audioDecoder->skipAll();
+}
+
 void BuiltinStreamDecoder::jumpToPosition(number_t position)
 {
-	if (position != 0)
-		LOG(LOG_NOT_IMPLEMENTED,"jumpToPosition for BuiltinStreamDecoder");
+	//The seek is done by the decoding thread before reading the next tag
+	Locker l(seekMutex);
+	seekTime=position;
+	seekPending=true;
 }
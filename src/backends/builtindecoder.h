@@ -44,6 +44,29 @@ private:
 	NetStream* netstream;
 	uint8_t* headerbuf;
 	uint32_t headerLen;
+	/*
+	   Index of the video keyframes, sorted by time.
+	   It is filled from the onMetaData keyframes object if available and
+	   from the tags that are decoded or scanned while seeking
+	*/
+	struct FLVKeyframe
+	{
+		uint32_t time;
+		//Offset of the tag in the stream
+		uint32_t position;
+	};
+	std::vector<FLVKeyframe> keyframes;
+	uint32_t firstTagPosition;
+	//All the tags before this offset have been indexed
+	uint32_t scannedPosition;
+	//Seeks are requested by the VM and executed by the decoding thread
+	Mutex seekMutex;
+	uint32_t seekTime;
+	bool seekPending;
+	void addKeyframe(uint32_t time, uint32_t position);
+	void addKeyframesFromMetadata(ASObject* metadata);
+	void scanKeyframesUntil(uint32_t time);
+	void seekToKeyframe(uint32_t time);
 public:
 	BuiltinStreamDecoder(std::istream& _s, NetStream* _ns);
 	~BuiltinStreamDecoder();
@@ -85,7 +85,7 @@ Config::Config():
 	//DEFAULT SETTINGS
 	defaultCacheDirectory((string) g_get_user_cache_dir() + G_DIR_SEPARATOR_S + "lightspark"),
 	cacheDirectory(defaultCacheDirectory),cachePrefix("cache"),
-	renderingEnabled(true)
+	renderingEnabled(true),videoDecodingThreads(0),compressionLevel(-1)
 {
 #ifdef _WIN32
 	const char* exePath = getExectuablePath();
@@ -204,6 +204,12 @@ void Config::handleEntry()
 	//Rendering
 	if(group == "rendering" && key == "enabled")
 		renderingEnabled = atoi(value.c_str());
+	//Video decoding threads
+	else if(group == "video" && key == "threads")
+		videoDecodingThreads = atoi(value.c_str());
+	//Compression level of ByteArrays
+	else if(group == "compression" && key == "level")
+		compressionLevel = atoi(value.c_str());
 	//Cache directory
 	else if(group == "cache" && key == "directory")
 		cacheDirectory = value;
@@ -51,6 +51,10 @@ namespace lightspark
 
 		//Specifies if rendering should be done
 		bool renderingEnabled;
+		//Specifies the number of threads used to decode a video stream, default=0 (as many as there are cores)
+		uint32_t videoDecodingThreads;
+		//Specifies the zlib level used by ByteArray.compress and deflate, default=-1 (zlib default)
+		int compressionLevel;
 		Config();
 		~Config();
 	public:
@@ -64,6 +68,8 @@ namespace lightspark
 		const std::string& getGnashPath() const { return gnashPath; }
 
 		bool isRenderingEnabled() const { return renderingEnabled; }
+		uint32_t getVideoDecodingThreads() const { return videoDecodingThreads; }
+		int getCompressionLevel() const { return compressionLevel; }
 	};
 }
 
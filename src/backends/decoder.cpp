@@ -22,7 +22,9 @@
 
 #include "backends/audio.h"
 #include "backends/decoder.h"
+#include "backends/config.h"
 #include "platforms/fastpaths.h"
+#include "platforms/audiokernels.h"
 #include "swf.h"
 #include "backends/rendering.h"
 #include "SDL2/SDL_mixer.h"
@@ -134,7 +136,7 @@ bool FFMpegVideoDecoder::fillDataAndCheckValidity()
 }
 
 FFMpegVideoDecoder::FFMpegVideoDecoder(LS_VIDEO_CODEC codecId, uint8_t* initdata, uint32_t datalen, double frameRateHint, DefineVideoStreamTag *tag):
-	ownedContext(true),curBuffer(0),codecContext(nullptr),curBufferOffset(0),currentcachedframe(UINT32_MAX),embeddedvideotag(tag)
+	ownedContext(true),curBuffer(0),codecContext(nullptr),dropframesinflight(false),curBufferOffset(0),currentcachedframe(UINT32_MAX),embeddedvideotag(tag)
 {
 	//The tag is the header, initialize decoding
 	switchCodec(codecId, initdata, datalen, frameRateHint);
@@ -203,6 +205,8 @@ void FFMpegVideoDecoder::switchCodec(LS_VIDEO_CODEC codecId, uint8_t *initdata,
 		codecContext->extradata=initdata;
 		codecContext->extradata_size=datalen;
 	}
+	//Embedded video is decoded frame by frame during upload, so it can't wait for frames in flight
+	configureThreading(embeddedvideotag==nullptr);
 #ifdef HAVE_AVCODEC_OPEN2
 	if(avcodec_open2(codecContext, codec, NULL)<0)
 #else
@@ -217,7 +221,7 @@ void FFMpegVideoDecoder::switchCodec(LS_VIDEO_CODEC codecId, uint8_t *initdata,
 }
 #if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(57, 40, 101)
 FFMpegVideoDecoder::FFMpegVideoDecoder(AVCodecParameters* codecPar, double frameRateHint):
-	ownedContext(true),curBuffer(0),codecContext(NULL),curBufferOffset(0),currentcachedframe(UINT32_MAX),embeddedvideotag(nullptr)
+	ownedContext(true),curBuffer(0),codecContext(NULL),dropframesinflight(false),curBufferOffset(0),currentcachedframe(UINT32_MAX),embeddedvideotag(nullptr)
 {
 	status=INIT;
 #ifdef HAVE_AVCODEC_ALLOC_CONTEXT3
@@ -243,6 +247,7 @@ FFMpegVideoDecoder::FFMpegVideoDecoder(AVCodecParameters* codecPar, double frame
 	}
 	avcodec_parameters_to_context(codecContext,codecPar);
 	AVCodec* codec=avcodec_find_decoder(codecPar->codec_id);
+	configureThreading(true);
 #ifdef HAVE_AVCODEC_OPEN2
 	if(avcodec_open2(codecContext, codec, NULL)<0)
 #else
@@ -258,7 +263,7 @@ FFMpegVideoDecoder::FFMpegVideoDecoder(AVCodecParameters* codecPar, double frame
 }
 #else
 FFMpegVideoDecoder::FFMpegVideoDecoder(AVCodecContext* _c, double frameRateHint):
-	ownedContext(false),curBuffer(0),codecContext(_c),curBufferOffset(0),currentcachedframe(UINT32_MAX),embeddedvideotag(nullptr)
+	ownedContext(false),curBuffer(0),codecContext(_c),dropframesinflight(false),curBufferOffset(0),currentcachedframe(UINT32_MAX),embeddedvideotag(nullptr)
 {
 	frameIn=av_frame_alloc();
 	status=INIT;
@@ -278,6 +283,7 @@ FFMpegVideoDecoder::FFMpegVideoDecoder(AVCodecContext* _c, double frameRateHint)
 			return;
 	}
 	AVCodec* codec=avcodec_find_decoder(codecContext->codec_id);
+	configureThreading(true);
 #ifdef HAVE_AVCODEC_OPEN2
 	if(avcodec_open2(codecContext, codec, NULL)<0)
 #else
@@ -293,6 +299,77 @@ FFMpegVideoDecoder::FFMpegVideoDecoder(AVCodecContext* _c, double frameRateHint)
 }
 #endif
 
+void FFMpegVideoDecoder::configureThreading(bool allowFrameThreads)
+{
+	//0 lets libavcodec use one thread per core
+	codecContext->thread_count=Config::getConfig()->getVideoDecodingThreads();
+	codecContext->thread_type=FF_THREAD_SLICE;
+#if defined HAVE_AVCODEC_SEND_PACKET && defined HAVE_AVCODEC_RECEIVE_FRAME
+	//Frame threading delays the output by one frame per thread,
+	//the frames keep the packet times as pts and are drained on flushing
+	if(allowFrameThreads)
+		codecContext->thread_type|=FF_THREAD_FRAME;
+#endif
+}
+
+#if defined HAVE_AVCODEC_SEND_PACKET && defined HAVE_AVCODEC_RECEIVE_FRAME
+int FFMpegVideoDecoder::sendPacket(AVPacket* pkt, uint32_t time)
+{
+	//The packet time is passed as pts, libavcodec carries it through the frame threads to the frame
+	//decoded from the packet, even if a packet before it didn't produce a frame
+	int64_t pts=pkt->pts;
+	int64_t dts=pkt->dts;
+	pkt->pts=time;
+	pkt->dts=AV_NOPTS_VALUE;
+	int ret=avcodec_send_packet(codecContext, pkt);
+	pkt->pts=pts;
+	pkt->dts=dts;
+	return ret;
+}
+
+uint32_t FFMpegVideoDecoder::getFrameTime(const AVFrame* frame)
+{
+	int64_t time=frame->best_effort_timestamp;
+	if(time==(int64_t)AV_NOPTS_VALUE)
+		time=frame->pts;
+	if(time<0 || time>=UINT32_MAX)
+		return UINT32_MAX;
+	return time;
+}
+#endif
+
+void FFMpegVideoDecoder::checkDropFramesInFlight()
+{
+#if defined HAVE_AVCODEC_SEND_PACKET && defined HAVE_AVCODEC_RECEIVE_FRAME
+	if(dropframesinflight.exchange(false))
+		avcodec_flush_buffers(codecContext);
+#endif
+}
+
+void FFMpegVideoDecoder::drainFrames()
+{
+#if defined HAVE_AVCODEC_SEND_PACKET && defined HAVE_AVCODEC_RECEIVE_FRAME
+	//Frames still in flight in the decoding threads are only returned at the end of the stream
+	if(!codecContext || !(codecContext->active_thread_type&FF_THREAD_FRAME))
+		return;
+	checkDropFramesInFlight();
+	//The mutex is not held, copyFrameToBuffers waits for upload or discardFrame to free a buffer
+	if(avcodec_send_packet(codecContext,nullptr)==0)
+	{
+		while(!dropframesinflight && avcodec_receive_frame(codecContext,frameIn)==0)
+		{
+			uint32_t time=getFrameTime(frameIn);
+			if (time != UINT32_MAX)
+				copyFrameToBuffers(frameIn, time);
+		}
+	}
+	avcodec_flush_buffers(codecContext);
+	//skipAll was called while draining, drop the frames that were added after it
+	if(dropframesinflight.exchange(false))
+		while(discardFrame());
+#endif
+}
+
 FFMpegVideoDecoder::~FFMpegVideoDecoder()
 {
 	while(fenceCount);
@@ -350,6 +427,10 @@ uint32_t FFMpegVideoDecoder::skipUntil(uint32_t time)
 }
 void FFMpegVideoDecoder::skipAll()
 {
+	//The frames still in flight in the decoding threads are dropped by the decoding thread,
+	//this may be called from other threads while it is using the codec.
+	//The flag is set first, so that draining stops adding the frames discarded here
+	dropframesinflight=true;
 	while(!streamingbuffers.isEmpty())
 		discardFrame();
 	while(!embeddedbuffers.isEmpty())
@@ -362,6 +443,9 @@ bool FFMpegVideoDecoder::discardFrame()
 	//We don't want ot block if no frame is available
 	if (embeddedvideotag)
 	{
+		//Give the planes back to the decoder
+		if(!embeddedbuffers.isEmpty())
+			embeddedbuffers.front().releaseFrame();
 		bool ret=embeddedbuffers.nonBlockingPopFront();
 		if(flushing && embeddedbuffers.isEmpty()) //End of our work
 		{
@@ -374,6 +458,8 @@ bool FFMpegVideoDecoder::discardFrame()
 	}
 	else
 	{
+		if(!streamingbuffers.isEmpty())
+			streamingbuffers.front().releaseFrame();
 		bool ret=streamingbuffers.nonBlockingPopFront();
 		if(flushing && streamingbuffers.isEmpty()) //End of our work
 		{
@@ -392,11 +478,12 @@ bool FFMpegVideoDecoder::decodeData(uint8_t* data, uint32_t datalen, uint32_t ti
 	if(datalen==0)
 		return false;
 #if defined HAVE_AVCODEC_SEND_PACKET && defined HAVE_AVCODEC_RECEIVE_FRAME
+	checkDropFramesInFlight();
 	AVPacket pkt;
 	av_init_packet(&pkt);
 	pkt.data=data;
 	pkt.size=datalen;
-	int ret = avcodec_send_packet(codecContext, &pkt);
+	int ret = sendPacket(&pkt, time);
 	while (ret == 0)
 	{
 		ret = avcodec_receive_frame(codecContext,frameIn);
@@ -418,9 +505,9 @@ bool FFMpegVideoDecoder::decodeData(uint8_t* data, uint32_t datalen, uint32_t ti
 			if(status==INIT && fillDataAndCheckValidity())
 				status=VALID;
 	
-			assert(frameIn->pts==(int64_t)AV_NOPTS_VALUE || frameIn->pts==0);
-			if (time != UINT32_MAX)
-				copyFrameToBuffers(frameIn, time);
+			uint32_t frametime=getFrameTime(frameIn);
+			if (frametime != UINT32_MAX)
+				copyFrameToBuffers(frameIn, frametime);
 		}
 	}
 #ifdef HAVE_AV_PACKET_UNREF
@@ -463,7 +550,8 @@ bool FFMpegVideoDecoder::decodeData(uint8_t* data, uint32_t datalen, uint32_t ti
 bool FFMpegVideoDecoder::decodePacket(AVPacket* pkt, uint32_t time)
 {
 #if defined HAVE_AVCODEC_SEND_PACKET && defined HAVE_AVCODEC_RECEIVE_FRAME
-	int ret = avcodec_send_packet(codecContext, pkt);
+	checkDropFramesInFlight();
+	int ret = sendPacket(pkt, time);
 	while (ret == 0)
 	{
 		ret = avcodec_receive_frame(codecContext,frameIn);
@@ -492,7 +580,9 @@ bool FFMpegVideoDecoder::decodePacket(AVPacket* pkt, uint32_t time)
 					LOG(LOG_NOT_IMPLEMENTED,"sending metadata from stream:"<<entry->key<<" "<<entry->value);
 				}
 			}
-			copyFrameToBuffers(frameIn, time);
+			uint32_t frametime=getFrameTime(frameIn);
+			if (frametime != UINT32_MAX)
+				copyFrameToBuffers(frameIn, frametime);
 		}
 	}
 #else
@@ -530,6 +620,13 @@ void FFMpegVideoDecoder::copyFrameToBuffers(const AVFrame* frameIn, uint32_t tim
 	YUVBuffer* curTail=nullptr;
 	curTail=embeddedvideotag ?  &embeddedbuffers.acquireLast() : &streamingbuffers.acquireLast();
 	//Only one thread may access the tail
+#ifdef HAVE_AV_FRAME_REF
+	//Keep a reference to the frame instead of copying the planes,
+	//the buffers are returned to the pool of the decoder when the frame is discarded
+	av_frame_unref(curTail->frame);
+	if(av_frame_ref(curTail->frame,frameIn)<0)
+		LOG(LOG_ERROR,"Cannot reference decoded video frame");
+#else
 	int offset[3]={0,0,0};
 	for(uint32_t y=0;y<frameHeight;y++)
 	{
@@ -545,6 +642,7 @@ void FFMpegVideoDecoder::copyFrameToBuffers(const AVFrame* frameIn, uint32_t tim
 		offset[1]+=frameWidth/2;
 		offset[2]+=frameWidth/2;
 	}
+#endif
 	curTail->time=time;
 	if (embeddedvideotag)
 		embeddedbuffers.commitLast();
@@ -585,10 +683,33 @@ void FFMpegVideoDecoder::upload(uint8_t* data, uint32_t w, uint32_t h)
 	
 	//At least a frame is available
 	YUVBuffer* cur=embeddedvideotag ? &embeddedbuffers.front() : &streamingbuffers.front();
+	uint32_t texw= (frameWidth+15)&0xfffffff0;
+#ifdef HAVE_AV_FRAME_REF
+	const AVFrame* frame=cur->frame;
+	if(frame->data[0]==nullptr)
+		return;
+	if(frame->linesize[0]==int(frameWidth) && frame->linesize[1]==int(frameWidth/2) && frame->linesize[2]==int(frameWidth/2))
+		fastYUV420ChannelsToYUV0Buffer(frame->data[0],frame->data[1],frame->data[2],data,frameWidth,frameHeight);
+	else
+	{
+		//The planes of the decoder are padded, pack them one line at a time
+		for(uint32_t i=0;i<frameHeight;i++)
+			fastYUV420ChannelsToYUV0Buffer(frame->data[0]+i*frame->linesize[0],frame->data[1]+(i/2)*frame->linesize[1],
+					frame->data[2]+(i/2)*frame->linesize[2],data+i*texw*4,frameWidth,1);
+	}
+	if (codecContext->pix_fmt==AV_PIX_FMT_YUVA420P)
+	{
+		for(uint32_t i=0;i<frameHeight;i++)
+		{
+			const uint8_t* alpha=frame->data[3]+i*frame->linesize[3];
+			for(uint32_t j=0;j<frameWidth;j++)
+				data[(i*texw+j)*4+3]=alpha[j];
+		}
+	}
+#else
 	fastYUV420ChannelsToYUV0Buffer(cur->ch[0],cur->ch[1],cur->ch[2],data,frameWidth,frameHeight);
 	if (codecContext->pix_fmt==AV_PIX_FMT_YUVA420P)
 	{
-		uint32_t texw= (frameWidth+15)&0xfffffff0;
 		for(uint32_t i=0;i<frameHeight;i++)
 		{
 			for(uint32_t j=0;j<frameWidth;j++)
@@ -598,10 +719,18 @@ void FFMpegVideoDecoder::upload(uint8_t* data, uint32_t w, uint32_t h)
 			}
 		}
 	}
+#endif
 }
 
 void FFMpegVideoDecoder::YUVBufferGenerator::init(YUVBuffer& buf) const
 {
+#ifdef HAVE_AV_FRAME_REF
+	//The planes are owned by the decoder, only a frame to reference them is needed
+	if(buf.frame)
+		av_frame_unref(buf.frame);
+	else
+		buf.frame=av_frame_alloc();
+#else
 	if(buf.ch[0])
 	{
 		aligned_free(buf.ch[0]);
@@ -615,18 +744,28 @@ void FFMpegVideoDecoder::YUVBufferGenerator::init(YUVBuffer& buf) const
 	aligned_malloc((void**)&buf.ch[2], 16, bufferSize/4);
 	if (hasAlpha)
 		aligned_malloc((void**)&buf.ch[3], 16, bufferSize);
+#endif
 }
 #endif //ENABLE_LIBAVCODEC
 
-void* AudioDecoder::operator new(size_t s)
+AudioDecoder::FrameSamples::~FrameSamples()
 {
-	void* retAddr;
-	aligned_malloc(&retAddr, 16, s);
-	return retAddr;
+	if(samples)
+		aligned_free(samples);
 }
-void AudioDecoder::operator delete(void* addr)
+
+int16_t* AudioDecoder::FrameSamples::reserve(uint32_t size)
 {
-	aligned_free(addr);
+	if(size>capacity)
+	{
+		if(samples)
+			aligned_free(samples);
+		//Round up, so that slightly bigger frames don't reallocate again
+		capacity=(size+4095)&~4095;
+		aligned_malloc((void**)&samples, 16, capacity);
+	}
+	current=samples;
+	return samples;
 }
 
 bool AudioDecoder::discardFrame()
@@ -717,6 +856,7 @@ FFMpegAudioDecoder::FFMpegAudioDecoder(EngineData* eng,LS_AUDIO_CODEC audioCodec
 	switchCodec(audioCodec,initdata,datalen);
 #if HAVE_AVCODEC_DECODE_AUDIO4
 	frameIn=av_frame_alloc();
+	resampleRate=0;
 #endif
 }
 void FFMpegAudioDecoder::switchCodec(LS_AUDIO_CODEC audioCodec, uint8_t* initdata, uint32_t datalen)
@@ -730,6 +870,9 @@ void FFMpegAudioDecoder::switchCodec(LS_AUDIO_CODEC audioCodec, uint8_t* initdat
 #elif defined HAVE_LIBAVRESAMPLE
 	if (resamplecontext)
 		avresample_free(&resamplecontext);
+#endif
+#ifdef HAVE_AVCODEC_DECODE_AUDIO4
+	resampleRate=0;
 #endif
 	AVCodec* codec=avcodec_find_decoder(LSToFFMpegCodec(audioCodec));
 	assert(codec);
@@ -796,6 +939,7 @@ FFMpegAudioDecoder::FFMpegAudioDecoder(EngineData* eng,LS_AUDIO_CODEC lscodec, i
 		status=VALID;
 #ifdef HAVE_AVCODEC_DECODE_AUDIO4
 	frameIn=av_frame_alloc();
+	resampleRate=0;
 #endif
 }
 
@@ -826,6 +970,7 @@ FFMpegAudioDecoder::FFMpegAudioDecoder(EngineData* eng,AVCodecParameters* codecP
 		status=VALID;
 #ifdef HAVE_AVCODEC_DECODE_AUDIO4
 	frameIn=av_frame_alloc();
+	resampleRate=0;
 #endif
 }
 #else
@@ -849,6 +994,7 @@ FFMpegAudioDecoder::FFMpegAudioDecoder(EngineData* eng,AVCodecContext* _c):engin
 		status=VALID;
 #if HAVE_AVCODEC_DECODE_AUDIO4
 	frameIn=av_frame_alloc();
+	resampleRate=0;
 #endif
 }
 #endif
@@ -993,7 +1139,12 @@ uint32_t FFMpegAudioDecoder::decodeData(uint8_t* data, int32_t datalen, uint32_t
 	return maxLen;
 #else
 	FrameSamples& curTail=samplesBuffer.acquireLast();
+#ifdef HAVE_AVCODEC_DECODE_AUDIO4
+	int maxLen=0;
+#else
 	int maxLen=AVCODEC_MAX_AUDIO_FRAME_SIZE;
+	curTail.reserve(maxLen);
+#endif
 #if defined HAVE_AVCODEC_DECODE_AUDIO3 || defined HAVE_AVCODEC_DECODE_AUDIO4
 	AVPacket pkt;
 	av_init_packet(&pkt);
@@ -1096,7 +1247,12 @@ uint32_t FFMpegAudioDecoder::decodePacket(AVPacket* pkt, uint32_t time)
 	return maxLen;
 #else
 	FrameSamples& curTail=samplesBuffer.acquireLast();
+#if HAVE_AVCODEC_DECODE_AUDIO4
+	int maxLen=0;
+#else
 	int maxLen=AVCODEC_MAX_AUDIO_FRAME_SIZE;
+	curTail.reserve(maxLen);
+#endif
 #if HAVE_AVCODEC_DECODE_AUDIO4
 	av_frame_unref(frameIn);
 	int frameOk=0;
@@ -1141,6 +1297,35 @@ uint32_t FFMpegAudioDecoder::decodePacket(AVPacket* pkt, uint32_t time)
 #endif
 }
 #if defined HAVE_AVCODEC_DECODE_AUDIO4 || (defined HAVE_AVCODEC_SEND_PACKET && defined HAVE_AVCODEC_RECEIVE_FRAME)
+bool FFMpegAudioDecoder::convertFrameToStereoS16(int16_t* dest)
+{
+	uint32_t frames=frameIn->nb_samples;
+	bool stereo=codecContext->channels==2;
+	switch(frameIn->format)
+	{
+		case AV_SAMPLE_FMT_S16:
+			if(stereo)
+				memcpy(dest,frameIn->extended_data[0],frames*4);
+			else
+				audioPlanarS16ToS16((int16_t*)frameIn->extended_data[0],(int16_t*)frameIn->extended_data[0],dest,frames);
+			return true;
+		case AV_SAMPLE_FMT_S16P:
+			audioPlanarS16ToS16((int16_t*)frameIn->extended_data[0],(int16_t*)frameIn->extended_data[stereo ? 1 : 0],dest,frames);
+			return true;
+		case AV_SAMPLE_FMT_FLT:
+			if(stereo)
+				audioFloatToS16((float*)frameIn->extended_data[0],dest,frames*2);
+			else
+				audioPlanarFloatToS16((float*)frameIn->extended_data[0],(float*)frameIn->extended_data[0],dest,frames);
+			return true;
+		case AV_SAMPLE_FMT_FLTP:
+			audioPlanarFloatToS16((float*)frameIn->extended_data[0],(float*)frameIn->extended_data[stereo ? 1 : 0],dest,frames);
+			return true;
+		default:
+			return false;
+	}
+}
+
 int FFMpegAudioDecoder::resampleFrameToS16(FrameSamples& curTail)
 {
 	int sample_rate = engine->audio_getSampleRate();
@@ -1154,12 +1339,48 @@ int FFMpegAudioDecoder::resampleFrameToS16(FrameSamples& curTail)
 #else
 	int framesamplerate = frameIn->sample_rate;
 #endif
-	if(frameIn->format == AV_SAMPLE_FMT_S16 && sample_rate == framesamplerate && channel_layout == frameIn->channel_layout)
+	uint32_t frames=frameIn->nb_samples;
+	if(codecContext->channels<=2 && framesamplerate>0 && sample_rate>0)
 	{
-		//This is suboptimal but equivalent to what libavcodec
-		//does for the compatibility version of avcodec_decode_audio3
-		memcpy(curTail.samples, frameIn->extended_data[0], frameIn->linesize[0]);
-		return frameIn->linesize[0];
+		//The formats produced by the flash codecs (mp3, aac, adpcm, pcm) are converted
+		//and resampled here, without going through libswresample for every frame
+		if(sample_rate == framesamplerate)
+		{
+			if(convertFrameToStereoS16(curTail.reserve(frames*4)))
+			{
+				resampleRate=0;
+				return frames*4;
+			}
+		}
+		else
+#if defined HAVE_LIBSWRESAMPLE || defined HAVE_LIBAVRESAMPLE
+		//Linear interpolation has no low-pass filter: upsampling the flash rates only leaves attenuated
+		//images above the input nyquist frequency, downsampling would alias, so that is left to the library
+		if(framesamplerate < sample_rate)
+#endif
+		{
+			//The last frame of the previous call is kept in front of the input to interpolate across calls
+			resampleInput.resize((frames+1)*2);
+			if(convertFrameToStereoS16(resampleInput.data()+2))
+			{
+				if(resampleRate!=framesamplerate)
+				{
+					resampleRate=framesamplerate;
+					resamplePosition=uint64_t(1)<<32;
+					resampleHistory[0]=resampleInput[2];
+					resampleHistory[1]=resampleInput[3];
+				}
+				resampleInput[0]=resampleHistory[0];
+				resampleInput[1]=resampleHistory[1];
+				uint64_t step=(uint64_t(framesamplerate)<<32)/sample_rate;
+				uint32_t maxFrames=((uint64_t(frames)<<32)/step)+2;
+				uint32_t written=audioResampleStereo(resampleInput.data(),frames+1,curTail.reserve(maxFrames*4),maxFrames,resamplePosition,step);
+				resamplePosition-=uint64_t(frames)<<32;
+				resampleHistory[0]=resampleInput[frames*2];
+				resampleHistory[1]=resampleInput[frames*2+1];
+				return written*4;
+			}
+		}
 	}
 	int maxLen;
 #ifdef HAVE_LIBSWRESAMPLE
@@ -1175,27 +1396,23 @@ int FFMpegAudioDecoder::resampleFrameToS16(FrameSamples& curTail)
 		swr_init(resamplecontext);
 	}
 
-	uint8_t *output;
 	int out_samples = swr_get_out_samples(resamplecontext,frameIn->nb_samples);
-	int res = av_samples_alloc(&output, NULL, 2, out_samples,AV_SAMPLE_FMT_S16, 0);
-
-	if (res >= 0)
+	if (out_samples >= 0)
 	{
+		//Convert directly into the frame buffer
+		uint8_t *output = (uint8_t*)curTail.reserve(out_samples*2*av_get_channel_layout_nb_channels(channel_layout));
 		maxLen = swr_convert(resamplecontext, &output, out_samples, (const uint8_t**)frameIn->extended_data, frameIn->nb_samples)*2*av_get_channel_layout_nb_channels(channel_layout);// 2 bytes in AV_SAMPLE_FMT_S16
-		if (maxLen > 0)
-			memcpy(curTail.samples, output, maxLen);
-		else
+		if (maxLen < 0)
 		{
 			LOG(LOG_ERROR, "resampling failed");
-			memset(curTail.samples, 0, frameIn->linesize[0]);
+			memset(curTail.reserve(frameIn->linesize[0]), 0, frameIn->linesize[0]);
 			maxLen = frameIn->linesize[0];
 		}
-		av_freep(&output);
 	}
 	else
 	{
-		LOG(LOG_ERROR, "resampling failed, error code:"<<res);
-		memset(curTail.samples, 0, frameIn->linesize[0]);
+		LOG(LOG_ERROR, "resampling failed, error code:"<<out_samples);
+		memset(curTail.reserve(frameIn->linesize[0]), 0, frameIn->linesize[0]);
 		maxLen = frameIn->linesize[0];
 	}
 #elif defined HAVE_LIBAVRESAMPLE
@@ -1211,25 +1428,20 @@ int FFMpegAudioDecoder::resampleFrameToS16(FrameSamples& curTail)
 		avresample_open(resamplecontext);
 	}
 
-	uint8_t *output;
-	int out_linesize;
 	int out_samples = avresample_available(resamplecontext) + av_rescale_rnd(avresample_get_delay(resamplecontext) + frameIn->linesize[0], sample_rate, sample_rate, AV_ROUND_UP);
-	int res = av_samples_alloc(&output, &out_linesize, frameIn->nb_samples, out_samples, AV_SAMPLE_FMT_S16, 0);
-	if (res >= 0)
-	{
-		maxLen = avresample_convert(resamplecontext, &output, out_linesize, out_samples, frameIn->extended_data, frameIn->linesize[0], frameIn->nb_samples)*2*av_get_channel_layout_nb_channels(channel_layout); // 2 bytes in AV_SAMPLE_FMT_S16
-		memcpy(curTail.samples, output, maxLen);
-		av_freep(&output);
-	}
-	else
-	{
-		LOG(LOG_ERROR, "resampling failed, error code:"<<res);
-		memset(curTail.samples, 0, frameIn->linesize[0]);
+	int out_linesize = out_samples*2*av_get_channel_layout_nb_channels(channel_layout);
+	//Convert directly into the frame buffer
+	uint8_t *output = (uint8_t*)curTail.reserve(out_linesize);
+	maxLen = avresample_convert(resamplecontext, &output, out_linesize, out_samples, frameIn->extended_data, frameIn->linesize[0], frameIn->nb_samples)*2*av_get_channel_layout_nb_channels(channel_layout); // 2 bytes in AV_SAMPLE_FMT_S16
+	if (maxLen < 0)
+	{
+		LOG(LOG_ERROR, "resampling failed, error code:"<<maxLen);
+		memset(curTail.reserve(frameIn->linesize[0]), 0, frameIn->linesize[0]);
 		maxLen = frameIn->linesize[0];
 	}
 #else
 	LOG(LOG_ERROR, "unexpected sample format and can't resample, recompile with libswresample");
-	memset(curTail.samples, 0, frameIn->linesize[0]);
+	memset(curTail.reserve(frameIn->linesize[0]), 0, frameIn->linesize[0]);
 	maxLen = frameIn->linesize[0];
 #endif
 	return maxLen;
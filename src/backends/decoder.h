@@ -23,6 +23,7 @@
 #include "compat.h"
 #include "threading.h"
 #include "backends/graphics.h"
+#include <atomic>
 #ifdef ENABLE_LIBAVCODEC
 extern "C"
 {
@@ -109,6 +110,8 @@ public:
 	virtual bool discardFrame()=0;
 	virtual uint32_t skipUntil(uint32_t time)=0;
 	virtual void skipAll()=0;
+	// returns the frames still in flight in the decoder at the end of the stream, only called on the decoding thread
+	virtual void drainFrames() {}
 	uint32_t getWidth()
 	{
 		return frameWidth;
@@ -179,11 +182,35 @@ private:
 	YUVBuffer& operator=(const YUVBuffer&); /* no impl */
 	public:
 		uint8_t* ch[4];
+#ifdef HAVE_AV_FRAME_REF
+		/*
+		   Reference to the decoded frame, the planes stay in the pool of the decoder
+		   until the buffer is discarded
+		*/
+		AVFrame* frame;
+#endif
 		uint32_t time;
-		YUVBuffer():time(0){ch[0]=nullptr;ch[1]=nullptr;ch[2]=nullptr;ch[3]=nullptr;}
+		YUVBuffer():time(0)
+		{
+			ch[0]=nullptr;ch[1]=nullptr;ch[2]=nullptr;ch[3]=nullptr;
+#ifdef HAVE_AV_FRAME_REF
+			frame=nullptr;
+#endif
+		}
 		~YUVBuffer()
 		{
 			setDecodedData(nullptr);
+#ifdef HAVE_AV_FRAME_REF
+			if(frame)
+				av_frame_free(&frame);
+#endif
+		}
+		void releaseFrame()
+		{
+#ifdef HAVE_AV_FRAME_REF
+			if(frame)
+				av_frame_unref(frame);
+#endif
 		}
 		void setDecodedData(uint8_t* data)
 		{
@@ -217,6 +244,16 @@ private:
 	BlockingCircularQueue<YUVBuffer,2> embeddedbuffers;
 	Mutex mutex;
 	AVFrame* frameIn;
+	// set by skipAll from other threads, the decoding thread drops the frames in flight before it continues
+	std::atomic<bool> dropframesinflight;
+	void configureThreading(bool allowFrameThreads);
+	void checkDropFramesInFlight();
+#if defined HAVE_AVCODEC_SEND_PACKET && defined HAVE_AVCODEC_RECEIVE_FRAME
+	// sends a packet to the decoder with time as its pts
+	int sendPacket(AVPacket* pkt, uint32_t time);
+	// the time of the packet the frame was decoded from, UINT32_MAX if it has none
+	uint32_t getFrameTime(const AVFrame* frame);
+#endif
 	void copyFrameToBuffers(const AVFrame* frameIn, uint32_t time);
 	void setSize(uint32_t w, uint32_t h);
 	bool fillDataAndCheckValidity();
@@ -244,6 +281,7 @@ public:
 	bool discardFrame() override;
 	uint32_t skipUntil(uint32_t time) override;
 	void skipAll() override;
+	void drainFrames() override;
 	void setFlushing() override
 	{
 		flushing=true;
@@ -272,15 +310,28 @@ public:
 class AudioDecoder: public Decoder
 {
 protected:
+	/*
+		The slots of samplesBuffer are a pool of sample buffers: a buffer is allocated
+		the first time its slot is used and grows to the largest frame decoded into it
+	*/
 	class FrameSamples
 	{
+	private:
+		FrameSamples(const FrameSamples&);
+		FrameSamples& operator=(const FrameSamples&);
 	public:
-		int16_t samples[MAX_AUDIO_FRAME_SIZE/2];
-		__attribute__ ((aligned (16)))
+		int16_t* samples;
 		int16_t* current;
 		uint32_t len;
 		uint32_t time;
-		FrameSamples():current(samples),len(0),time(0){}
+		//Size of samples in bytes
+		uint32_t capacity;
+		FrameSamples():samples(NULL),current(NULL),len(0),time(0),capacity(0){}
+		~FrameSamples();
+		/**
+			Makes room for at least size bytes, the previous content is lost
+		*/
+		int16_t* reserve(uint32_t size);
 	};
 	class FrameSamplesGenerator
 	{
@@ -292,11 +343,6 @@ public:
 protected:
 	BlockingCircularQueue<FrameSamples,150> samplesBuffer;
 public:
-	/**
-	  	The AudioDecoder contains audio buffers that must be aligned to 16 bytes, so we redefine the allocator
-	*/
-	void* operator new(size_t);
-	void operator delete(void*);
 	AudioDecoder():sampleRate(0),channelCount(0),initialTime(-1){}
 	virtual ~AudioDecoder(){}
 	virtual void switchCodec(LS_AUDIO_CODEC codecId, uint8_t* initdata, uint32_t datalen)=0;
@@ -368,6 +414,12 @@ private:
 	CodecID LSToFFMpegCodec(LS_AUDIO_CODEC lscodec);
 #ifdef HAVE_AVCODEC_DECODE_AUDIO4
 	AVFrame* frameIn;
+	//State of the linear resampler used for the common sample formats
+	std::vector<int16_t> resampleInput;
+	int resampleRate;
+	uint64_t resamplePosition;
+	int16_t resampleHistory[2];
+	bool convertFrameToStereoS16(int16_t* dest);
 	int resampleFrameToS16(FrameSamples& curTail);
 #endif
 public:
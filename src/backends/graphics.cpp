@@ -30,6 +30,7 @@
 #include "scripting/flash/geom/flashgeom.h"
 #include "scripting/flash/text/flashtext.h"
 #include "scripting/flash/display/BitmapData.h"
+#include "scripting/flash/filters/flashfilters.h"
 #include <pango/pangocairo.h>
 
 using namespace lightspark;
@@ -826,12 +827,151 @@ CairoTokenRenderer::CairoTokenRenderer(const tokensVector &_g, const MATRIX &_m,
 									   , const std::vector<IDrawable::MaskData> &_ms
 									   , float _redMultiplier,float _greenMultiplier,float _blueMultiplier,float _alphaMultiplier
 									   , float _redOffset,float _greenOffset,float _blueOffset,float _alphaOffset
-									   , bool _smoothing, number_t _xmin, number_t _ymin)
+									   , bool _smoothing, number_t _xmin, number_t _ymin
+									   , float _rasterScale, ScaleBucketCache* _cache, int32_t _bucket, uint32_t _generation)
 	: CairoRenderer(_m,_x,_y,_w,_h,_rx,_ry,_rw,_rh,_r,_xs,_ys,_im,_hm,_s,_a,_ms
 					, _redMultiplier,_greenMultiplier,_blueMultiplier,_alphaMultiplier
 					, _redOffset,_greenOffset,_blueOffset,_alphaOffset
-					,_smoothing,_xmin,_ymin),tokens(_g)
+					,_smoothing,_xmin,_ymin),tokens(_g),rasterCache(_cache),rasterBucket(_bucket),rasterGeneration(_generation)
 {
+	rasterScale=_rasterScale;
+}
+
+uint8_t* CairoTokenRenderer::getPixelBuffer(float scalex, float scaley, bool* isBufferOwner)
+{
+	uint8_t* ret=CairoRenderer::getPixelBuffer(scalex,scaley,isBufferOwner);
+	// the cached raster is unfiltered, so the filters can be applied to it with a different scale
+	if (ret && rasterCache)
+		rasterCache->store(rasterBucket,rasterGeneration,ret,width,height);
+	applyFilters(ret);
+	return ret;
+}
+
+std::list<ScaleBucketCache::LRUEntry> ScaleBucketCache::lru;
+uint32_t ScaleBucketCache::totalBytes=0;
+Mutex ScaleBucketCache::mutex;
+
+int32_t ScaleBucketCache::bucketForScale(float scale)
+{
+	if (!(scale > 0))
+		return 0;
+	// buckets are powers of sqrt(2), so the bucket is log2(scale^2).
+	// Rounding up means rasters are only ever shrunk by the GPU, which keeps them sharp
+	int32_t bucket=ceil(log2(scale*scale)-1e-4);
+	if (bucket < MIN_BUCKET)
+		return MIN_BUCKET;
+	if (bucket > MAX_BUCKET)
+		return MAX_BUCKET;
+	return bucket;
+}
+
+float ScaleBucketCache::scaleForBucket(int32_t bucket)
+{
+	return pow(M_SQRT2,bucket);
+}
+
+ScaleBucketCache::~ScaleBucketCache()
+{
+	Locker l(mutex);
+	while (!rasters.empty())
+		evict(rasters.begin());
+}
+
+uint32_t ScaleBucketCache::getGeneration()
+{
+	Locker l(mutex);
+	return generation;
+}
+
+void ScaleBucketCache::evict(std::map<int32_t,Raster>::iterator it)
+{
+	totalBytes-=it->second.size();
+	delete[] it->second.data;
+	lru.erase(it->second.lruPos);
+	rasters.erase(it);
+}
+
+void ScaleBucketCache::clear()
+{
+	Locker l(mutex);
+	generation++;
+	while (!rasters.empty())
+		evict(rasters.begin());
+}
+
+uint8_t* ScaleBucketCache::lookup(int32_t bucket, uint32_t width, uint32_t height)
+{
+	Locker l(mutex);
+	auto it=rasters.find(bucket);
+	if (it==rasters.end())
+		return nullptr;
+	// the bounds may differ by rounding even if the tokens did not change
+	if (it->second.width!=width || it->second.height!=height)
+	{
+		evict(it);
+		return nullptr;
+	}
+	lru.splice(lru.end(),lru,it->second.lruPos);
+	uint8_t* ret=new uint8_t[it->second.size()];
+	memcpy(ret,it->second.data,it->second.size());
+	return ret;
+}
+
+void ScaleBucketCache::store(int32_t bucket, uint32_t _generation, const uint8_t* data, uint32_t width, uint32_t height)
+{
+	const uint32_t size=width*height*4;
+	if (size>MEMORY_BUDGET)
+		return;
+	Locker l(mutex);
+	if (_generation!=generation)
+		return;
+	auto it=rasters.find(bucket);
+	if (it!=rasters.end())
+		evict(it);
+	// make room by dropping the least recently used rasters of all shapes,
+	// rasters of shapes not on stage anymore are not looked up and end up first
+	while (totalBytes+size>MEMORY_BUDGET)
+	{
+		LRUEntry& oldest=lru.front();
+		oldest.cache->evict(oldest.cache->rasters.find(oldest.bucket));
+	}
+	Raster r;
+	r.data=new uint8_t[size];
+	memcpy(r.data,data,size);
+	r.width=width;
+	r.height=height;
+	r.lruPos=lru.insert(lru.end(),LRUEntry{this,bucket});
+	totalBytes+=size;
+	rasters[bucket]=r;
+}
+
+CachedRasterRenderer::CachedRasterRenderer(uint8_t* _data, int32_t _x, int32_t _y, int32_t _w, int32_t _h, int32_t _rx, int32_t _ry, int32_t _rw, int32_t _rh, float _r, float _xs, float _ys, bool _im, bool _hm,
+		float _a, const std::vector<MaskData>& _ms,
+		float _redMultiplier, float _greenMultiplier, float _blueMultiplier, float _alphaMultiplier,
+		float _redOffset, float _greenOffset, float _blueOffset, float _alphaOffset, float _rasterScale)
+	: IDrawable(_w, _h, _x, _y, _rw, _rh, _rx, _ry, _r, _xs, _ys, _im, _hm,_a, _ms,
+				_redMultiplier,_greenMultiplier,_blueMultiplier,_alphaMultiplier,
+				_redOffset,_greenOffset,_blueOffset,_alphaOffset)
+	, data(_data)
+{
+	rasterScale=_rasterScale;
+}
+
+CachedRasterRenderer::~CachedRasterRenderer()
+{
+	if (data)
+		delete[] data;
+}
+
+uint8_t* CachedRasterRenderer::getPixelBuffer(float scalex, float scaley, bool* isBufferOwner)
+{
+	if (isBufferOwner)
+		*isBufferOwner=true;
+	// ownership of the raster is passed to the caller
+	uint8_t* ret=data;
+	data=nullptr;
+	applyFilters(ret);
+	return ret;
 }
 
 void CairoRenderer::convertBitmapWithAlphaToCairo(std::vector<uint8_t, reporter_allocator<uint8_t>>& data, uint8_t* inData, uint32_t width,
@@ -1214,6 +1354,7 @@ const TextureChunk& AsyncDrawJob::getTexture()
 	surface.greenOffset=drawable->getGreenOffset();
 	surface.blueOffset=drawable->getBlueOffset();
 	surface.alphaOffset=drawable->getAlphaOffset();
+	surface.rasterScale=drawable->getRasterScale();
 	return *surface.tex;
 }
 
@@ -1242,6 +1383,22 @@ IDrawable::~IDrawable()
 		it->m=nullptr;
 		it++;
 	}
+	// the filters are released in the vm thread
+	for (auto itf = filters.begin(); itf != filters.end(); itf++)
+	{
+		if (getVm((*itf)->getSystemState()))
+			getVm((*itf)->getSystemState())->addDeletableObject(*itf);
+		else
+			(*itf)->decRef();
+	}
+}
+
+void IDrawable::applyFilters(uint8_t* buf)
+{
+	if (!buf)
+		return;
+	for (auto it = filters.begin(); it != filters.end(); it++)
+		(*it)->applyFilter((uint32_t*)buf,width,height,filterScaleX,filterScaleY);
 }
 
 BitmapRenderer::BitmapRenderer(_NR<BitmapContainer> _data, int32_t _x, int32_t _y, int32_t _w, int32_t _h, int32_t _rx, int32_t _ry, int32_t _rw, int32_t _rh, float _r, float _xs, float _ys, bool _im, bool _hm,
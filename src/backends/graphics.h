@@ -25,6 +25,8 @@
 
 #include "compat.h"
 #include <vector>
+#include <map>
+#include <list>
 #include "swftypes.h"
 #include "threading.h"
 #include <cairo.h>
@@ -38,6 +40,7 @@ namespace lightspark
 class DisplayObject;
 class InvalidateQueue;
 class ColorTransform;
+class BitmapFilter;
 
 class TextureChunk
 {
@@ -72,7 +75,7 @@ class CachedSurface
 public:
 	CachedSurface():tex(nullptr),xOffset(0),yOffset(0),xOffsetTransformed(0),yOffsetTransformed(0),widthTransformed(0),heightTransformed(0),alpha(1.0),rotation(0.0),xscale(1.0),yscale(1.0)
 	  , redMultiplier(1.0), greenMultiplier(1.0), blueMultiplier(1.0), alphaMultiplier(1.0), redOffset(0.0), greenOffset(0.0), blueOffset(0.0), alphaOffset(0.0)
-	  ,isMask(false),hasMask(false),isChunkOwner(true){}
+	  ,rasterScale(1.0),isMask(false),hasMask(false),isChunkOwner(true){}
 	~CachedSurface()
 	{
 		if (isChunkOwner && tex)
@@ -97,11 +100,77 @@ public:
 	float greenOffset;
 	float blueOffset;
 	float alphaOffset;
+	/*
+	 * The scale the texture was rasterized at, relative to the local coordinates
+	 * of the object. xscale/yscale are divided by this when rendering
+	 */
+	float rasterScale;
 	bool isMask;
 	bool hasMask;
 	bool isChunkOwner;
 };
 
+/*
+ * Cache of the rasterizations of a shape at quantized scales.
+ * Scales are bucketed in powers of sqrt(2), so the small scale changes of
+ * tweened zoom animations map to the same bucket and the raster of the
+ * bucket is scaled by the GPU instead of being rasterized again.
+ * Buckets are only used while the scale changes, shapes with a stable scale
+ * are rasterized at their exact scale and not cached here.
+ * Rasters are rendered at the next bucket above the requested scale, so the
+ * GPU only shrinks them by a factor between 1/sqrt(2) and 1.
+ * The memory used by all caches together is limited to MEMORY_BUDGET bytes,
+ * when it is exceeded the least recently used rasters of any cache are dropped.
+ * Rasters are stored by the threads executing the AsyncDrawJobs and looked up
+ * from the VM thread, so all accesses are protected by a mutex shared by all caches
+ */
+class ScaleBucketCache
+{
+public:
+	static const int32_t MIN_BUCKET=-6;
+	static const int32_t MAX_BUCKET=6;
+	static const uint32_t MEMORY_BUDGET=64*1024*1024;
+	/* Returns the smallest bucket whose scale is not below the given scale */
+	static int32_t bucketForScale(float scale);
+	/* Returns the scale rasters of the given bucket are rendered at */
+	static float scaleForBucket(int32_t bucket);
+private:
+	struct LRUEntry
+	{
+		ScaleBucketCache* cache;
+		int32_t bucket;
+	};
+	struct Raster
+	{
+		uint8_t* data;
+		uint32_t width;
+		uint32_t height;
+		/* position of this raster in the LRU list */
+		std::list<LRUEntry>::iterator lruPos;
+		uint32_t size() const { return width*height*4; }
+	};
+	/* the rasters of all caches, least recently used first */
+	static std::list<LRUEntry> lru;
+	static uint32_t totalBytes;
+	static Mutex mutex;
+	std::map<int32_t,Raster> rasters;
+	/* Incremented on every clear(), rasters of older generations are not stored */
+	uint32_t generation;
+	void evict(std::map<int32_t,Raster>::iterator it);
+public:
+	ScaleBucketCache():generation(0){}
+	~ScaleBucketCache();
+	uint32_t getGeneration();
+	/* Drops all cached rasters, to be called when the shape changes */
+	void clear();
+	/*
+	 * Copies the raster of the given bucket into a newly allocated buffer
+	 * Returns nullptr if there is no raster of the requested size
+	 */
+	uint8_t* lookup(int32_t bucket, uint32_t width, uint32_t height);
+	/* Stores a copy of the raster, evicting the least recently used rasters if needed */
+	void store(int32_t bucket, uint32_t _generation, const uint8_t* data, uint32_t width, uint32_t height);
+};
 
 class ITextureUploadable
 {
@@ -162,8 +231,20 @@ protected:
 	float greenOffset;
 	float blueOffset;
 	float alphaOffset;
+	/*
+	   The scale the pixel buffer is rasterized at, relative to the local coordinates
+	*/
+	float rasterScale;
+	/*
+	   Private clones of the filters of the drawn object, they are applied to the pixel buffer
+	   outside of the vm thread. filterScaleX/Y convert the filter distances to pixels of the buffer
+	*/
+	std::vector<BitmapFilter*> filters;
+	float filterScaleX;
+	float filterScaleY;
 	bool isMask;
 	bool hasMask;
+	void applyFilters(uint8_t* buf);
 public:
 	IDrawable(int32_t w, int32_t h, int32_t x, int32_t y,
 		int32_t rw, int32_t rh, int32_t rx, int32_t ry, float r,
@@ -176,7 +257,7 @@ public:
 		alpha(a),xscale(xs),yscale(ys),
 		redMultiplier(_redMultiplier),greenMultiplier(_greenMultiplier),blueMultiplier(_blueMultiplier),alphaMultiplier(_alphaMultiplier),
 		redOffset(_redOffset),greenOffset(_greenOffset),blueOffset(_blueOffset),alphaOffset(_alphaOffset),
-		isMask(im),hasMask(hm) {}
+		rasterScale(1.0),filterScaleX(1.0),filterScaleY(1.0),isMask(im),hasMask(hm) {}
 	virtual ~IDrawable();
 	/*
 	 * This method returns a raster buffer of the image
@@ -211,6 +292,16 @@ public:
 	float getGreenOffset() const { return greenOffset; }
 	float getBlueOffset() const { return blueOffset; }
 	float getAlphaOffset() const { return alphaOffset; }
+	float getRasterScale() const { return rasterScale; }
+	/*
+	 * The drawable takes ownership of the filters
+	 */
+	void setFilters(const std::vector<BitmapFilter*>& f, float scalex, float scaley)
+	{
+		filters=f;
+		filterScaleX=scalex;
+		filterScaleY=scaley;
+	}
 };
 
 class AsyncDrawJob: public IThreadJob, public ITextureUploadable
@@ -302,6 +393,12 @@ private:
 	   The tokens to be drawn
 	*/
 	const tokensVector tokens;
+	/*
+	   If not null, the rendered raster is stored in this cache for the given bucket
+	*/
+	ScaleBucketCache* rasterCache;
+	int32_t rasterBucket;
+	uint32_t rasterGeneration;
 	/*
 	 * This is run by CairoRenderer::execute()
 	 */
@@ -319,6 +416,8 @@ public:
 	   @param _a The alpha factor to be applied
 	   @param _ms The masks that must be applied
 	   @param _smoothing indicates if the tokens should be rendered with antialiasing
+	   @param _rasterScale The scale the tokens are rasterized at, already applied to _w, _h and _s
+	   @param _cache If not null, the raster is stored in this cache for _bucket
 	*/
 	CairoTokenRenderer(const tokensVector& _g, const MATRIX& _m,
 			int32_t _x, int32_t _y, int32_t _w, int32_t _h,
@@ -329,7 +428,9 @@ public:
 			float _redMultiplier, float _greenMultiplier, float _blueMultiplier, float _alphaMultiplier,
 			float _redOffset, float _greenOffset, float _blueOffset, float _alphaOffset,
 			bool _smoothing,
-			number_t _xmin, number_t _ymin);
+			number_t _xmin, number_t _ymin,
+			float _rasterScale=1.0, ScaleBucketCache* _cache=nullptr, int32_t _bucket=0, uint32_t _generation=0);
+	uint8_t* getPixelBuffer(float scalex, float scaley, bool* isBufferOwner=nullptr) override;
 	/*
 	   Hit testing helper. Uses cairo to find if a point in inside the shape
 
@@ -445,6 +546,31 @@ public:
 	void applyCairoMask(cairo_t* cr, int32_t offsetX, int32_t offsetY, float scalex, float scaley) const override {}
 };
 
+/*
+ * Drawable for a raster taken from a ScaleBucketCache, no rendering is needed
+ */
+class CachedRasterRenderer: public IDrawable
+{
+private:
+	uint8_t* data;
+public:
+	/*
+	   @param _data The raster, the pointer is now owned by this instance
+	*/
+	CachedRasterRenderer(uint8_t* _data, int32_t _x, int32_t _y, int32_t _w, int32_t _h
+				  , int32_t _rx, int32_t _ry, int32_t _rw, int32_t _rh, float _r
+				  , float _xs, float _ys
+				  , bool _im, bool _hm
+				  , float _a, const std::vector<MaskData>& m
+				  , float _redMultiplier, float _greenMultiplier, float _blueMultiplier, float _alphaMultiplier
+				  , float _redOffset, float _greenOffset, float _blueOffset, float _alphaOffset
+				  , float _rasterScale);
+	~CachedRasterRenderer();
+	//IDrawable interface
+	uint8_t* getPixelBuffer(float scalex, float scaley, bool* isBufferOwner=nullptr) override;
+	void applyCairoMask(cairo_t* cr, int32_t offsetX, int32_t offsetY, float scalex, float scaley) const override {}
+};
+
 class InvalidateQueue
 {
 public:
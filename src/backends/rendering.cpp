@@ -58,7 +58,7 @@ void RenderThread::wait()
 
 RenderThread::RenderThread(SystemState* s):GLRenderContext(),
 	m_sys(s),status(CREATED),
-	prevUploadJob(nullptr),
+	prevUploadJob(nullptr),pixelUnpackBuffer(0),
 	renderNeeded(false),uploadNeeded(false),resizeNeeded(false),newTextureNeeded(false),event(0),newWidth(0),newHeight(0),scaleX(1),scaleY(1),
 	offsetX(0),offsetY(0),tempBufferAcquired(false),frameCount(0),secsCount(0),initialized(0),refreshNeeded(false),screenshotneeded(false),inSettings(false),canrender(false),
 	cairoTextureContextSettings(nullptr),cairoTextureContext(nullptr)
@@ -529,6 +529,8 @@ void RenderThread::commonGLDeinit()
 	engineData->exec_glDeleteTextures(1, &cairoTextureID);
 	engineData->exec_glDeleteTextures(1, &cairoTextureIDSettings);
 	engineData->exec_glDeleteTextures(1, &maskTextureID);
+	if(pixelUnpackBuffer)
+		engineData->exec_glDeleteBuffers(1,&pixelUnpackBuffer);
 }
 
 void RenderThread::commonGLInit(int width, int height)
@@ -906,7 +908,8 @@ void RenderThread::draw(bool force)
 	if(diff>0) /* is one seconds elapsed? */
 	{
 		time_s=time_d;
-		LOG(LOG_INFO,_("FPS: ") << dec << frameCount<<" "<<(getVm(m_sys) ? getVm(m_sys)->getEventQueueSize() : 0));
+		ABCVm* vm=getVm(m_sys);
+		LOG(LOG_INFO,_("FPS: ") << dec << frameCount<<" "<<(vm ? vm->getEventQueueSize() : 0)<<" max event latency (us): "<<(vm ? vm->getMaxEventLatency() : 0));
 		frameCount=0;
 		secsCount++;
 	}
@@ -1103,6 +1106,36 @@ TextureChunk RenderThread::allocateTexture(uint32_t w, uint32_t h, bool compact)
 	return ret;
 }
 
+/*
+ * Copy a block of the source data and repeat its outer pixels on each side
+ * to clamp the texture sampling to the edge of the block
+ */
+static void copyClampedChunk(uint8_t* data_clamp, const uint8_t* data, uint32_t w, uint32_t curX, uint32_t curY, uint32_t sizeX, uint32_t sizeY)
+{
+	// copy chunk data
+	for(uint32_t j=1;j<sizeY-1;j++) {
+		memcpy(data_clamp+4*j*sizeX+4, data+4*w*((j-1)+curY)+4*curX, (sizeX-2)*4);
+	}
+	for (uint32_t j = 0; j < sizeY; j++)
+	{
+		// clamp left border to edge
+		data_clamp[j*sizeX*4  ] = data_clamp[j*sizeX*4+4  ];
+		data_clamp[j*sizeX*4+1] = data_clamp[j*sizeX*4+4+1];
+		data_clamp[j*sizeX*4+2] = data_clamp[j*sizeX*4+4+2];
+		data_clamp[j*sizeX*4+3] = data_clamp[j*sizeX*4+4+3];
+
+		// clamp right border to edge
+		data_clamp[j*sizeX*4 + (sizeX-1)*4  ] = data_clamp[j*sizeX*4 + (sizeX-2)*4  ];
+		data_clamp[j*sizeX*4 + (sizeX-1)*4+1] = data_clamp[j*sizeX*4 + (sizeX-2)*4+1];
+		data_clamp[j*sizeX*4 + (sizeX-1)*4+2] = data_clamp[j*sizeX*4 + (sizeX-2)*4+2];
+		data_clamp[j*sizeX*4 + (sizeX-1)*4+3] = data_clamp[j*sizeX*4 + (sizeX-2)*4+3];
+	}
+	// clamp top border to edge
+	memcpy(data_clamp, data_clamp+4*sizeX, sizeX*4);
+	// clamp bottom border to edge
+	memcpy(data_clamp+(sizeY-1)*sizeX*4, data_clamp+(sizeY-2)*sizeX*4, sizeX*4);
+}
+
 void RenderThread::loadChunkBGRA(const TextureChunk& chunk, uint32_t w, uint32_t h, uint8_t* data)
 {
 	//Fast bailout if the TextureChunk is not valid
@@ -1117,6 +1150,52 @@ void RenderThread::loadChunkBGRA(const TextureChunk& chunk, uint32_t w, uint32_t
 	const uint32_t numberOfChunks=chunk.getNumberOfChunks();
 	const uint32_t blocksPerSide=largeTextureSize/CHUNKSIZE;
 	const uint32_t blocksW=((w+CHUNKSIZE_REAL-1)/CHUNKSIZE_REAL);
+	//Stage all the blocks in a pixel unpack buffer, so that the driver
+	//can transfer them to the texture without stalling the render thread.
+	//The buffer is kept across uploads and its storage is orphaned on every upload
+	uint8_t* staging=nullptr;
+	if(engineData->supportPixelBufferObject)
+	{
+		if(pixelUnpackBuffer==0)
+			engineData->exec_glGenBuffers(1,&pixelUnpackBuffer);
+		engineData->exec_glBindBuffer_GL_PIXEL_UNPACK_BUFFER(pixelUnpackBuffer);
+		engineData->exec_glBufferData_GL_PIXEL_UNPACK_BUFFER_GL_STREAM_DRAW(numberOfChunks*CHUNKSIZE*CHUNKSIZE*4,nullptr);
+		staging=engineData->exec_glMapBuffer_GL_PIXEL_UNPACK_BUFFER_GL_WRITE_ONLY();
+		if(staging==nullptr)
+			engineData->exec_glBindBuffer_GL_PIXEL_UNPACK_BUFFER(0);
+	}
+	if(staging)
+	{
+		uint32_t loaded=0;
+		for(;loaded<numberOfChunks;loaded++)
+		{
+			uint32_t curX=(loaded%blocksW)*CHUNKSIZE_REAL;
+			uint32_t curY=(loaded/blocksW)*CHUNKSIZE_REAL;
+			if (curX > w || curY > h)
+				break;
+			uint32_t sizeX=min(int(w-curX),CHUNKSIZE_REAL)+2;
+			uint32_t sizeY=min(int(h-curY),CHUNKSIZE_REAL)+2;
+			copyClampedChunk(staging+loaded*CHUNKSIZE*CHUNKSIZE*4, data, w, curX, curY, sizeX, sizeY);
+		}
+		//The content of the buffer is undefined if unmapping fails, the blocks are loaded from memory then
+		if(engineData->exec_glUnmapBuffer_GL_PIXEL_UNPACK_BUFFER())
+		{
+			for(uint32_t i=0;i<loaded;i++)
+			{
+				uint32_t curX=(i%blocksW)*CHUNKSIZE_REAL;
+				uint32_t curY=(i/blocksW)*CHUNKSIZE_REAL;
+				uint32_t sizeX=min(int(w-curX),CHUNKSIZE_REAL)+2;
+				uint32_t sizeY=min(int(h-curY),CHUNKSIZE_REAL)+2;
+				const uint32_t blockX=((chunk.chunks[i]%blocksPerSide)*CHUNKSIZE);
+				const uint32_t blockY=((chunk.chunks[i]/blocksPerSide)*CHUNKSIZE);
+				//With a bound pixel unpack buffer the pointer is an offset into the buffer
+				engineData->exec_glTexSubImage2D_GL_TEXTURE_2D(0, blockX, blockY, sizeX, sizeY, (const void*)(uintptr_t)(i*CHUNKSIZE*CHUNKSIZE*4));
+			}
+			engineData->exec_glBindBuffer_GL_PIXEL_UNPACK_BUFFER(0);
+			return;
+		}
+		engineData->exec_glBindBuffer_GL_PIXEL_UNPACK_BUFFER(0);
+	}
 	uint8_t data_clamp[4*CHUNKSIZE*CHUNKSIZE];
 	for(uint32_t i=0;i<numberOfChunks;i++)
 	{
@@ -1128,29 +1207,7 @@ void RenderThread::loadChunkBGRA(const TextureChunk& chunk, uint32_t w, uint32_t
 		uint32_t sizeY=min(int(h-curY),CHUNKSIZE_REAL)+2;
 		const uint32_t blockX=((chunk.chunks[i]%blocksPerSide)*CHUNKSIZE);
 		const uint32_t blockY=((chunk.chunks[i]/blocksPerSide)*CHUNKSIZE);
-
-		// copy chunk data
-		for(uint32_t j=1;j<sizeY-1;j++) {
-			memcpy(data_clamp+4*j*sizeX+4, data+4*w*((j-1)+curY)+4*curX, (sizeX-2)*4);
-		}
-		for (uint32_t j = 0; j < sizeY; j++)
-		{
-			// clamp left border to edge
-			data_clamp[j*sizeX*4  ] = data_clamp[j*sizeX*4+4  ];
-			data_clamp[j*sizeX*4+1] = data_clamp[j*sizeX*4+4+1];
-			data_clamp[j*sizeX*4+2] = data_clamp[j*sizeX*4+4+2];
-			data_clamp[j*sizeX*4+3] = data_clamp[j*sizeX*4+4+3];
-	
-			// clamp right border to edge
-			data_clamp[j*sizeX*4 + (sizeX-1)*4  ] = data_clamp[j*sizeX*4 + (sizeX-2)*4  ];
-			data_clamp[j*sizeX*4 + (sizeX-1)*4+1] = data_clamp[j*sizeX*4 + (sizeX-2)*4+1];
-			data_clamp[j*sizeX*4 + (sizeX-1)*4+2] = data_clamp[j*sizeX*4 + (sizeX-2)*4+2];
-			data_clamp[j*sizeX*4 + (sizeX-1)*4+3] = data_clamp[j*sizeX*4 + (sizeX-2)*4+3];
-		}
-		// clamp top border to edge
-		memcpy(data_clamp, data_clamp+4*sizeX, sizeX*4);
-		// clamp bottom border to edge
-		memcpy(data_clamp+(sizeY-1)*sizeX*4, data_clamp+(sizeY-2)*sizeX*4, sizeX*4);
+		copyClampedChunk(data_clamp, data, w, curX, curY, sizeX, sizeY);
 		engineData->exec_glTexSubImage2D_GL_TEXTURE_2D(0, blockX, blockY, sizeX, sizeY, data_clamp);
 	}
 }
@@ -48,6 +48,8 @@ private:
 	void commonGLResize();
 	void commonGLDeinit();
 	ITextureUploadable* prevUploadJob;
+	//Staging buffer for the texture uploads, if supported by the driver
+	uint32_t pixelUnpackBuffer;
 	uint32_t allocateNewGLTexture() const;
 	LargeTexture& allocateNewTexture();
 	bool allocateChunkOnTextureCompact(LargeTexture& tex, TextureChunk& ret, uint32_t blocksW, uint32_t blocksH);
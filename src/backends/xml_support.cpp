@@ -26,14 +26,15 @@
 using namespace lightspark;
 using namespace std;
 
-const pugi::xml_node XMLBase::buildFromString(const tiny_string& str,
+const pugi::xml_node XMLBase::buildFromString(pugi::xml_document& doc,
+										const tiny_string& str,
 										unsigned int xmlparsemode,
 										const tiny_string& default_ns)
 {
 	tiny_string buf = quirkEncodeNull(removeWhitespace(str));
 	if (buf.numBytes() > 0 && buf.charAt(0) == '<')
 	{
-		pugi::xml_parse_result res = xmldoc.load_buffer((void*)buf.raw_buf(),buf.numBytes(),xmlparsemode);
+		pugi::xml_parse_result res = doc.load_buffer((void*)buf.raw_buf(),buf.numBytes(),xmlparsemode);
 		switch (res.status)
 		{
 			case pugi::status_ok:
@@ -66,10 +67,10 @@ const pugi::xml_node XMLBase::buildFromString(const tiny_string& str,
 	}
 	else
 	{
-		pugi::xml_node n = xmldoc.append_child(pugi::node_pcdata);
+		pugi::xml_node n = doc.append_child(pugi::node_pcdata);
 		n.set_value(str.raw_buf());
 	}
-	return xmldoc.root();
+	return doc.root();
 }
 const tiny_string XMLBase::encodeToXML(const tiny_string value, bool bIsAttribute)
 {
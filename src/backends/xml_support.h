@@ -35,6 +35,13 @@ protected:
 	//The parser will destroy the document and all the childs on destruction
 	pugi::xml_document xmldoc;
 	const pugi::xml_node buildFromString(const tiny_string& str,
+										unsigned int xmlparsemode,
+										const tiny_string& default_ns=tiny_string())
+	{
+		return buildFromString(xmldoc,str,xmlparsemode,default_ns);
+	}
+	static const pugi::xml_node buildFromString(pugi::xml_document& doc,
+										const tiny_string& str,
 										unsigned int xmlparsemode,
 										const tiny_string& default_ns=tiny_string());
 
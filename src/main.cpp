@@ -251,12 +251,17 @@ int main(int argc, char* argv[])
 	char* paramsFileName=nullptr;
 #ifdef PROFILING_SUPPORT
 	char* profilingFileName=nullptr;
+#ifndef NDEBUG
+	char* opcodeProfileFileName=nullptr;
+#endif
 #endif
 	char *HTTPcookie=nullptr;
 	SecurityManager::SANDBOXTYPE sandboxType=SecurityManager::LOCAL_WITH_FILE;
 	bool useInterpreter=true;
 	bool useFastInterpreter=false;
 	bool useJit=false;
+	bool useBaselineJit=true;
+	uint32_t vmStackSize=16;
 	bool ignoreUnhandledExceptions = false;
 	SystemState::ERROR_TYPE exitOnError=SystemState::ERROR_PARSING;
 	LOG_LEVEL log_level=LOG_INFO;
@@ -297,6 +302,8 @@ int main(int argc, char* argv[])
 			useFastInterpreter=true;
 		else if(strcmp(argv[i],"-j")==0 || strcmp(argv[i],"--enable-jit")==0)
 			useJit=true;
+		else if(strcmp(argv[i],"-nb")==0 || strcmp(argv[i],"--disable-baseline-jit")==0)
+			useBaselineJit=false;
 		else if(strcmp(argv[i],"-ne")==0 || strcmp(argv[i],"--ignore-unhandled-exceptions")==0)
 			ignoreUnhandledExceptions=true;
 		else if(strcmp(argv[i],"-l")==0 || strcmp(argv[i],"--log-level")==0)
@@ -310,6 +317,17 @@ int main(int argc, char* argv[])
 
 			log_level=(LOG_LEVEL) min(4, max(0, atoi(argv[i])));
 		}
+		else if(strcmp(argv[i],"--vm-stack-size")==0)
+		{
+			i++;
+			if(i==argc)
+			{
+				fileName=nullptr;
+				break;
+			}
+
+			vmStackSize=min(1024, max(1, atoi(argv[i])));
+		}
 		else if(strcmp(argv[i],"-p")==0 || 
 			strcmp(argv[i],"--parameters-file")==0)
 		{
@@ -333,6 +351,18 @@ int main(int argc, char* argv[])
 			}
 			profilingFileName=argv[i];
 		}
+#endif
+#ifndef NDEBUG
+		else if(strcmp(argv[i],"--opcode-profile")==0)
+		{
+			i++;
+			if(i==argc)
+			{
+				fileName=nullptr;
+				break;
+			}
+			opcodeProfileFileName=argv[i];
+		}
 #endif
 		else if(strcmp(argv[i],"-s")==0 || 
 			strcmp(argv[i],"--security-sandbox")==0)
@@ -395,10 +425,14 @@ int main(int argc, char* argv[])
 #ifdef LLVM_ENABLED
 			" [--enable-jit|-j]" <<
 #endif
+			" [--disable-baseline-jit|-nb] [--vm-stack-size MB]" <<
 			" [--log-level|-l 0-4] [--parameters-file|-p params-file] [--security-sandbox|-s sandbox]" <<
 			" [--exit-on-error] [--HTTP-cookies cookie] [--air] [--avmplus] [--disable-rendering]" <<
 #ifdef PROFILING_SUPPORT
 			" [--profiling-output|-o profiling-file]" <<
+#endif
+#ifndef NDEBUG
+			" [--opcode-profile opcode-profile-file]" <<
 #endif
 			" [--ignore-unhandled-exceptions|-ne]"
 			" [--version|-v]" <<
@@ -474,6 +508,8 @@ int main(int argc, char* argv[])
 	sys->useInterpreter=useInterpreter;
 	sys->useFastInterpreter=useFastInterpreter;
 	sys->useJit=useJit;
+	sys->useBaselineJit=useBaselineJit;
+	sys->vmStackSize=vmStackSize*1024*1024;
 	sys->ignoreUnhandledExceptions=ignoreUnhandledExceptions;
 	sys->exitOnError=exitOnError;
 	if(paramsFileName)
@@ -481,6 +517,14 @@ int main(int argc, char* argv[])
 #ifdef PROFILING_SUPPORT
 	if(profilingFileName)
 		sys->setProfilingOutput(profilingFileName);
+#endif
+#ifndef NDEBUG
+	if(opcodeProfileFileName)
+	{
+		sys->setOpcodeProfileOutput(opcodeProfileFileName);
+		//Native code bypasses the profiler in the interpreter loop
+		sys->useBaselineJit=false;
+	}
 #endif
 	if(HTTPcookie)
 		sys->setCookies(HTTPcookie);
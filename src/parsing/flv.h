@@ -56,6 +56,7 @@ public:
 	VideoTag() {}
 	VideoTag(std::istream& s);
 	uint32_t getDataSize() const { return dataSize; }
+	uint32_t getTimestamp() const { return timestamp; }
 	uint32_t getTotalLen() const { return totalLen; }
 };
 
@@ -25,6 +25,7 @@
 #include "toplevel/Error.h"
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
 #include <assert.h>
 
 
@@ -115,6 +116,52 @@ int zlib_filter::fillBuffer()
 	return sizeof(buffer) - strm.avail_out;
 }
 
+zlib_inflater::zlib_inflater(bool raw):finished(false)
+{
+	strm.zalloc = Z_NULL;
+	strm.zfree = Z_NULL;
+	strm.opaque = Z_NULL;
+	strm.avail_in = 0;
+	strm.next_in = Z_NULL;
+	if (inflateInit2(&strm, raw ? -MAX_WBITS : MAX_WBITS) != Z_OK)
+		throw lightspark::RunTimeException("Failed to initialize ZLib");
+}
+
+zlib_inflater::~zlib_inflater()
+{
+	inflateEnd(&strm);
+}
+
+bool zlib_inflater::append(const uint8_t* data, uint32_t len, vector<uint8_t>& out)
+{
+	strm.next_in = (unsigned char*)data;
+	strm.avail_in = len;
+	size_t used = out.size();
+	while (!finished)
+	{
+		//Grow the output geometrically, so big streams are not copied too often
+		if (out.size()-used < 4096)
+			out.resize(max(out.size()*2, used+65536));
+		strm.next_out = &out[used];
+		strm.avail_out = out.size()-used;
+		int ret = inflate(&strm, Z_NO_FLUSH);
+		used = out.size()-strm.avail_out;
+		if (ret == Z_STREAM_END)
+			finished = true;
+		else if (ret == Z_BUF_ERROR)
+			break; //More input is needed
+		else if (ret != Z_OK)
+		{
+			out.resize(used);
+			return false;
+		}
+		else if (strm.avail_in == 0 && strm.avail_out != 0)
+			break;
+	}
+	out.resize(used);
+	return true;
+}
+
 bytes_buf::bytes_buf(const uint8_t* b, int l):buf(b),len(l)
 {
 	setg((char*)buf,(char*)buf,(char*)buf+len);
@@ -26,6 +26,7 @@
 #include <streambuf>
 #include <fstream>
 #include <cinttypes>
+#include <vector>
 #include <zlib.h>
 #include <lzma.h>
 
@@ -67,6 +68,28 @@ public:
 	~zlib_filter();
 };
 
+/*
+ * Incremental zlib or raw deflate decompression. Compressed data can be passed in pieces,
+ * everything that can be decompressed so far is appended to the output.
+ * It is only fed complete buffers by ByteArray, URLStream and Socket pass the received bytes
+ * to the application unchanged and HTTP content encodings are decoded by curl
+ */
+class zlib_inflater
+{
+private:
+	z_stream strm;
+	bool finished;
+public:
+	zlib_inflater(bool raw);
+	~zlib_inflater();
+	/*
+	 * Decompresses len bytes of data and appends the result to out.
+	 * Returns false if the data is not valid, data after the end of the stream is ignored
+	 */
+	bool append(const uint8_t* data, uint32_t len, std::vector<uint8_t>& out);
+	bool isFinished() const { return finished; }
+};
+
 class liblzma_filter: public uncompressing_filter
 {
 private:
@@ -2064,8 +2064,10 @@ void PlaceObject3Tag::setProperties(DisplayObject *obj, DisplayObjectContainer *
 		obj->setVisible(Visible);
 	if (this->SurfaceFilterList.Filters.size())
 	{
-		if (obj->filters.isNull())
-			obj->filters = _MR(Class<Array>::getInstanceSNoArgsNoFreelist(obj->getSystemState()));
+		// the filter list of the tag replaces the current filters
+		obj->filters = _MR(Class<Array>::getInstanceSNoArgsNoFreelist(obj->getSystemState()));
+		obj->setNeedsTextureRecalculation();
+		obj->hasChanged=true;
 		auto it = this->SurfaceFilterList.Filters.begin();
 		while (it != this->SurfaceFilterList.Filters.end())
 		{
@@ -2534,7 +2536,7 @@ void StartSoundTag::play(DefineSoundTag *soundTag)
 			soundTag->getSoundData(),
 			AudioFormat(soundTag->getAudioCodec(),
 			    soundTag->getSampleRate(),
-			    soundTag->getChannels()),false));
+			    soundTag->getChannels()),false,true));
 		soundTag->soundchanel->setConstant();
 	}
 	if (this->SoundInfo.SyncNoMultiple && soundTag->soundchanel->isPlaying())
@@ -0,0 +1,423 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include "platforms/audiokernels.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#if defined(ENABLE_SSE2) && (defined(__i386__) || defined(__x86_64__)) && defined(__GNUC__)
+#define AUDIOKERNELS_X86 1
+#include <immintrin.h>
+#define SSE2_TARGET __attribute__((target("sse2")))
+#endif
+
+using namespace lightspark;
+
+static void mixRowGeneric(const int16_t* src, int32_t* acc, uint32_t frames, const float* gains)
+{
+	for (uint32_t i=0;i<frames;i++)
+	{
+		float left=src[i*2];
+		float right=src[i*2+1];
+		acc[i*2]+=lrintf(left*gains[0]+right*gains[2]);
+		acc[i*2+1]+=lrintf(left*gains[1]+right*gains[3]);
+	}
+}
+
+static inline int16_t saturate16(int32_t v)
+{
+	return std::min(std::max(v,int32_t(INT16_MIN)),int32_t(INT16_MAX));
+}
+
+static void storeRowGeneric(const int32_t* acc, int16_t* dst, uint32_t count)
+{
+	for (uint32_t i=0;i<count;i++)
+		dst[i]=saturate16(saturate16(acc[i])+dst[i]);
+}
+
+static inline int16_t floatToS16(float v)
+{
+	// NaN ends up as INT16_MIN like in the SSE2 version
+	return lrintf(std::min(std::max(-32768.0f,v*32768.0f),32767.0f));
+}
+
+static void floatToS16Generic(const float* src, int16_t* dst, uint32_t count)
+{
+	for (uint32_t i=0;i<count;i++)
+		dst[i]=floatToS16(src[i]);
+}
+
+static void s16ToFloatGeneric(const int16_t* src, float* dst, uint32_t count)
+{
+	for (uint32_t i=0;i<count;i++)
+		dst[i]=src[i]*(1.0f/32768.0f);
+}
+
+static void planarFloatToS16Generic(const float* left, const float* right, int16_t* dst, uint32_t frames)
+{
+	for (uint32_t i=0;i<frames;i++)
+	{
+		dst[i*2]=floatToS16(left[i]);
+		dst[i*2+1]=floatToS16(right[i]);
+	}
+}
+
+static void planarS16ToS16Generic(const int16_t* left, const int16_t* right, int16_t* dst, uint32_t frames)
+{
+	for (uint32_t i=0;i<frames;i++)
+	{
+		dst[i*2]=left[i];
+		dst[i*2+1]=right[i];
+	}
+}
+
+static inline float fractionOf(uint64_t position)
+{
+	return (position&0xffffffff)*(1.0f/4294967296.0f);
+}
+
+static uint32_t resampleStereoGeneric(const int16_t* src, uint32_t frames, int16_t* dst, uint32_t maxFrames, uint64_t& position, uint64_t step)
+{
+	uint32_t out=0;
+	for (;out<maxFrames;out++)
+	{
+		uint64_t index=position>>32;
+		if (index+1>=frames)
+			break;
+		float frac=fractionOf(position);
+		const int16_t* s=src+index*2;
+		dst[out*2]=lrintf(s[0]+(s[2]-s[0])*frac);
+		dst[out*2+1]=lrintf(s[1]+(s[3]-s[1])*frac);
+		position+=step;
+	}
+	return out;
+}
+
+static void fftPassGeneric(float* re, float* im, uint32_t size, uint32_t span, const float* wre, const float* wim)
+{
+	for (uint32_t k=0;k<size;k+=span*2)
+	{
+		for (uint32_t j=0;j<span;j++)
+		{
+			uint32_t a=k+j;
+			uint32_t b=a+span;
+			float tr=re[b]*wre[j]-im[b]*wim[j];
+			float ti=re[b]*wim[j]+im[b]*wre[j];
+			re[b]=re[a]-tr;
+			im[b]=im[a]-ti;
+			re[a]+=tr;
+			im[a]+=ti;
+		}
+	}
+}
+
+#ifdef AUDIOKERNELS_X86
+SSE2_TARGET static void mixRowSSE2(const int16_t* src, int32_t* acc, uint32_t frames, const float* gains)
+{
+	// left samples get leftToLeft and rightToLeft, right samples rightToRight and leftToRight
+	const __m128 direct=_mm_setr_ps(gains[0],gains[3],gains[0],gains[3]);
+	const __m128 crossed=_mm_setr_ps(gains[2],gains[1],gains[2],gains[1]);
+	uint32_t i=0;
+	for (;i+4<=frames;i+=4)
+	{
+		__m128i s=_mm_loadu_si128((const __m128i*)(src+i*2));
+		// sign extend the samples to 32 bit
+		__m128i lo=_mm_srai_epi32(_mm_unpacklo_epi16(s,s),16);
+		__m128i hi=_mm_srai_epi32(_mm_unpackhi_epi16(s,s),16);
+		__m128 flo=_mm_cvtepi32_ps(lo);
+		__m128 fhi=_mm_cvtepi32_ps(hi);
+		__m128 rlo=_mm_add_ps(_mm_mul_ps(flo,direct),_mm_mul_ps(_mm_shuffle_ps(flo,flo,_MM_SHUFFLE(2,3,0,1)),crossed));
+		__m128 rhi=_mm_add_ps(_mm_mul_ps(fhi,direct),_mm_mul_ps(_mm_shuffle_ps(fhi,fhi,_MM_SHUFFLE(2,3,0,1)),crossed));
+		__m128i* a=(__m128i*)(acc+i*2);
+		_mm_storeu_si128(a,_mm_add_epi32(_mm_loadu_si128(a),_mm_cvtps_epi32(rlo)));
+		_mm_storeu_si128(a+1,_mm_add_epi32(_mm_loadu_si128(a+1),_mm_cvtps_epi32(rhi)));
+	}
+	mixRowGeneric(src+i*2,acc+i*2,frames-i,gains);
+}
+
+SSE2_TARGET static void storeRowSSE2(const int32_t* acc, int16_t* dst, uint32_t count)
+{
+	uint32_t i=0;
+	for (;i+8<=count;i+=8)
+	{
+		__m128i s=_mm_packs_epi32(_mm_loadu_si128((const __m128i*)(acc+i)),_mm_loadu_si128((const __m128i*)(acc+i+4)));
+		__m128i d=_mm_loadu_si128((const __m128i*)(dst+i));
+		_mm_storeu_si128((__m128i*)(dst+i),_mm_adds_epi16(s,d));
+	}
+	storeRowGeneric(acc+i,dst+i,count-i);
+}
+
+SSE2_TARGET static inline __m128i floatToS16x4SSE2(__m128 v)
+{
+	// clamping before the conversion keeps large values from turning into INT32_MIN
+	v=_mm_min_ps(_mm_max_ps(_mm_mul_ps(v,_mm_set1_ps(32768.0f)),_mm_set1_ps(-32768.0f)),_mm_set1_ps(32767.0f));
+	return _mm_cvtps_epi32(v);
+}
+
+SSE2_TARGET static void floatToS16SSE2(const float* src, int16_t* dst, uint32_t count)
+{
+	uint32_t i=0;
+	for (;i+8<=count;i+=8)
+	{
+		__m128i lo=floatToS16x4SSE2(_mm_loadu_ps(src+i));
+		__m128i hi=floatToS16x4SSE2(_mm_loadu_ps(src+i+4));
+		_mm_storeu_si128((__m128i*)(dst+i),_mm_packs_epi32(lo,hi));
+	}
+	floatToS16Generic(src+i,dst+i,count-i);
+}
+
+SSE2_TARGET static void s16ToFloatSSE2(const int16_t* src, float* dst, uint32_t count)
+{
+	const __m128 scale=_mm_set1_ps(1.0f/32768.0f);
+	uint32_t i=0;
+	for (;i+8<=count;i+=8)
+	{
+		__m128i s=_mm_loadu_si128((const __m128i*)(src+i));
+		__m128i lo=_mm_srai_epi32(_mm_unpacklo_epi16(s,s),16);
+		__m128i hi=_mm_srai_epi32(_mm_unpackhi_epi16(s,s),16);
+		_mm_storeu_ps(dst+i,_mm_mul_ps(_mm_cvtepi32_ps(lo),scale));
+		_mm_storeu_ps(dst+i+4,_mm_mul_ps(_mm_cvtepi32_ps(hi),scale));
+	}
+	s16ToFloatGeneric(src+i,dst+i,count-i);
+}
+
+SSE2_TARGET static void planarFloatToS16SSE2(const float* left, const float* right, int16_t* dst, uint32_t frames)
+{
+	uint32_t i=0;
+	for (;i+4<=frames;i+=4)
+	{
+		__m128i l=floatToS16x4SSE2(_mm_loadu_ps(left+i));
+		__m128i r=floatToS16x4SSE2(_mm_loadu_ps(right+i));
+		_mm_storeu_si128((__m128i*)(dst+i*2),_mm_packs_epi32(_mm_unpacklo_epi32(l,r),_mm_unpackhi_epi32(l,r)));
+	}
+	planarFloatToS16Generic(left+i,right+i,dst+i*2,frames-i);
+}
+
+SSE2_TARGET static void planarS16ToS16SSE2(const int16_t* left, const int16_t* right, int16_t* dst, uint32_t frames)
+{
+	uint32_t i=0;
+	for (;i+8<=frames;i+=8)
+	{
+		__m128i l=_mm_loadu_si128((const __m128i*)(left+i));
+		__m128i r=_mm_loadu_si128((const __m128i*)(right+i));
+		_mm_storeu_si128((__m128i*)(dst+i*2),_mm_unpacklo_epi16(l,r));
+		_mm_storeu_si128((__m128i*)(dst+i*2+8),_mm_unpackhi_epi16(l,r));
+	}
+	planarS16ToS16Generic(left+i,right+i,dst+i*2,frames-i);
+}
+
+SSE2_TARGET static uint32_t resampleStereoSSE2(const int16_t* src, uint32_t frames, int16_t* dst, uint32_t maxFrames, uint64_t& position, uint64_t step)
+{
+	uint32_t out=0;
+	for (;out+4<=maxFrames;out+=4)
+	{
+		// positions only grow, so if the last of the four frames is available all of them are
+		if (((position+step*3)>>32)+1>=frames)
+			break;
+		// gather the two neighbouring stereo frames of every output frame
+		int32_t a[4];
+		int32_t b[4];
+		float f[4];
+		for (uint32_t k=0;k<4;k++)
+		{
+			uint64_t p=position+step*k;
+			const int16_t* s=src+(p>>32)*2;
+			memcpy(a+k,s,4);
+			memcpy(b+k,s+2,4);
+			f[k]=fractionOf(p);
+		}
+		__m128i va=_mm_loadu_si128((const __m128i*)a);
+		__m128i vb=_mm_loadu_si128((const __m128i*)b);
+		__m128 alo=_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(va,va),16));
+		__m128 ahi=_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(va,va),16));
+		__m128 blo=_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(vb,vb),16));
+		__m128 bhi=_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(vb,vb),16));
+		__m128 flo=_mm_setr_ps(f[0],f[0],f[1],f[1]);
+		__m128 fhi=_mm_setr_ps(f[2],f[2],f[3],f[3]);
+		__m128 rlo=_mm_add_ps(alo,_mm_mul_ps(_mm_sub_ps(blo,alo),flo));
+		__m128 rhi=_mm_add_ps(ahi,_mm_mul_ps(_mm_sub_ps(bhi,ahi),fhi));
+		_mm_storeu_si128((__m128i*)(dst+out*2),_mm_packs_epi32(_mm_cvtps_epi32(rlo),_mm_cvtps_epi32(rhi)));
+		position+=step*4;
+	}
+	return out+resampleStereoGeneric(src,frames,dst+out*2,maxFrames-out,position,step);
+}
+
+SSE2_TARGET static void fftPassSSE2(float* re, float* im, uint32_t size, uint32_t span, const float* wre, const float* wim)
+{
+	// the first passes have less than 4 butterflies per group
+	if (span<4)
+	{
+		fftPassGeneric(re,im,size,span,wre,wim);
+		return;
+	}
+	for (uint32_t k=0;k<size;k+=span*2)
+	{
+		for (uint32_t j=0;j<span;j+=4)
+		{
+			float* ar=re+k+j;
+			float* ai=im+k+j;
+			float* br=ar+span;
+			float* bi=ai+span;
+			__m128 xr=_mm_loadu_ps(br);
+			__m128 xi=_mm_loadu_ps(bi);
+			__m128 wr=_mm_loadu_ps(wre+j);
+			__m128 wi=_mm_loadu_ps(wim+j);
+			__m128 tr=_mm_sub_ps(_mm_mul_ps(xr,wr),_mm_mul_ps(xi,wi));
+			__m128 ti=_mm_add_ps(_mm_mul_ps(xr,wi),_mm_mul_ps(xi,wr));
+			__m128 yr=_mm_loadu_ps(ar);
+			__m128 yi=_mm_loadu_ps(ai);
+			_mm_storeu_ps(br,_mm_sub_ps(yr,tr));
+			_mm_storeu_ps(bi,_mm_sub_ps(yi,ti));
+			_mm_storeu_ps(ar,_mm_add_ps(yr,tr));
+			_mm_storeu_ps(ai,_mm_add_ps(yi,ti));
+		}
+	}
+}
+#endif
+
+struct AudioKernelTable
+{
+	const char* name;
+	void (*mixRow)(const int16_t* src, int32_t* acc, uint32_t frames, const float* gains);
+	void (*storeRow)(const int32_t* acc, int16_t* dst, uint32_t count);
+	void (*floatToS16)(const float* src, int16_t* dst, uint32_t count);
+	void (*s16ToFloat)(const int16_t* src, float* dst, uint32_t count);
+	void (*planarFloatToS16)(const float* left, const float* right, int16_t* dst, uint32_t frames);
+	void (*planarS16ToS16)(const int16_t* left, const int16_t* right, int16_t* dst, uint32_t frames);
+	uint32_t (*resampleStereo)(const int16_t* src, uint32_t frames, int16_t* dst, uint32_t maxFrames, uint64_t& position, uint64_t step);
+	void (*fftPass)(float* re, float* im, uint32_t size, uint32_t span, const float* wre, const float* wim);
+};
+
+static AudioKernelTable selectAudioKernels()
+{
+	AudioKernelTable t;
+	t.name="generic";
+	t.mixRow=mixRowGeneric;
+	t.storeRow=storeRowGeneric;
+	t.floatToS16=floatToS16Generic;
+	t.s16ToFloat=s16ToFloatGeneric;
+	t.planarFloatToS16=planarFloatToS16Generic;
+	t.planarS16ToS16=planarS16ToS16Generic;
+	t.resampleStereo=resampleStereoGeneric;
+	t.fftPass=fftPassGeneric;
+#ifdef AUDIOKERNELS_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2"))
+	{
+		t.name="sse2";
+		t.mixRow=mixRowSSE2;
+		t.storeRow=storeRowSSE2;
+		t.floatToS16=floatToS16SSE2;
+		t.s16ToFloat=s16ToFloatSSE2;
+		t.planarFloatToS16=planarFloatToS16SSE2;
+		t.planarS16ToS16=planarS16ToS16SSE2;
+		t.resampleStereo=resampleStereoSSE2;
+		t.fftPass=fftPassSSE2;
+	}
+#endif
+	return t;
+}
+
+static const AudioKernelTable& audioKernels()
+{
+	static const AudioKernelTable table=selectAudioKernels();
+	return table;
+}
+
+const char* lightspark::audioKernelsName()
+{
+	return audioKernels().name;
+}
+
+void lightspark::audioMixRow(const int16_t* src, int32_t* acc, uint32_t frames, const float* gains)
+{
+	audioKernels().mixRow(src,acc,frames,gains);
+}
+
+void lightspark::audioStoreRow(const int32_t* acc, int16_t* dst, uint32_t count)
+{
+	audioKernels().storeRow(acc,dst,count);
+}
+
+void lightspark::audioFloatToS16(const float* src, int16_t* dst, uint32_t count)
+{
+	audioKernels().floatToS16(src,dst,count);
+}
+
+void lightspark::audioS16ToFloat(const int16_t* src, float* dst, uint32_t count)
+{
+	audioKernels().s16ToFloat(src,dst,count);
+}
+
+void lightspark::audioPlanarFloatToS16(const float* left, const float* right, int16_t* dst, uint32_t frames)
+{
+	audioKernels().planarFloatToS16(left,right,dst,frames);
+}
+
+void lightspark::audioPlanarS16ToS16(const int16_t* left, const int16_t* right, int16_t* dst, uint32_t frames)
+{
+	audioKernels().planarS16ToS16(left,right,dst,frames);
+}
+
+uint32_t lightspark::audioResampleStereo(const int16_t* src, uint32_t frames, int16_t* dst, uint32_t maxFrames, uint64_t& position, uint64_t step)
+{
+	return audioKernels().resampleStereo(src,frames,dst,maxFrames,position,step);
+}
+
+AudioFFT::AudioFFT(uint32_t n):size(n),reversed(n),twiddleRe(n),twiddleIm(n)
+{
+	assert(n>=2 && (n&(n-1))==0);
+	uint32_t bits=0;
+	while ((1u<<bits)<n)
+		bits++;
+	for (uint32_t i=0;i<n;i++)
+	{
+		uint32_t r=0;
+		for (uint32_t b=0;b<bits;b++)
+			r|=((i>>b)&1)<<(bits-1-b);
+		reversed[i]=r;
+	}
+	for (uint32_t span=1;span<n;span*=2)
+	{
+		for (uint32_t j=0;j<span;j++)
+		{
+			double angle=-M_PI*j/span;
+			twiddleRe[span-1+j]=cos(angle);
+			twiddleIm[span-1+j]=sin(angle);
+		}
+	}
+}
+
+void AudioFFT::transform(float* re, float* im) const
+{
+	for (uint32_t i=0;i<size;i++)
+	{
+		uint32_t r=reversed[i];
+		if (r>i)
+		{
+			std::swap(re[i],re[r]);
+			std::swap(im[i],im[r]);
+		}
+	}
+	const AudioKernelTable& k=audioKernels();
+	for (uint32_t span=1;span<size;span*=2)
+		k.fftPass(re,im,size,span,twiddleRe.data()+span-1,twiddleIm.data()+span-1);
+}
@@ -0,0 +1,104 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef PLATFORMS_AUDIOKERNELS_H
+#define PLATFORMS_AUDIOKERNELS_H 1
+
+#include "compat.h"
+#include <cinttypes>
+#include <vector>
+
+namespace lightspark
+{
+
+/*
+	Kernels used by the AudioManager to mix interleaved 16 bit stereo samples and by the audio decoders
+	to convert decoded frames to that format.
+	On x86 SSE2 implementations are selected at runtime, everywhere else the generic versions are used
+*/
+
+/**
+	Returns a description of the kernels selected for this cpu ("generic" or "sse2")
+*/
+const char* audioKernelsName();
+
+/**
+	Adds frames stereo frames of src to the 32 bit accumulator acc:
+	acc.left+=src.left*gains[0]+src.right*gains[2], acc.right+=src.left*gains[1]+src.right*gains[3]
+
+	@param gains leftToLeft, leftToRight, rightToLeft, rightToRight
+*/
+void audioMixRow(const int16_t* src, int32_t* acc, uint32_t frames, const float* gains);
+/**
+	Adds count samples of acc to dst, saturating to 16 bit
+*/
+void audioStoreRow(const int32_t* acc, int16_t* dst, uint32_t count);
+/**
+	Converts count float samples in [-1,1] to 16 bit, saturating
+*/
+void audioFloatToS16(const float* src, int16_t* dst, uint32_t count);
+/**
+	Converts count 16 bit samples to floats in [-1,1]
+*/
+void audioS16ToFloat(const int16_t* src, float* dst, uint32_t count);
+/**
+	Interleaves frames float samples of two planes into 16 bit stereo frames, saturating.
+	Mono is converted by passing the same plane twice
+*/
+void audioPlanarFloatToS16(const float* left, const float* right, int16_t* dst, uint32_t frames);
+/**
+	Interleaves frames 16 bit samples of two planes into stereo frames.
+	Mono is converted by passing the same plane twice
+*/
+void audioPlanarS16ToS16(const int16_t* left, const int16_t* right, int16_t* dst, uint32_t frames);
+/**
+	Resamples 16 bit stereo frames by linear interpolation.
+	position is the 32.32 fixed point offset in src of the next output frame and step the distance
+	between two output frames (input rate/output rate). Output frames are produced as long as both
+	neighbouring input frames are available, position is advanced past them.
+	No low-pass filter is applied, so this is only suitable for upsampling: images of the input
+	spectrum are attenuated but not removed, downsampling aliases
+
+	@return the number of frames written to dst, never more than maxFrames
+*/
+uint32_t audioResampleStereo(const int16_t* src, uint32_t frames, int16_t* dst, uint32_t maxFrames, uint64_t& position, uint64_t step);
+
+/**
+	Radix-2 complex FFT of a fixed power of 2 size, used by SoundMixer.computeSpectrum.
+	The bit reversal and twiddle tables are computed once, the butterflies use the selected kernels
+*/
+class AudioFFT
+{
+private:
+	uint32_t size;
+	std::vector<uint32_t> reversed;
+	//Twiddle factors of all passes, the pass with span n starts at n-1
+	std::vector<float> twiddleRe;
+	std::vector<float> twiddleIm;
+public:
+	AudioFFT(uint32_t n);
+	uint32_t getSize() const { return size; }
+	/**
+		Transforms size complex values in place, given as separate real and imaginary parts
+	*/
+	void transform(float* re, float* im) const;
+};
+
+};
+#endif /* PLATFORMS_AUDIOKERNELS_H */
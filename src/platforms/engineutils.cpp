@@ -52,7 +52,7 @@ bool EngineData::mainthread_running = false;
 bool EngineData::sdl_needinit = true;
 bool EngineData::enablerendering = true;
 Semaphore EngineData::mainthread_initialized(0);
-EngineData::EngineData() : contextmenu(nullptr),contextmenurenderer(nullptr),sdleventtickjob(nullptr),incontextmenu(false),incontextmenupreparing(false),currentPixelBufPtr(nullptr),pixelBufferWidth(0),pixelBufferHeight(0),widget(0), width(0), height(0),needrenderthread(true),supportPackedDepthStencil(false),hasExternalFontRenderer(false)
+EngineData::EngineData() : contextmenu(nullptr),contextmenurenderer(nullptr),sdleventtickjob(nullptr),incontextmenu(false),incontextmenupreparing(false),currentPixelBufPtr(nullptr),pixelBufferWidth(0),pixelBufferHeight(0),widget(0), width(0), height(0),needrenderthread(true),supportPackedDepthStencil(false),supportPixelBufferObject(false),hasExternalFontRenderer(false)
 {
 }
 
@@ -298,6 +298,7 @@ void EngineData::initGLEW()
 		throw RunTimeException("Rendering: OpenGL driver does not support framebuffer objects");
 	}
 	supportPackedDepthStencil = GLEW_EXT_packed_depth_stencil;
+	supportPixelBufferObject = GLEW_VERSION_2_1 || GLEW_ARB_pixel_buffer_object;
 #endif
 }
 
@@ -791,6 +792,12 @@ void EngineData::exec_glBindBuffer_GL_ARRAY_BUFFER(uint32_t buffer)
 {
 	glBindBuffer(GL_ARRAY_BUFFER,buffer);
 }
+void EngineData::exec_glBindBuffer_GL_PIXEL_UNPACK_BUFFER(uint32_t buffer)
+{
+#ifndef ENABLE_GLES2
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER,buffer);
+#endif
+}
 void EngineData::exec_glEnable_GL_TEXTURE_2D()
 {
 	glEnable(GL_TEXTURE_2D);
@@ -1133,6 +1140,28 @@ void EngineData::exec_glBufferData_GL_ARRAY_BUFFER_GL_DYNAMIC_DRAW(int32_t size,
 {
 	glBufferData(GL_ARRAY_BUFFER,size, data,GL_DYNAMIC_DRAW);
 }
+void EngineData::exec_glBufferData_GL_PIXEL_UNPACK_BUFFER_GL_STREAM_DRAW(int32_t size,const void* data)
+{
+#ifndef ENABLE_GLES2
+	glBufferData(GL_PIXEL_UNPACK_BUFFER,size, data,GL_STREAM_DRAW);
+#endif
+}
+uint8_t* EngineData::exec_glMapBuffer_GL_PIXEL_UNPACK_BUFFER_GL_WRITE_ONLY()
+{
+#ifndef ENABLE_GLES2
+	return (uint8_t*)glMapBuffer(GL_PIXEL_UNPACK_BUFFER,GL_WRITE_ONLY);
+#else
+	return nullptr;
+#endif
+}
+bool EngineData::exec_glUnmapBuffer_GL_PIXEL_UNPACK_BUFFER()
+{
+#ifndef ENABLE_GLES2
+	return glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+#else
+	return false;
+#endif
+}
 
 void EngineData::exec_glTexParameteri_GL_TEXTURE_2D_GL_TEXTURE_MIN_FILTER_GL_LINEAR()
 {
@@ -1272,64 +1301,10 @@ void EngineData::exec_glColorMask(bool red, bool green, bool blue, bool alpha)
 }
 
 
-void mixer_effect_ffmpeg_cb(int chan, void * stream, int len, void * udata)
-{
-	AudioStream *s = (AudioStream*)udata;
-	if (!s)
-		return;
-	s->startMixing();
-	memset(stream,0,len);
-	uint32_t readcount = 0;
-	while (readcount < ((uint32_t)len))
-	{
-		uint32_t ret = s->getDecoder()->copyFrame((int16_t *)(((unsigned char*)stream)+readcount), ((uint32_t)len)-readcount);
-		if (!ret)
-			break;
-		readcount += ret;
-	}
-}
-
-
-
-int EngineData::audio_StreamInit(AudioStream* s)
+void mixer_postmix_cb(void* udata, Uint8* stream, int len)
 {
-	int mixer_channel = -1;
-
-	uint32_t len = LIGHTSPARK_AUDIO_BUFFERSIZE;
-
-	uint8_t *buf = new uint8_t[len];
-	memset(buf,0,len);
-	Mix_Chunk* chunk = Mix_QuickLoad_RAW(buf, len);
-	delete[] buf;
-
-
-	mixer_channel = Mix_PlayChannel(-1, chunk, -1);
-	Mix_RegisterEffect(mixer_channel, mixer_effect_ffmpeg_cb, NULL, s);
-	Mix_Resume(mixer_channel);
-	return mixer_channel;
-}
-
-void EngineData::audio_StreamPause(int channel, bool dopause)
-{
-	if (channel == -1)
-		return;
-	if(dopause)
-		Mix_Pause(channel);
-	else
-		Mix_Resume(channel);
-}
-
-void EngineData::audio_StreamSetVolume(int channel, double volume)
-{
-	int curvolume = SDL_MIX_MAXVOLUME * volume;
-	if (channel != -1)
-		Mix_Volume(channel, curvolume);
-}
-
-void EngineData::audio_StreamDeinit(int channel)
-{
-	if (channel != -1)
-		Mix_HaltChannel(channel);
+	AudioManager* manager = (AudioManager*)udata;
+	manager->mixStreams((int16_t*)stream, len);
 }
 
 bool EngineData::audio_ManagerInit()
@@ -1344,12 +1319,17 @@ bool EngineData::audio_ManagerInit()
 
 void EngineData::audio_ManagerCloseMixer()
 {
+	Mix_SetPostMix(nullptr, nullptr);
 	Mix_CloseAudio();
 }
 
-bool EngineData::audio_ManagerOpenMixer()
+bool EngineData::audio_ManagerOpenMixer(AudioManager* manager)
 {
-	return Mix_OpenAudio (audio_getSampleRate(), AUDIO_S16, 2, LIGHTSPARK_AUDIO_BUFFERSIZE) >= 0;
+	if (Mix_OpenAudio (audio_getSampleRate(), AUDIO_S16, 2, LIGHTSPARK_AUDIO_BUFFERSIZE) < 0)
+		return false;
+	// SDL_mixer channels are not used, all streams are mixed by the AudioManager
+	Mix_SetPostMix(mixer_postmix_cb, manager);
+	return true;
 }
 
 void EngineData::audio_ManagerDeinit()
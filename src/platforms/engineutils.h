@@ -43,7 +43,7 @@ namespace lightspark
 #define LS_USEREVENT_SELECTITEM_CONTEXTMENU EngineData::userevent+5
 class SystemState;
 class StreamCache;
-class AudioStream;
+class AudioManager;
 class ITickJob;
 
 enum DEPTH_FUNCTION { ALWAYS, EQUAL, GREATER, GREATER_EQUAL, LESS, LESS_EQUAL, NEVER, NOT_EQUAL };
@@ -107,6 +107,8 @@ public:
 	uint32_t origheight;
 	bool needrenderthread;
 	bool supportPackedDepthStencil;
+	// texture uploads can be staged in a pixel unpack buffer
+	bool supportPixelBufferObject;
 	bool hasExternalFontRenderer;
 	tiny_string driverInfoString;
 	EngineData();
@@ -210,6 +212,7 @@ public:
 	virtual void exec_glUniformMatrix4fv(int32_t location,int32_t count, bool transpose,const float* value);
 	virtual void exec_glBindBuffer_GL_ELEMENT_ARRAY_BUFFER(uint32_t buffer);
 	virtual void exec_glBindBuffer_GL_ARRAY_BUFFER(uint32_t buffer);
+	virtual void exec_glBindBuffer_GL_PIXEL_UNPACK_BUFFER(uint32_t buffer);
 	virtual void exec_glEnable_GL_TEXTURE_2D();
 	virtual void exec_glEnable_GL_BLEND();
 	virtual void exec_glEnable_GL_DEPTH_TEST();
@@ -263,6 +266,9 @@ public:
 	virtual void exec_glBufferData_GL_ELEMENT_ARRAY_BUFFER_GL_DYNAMIC_DRAW(int32_t size, const void* data);
 	virtual void exec_glBufferData_GL_ARRAY_BUFFER_GL_STATIC_DRAW(int32_t size, const void* data);
 	virtual void exec_glBufferData_GL_ARRAY_BUFFER_GL_DYNAMIC_DRAW(int32_t size, const void* data);
+	virtual void exec_glBufferData_GL_PIXEL_UNPACK_BUFFER_GL_STREAM_DRAW(int32_t size, const void* data);
+	virtual uint8_t* exec_glMapBuffer_GL_PIXEL_UNPACK_BUFFER_GL_WRITE_ONLY();
+	virtual bool exec_glUnmapBuffer_GL_PIXEL_UNPACK_BUFFER();
 	virtual void exec_glTexParameteri_GL_TEXTURE_2D_GL_TEXTURE_MIN_FILTER_GL_LINEAR();
 	virtual void exec_glTexParameteri_GL_TEXTURE_2D_GL_TEXTURE_MAG_FILTER_GL_LINEAR();
 	virtual void exec_glTexParameteri_GL_TEXTURE_2D_GL_TEXTURE_MIN_FILTER_GL_NEAREST();
@@ -289,13 +295,10 @@ public:
 	virtual void exec_glColorMask(bool red, bool green, bool blue, bool alpha);
 
 	// Audio handling
-	virtual int audio_StreamInit(AudioStream* s);
-	virtual void audio_StreamPause(int channel, bool dopause);
-	virtual void audio_StreamSetVolume(int channel, double volume);
-	virtual void audio_StreamDeinit(int channel);
 	virtual bool audio_ManagerInit();
 	virtual void audio_ManagerCloseMixer();
-	virtual bool audio_ManagerOpenMixer();
+	// opens the audio output, which is filled by manager->mixStreams() from the audio thread
+	virtual bool audio_ManagerOpenMixer(AudioManager* manager);
 	virtual void audio_ManagerDeinit();
 	virtual int audio_getSampleRate();
 	
@@ -0,0 +1,1209 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include "platforms/pixelkernels.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(ENABLE_SSE2) && (defined(__i386__) || defined(__x86_64__)) && defined(__GNUC__)
+#define PIXELKERNELS_X86 1
+#include <immintrin.h>
+#define SSE2_TARGET __attribute__((target("sse2")))
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+using namespace lightspark;
+
+static inline uint32_t packChannels(const int32_t* c)
+{
+	uint32_t ret=0;
+	for (uint32_t i=0;i<4;i++)
+	{
+		int32_t v=c[i];
+		if (v<0)
+			v=0;
+		else if (v>255)
+			v=255;
+		ret|=uint32_t(v)<<(i*8);
+	}
+	return ret;
+}
+
+static inline float clampChannel(float v)
+{
+	return v<0 ? 0 : (v>255 ? 255 : v);
+}
+
+static void boxBlurAccumulateRowGeneric(int32_t* sums, const uint32_t* addRow, const uint32_t* subRow, uint32_t count)
+{
+	for (uint32_t i=0;i<count;i++)
+	{
+		for (uint32_t c=0;c<4;c++)
+		{
+			int32_t v=0;
+			if (addRow)
+				v+=(addRow[i]>>(c*8))&0xff;
+			if (subRow)
+				v-=(subRow[i]>>(c*8))&0xff;
+			sums[i*4+c]+=v;
+		}
+	}
+}
+
+static void boxBlurStoreRowGeneric(const int32_t* sums, uint32_t* dst, uint32_t count, float scale)
+{
+	for (uint32_t i=0;i<count;i++)
+	{
+		int32_t c[4];
+		for (uint32_t j=0;j<4;j++)
+			c[j]=lrintf(sums[i*4+j]*scale);
+		dst[i]=packChannels(c);
+	}
+}
+
+static void boxBlurRowGeneric(const uint32_t* src, uint32_t* dst, uint32_t count, uint32_t radius)
+{
+	int32_t sum[4]={0,0,0,0};
+	float scale=1.0f/(2*radius+1);
+	for (uint32_t i=0;i<=radius && i<count;i++)
+		boxBlurAccumulateRowGeneric(sum,src+i,nullptr,1);
+	for (uint32_t x=0;x<count;x++)
+	{
+		boxBlurStoreRowGeneric(sum,dst+x,1,scale);
+		boxBlurAccumulateRowGeneric(sum,x+radius+1<count ? src+x+radius+1 : nullptr,x>=radius ? src+x-radius : nullptr,1);
+	}
+}
+
+static void unpremultiplyRowGeneric(const uint32_t* src, float* dst, uint32_t count)
+{
+	for (uint32_t i=0;i<count;i++)
+	{
+		uint32_t a=src[i]>>24;
+		float factor=a ? 255.0f/a : 0;
+		for (uint32_t c=0;c<3;c++)
+			dst[i*4+c]=std::min(((src[i]>>(c*8))&0xff)*factor,255.0f);
+		dst[i*4+3]=a;
+	}
+}
+
+static void premultiplyRowGeneric(const float* src, uint32_t* dst, uint32_t count)
+{
+	for (uint32_t i=0;i<count;i++)
+	{
+		float a=clampChannel(src[i*4+3]);
+		int32_t c[4];
+		for (uint32_t j=0;j<3;j++)
+			c[j]=lrintf(clampChannel(src[i*4+j])*a/255.0f);
+		c[3]=lrintf(a);
+		dst[i]=packChannels(c);
+	}
+}
+
+static void colorMatrixRowGeneric(const uint32_t* src, uint32_t* dst, uint32_t count, const float* matrix, const float* offsets)
+{
+	for (uint32_t i=0;i<count;i++)
+	{
+		float in[4];
+		float out[4];
+		unpremultiplyRowGeneric(src+i,in,1);
+		for (uint32_t j=0;j<4;j++)
+		{
+			out[j]=offsets[j];
+			for (uint32_t k=0;k<4;k++)
+				out[j]+=in[k]*matrix[k*4+j];
+		}
+		premultiplyRowGeneric(out,dst+i,1);
+	}
+}
+
+static void convolveRowGeneric(const float* src, uint32_t srcStride, float* dst, uint32_t count,
+		const float* matrix, uint32_t matrixX, uint32_t matrixY, float scale, float bias)
+{
+	for (uint32_t x=0;x<count;x++)
+	{
+		float acc[4]={0,0,0,0};
+		for (uint32_t j=0;j<matrixY;j++)
+		{
+			const float* p=src+j*srcStride+x*4;
+			for (uint32_t i=0;i<matrixX;i++)
+			{
+				float w=matrix[j*matrixX+i];
+				for (uint32_t c=0;c<4;c++)
+					acc[c]+=p[i*4+c]*w;
+			}
+		}
+		for (uint32_t c=0;c<4;c++)
+			dst[x*4+c]=acc[c]*scale+bias;
+	}
+}
+
+// rounded x/255 for 0<=x<=255*255
+static inline uint32_t div255(uint32_t x)
+{
+	x+=128;
+	return (x+(x>>8))>>8;
+}
+
+static void toPremultipliedRowGeneric(const uint32_t* src, uint32_t* dst, uint32_t count)
+{
+	for (uint32_t i=0;i<count;i++)
+	{
+		uint32_t p=src[i];
+		uint32_t a=p>>24;
+		if (a!=0xff)
+		{
+			uint32_t res=a<<24;
+			for (uint32_t c=0;c<24;c+=8)
+				res|=div255(((p>>c)&0xff)*a)<<c;
+			p=res;
+		}
+		dst[i]=p;
+	}
+}
+
+static void toUnpremultipliedRowGeneric(const uint32_t* src, uint32_t* dst, uint32_t count)
+{
+	for (uint32_t i=0;i<count;i++)
+	{
+		uint32_t p=src[i];
+		uint32_t a=p>>24;
+		if (a && a!=0xff)
+		{
+			uint32_t res=a<<24;
+			for (uint32_t c=0;c<24;c+=8)
+			{
+				// the same float operations as in the SSE2 version, to get identical results
+				float q=float(((p>>c)&0xff)*255)/float(a);
+				uint32_t v=uint32_t(q);
+				if (float(v)<q)
+					v++;
+				res|=std::min(v,255u)<<c;
+			}
+			p=res;
+		}
+		dst[i]=p;
+	}
+}
+
+static void blendRowGeneric(const uint32_t* src, uint32_t* dst, uint32_t count)
+{
+	for (uint32_t i=0;i<count;i++)
+	{
+		uint32_t s=src[i];
+		uint32_t inv=255-(s>>24);
+		if (inv==0)
+			dst[i]=s;
+		else if (s!=0)
+		{
+			uint32_t d=dst[i];
+			uint32_t res=0;
+			for (uint32_t c=0;c<32;c+=8)
+				res|=std::min(((s>>c)&0xff)+div255(((d>>c)&0xff)*inv),255u)<<c;
+			dst[i]=res;
+		}
+	}
+}
+
+static void copyChannelRowGeneric(const uint32_t* src, uint32_t* dst, uint32_t count, uint32_t srcShift, uint32_t dstShift)
+{
+	uint32_t keepMask=~(0xffu<<dstShift);
+	for (uint32_t i=0;i<count;i++)
+		dst[i]=(dst[i]&keepMask)|(((src[i]>>srcShift)&0xff)<<dstShift);
+}
+
+static inline bool thresholdTest(uint32_t v, uint32_t threshold, PIXEL_THRESHOLD_OP op)
+{
+	switch (op)
+	{
+		case THRESHOLD_LESS:
+			return v<threshold;
+		case THRESHOLD_LESS_EQUAL:
+			return v<=threshold;
+		case THRESHOLD_GREATER:
+			return v>threshold;
+		case THRESHOLD_GREATER_EQUAL:
+			return v>=threshold;
+		case THRESHOLD_EQUAL:
+			return v==threshold;
+		case THRESHOLD_NOT_EQUAL:
+			return v!=threshold;
+	}
+	return false;
+}
+
+static uint32_t thresholdRowGeneric(const uint32_t* src, uint32_t* dst, uint32_t count, PIXEL_THRESHOLD_OP op,
+		uint32_t threshold, uint32_t color, uint32_t mask, bool copySource)
+{
+	uint32_t matched=0;
+	threshold&=mask;
+	for (uint32_t i=0;i<count;i++)
+	{
+		if (thresholdTest(src[i]&mask,threshold,op))
+		{
+			dst[i]=color;
+			matched++;
+		}
+		else if (copySource)
+			dst[i]=src[i];
+	}
+	return matched;
+}
+
+static void mergeRowGeneric(const uint32_t* src, uint32_t* dst, uint32_t count, const uint32_t* multipliers)
+{
+	for (uint32_t i=0;i<count;i++)
+	{
+		uint32_t res=0;
+		for (uint32_t c=0;c<4;c++)
+		{
+			uint32_t m=multipliers[c];
+			res|=((((src[i]>>(c*8))&0xff)*m+((dst[i]>>(c*8))&0xff)*(256-m))>>8)<<(c*8);
+		}
+		dst[i]=res;
+	}
+}
+
+static bool compareRowGeneric(const uint32_t* src1, const uint32_t* src2, uint32_t* dst, uint32_t count)
+{
+	bool different=false;
+	for (uint32_t i=0;i<count;i++)
+	{
+		uint32_t p1=src1[i];
+		uint32_t p2=src2[i];
+		uint32_t diff=0;
+		for (uint32_t c=0;c<32;c+=8)
+			diff|=((((p1>>c)&0xff)-((p2>>c)&0xff))&0xff)<<c;
+		if (p1==p2)
+			dst[i]=0;
+		else if ((p1&0xffffff)==(p2&0xffffff))
+			dst[i]=(diff&0xff000000)|0xffffff;
+		else
+			dst[i]=(diff&0xffffff)|0xff000000;
+		different|=(p1!=p2);
+	}
+	return different;
+}
+
+static void paletteMapRowGeneric(const uint32_t* src, uint32_t* dst, uint32_t count, const uint32_t* tables)
+{
+	for (uint32_t i=0;i<count;i++)
+	{
+		uint32_t p=src[i];
+		dst[i]=tables[p&0xff]+tables[256+((p>>8)&0xff)]+tables[512+((p>>16)&0xff)]+tables[768+(p>>24)];
+	}
+}
+
+
+#define NOISE_LATTICE_SIZE 256
+#define NOISE_LATTICE_MASK 0xff
+#define NOISE_OFFSET 4096
+
+// Park-Miller random generator used to build the noise lattice
+static int32_t noiseRandom(int32_t seed)
+{
+	int32_t result=16807*(seed%127773)-2836*(seed/127773);
+	if (result<=0)
+		result+=2147483647;
+	return result;
+}
+
+PixelNoiseLattice::PixelNoiseLattice(int32_t seed)
+{
+	if (seed<=0)
+		seed=-(seed%(2147483647-1))+1;
+	if (seed>2147483647-1)
+		seed=2147483647-1;
+	int32_t i;
+	for (uint32_t k=0;k<4;k++)
+	{
+		for (i=0;i<NOISE_LATTICE_SIZE;i++)
+		{
+			selector[i]=i;
+			for (uint32_t j=0;j<2;j++)
+			{
+				seed=noiseRandom(seed);
+				gradients[k][i][j]=double((seed%(2*NOISE_LATTICE_SIZE))-NOISE_LATTICE_SIZE)/NOISE_LATTICE_SIZE;
+			}
+			double s=sqrt(gradients[k][i][0]*gradients[k][i][0]+gradients[k][i][1]*gradients[k][i][1]);
+			if (s!=0)
+			{
+				gradients[k][i][0]/=s;
+				gradients[k][i][1]/=s;
+			}
+		}
+	}
+	while (--i)
+	{
+		int32_t k=selector[i];
+		seed=noiseRandom(seed);
+		int32_t j=seed%NOISE_LATTICE_SIZE;
+		selector[i]=selector[j];
+		selector[j]=k;
+	}
+	for (i=0;i<NOISE_LATTICE_SIZE+2;i++)
+	{
+		selector[NOISE_LATTICE_SIZE+i]=selector[i];
+		for (uint32_t k=0;k<4;k++)
+		{
+			gradients[k][NOISE_LATTICE_SIZE+i][0]=gradients[k][i][0];
+			gradients[k][NOISE_LATTICE_SIZE+i][1]=gradients[k][i][1];
+		}
+	}
+}
+
+static inline double noiseCurve(double t)
+{
+	return t*t*(3.0-2.0*t);
+}
+
+// lattice rows of a noise row
+struct NoiseRow
+{
+	int32_t by0;
+	int32_t by1;
+	double ry0;
+	double ry1;
+	double sy;
+	NoiseRow(double y, const PixelNoiseStitch* stitch)
+	{
+		double t=y+NOISE_OFFSET;
+		by0=int32_t(t);
+		by1=by0+1;
+		ry0=t-by0;
+		ry1=ry0-1.0;
+		if (stitch)
+		{
+			if (by0>=stitch->wrapY)
+				by0-=stitch->height;
+			if (by1>=stitch->wrapY)
+				by1-=stitch->height;
+		}
+		by0&=NOISE_LATTICE_MASK;
+		by1&=NOISE_LATTICE_MASK;
+		sy=noiseCurve(ry0);
+	}
+};
+
+static inline void noiseColumn(const PixelNoiseLattice& lattice, double t, const PixelNoiseStitch* stitch, int32_t& i, int32_t& j, double& rx0)
+{
+	int32_t bx0=int32_t(t);
+	int32_t bx1=bx0+1;
+	rx0=t-bx0;
+	if (stitch)
+	{
+		if (bx0>=stitch->wrapX)
+			bx0-=stitch->width;
+		if (bx1>=stitch->wrapX)
+			bx1-=stitch->width;
+	}
+	i=lattice.selector[bx0&NOISE_LATTICE_MASK];
+	j=lattice.selector[bx1&NOISE_LATTICE_MASK];
+}
+
+static void noiseRowGeneric(const PixelNoiseLattice& lattice, uint32_t channel, double x, double dx, double y,
+		const PixelNoiseStitch* stitch, bool absolute, double scale, double* sums, uint32_t count)
+{
+	const double (*g)[2]=lattice.gradients[channel];
+	const NoiseRow row(y,stitch);
+	for (uint32_t n=0;n<count;n++)
+	{
+		int32_t i,j;
+		double rx0;
+		noiseColumn(lattice,x+n*dx+NOISE_OFFSET,stitch,i,j,rx0);
+		double rx1=rx0-1.0;
+		const double* q00=g[lattice.selector[i+row.by0]];
+		const double* q10=g[lattice.selector[j+row.by0]];
+		const double* q01=g[lattice.selector[i+row.by1]];
+		const double* q11=g[lattice.selector[j+row.by1]];
+		double sx=noiseCurve(rx0);
+		double u=rx0*q00[0]+row.ry0*q00[1];
+		double v=rx1*q10[0]+row.ry0*q10[1];
+		double a=u+sx*(v-u);
+		u=rx0*q01[0]+row.ry1*q01[1];
+		v=rx1*q11[0]+row.ry1*q11[1];
+		double b=u+sx*(v-u);
+		double noise=a+row.sy*(b-a);
+		sums[n]+=(absolute ? fabs(noise) : noise)*scale;
+	}
+}
+
+#ifdef PIXELKERNELS_X86
+SSE2_TARGET static inline __m128i pixelToEpi32(uint32_t p)
+{
+	__m128i zero=_mm_setzero_si128();
+	__m128i v=_mm_unpacklo_epi8(_mm_cvtsi32_si128(p),zero);
+	return _mm_unpacklo_epi16(v,zero);
+}
+
+SSE2_TARGET static inline uint32_t epi32ToPixel(__m128i v)
+{
+	v=_mm_packs_epi32(v,v);
+	v=_mm_packus_epi16(v,v);
+	return _mm_cvtsi128_si32(v);
+}
+
+SSE2_TARGET static void boxBlurAccumulateRowSSE2(int32_t* sums, const uint32_t* addRow, const uint32_t* subRow, uint32_t count)
+{
+	const __m128i zero=_mm_setzero_si128();
+	uint32_t i=0;
+	for (;i+4<=count;i+=4)
+	{
+		__m128i* s=(__m128i*)(sums+i*4);
+		__m128i s0=_mm_loadu_si128(s);
+		__m128i s1=_mm_loadu_si128(s+1);
+		__m128i s2=_mm_loadu_si128(s+2);
+		__m128i s3=_mm_loadu_si128(s+3);
+		if (addRow)
+		{
+			__m128i p=_mm_loadu_si128((const __m128i*)(addRow+i));
+			__m128i lo=_mm_unpacklo_epi8(p,zero);
+			__m128i hi=_mm_unpackhi_epi8(p,zero);
+			s0=_mm_add_epi32(s0,_mm_unpacklo_epi16(lo,zero));
+			s1=_mm_add_epi32(s1,_mm_unpackhi_epi16(lo,zero));
+			s2=_mm_add_epi32(s2,_mm_unpacklo_epi16(hi,zero));
+			s3=_mm_add_epi32(s3,_mm_unpackhi_epi16(hi,zero));
+		}
+		if (subRow)
+		{
+			__m128i p=_mm_loadu_si128((const __m128i*)(subRow+i));
+			__m128i lo=_mm_unpacklo_epi8(p,zero);
+			__m128i hi=_mm_unpackhi_epi8(p,zero);
+			s0=_mm_sub_epi32(s0,_mm_unpacklo_epi16(lo,zero));
+			s1=_mm_sub_epi32(s1,_mm_unpackhi_epi16(lo,zero));
+			s2=_mm_sub_epi32(s2,_mm_unpacklo_epi16(hi,zero));
+			s3=_mm_sub_epi32(s3,_mm_unpackhi_epi16(hi,zero));
+		}
+		_mm_storeu_si128(s,s0);
+		_mm_storeu_si128(s+1,s1);
+		_mm_storeu_si128(s+2,s2);
+		_mm_storeu_si128(s+3,s3);
+	}
+	boxBlurAccumulateRowGeneric(sums+i*4,addRow ? addRow+i : nullptr,subRow ? subRow+i : nullptr,count-i);
+}
+
+SSE2_TARGET static void boxBlurStoreRowSSE2(const int32_t* sums, uint32_t* dst, uint32_t count, float scale)
+{
+	const __m128 s=_mm_set1_ps(scale);
+	uint32_t i=0;
+	for (;i+4<=count;i+=4)
+	{
+		const __m128i* p=(const __m128i*)(sums+i*4);
+		__m128i v0=_mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(p)),s));
+		__m128i v1=_mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(p+1)),s));
+		__m128i v2=_mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(p+2)),s));
+		__m128i v3=_mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(p+3)),s));
+		__m128i v=_mm_packus_epi16(_mm_packs_epi32(v0,v1),_mm_packs_epi32(v2,v3));
+		_mm_storeu_si128((__m128i*)(dst+i),v);
+	}
+	boxBlurStoreRowGeneric(sums+i*4,dst+i,count-i,scale);
+}
+
+SSE2_TARGET static void boxBlurRowSSE2(const uint32_t* src, uint32_t* dst, uint32_t count, uint32_t radius)
+{
+	const __m128 scale=_mm_set1_ps(1.0f/(2*radius+1));
+	__m128i sum=_mm_setzero_si128();
+	for (uint32_t i=0;i<=radius && i<count;i++)
+		sum=_mm_add_epi32(sum,pixelToEpi32(src[i]));
+	for (uint32_t x=0;x<count;x++)
+	{
+		dst[x]=epi32ToPixel(_mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(sum),scale)));
+		if (x+radius+1<count)
+			sum=_mm_add_epi32(sum,pixelToEpi32(src[x+radius+1]));
+		if (x>=radius)
+			sum=_mm_sub_epi32(sum,pixelToEpi32(src[x-radius]));
+	}
+}
+
+// unpremultiplies the color channels of f, the alpha channel is left untouched
+SSE2_TARGET static inline __m128 unpremultiplySSE2(__m128 f)
+{
+	const __m128 rgbMask=_mm_castsi128_ps(_mm_setr_epi32(-1,-1,-1,0));
+	const __m128 c255=_mm_set1_ps(255.0f);
+	__m128 alpha=_mm_shuffle_ps(f,f,_MM_SHUFFLE(3,3,3,3));
+	__m128 factor=_mm_div_ps(c255,_mm_max_ps(alpha,_mm_set1_ps(1.0f)));
+	__m128 rgb=_mm_min_ps(_mm_mul_ps(f,factor),c255);
+	return _mm_or_ps(_mm_and_ps(rgb,rgbMask),_mm_andnot_ps(rgbMask,f));
+}
+
+// clamps f to 0-255 and premultiplies the color channels
+SSE2_TARGET static inline __m128i premultiplySSE2(__m128 f)
+{
+	const __m128 rgbMask=_mm_castsi128_ps(_mm_setr_epi32(-1,-1,-1,0));
+	const __m128 one=_mm_set1_ps(1.0f);
+	f=_mm_min_ps(_mm_max_ps(f,_mm_setzero_ps()),_mm_set1_ps(255.0f));
+	__m128 alpha=_mm_shuffle_ps(f,f,_MM_SHUFFLE(3,3,3,3));
+	__m128 factor=_mm_mul_ps(alpha,_mm_set1_ps(1.0f/255.0f));
+	factor=_mm_or_ps(_mm_and_ps(factor,rgbMask),_mm_andnot_ps(rgbMask,one));
+	return _mm_cvtps_epi32(_mm_mul_ps(f,factor));
+}
+
+SSE2_TARGET static void unpremultiplyRowSSE2(const uint32_t* src, float* dst, uint32_t count)
+{
+	for (uint32_t i=0;i<count;i++)
+		_mm_storeu_ps(dst+i*4,unpremultiplySSE2(_mm_cvtepi32_ps(pixelToEpi32(src[i]))));
+}
+
+SSE2_TARGET static void premultiplyRowSSE2(const float* src, uint32_t* dst, uint32_t count)
+{
+	for (uint32_t i=0;i<count;i++)
+		dst[i]=epi32ToPixel(premultiplySSE2(_mm_loadu_ps(src+i*4)));
+}
+
+SSE2_TARGET static void colorMatrixRowSSE2(const uint32_t* src, uint32_t* dst, uint32_t count, const float* matrix, const float* offsets)
+{
+	const __m128 col0=_mm_loadu_ps(matrix);
+	const __m128 col1=_mm_loadu_ps(matrix+4);
+	const __m128 col2=_mm_loadu_ps(matrix+8);
+	const __m128 col3=_mm_loadu_ps(matrix+12);
+	const __m128 off=_mm_loadu_ps(offsets);
+	for (uint32_t i=0;i<count;i++)
+	{
+		__m128 f=unpremultiplySSE2(_mm_cvtepi32_ps(pixelToEpi32(src[i])));
+		__m128 out=_mm_add_ps(off,_mm_mul_ps(_mm_shuffle_ps(f,f,_MM_SHUFFLE(0,0,0,0)),col0));
+		out=_mm_add_ps(out,_mm_mul_ps(_mm_shuffle_ps(f,f,_MM_SHUFFLE(1,1,1,1)),col1));
+		out=_mm_add_ps(out,_mm_mul_ps(_mm_shuffle_ps(f,f,_MM_SHUFFLE(2,2,2,2)),col2));
+		out=_mm_add_ps(out,_mm_mul_ps(_mm_shuffle_ps(f,f,_MM_SHUFFLE(3,3,3,3)),col3));
+		dst[i]=epi32ToPixel(premultiplySSE2(out));
+	}
+}
+
+SSE2_TARGET static void convolveRowSSE2(const float* src, uint32_t srcStride, float* dst, uint32_t count,
+		const float* matrix, uint32_t matrixX, uint32_t matrixY, float scale, float bias)
+{
+	for (uint32_t x=0;x<count;x++)
+	{
+		__m128 acc=_mm_setzero_ps();
+		for (uint32_t j=0;j<matrixY;j++)
+		{
+			const float* p=src+j*srcStride+x*4;
+			const float* m=matrix+j*matrixX;
+			for (uint32_t i=0;i<matrixX;i++)
+				acc=_mm_add_ps(acc,_mm_mul_ps(_mm_loadu_ps(p+i*4),_mm_set1_ps(m[i])));
+		}
+		_mm_storeu_ps(dst+x*4,_mm_add_ps(_mm_mul_ps(acc,_mm_set1_ps(scale)),_mm_set1_ps(bias)));
+	}
+}
+
+// rounded x/255 for 16 bit lanes with 0<=x<=255*255
+SSE2_TARGET static inline __m128i div255SSE2(__m128i x)
+{
+	x=_mm_add_epi16(x,_mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(x,_mm_srli_epi16(x,8)),8);
+}
+
+// broadcasts the alpha channel of two pixels with 16 bit lanes
+SSE2_TARGET static inline __m128i alphaEpi16SSE2(__m128i v)
+{
+	return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v,_MM_SHUFFLE(3,3,3,3)),_MM_SHUFFLE(3,3,3,3));
+}
+
+SSE2_TARGET static inline __m128i premultiplyEpi16SSE2(__m128i v)
+{
+	const __m128i alphaLanes=_mm_setr_epi16(0,0,0,-1,0,0,0,-1);
+	__m128i a=alphaEpi16SSE2(v);
+	a=_mm_or_si128(_mm_andnot_si128(alphaLanes,a),_mm_and_si128(alphaLanes,_mm_set1_epi16(255)));
+	return div255SSE2(_mm_mullo_epi16(v,a));
+}
+
+SSE2_TARGET static inline bool allOpaqueSSE2(__m128i v)
+{
+	const __m128i alphaMask=_mm_set1_epi32(int(0xff000000));
+	return _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(v,alphaMask),alphaMask))==0xffff;
+}
+
+SSE2_TARGET static void toPremultipliedRowSSE2(const uint32_t* src, uint32_t* dst, uint32_t count)
+{
+	const __m128i zero=_mm_setzero_si128();
+	uint32_t i=0;
+	for (;i+4<=count;i+=4)
+	{
+		__m128i v=_mm_loadu_si128((const __m128i*)(src+i));
+		if (!allOpaqueSSE2(v))
+			v=_mm_packus_epi16(premultiplyEpi16SSE2(_mm_unpacklo_epi8(v,zero)),premultiplyEpi16SSE2(_mm_unpackhi_epi8(v,zero)));
+		_mm_storeu_si128((__m128i*)(dst+i),v);
+	}
+	toPremultipliedRowGeneric(src+i,dst+i,count-i);
+}
+
+// ceil(c*255/a) for the channels of a single pixel with 32 bit lanes
+SSE2_TARGET static inline __m128i unpremultiplyEpi32SSE2(__m128i v)
+{
+	__m128 f=_mm_cvtepi32_ps(v);
+	__m128 q=_mm_div_ps(_mm_mul_ps(f,_mm_set1_ps(255.0f)),_mm_shuffle_ps(f,f,_MM_SHUFFLE(3,3,3,3)));
+	__m128i t=_mm_cvttps_epi32(q);
+	// cmplt is -1 where the quotient has been truncated
+	return _mm_sub_epi32(t,_mm_castps_si128(_mm_cmplt_ps(_mm_cvtepi32_ps(t),q)));
+}
+
+SSE2_TARGET static void toUnpremultipliedRowSSE2(const uint32_t* src, uint32_t* dst, uint32_t count)
+{
+	const __m128i zero=_mm_setzero_si128();
+	const __m128i alphaMask=_mm_set1_epi32(int(0xff000000));
+	uint32_t i=0;
+	for (;i+4<=count;i+=4)
+	{
+		__m128i v=_mm_loadu_si128((const __m128i*)(src+i));
+		__m128i alpha=_mm_and_si128(v,alphaMask);
+		// pixels with alpha 0 or 255 are left untouched
+		__m128i keep=_mm_or_si128(_mm_cmpeq_epi32(alpha,zero),_mm_cmpeq_epi32(alpha,alphaMask));
+		if (_mm_movemask_epi8(keep)!=0xffff)
+		{
+			__m128i lo=_mm_unpacklo_epi8(v,zero);
+			__m128i hi=_mm_unpackhi_epi8(v,zero);
+			__m128i p0=unpremultiplyEpi32SSE2(_mm_unpacklo_epi16(lo,zero));
+			__m128i p1=unpremultiplyEpi32SSE2(_mm_unpackhi_epi16(lo,zero));
+			__m128i p2=unpremultiplyEpi32SSE2(_mm_unpacklo_epi16(hi,zero));
+			__m128i p3=unpremultiplyEpi32SSE2(_mm_unpackhi_epi16(hi,zero));
+			__m128i res=_mm_packus_epi16(_mm_packs_epi32(p0,p1),_mm_packs_epi32(p2,p3));
+			res=_mm_or_si128(_mm_andnot_si128(alphaMask,res),alpha);
+			v=_mm_or_si128(_mm_and_si128(keep,v),_mm_andnot_si128(keep,res));
+		}
+		_mm_storeu_si128((__m128i*)(dst+i),v);
+	}
+	toUnpremultipliedRowGeneric(src+i,dst+i,count-i);
+}
+
+SSE2_TARGET static void blendRowSSE2(const uint32_t* src, uint32_t* dst, uint32_t count)
+{
+	const __m128i zero=_mm_setzero_si128();
+	const __m128i c255=_mm_set1_epi16(255);
+	uint32_t i=0;
+	for (;i+4<=count;i+=4)
+	{
+		__m128i s=_mm_loadu_si128((const __m128i*)(src+i));
+		if (allOpaqueSSE2(s))
+		{
+			_mm_storeu_si128((__m128i*)(dst+i),s);
+			continue;
+		}
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(s,zero))==0xffff)
+			continue;
+		__m128i d=_mm_loadu_si128((const __m128i*)(dst+i));
+		__m128i invlo=_mm_sub_epi16(c255,alphaEpi16SSE2(_mm_unpacklo_epi8(s,zero)));
+		__m128i invhi=_mm_sub_epi16(c255,alphaEpi16SSE2(_mm_unpackhi_epi8(s,zero)));
+		__m128i dlo=div255SSE2(_mm_mullo_epi16(_mm_unpacklo_epi8(d,zero),invlo));
+		__m128i dhi=div255SSE2(_mm_mullo_epi16(_mm_unpackhi_epi8(d,zero),invhi));
+		_mm_storeu_si128((__m128i*)(dst+i),_mm_adds_epu8(s,_mm_packus_epi16(dlo,dhi)));
+	}
+	blendRowGeneric(src+i,dst+i,count-i);
+}
+
+SSE2_TARGET static void copyChannelRowSSE2(const uint32_t* src, uint32_t* dst, uint32_t count, uint32_t srcShift, uint32_t dstShift)
+{
+	const __m128i srcCount=_mm_cvtsi32_si128(srcShift);
+	const __m128i dstCount=_mm_cvtsi32_si128(dstShift);
+	const __m128i byteMask=_mm_set1_epi32(0xff);
+	const __m128i keepMask=_mm_set1_epi32(int(~(0xffu<<dstShift)));
+	uint32_t i=0;
+	for (;i+4<=count;i+=4)
+	{
+		__m128i s=_mm_loadu_si128((const __m128i*)(src+i));
+		__m128i d=_mm_loadu_si128((const __m128i*)(dst+i));
+		__m128i c=_mm_and_si128(_mm_srl_epi32(s,srcCount),byteMask);
+		_mm_storeu_si128((__m128i*)(dst+i),_mm_or_si128(_mm_and_si128(d,keepMask),_mm_sll_epi32(c,dstCount)));
+	}
+	copyChannelRowGeneric(src+i,dst+i,count-i,srcShift,dstShift);
+}
+
+SSE2_TARGET static uint32_t thresholdRowSSE2(const uint32_t* src, uint32_t* dst, uint32_t count, PIXEL_THRESHOLD_OP op,
+		uint32_t threshold, uint32_t color, uint32_t mask, bool copySource)
+{
+	// SSE2 only has signed comparisons, flipping the sign bit turns them into unsigned ones
+	const __m128i bias=_mm_set1_epi32(int(0x80000000));
+	const __m128i vmask=_mm_set1_epi32(int(mask));
+	const __m128i t=_mm_xor_si128(_mm_set1_epi32(int(threshold&mask)),bias);
+	const __m128i vcolor=_mm_set1_epi32(int(color));
+	const __m128i ones=_mm_set1_epi32(-1);
+	uint32_t matched=0;
+	uint32_t i=0;
+	for (;i+4<=count;i+=4)
+	{
+		__m128i s=_mm_loadu_si128((const __m128i*)(src+i));
+		__m128i v=_mm_xor_si128(_mm_and_si128(s,vmask),bias);
+		__m128i sel;
+		switch (op)
+		{
+			case THRESHOLD_LESS:
+				sel=_mm_cmplt_epi32(v,t);
+				break;
+			case THRESHOLD_LESS_EQUAL:
+				sel=_mm_xor_si128(_mm_cmpgt_epi32(v,t),ones);
+				break;
+			case THRESHOLD_GREATER:
+				sel=_mm_cmpgt_epi32(v,t);
+				break;
+			case THRESHOLD_GREATER_EQUAL:
+				sel=_mm_xor_si128(_mm_cmplt_epi32(v,t),ones);
+				break;
+			case THRESHOLD_EQUAL:
+				sel=_mm_cmpeq_epi32(v,t);
+				break;
+			default:
+				sel=_mm_xor_si128(_mm_cmpeq_epi32(v,t),ones);
+				break;
+		}
+		__m128i other=copySource ? s : _mm_loadu_si128((const __m128i*)(dst+i));
+		_mm_storeu_si128((__m128i*)(dst+i),_mm_or_si128(_mm_and_si128(sel,vcolor),_mm_andnot_si128(sel,other)));
+		matched+=__builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(sel)));
+	}
+	return matched+thresholdRowGeneric(src+i,dst+i,count-i,op,threshold,color,mask,copySource);
+}
+
+SSE2_TARGET static void mergeRowSSE2(const uint32_t* src, uint32_t* dst, uint32_t count, const uint32_t* multipliers)
+{
+	const __m128i zero=_mm_setzero_si128();
+	const __m128i m=_mm_setr_epi16(multipliers[0],multipliers[1],multipliers[2],multipliers[3],
+			multipliers[0],multipliers[1],multipliers[2],multipliers[3]);
+	const __m128i inv=_mm_sub_epi16(_mm_set1_epi16(256),m);
+	uint32_t i=0;
+	for (;i+4<=count;i+=4)
+	{
+		__m128i s=_mm_loadu_si128((const __m128i*)(src+i));
+		__m128i d=_mm_loadu_si128((const __m128i*)(dst+i));
+		// the sums are at most 255*256 and fit into unsigned 16 bit lanes
+		__m128i lo=_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(s,zero),m),_mm_mullo_epi16(_mm_unpacklo_epi8(d,zero),inv));
+		__m128i hi=_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(s,zero),m),_mm_mullo_epi16(_mm_unpackhi_epi8(d,zero),inv));
+		_mm_storeu_si128((__m128i*)(dst+i),_mm_packus_epi16(_mm_srli_epi16(lo,8),_mm_srli_epi16(hi,8)));
+	}
+	mergeRowGeneric(src+i,dst+i,count-i,multipliers);
+}
+
+SSE2_TARGET static bool compareRowSSE2(const uint32_t* src1, const uint32_t* src2, uint32_t* dst, uint32_t count)
+{
+	const __m128i rgbMask=_mm_set1_epi32(0xffffff);
+	int equal=0xffff;
+	uint32_t i=0;
+	for (;i+4<=count;i+=4)
+	{
+		__m128i a=_mm_loadu_si128((const __m128i*)(src1+i));
+		__m128i b=_mm_loadu_si128((const __m128i*)(src2+i));
+		__m128i diff=_mm_sub_epi8(a,b);
+		__m128i eq=_mm_cmpeq_epi32(a,b);
+		__m128i rgbEq=_mm_cmpeq_epi32(_mm_and_si128(a,rgbMask),_mm_and_si128(b,rgbMask));
+		__m128i alphaDiff=_mm_or_si128(_mm_andnot_si128(rgbMask,diff),rgbMask);
+		__m128i colorDiff=_mm_or_si128(_mm_and_si128(diff,rgbMask),_mm_andnot_si128(rgbMask,_mm_set1_epi32(-1)));
+		__m128i res=_mm_or_si128(_mm_and_si128(rgbEq,alphaDiff),_mm_andnot_si128(rgbEq,colorDiff));
+		_mm_storeu_si128((__m128i*)(dst+i),_mm_andnot_si128(eq,res));
+		equal&=_mm_movemask_epi8(eq);
+	}
+	bool different=compareRowGeneric(src1+i,src2+i,dst+i,count-i);
+	return different || equal!=0xffff;
+}
+
+/*
+	Computes two points at a time, the lattice lookups are scalar but the interpolation is vectorized
+*/
+SSE2_TARGET static void noiseRowSSE2(const PixelNoiseLattice& lattice, uint32_t channel, double x, double dx, double y,
+		const PixelNoiseStitch* stitch, bool absolute, double scale, double* sums, uint32_t count)
+{
+	const double (*g)[2]=lattice.gradients[channel];
+	const NoiseRow row(y,stitch);
+	const __m128d ry0=_mm_set1_pd(row.ry0);
+	const __m128d ry1=_mm_set1_pd(row.ry1);
+	const __m128d sy=_mm_set1_pd(row.sy);
+	const __m128d one=_mm_set1_pd(1.0);
+	const __m128d two=_mm_set1_pd(2.0);
+	const __m128d three=_mm_set1_pd(3.0);
+	const __m128d vscale=_mm_set1_pd(scale);
+	const __m128d signMask=_mm_set1_pd(-0.0);
+	uint32_t n=0;
+	for (;n+2<=count;n+=2)
+	{
+		int32_t i0,j0,i1,j1;
+		double r0,r1;
+		noiseColumn(lattice,x+n*dx+NOISE_OFFSET,stitch,i0,j0,r0);
+		noiseColumn(lattice,x+(n+1)*dx+NOISE_OFFSET,stitch,i1,j1,r1);
+		const __m128d rx0=_mm_set_pd(r1,r0);
+		const __m128d rx1=_mm_sub_pd(rx0,one);
+		const double* a00=g[lattice.selector[i0+row.by0]];
+		const double* b00=g[lattice.selector[i1+row.by0]];
+		const double* a10=g[lattice.selector[j0+row.by0]];
+		const double* b10=g[lattice.selector[j1+row.by0]];
+		const double* a01=g[lattice.selector[i0+row.by1]];
+		const double* b01=g[lattice.selector[i1+row.by1]];
+		const double* a11=g[lattice.selector[j0+row.by1]];
+		const double* b11=g[lattice.selector[j1+row.by1]];
+		// sx=rx0*rx0*(3-2*rx0)
+		__m128d sx=_mm_mul_pd(_mm_mul_pd(rx0,rx0),_mm_sub_pd(three,_mm_mul_pd(two,rx0)));
+		__m128d u=_mm_add_pd(_mm_mul_pd(rx0,_mm_set_pd(b00[0],a00[0])),_mm_mul_pd(ry0,_mm_set_pd(b00[1],a00[1])));
+		__m128d v=_mm_add_pd(_mm_mul_pd(rx1,_mm_set_pd(b10[0],a10[0])),_mm_mul_pd(ry0,_mm_set_pd(b10[1],a10[1])));
+		__m128d a=_mm_add_pd(u,_mm_mul_pd(sx,_mm_sub_pd(v,u)));
+		u=_mm_add_pd(_mm_mul_pd(rx0,_mm_set_pd(b01[0],a01[0])),_mm_mul_pd(ry1,_mm_set_pd(b01[1],a01[1])));
+		v=_mm_add_pd(_mm_mul_pd(rx1,_mm_set_pd(b11[0],a11[0])),_mm_mul_pd(ry1,_mm_set_pd(b11[1],a11[1])));
+		__m128d b=_mm_add_pd(u,_mm_mul_pd(sx,_mm_sub_pd(v,u)));
+		__m128d noise=_mm_add_pd(a,_mm_mul_pd(sy,_mm_sub_pd(b,a)));
+		if (absolute)
+			noise=_mm_andnot_pd(signMask,noise);
+		_mm_storeu_pd(sums+n,_mm_add_pd(_mm_loadu_pd(sums+n),_mm_mul_pd(noise,vscale)));
+	}
+	if (n<count)
+		noiseRowGeneric(lattice,channel,x+n*dx,dx,y,stitch,absolute,scale,sums+n,count-n);
+}
+
+AVX2_TARGET static void boxBlurAccumulateRowAVX2(int32_t* sums, const uint32_t* addRow, const uint32_t* subRow, uint32_t count)
+{
+	uint32_t i=0;
+	for (;i+8<=count;i+=8)
+	{
+		// every register holds the sums of two pixels
+		for (uint32_t k=0;k<4;k++)
+		{
+			__m256i* s=(__m256i*)(sums+(i+k*2)*4);
+			__m256i v=_mm256_loadu_si256(s);
+			if (addRow)
+				v=_mm256_add_epi32(v,_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(addRow+i+k*2))));
+			if (subRow)
+				v=_mm256_sub_epi32(v,_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(subRow+i+k*2))));
+			_mm256_storeu_si256(s,v);
+		}
+	}
+	boxBlurAccumulateRowSSE2(sums+i*4,addRow ? addRow+i : nullptr,subRow ? subRow+i : nullptr,count-i);
+}
+
+AVX2_TARGET static void boxBlurStoreRowAVX2(const int32_t* sums, uint32_t* dst, uint32_t count, float scale)
+{
+	const __m256 s=_mm256_set1_ps(scale);
+	// packing works inside the 128 bit lanes, this restores the pixel order
+	const __m256i order=_mm256_setr_epi32(0,4,1,5,2,6,3,7);
+	uint32_t i=0;
+	for (;i+8<=count;i+=8)
+	{
+		const __m256i* p=(const __m256i*)(sums+i*4);
+		__m256i v0=_mm256_cvtps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256(p)),s));
+		__m256i v1=_mm256_cvtps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256(p+1)),s));
+		__m256i v2=_mm256_cvtps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256(p+2)),s));
+		__m256i v3=_mm256_cvtps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256(p+3)),s));
+		__m256i v=_mm256_packus_epi16(_mm256_packs_epi32(v0,v1),_mm256_packs_epi32(v2,v3));
+		_mm256_storeu_si256((__m256i*)(dst+i),_mm256_permutevar8x32_epi32(v,order));
+	}
+	boxBlurStoreRowSSE2(sums+i*4,dst+i,count-i,scale);
+}
+
+AVX2_TARGET static inline __m256 broadcast128(__m128 v)
+{
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(v),v,1);
+}
+
+AVX2_TARGET static void colorMatrixRowAVX2(const uint32_t* src, uint32_t* dst, uint32_t count, const float* matrix, const float* offsets)
+{
+	const __m256 col0=broadcast128(_mm_loadu_ps(matrix));
+	const __m256 col1=broadcast128(_mm_loadu_ps(matrix+4));
+	const __m256 col2=broadcast128(_mm_loadu_ps(matrix+8));
+	const __m256 col3=broadcast128(_mm_loadu_ps(matrix+12));
+	const __m256 off=broadcast128(_mm_loadu_ps(offsets));
+	const __m256 rgbMask=_mm256_castsi256_ps(_mm256_setr_epi32(-1,-1,-1,0,-1,-1,-1,0));
+	const __m256 c255=_mm256_set1_ps(255.0f);
+	const __m256 one=_mm256_set1_ps(1.0f);
+	uint32_t i=0;
+	for (;i+2<=count;i+=2)
+	{
+		// two pixels per register
+		__m256 f=_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src+i))));
+		__m256 alpha=_mm256_shuffle_ps(f,f,_MM_SHUFFLE(3,3,3,3));
+		__m256 rgb=_mm256_min_ps(_mm256_mul_ps(f,_mm256_div_ps(c255,_mm256_max_ps(alpha,one))),c255);
+		f=_mm256_blendv_ps(f,rgb,rgbMask);
+		__m256 out=_mm256_add_ps(off,_mm256_mul_ps(_mm256_shuffle_ps(f,f,_MM_SHUFFLE(0,0,0,0)),col0));
+		out=_mm256_add_ps(out,_mm256_mul_ps(_mm256_shuffle_ps(f,f,_MM_SHUFFLE(1,1,1,1)),col1));
+		out=_mm256_add_ps(out,_mm256_mul_ps(_mm256_shuffle_ps(f,f,_MM_SHUFFLE(2,2,2,2)),col2));
+		out=_mm256_add_ps(out,_mm256_mul_ps(_mm256_shuffle_ps(f,f,_MM_SHUFFLE(3,3,3,3)),col3));
+		out=_mm256_min_ps(_mm256_max_ps(out,_mm256_setzero_ps()),c255);
+		__m256 factor=_mm256_mul_ps(_mm256_shuffle_ps(out,out,_MM_SHUFFLE(3,3,3,3)),_mm256_set1_ps(1.0f/255.0f));
+		factor=_mm256_blendv_ps(one,factor,rgbMask);
+		__m256i v=_mm256_cvtps_epi32(_mm256_mul_ps(out,factor));
+		__m128i p=_mm_packs_epi32(_mm256_castsi256_si128(v),_mm256_extracti128_si256(v,1));
+		_mm_storel_epi64((__m128i*)(dst+i),_mm_packus_epi16(p,p));
+	}
+	colorMatrixRowSSE2(src+i,dst+i,count-i,matrix,offsets);
+}
+
+AVX2_TARGET static void convolveRowAVX2(const float* src, uint32_t srcStride, float* dst, uint32_t count,
+		const float* matrix, uint32_t matrixX, uint32_t matrixY, float scale, float bias)
+{
+	uint32_t x=0;
+	for (;x+2<=count;x+=2)
+	{
+		// two adjacent destination pixels use two adjacent source pixels for every weight
+		__m256 acc=_mm256_setzero_ps();
+		for (uint32_t j=0;j<matrixY;j++)
+		{
+			const float* p=src+j*srcStride+x*4;
+			const float* m=matrix+j*matrixX;
+			for (uint32_t i=0;i<matrixX;i++)
+				acc=_mm256_add_ps(acc,_mm256_mul_ps(_mm256_loadu_ps(p+i*4),_mm256_set1_ps(m[i])));
+		}
+		_mm256_storeu_ps(dst+x*4,_mm256_add_ps(_mm256_mul_ps(acc,_mm256_set1_ps(scale)),_mm256_set1_ps(bias)));
+	}
+	convolveRowSSE2(src+x*4,srcStride,dst+x*4,count-x,matrix,matrixX,matrixY,scale,bias);
+}
+AVX2_TARGET static inline __m256i div255AVX2(__m256i x)
+{
+	x=_mm256_add_epi16(x,_mm256_set1_epi16(128));
+	return _mm256_srli_epi16(_mm256_add_epi16(x,_mm256_srli_epi16(x,8)),8);
+}
+
+AVX2_TARGET static inline __m256i alphaEpi16AVX2(__m256i v)
+{
+	return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(v,_MM_SHUFFLE(3,3,3,3)),_MM_SHUFFLE(3,3,3,3));
+}
+
+AVX2_TARGET static inline __m256i premultiplyEpi16AVX2(__m256i v)
+{
+	const __m256i alphaLanes=_mm256_setr_epi16(0,0,0,-1,0,0,0,-1,0,0,0,-1,0,0,0,-1);
+	__m256i a=_mm256_blendv_epi8(alphaEpi16AVX2(v),_mm256_set1_epi16(255),alphaLanes);
+	return div255AVX2(_mm256_mullo_epi16(v,a));
+}
+
+AVX2_TARGET static inline bool allOpaqueAVX2(__m256i v)
+{
+	const __m256i alphaMask=_mm256_set1_epi32(int(0xff000000));
+	return _mm256_movemask_epi8(_mm256_cmpeq_epi32(_mm256_and_si256(v,alphaMask),alphaMask))==-1;
+}
+
+// unpack and pack work on each 128 bit half, so the pixel order is preserved
+AVX2_TARGET static void toPremultipliedRowAVX2(const uint32_t* src, uint32_t* dst, uint32_t count)
+{
+	const __m256i zero=_mm256_setzero_si256();
+	uint32_t i=0;
+	for (;i+8<=count;i+=8)
+	{
+		__m256i v=_mm256_loadu_si256((const __m256i*)(src+i));
+		if (!allOpaqueAVX2(v))
+			v=_mm256_packus_epi16(premultiplyEpi16AVX2(_mm256_unpacklo_epi8(v,zero)),premultiplyEpi16AVX2(_mm256_unpackhi_epi8(v,zero)));
+		_mm256_storeu_si256((__m256i*)(dst+i),v);
+	}
+	toPremultipliedRowSSE2(src+i,dst+i,count-i);
+}
+
+AVX2_TARGET static void blendRowAVX2(const uint32_t* src, uint32_t* dst, uint32_t count)
+{
+	const __m256i zero=_mm256_setzero_si256();
+	const __m256i c255=_mm256_set1_epi16(255);
+	uint32_t i=0;
+	for (;i+8<=count;i+=8)
+	{
+		__m256i s=_mm256_loadu_si256((const __m256i*)(src+i));
+		if (allOpaqueAVX2(s))
+		{
+			_mm256_storeu_si256((__m256i*)(dst+i),s);
+			continue;
+		}
+		if (_mm256_testz_si256(s,s))
+			continue;
+		__m256i d=_mm256_loadu_si256((const __m256i*)(dst+i));
+		__m256i invlo=_mm256_sub_epi16(c255,alphaEpi16AVX2(_mm256_unpacklo_epi8(s,zero)));
+		__m256i invhi=_mm256_sub_epi16(c255,alphaEpi16AVX2(_mm256_unpackhi_epi8(s,zero)));
+		__m256i dlo=div255AVX2(_mm256_mullo_epi16(_mm256_unpacklo_epi8(d,zero),invlo));
+		__m256i dhi=div255AVX2(_mm256_mullo_epi16(_mm256_unpackhi_epi8(d,zero),invhi));
+		_mm256_storeu_si256((__m256i*)(dst+i),_mm256_adds_epu8(s,_mm256_packus_epi16(dlo,dhi)));
+	}
+	blendRowSSE2(src+i,dst+i,count-i);
+}
+
+AVX2_TARGET static void paletteMapRowAVX2(const uint32_t* src, uint32_t* dst, uint32_t count, const uint32_t* tables)
+{
+	const __m256i byteMask=_mm256_set1_epi32(0xff);
+	const int* t=(const int*)tables;
+	uint32_t i=0;
+	for (;i+8<=count;i+=8)
+	{
+		__m256i p=_mm256_loadu_si256((const __m256i*)(src+i));
+		__m256i res=_mm256_i32gather_epi32(t,_mm256_and_si256(p,byteMask),4);
+		res=_mm256_add_epi32(res,_mm256_i32gather_epi32(t+256,_mm256_and_si256(_mm256_srli_epi32(p,8),byteMask),4));
+		res=_mm256_add_epi32(res,_mm256_i32gather_epi32(t+512,_mm256_and_si256(_mm256_srli_epi32(p,16),byteMask),4));
+		res=_mm256_add_epi32(res,_mm256_i32gather_epi32(t+768,_mm256_srli_epi32(p,24),4));
+		_mm256_storeu_si256((__m256i*)(dst+i),res);
+	}
+	paletteMapRowGeneric(src+i,dst+i,count-i,tables);
+}
+
+#endif
+
+struct PixelKernelTable
+{
+	const char* name;
+	void (*boxBlurAccumulateRow)(int32_t* sums, const uint32_t* addRow, const uint32_t* subRow, uint32_t count);
+	void (*boxBlurStoreRow)(const int32_t* sums, uint32_t* dst, uint32_t count, float scale);
+	void (*boxBlurRow)(const uint32_t* src, uint32_t* dst, uint32_t count, uint32_t radius);
+	void (*colorMatrixRow)(const uint32_t* src, uint32_t* dst, uint32_t count, const float* matrix, const float* offsets);
+	void (*unpremultiplyRow)(const uint32_t* src, float* dst, uint32_t count);
+	void (*premultiplyRow)(const float* src, uint32_t* dst, uint32_t count);
+	void (*convolveRow)(const float* src, uint32_t srcStride, float* dst, uint32_t count,
+			const float* matrix, uint32_t matrixX, uint32_t matrixY, float scale, float bias);
+	void (*toPremultipliedRow)(const uint32_t* src, uint32_t* dst, uint32_t count);
+	void (*toUnpremultipliedRow)(const uint32_t* src, uint32_t* dst, uint32_t count);
+	void (*blendRow)(const uint32_t* src, uint32_t* dst, uint32_t count);
+	void (*copyChannelRow)(const uint32_t* src, uint32_t* dst, uint32_t count, uint32_t srcShift, uint32_t dstShift);
+	uint32_t (*thresholdRow)(const uint32_t* src, uint32_t* dst, uint32_t count, PIXEL_THRESHOLD_OP op,
+			uint32_t threshold, uint32_t color, uint32_t mask, bool copySource);
+	void (*mergeRow)(const uint32_t* src, uint32_t* dst, uint32_t count, const uint32_t* multipliers);
+	bool (*compareRow)(const uint32_t* src1, const uint32_t* src2, uint32_t* dst, uint32_t count);
+	void (*paletteMapRow)(const uint32_t* src, uint32_t* dst, uint32_t count, const uint32_t* tables);
+	void (*noiseRow)(const PixelNoiseLattice& lattice, uint32_t channel, double x, double dx, double y,
+			const PixelNoiseStitch* stitch, bool absolute, double scale, double* sums, uint32_t count);
+};
+
+static PixelKernelTable selectPixelKernels()
+{
+	PixelKernelTable t;
+	t.name="generic";
+	t.boxBlurAccumulateRow=boxBlurAccumulateRowGeneric;
+	t.boxBlurStoreRow=boxBlurStoreRowGeneric;
+	t.boxBlurRow=boxBlurRowGeneric;
+	t.colorMatrixRow=colorMatrixRowGeneric;
+	t.unpremultiplyRow=unpremultiplyRowGeneric;
+	t.premultiplyRow=premultiplyRowGeneric;
+	t.convolveRow=convolveRowGeneric;
+	t.toPremultipliedRow=toPremultipliedRowGeneric;
+	t.toUnpremultipliedRow=toUnpremultipliedRowGeneric;
+	t.blendRow=blendRowGeneric;
+	t.copyChannelRow=copyChannelRowGeneric;
+	t.thresholdRow=thresholdRowGeneric;
+	t.mergeRow=mergeRowGeneric;
+	t.compareRow=compareRowGeneric;
+	t.paletteMapRow=paletteMapRowGeneric;
+	t.noiseRow=noiseRowGeneric;
+#ifdef PIXELKERNELS_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2"))
+	{
+		t.name="sse2";
+		t.boxBlurAccumulateRow=boxBlurAccumulateRowSSE2;
+		t.boxBlurStoreRow=boxBlurStoreRowSSE2;
+		t.boxBlurRow=boxBlurRowSSE2;
+		t.colorMatrixRow=colorMatrixRowSSE2;
+		t.unpremultiplyRow=unpremultiplyRowSSE2;
+		t.premultiplyRow=premultiplyRowSSE2;
+		t.convolveRow=convolveRowSSE2;
+		t.toPremultipliedRow=toPremultipliedRowSSE2;
+		t.toUnpremultipliedRow=toUnpremultipliedRowSSE2;
+		t.blendRow=blendRowSSE2;
+		t.copyChannelRow=copyChannelRowSSE2;
+		t.thresholdRow=thresholdRowSSE2;
+		t.mergeRow=mergeRowSSE2;
+		t.compareRow=compareRowSSE2;
+		t.noiseRow=noiseRowSSE2;
+		if (__builtin_cpu_supports("avx2"))
+		{
+			t.name="avx2";
+			t.boxBlurAccumulateRow=boxBlurAccumulateRowAVX2;
+			t.boxBlurStoreRow=boxBlurStoreRowAVX2;
+			t.colorMatrixRow=colorMatrixRowAVX2;
+			t.convolveRow=convolveRowAVX2;
+			t.toPremultipliedRow=toPremultipliedRowAVX2;
+			t.blendRow=blendRowAVX2;
+			t.paletteMapRow=paletteMapRowAVX2;
+		}
+	}
+#endif
+	return t;
+}
+
+static const PixelKernelTable& pixelKernels()
+{
+	static const PixelKernelTable table=selectPixelKernels();
+	return table;
+}
+
+const char* lightspark::pixelKernelsName()
+{
+	return pixelKernels().name;
+}
+
+void lightspark::pixelBoxBlurAccumulateRow(int32_t* sums, const uint32_t* addRow, const uint32_t* subRow, uint32_t count)
+{
+	pixelKernels().boxBlurAccumulateRow(sums,addRow,subRow,count);
+}
+
+void lightspark::pixelBoxBlurStoreRow(const int32_t* sums, uint32_t* dst, uint32_t count, float scale)
+{
+	pixelKernels().boxBlurStoreRow(sums,dst,count,scale);
+}
+
+void lightspark::pixelBoxBlurRow(const uint32_t* src, uint32_t* dst, uint32_t count, uint32_t radius)
+{
+	pixelKernels().boxBlurRow(src,dst,count,radius);
+}
+
+void lightspark::pixelColorMatrixRow(const uint32_t* src, uint32_t* dst, uint32_t count, const float* matrix, const float* offsets)
+{
+	pixelKernels().colorMatrixRow(src,dst,count,matrix,offsets);
+}
+
+void lightspark::pixelUnpremultiplyRow(const uint32_t* src, float* dst, uint32_t count)
+{
+	pixelKernels().unpremultiplyRow(src,dst,count);
+}
+
+void lightspark::pixelPremultiplyRow(const float* src, uint32_t* dst, uint32_t count)
+{
+	pixelKernels().premultiplyRow(src,dst,count);
+}
+
+void lightspark::pixelConvolveRow(const float* src, uint32_t srcStride, float* dst, uint32_t count,
+		const float* matrix, uint32_t matrixX, uint32_t matrixY, float scale, float bias)
+{
+	pixelKernels().convolveRow(src,srcStride,dst,count,matrix,matrixX,matrixY,scale,bias);
+}
+
+void lightspark::pixelToPremultipliedRow(const uint32_t* src, uint32_t* dst, uint32_t count)
+{
+	pixelKernels().toPremultipliedRow(src,dst,count);
+}
+
+void lightspark::pixelToUnpremultipliedRow(const uint32_t* src, uint32_t* dst, uint32_t count)
+{
+	pixelKernels().toUnpremultipliedRow(src,dst,count);
+}
+
+void lightspark::pixelBlendRow(const uint32_t* src, uint32_t* dst, uint32_t count)
+{
+	pixelKernels().blendRow(src,dst,count);
+}
+
+void lightspark::pixelCopyChannelRow(const uint32_t* src, uint32_t* dst, uint32_t count, uint32_t srcShift, uint32_t dstShift)
+{
+	pixelKernels().copyChannelRow(src,dst,count,srcShift,dstShift);
+}
+
+uint32_t lightspark::pixelThresholdRow(const uint32_t* src, uint32_t* dst, uint32_t count, PIXEL_THRESHOLD_OP op,
+		uint32_t threshold, uint32_t color, uint32_t mask, bool copySource)
+{
+	return pixelKernels().thresholdRow(src,dst,count,op,threshold,color,mask,copySource);
+}
+
+void lightspark::pixelMergeRow(const uint32_t* src, uint32_t* dst, uint32_t count, const uint32_t* multipliers)
+{
+	pixelKernels().mergeRow(src,dst,count,multipliers);
+}
+
+bool lightspark::pixelCompareRow(const uint32_t* src1, const uint32_t* src2, uint32_t* dst, uint32_t count)
+{
+	return pixelKernels().compareRow(src1,src2,dst,count);
+}
+
+void lightspark::pixelPaletteMapRow(const uint32_t* src, uint32_t* dst, uint32_t count, const uint32_t* tables)
+{
+	pixelKernels().paletteMapRow(src,dst,count,tables);
+}
+
+void lightspark::pixelNoiseRow(const PixelNoiseLattice& lattice, uint32_t channel, double x, double dx, double y,
+		const PixelNoiseStitch* stitch, bool absolute, double scale, double* sums, uint32_t count)
+{
+	pixelKernels().noiseRow(lattice,channel,x,dx,y,stitch,absolute,scale,sums,count);
+}
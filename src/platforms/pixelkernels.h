@@ -0,0 +1,172 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef PLATFORMS_PIXELKERNELS_H
+#define PLATFORMS_PIXELKERNELS_H 1
+
+#include "compat.h"
+#include <cinttypes>
+
+namespace lightspark
+{
+
+/*
+	Row kernels working on 32 bit premultiplied ARGB pixels.
+	On x86 SSE2 and AVX2 implementations are selected at runtime, everywhere else the generic versions are used.
+	Sums and float pixels always have 4 components in the order b,g,r,a
+*/
+
+/**
+	Returns a description of the kernels selected for this cpu ("generic", "sse2" or "avx2")
+*/
+const char* pixelKernelsName();
+
+/**
+	Adds the channels of addRow to and subtracts the channels of subRow from the running sums of a vertical box blur
+
+	@param sums 4 sums per pixel
+	@param addRow pixels to be added, may be null
+	@param subRow pixels to be subtracted, may be null
+	@param count Number of pixels
+*/
+void pixelBoxBlurAccumulateRow(int32_t* sums, const uint32_t* addRow, const uint32_t* subRow, uint32_t count);
+/**
+	Stores the running sums of a vertical box blur multiplied by scale as pixels
+*/
+void pixelBoxBlurStoreRow(const int32_t* sums, uint32_t* dst, uint32_t count, float scale);
+/**
+	Horizontal box blur of a single row, pixels outside of the row are transparent
+
+	@param radius The blur window is 2*radius+1 pixels wide
+	@param src and dst must not overlap
+*/
+void pixelBoxBlurRow(const uint32_t* src, uint32_t* dst, uint32_t count, uint32_t radius);
+/**
+	Applies a color matrix to unpremultiplied channels
+
+	@param matrix 16 values, matrix[i*4+j] is the contribution of source channel i to destination channel j
+	@param offsets 4 values added to the destination channels
+	src and dst may be the same buffer
+*/
+void pixelColorMatrixRow(const uint32_t* src, uint32_t* dst, uint32_t count, const float* matrix, const float* offsets);
+/**
+	Converts premultiplied pixels to unpremultiplied float pixels in the range 0-255
+*/
+void pixelUnpremultiplyRow(const uint32_t* src, float* dst, uint32_t count);
+/**
+	Converts unpremultiplied float pixels to premultiplied pixels, clamping the channels to 0-255
+*/
+void pixelPremultiplyRow(const float* src, uint32_t* dst, uint32_t count);
+/**
+	Convolution of a single row of float pixels
+
+	@param src The top left pixel of the window of the first destination pixel
+	@param srcStride The distance between two source rows, in floats
+	@param matrix matrixX*matrixY weights
+	@param scale applied to the sum, bias is added afterwards
+*/
+void pixelConvolveRow(const float* src, uint32_t srcStride, float* dst, uint32_t count,
+		const float* matrix, uint32_t matrixX, uint32_t matrixY, float scale, float bias);
+
+/*
+	The following kernels work on 32 bit ARGB pixels without conversion to float.
+	Unless stated otherwise src and dst may be the same buffer
+*/
+
+/**
+	Converts unpremultiplied pixels to premultiplied pixels
+*/
+void pixelToPremultipliedRow(const uint32_t* src, uint32_t* dst, uint32_t count);
+/**
+	Converts premultiplied pixels to unpremultiplied pixels, the channels are rounded up like BitmapContainer::getPixel does
+*/
+void pixelToUnpremultipliedRow(const uint32_t* src, uint32_t* dst, uint32_t count);
+/**
+	Draws premultiplied src over premultiplied dst
+*/
+void pixelBlendRow(const uint32_t* src, uint32_t* dst, uint32_t count);
+/**
+	Copies a channel of src to a channel of dst
+
+	@param srcShift and dstShift The bit position of the channels (0, 8, 16 or 24)
+*/
+void pixelCopyChannelRow(const uint32_t* src, uint32_t* dst, uint32_t count, uint32_t srcShift, uint32_t dstShift);
+
+enum PIXEL_THRESHOLD_OP { THRESHOLD_LESS, THRESHOLD_LESS_EQUAL, THRESHOLD_GREATER, THRESHOLD_GREATER_EQUAL, THRESHOLD_EQUAL, THRESHOLD_NOT_EQUAL };
+/**
+	Sets all pixels of dst to color where (src & mask) op (threshold & mask) is true.
+	The other pixels are set to src if copySource is true and left untouched otherwise
+
+	@return The number of pixels set to color
+*/
+uint32_t pixelThresholdRow(const uint32_t* src, uint32_t* dst, uint32_t count, PIXEL_THRESHOLD_OP op,
+		uint32_t threshold, uint32_t color, uint32_t mask, bool copySource);
+/**
+	Blends the channels of src into dst: dst=(src*multiplier+dst*(256-multiplier))/256
+
+	@param multipliers 4 values in the range 0-256, in the order b,g,r,a
+*/
+void pixelMergeRow(const uint32_t* src, uint32_t* dst, uint32_t count, const uint32_t* multipliers);
+/**
+	Compares two rows of unpremultiplied pixels like BitmapData.compare does.
+	Equal pixels produce 0, pixels differing only in alpha produce 0xZZFFFFFF with ZZ the alpha difference,
+	all other pixels produce 0xFFRRGGBB with the channel differences
+
+	@return true if any pixel is different
+*/
+bool pixelCompareRow(const uint32_t* src1, const uint32_t* src2, uint32_t* dst, uint32_t count);
+/**
+	Maps every channel of src through a table and stores the sum of the four values
+
+	@param tables 4*256 values, tables[c*256+v] is the value for channel c (in the order b,g,r,a) having value v
+*/
+void pixelPaletteMapRow(const uint32_t* src, uint32_t* dst, uint32_t count, const uint32_t* tables);
+
+/**
+	Gradient lattice of the noise used by BitmapData.perlinNoise.
+	This is the noise of the SVG feTurbulence filter, with a set of gradients for each of 4 channels
+*/
+struct PixelNoiseLattice
+{
+	int32_t selector[2*256+2];
+	double gradients[4][2*256+2][2];
+	PixelNoiseLattice(int32_t seed);
+};
+/**
+	Wraps the lattice to make the noise tileable, positions are in lattice coordinates offset by 4096
+*/
+struct PixelNoiseStitch
+{
+	int32_t width;
+	int32_t height;
+	int32_t wrapX;
+	int32_t wrapY;
+};
+/**
+	Adds the noise at the points (x+i*dx,y) multiplied by scale to sums[i]
+
+	@param channel The gradient set to use (0-3)
+	@param stitch May be null
+	@param absolute Adds the absolute value of the noise (turbulence) instead of the signed value (fractal noise)
+*/
+void pixelNoiseRow(const PixelNoiseLattice& lattice, uint32_t channel, double x, double dx, double y,
+		const PixelNoiseStitch* stitch, bool absolute, double scale, double* sums, uint32_t count);
+
+};
+#endif /* PLATFORMS_PIXELKERNELS_H */
@@ -23,6 +23,9 @@
 
 #include "compat.h"
 #include <algorithm>
+#if defined(__linux__) && defined(__GLIBC__)
+#include <pthread.h>
+#endif
 
 #ifdef LLVM_ENABLED
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
@@ -192,12 +195,8 @@ void ScriptLimitsTag::execute(RootMovieClip* root) const
 {
 	if (root != root->getSystemState()->mainClip)
 		return;
-	if (MaxRecursionDepth > getVm(root->getSystemState())->limits.max_recursion)
-	{
-		delete[] getVm(root->getSystemState())->stacktrace;
-		getVm(root->getSystemState())->stacktrace = new ABCVm::stacktrace_entry[MaxRecursionDepth];
-	}
-	getVm(root->getSystemState())->limits.max_recursion = MaxRecursionDepth;
+	// the frame stack can't hold deeper recursions than the limit derived from its size
+	getVm(root->getSystemState())->limits.max_recursion = min(uint32_t(MaxRecursionDepth),getVm(root->getSystemState())->getStackRecursionLimit());
 	getVm(root->getSystemState())->limits.script_timeout = ScriptTimeoutSeconds;
 }
 
@@ -242,16 +241,16 @@ void ABCVm::registerClasses()
 void ABCVm::loadFloat(call_context *th)
 {
 	RUNTIME_STACK_POP_CREATE(th,arg1);
-	float addr=asAtomHandler::toNumber(*arg1);
-	ApplicationDomain* appDomain = th->mi->context->root->applicationDomain.getPtr();
+	uint32_t addr=asAtomHandler::toUInt(*arg1);
+	ApplicationDomain* appDomain = getDomainMemoryOwner(th);
 	number_t ret=appDomain->readFromDomainMemory<float>(addr);
 	ASATOM_DECREF_POINTER(arg1);
 	RUNTIME_STACK_PUSH(th,asAtomHandler::fromNumber(appDomain->getSystemState(),ret,false));
 }
 void ABCVm::loadFloat(call_context *th,asAtom& ret, asAtom& arg1)
 {
-	float addr=asAtomHandler::toNumber(arg1);
-	ApplicationDomain* appDomain = th->mi->context->root->applicationDomain.getPtr();
+	uint32_t addr=asAtomHandler::toUInt(arg1);
+	ApplicationDomain* appDomain = getDomainMemoryOwner(th);
 	number_t res=appDomain->readFromDomainMemory<float>(addr);
 	ret = asAtomHandler::fromNumber(appDomain->getSystemState(),res,false);
 }
@@ -259,16 +258,16 @@ void ABCVm::loadFloat(call_context *th,asAtom& ret, asAtom& arg1)
 void ABCVm::loadDouble(call_context *th)
 {
 	RUNTIME_STACK_POP_CREATE(th,arg1);
-	double addr=asAtomHandler::toNumber(*arg1);
-	ApplicationDomain* appDomain = th->mi->context->root->applicationDomain.getPtr();
+	uint32_t addr=asAtomHandler::toUInt(*arg1);
+	ApplicationDomain* appDomain = getDomainMemoryOwner(th);
 	number_t ret=appDomain->readFromDomainMemory<double>(addr);
 	ASATOM_DECREF_POINTER(arg1);
 	RUNTIME_STACK_PUSH(th,asAtomHandler::fromNumber(appDomain->getSystemState(),ret,false));
 }
 void ABCVm::loadDouble(call_context *th,asAtom& ret, asAtom& arg1)
 {
-	float addr=asAtomHandler::toNumber(arg1);
-	ApplicationDomain* appDomain = th->mi->context->root->applicationDomain.getPtr();
+	uint32_t addr=asAtomHandler::toUInt(arg1);
+	ApplicationDomain* appDomain = getDomainMemoryOwner(th);
 	number_t res=appDomain->readFromDomainMemory<double>(addr);
 	ret = asAtomHandler::fromNumber(appDomain->getSystemState(),res,false);
 }
@@ -277,18 +276,18 @@ void ABCVm::storeFloat(call_context *th)
 {
 	RUNTIME_STACK_POP_CREATE(th,arg1);
 	RUNTIME_STACK_POP_CREATE(th,arg2);
-	number_t addr=asAtomHandler::toNumber(*arg1);
+	uint32_t addr=asAtomHandler::toUInt(*arg1);
 	ASATOM_DECREF_POINTER(arg1);
 	float val=(float)asAtomHandler::toNumber(*arg2);
 	ASATOM_DECREF_POINTER(arg2);
-	ApplicationDomain* appDomain = th->mi->context->root->applicationDomain.getPtr();
+	ApplicationDomain* appDomain = getDomainMemoryOwner(th);
 	appDomain->writeToDomainMemory<float>(addr, val);
 }
 void ABCVm::storeFloat(call_context *th, asAtom& arg1, asAtom& arg2)
 {
-	number_t addr=asAtomHandler::toNumber(arg1);
+	uint32_t addr=asAtomHandler::toUInt(arg1);
 	float val=(float)asAtomHandler::toNumber(arg2);
-	ApplicationDomain* appDomain = th->mi->context->root->applicationDomain.getPtr();
+	ApplicationDomain* appDomain = getDomainMemoryOwner(th);
 	appDomain->writeToDomainMemory<float>(addr, val);
 }
 
@@ -296,18 +295,18 @@ void ABCVm::storeDouble(call_context *th)
 {
 	RUNTIME_STACK_POP_CREATE(th,arg1);
 	RUNTIME_STACK_POP_CREATE(th,arg2);
-	number_t addr=asAtomHandler::toNumber(*arg1);
+	uint32_t addr=asAtomHandler::toUInt(*arg1);
 	ASATOM_DECREF_POINTER(arg1);
 	double val=asAtomHandler::toNumber(*arg2);
 	ASATOM_DECREF_POINTER(arg2);
-	ApplicationDomain* appDomain = th->mi->context->root->applicationDomain.getPtr();
+	ApplicationDomain* appDomain = getDomainMemoryOwner(th);
 	appDomain->writeToDomainMemory<double>(addr, val);
 }
 void ABCVm::storeDouble(call_context *th, asAtom& arg1, asAtom& arg2)
 {
-	number_t addr=asAtomHandler::toNumber(arg1);
+	uint32_t addr=asAtomHandler::toUInt(arg1);
 	double val=asAtomHandler::toNumber(arg2);
-	ApplicationDomain* appDomain = th->mi->context->root->applicationDomain.getPtr();
+	ApplicationDomain* appDomain = getDomainMemoryOwner(th);
 	appDomain->writeToDomainMemory<double>(addr, val);
 }
 
@@ -920,18 +919,72 @@ void ABCContext::dumpProfilingData(ostream& f) const
  * nextNamespaceBase is set to 2 since 0 is the empty namespace and 1 is the AS3 namespace
  */
 ABCVm::ABCVm(SystemState* s, MemoryAccount* m):m_sys(s),status(CREATED),isIdle(true),shuttingdown(false),
-	events_queue(reporter_allocator<eventType>(m)),idleevents_queue(reporter_allocator<eventType>(m)),nextNamespaceBase(2),currentCallContext(NULL),
+	lockedEventsPending(false),sleeping(false),events_queue(reporter_allocator<queuedEvent>(m)),queuedEventCount(0),maxEventLatency(0),
+	nextNamespaceBase(2),currentCallContext(NULL),
 	vmDataMemory(m),cur_recursion(0)
 {
-	limits.max_recursion = 256;
+	stackrecursionlimit = min(uint32_t(VM_MAX_RECURSION),max(uint32_t(1),m_sys->vmStackSize/VM_FRAME_SIZE_ESTIMATE));
+#if !SDL_VERSION_ATLEAST(2, 0, 9)
+	// the vm thread runs on a native stack of the default size (usually 8MB)
+	stackrecursionlimit = min(stackrecursionlimit,uint32_t(8*1024*1024/VM_NATIVE_FRAME_SIZE));
+#endif
+	limits.max_recursion = stackrecursionlimit;
 	limits.script_timeout = 20;
+	nativestacklow = 0;
+	nativestacksize = 8*1024*1024;
 	m_sys=s;
-	stacktrace=new stacktrace_entry[256];
+	// the memory is only committed by the os when a recursion gets that deep
+	framestack=new uint8_t[m_sys->vmStackSize];
+	framestackptr=framestack;
+	framestackend=framestack+m_sys->vmStackSize;
+}
+
+void ABCVm::initNativeStackBounds()
+{
+#if defined(__linux__) && defined(__GLIBC__)
+	// the real bounds, the size of a thread created without a stack size depends on the system
+	pthread_attr_t attr;
+	if (pthread_getattr_np(pthread_self(),&attr)==0)
+	{
+		void* addr;
+		size_t size;
+		int res=pthread_attr_getstack(&attr,&addr,&size);
+		pthread_attr_destroy(&attr);
+		if (res==0)
+		{
+			nativestacklow = uintptr_t(addr);
+			nativestacksize = size;
+			return;
+		}
+	}
+#endif
+	// the stack of the thread starts a few frames above this one
+	char base;
+	nativestacklow = uintptr_t(&base)-nativestacksize+VM_NATIVE_STACK_RESERVE/4;
+}
+
+void ABCVm::growStacktrace()
+{
+	stacktrace.resize(max(size_t(256),min(size_t(limits.max_recursion),stacktrace.size()*2)));
 }
 
 void ABCVm::start()
 {
+#if SDL_VERSION_ATLEAST(2, 0, 9)
+	// the native stack has to be large enough for the deepest recursion the frame stack allows
+	nativestacksize = size_t(stackrecursionlimit)*VM_NATIVE_FRAME_SIZE+VM_NATIVE_STACK_RESERVE;
+	t = SDL_CreateThreadWithStackSize(Run,"ABCVm",nativestacksize,this);
+	if (!t)
+	{
+		nativestacksize = 8*1024*1024;
+		LOG(LOG_ERROR,"could not create the vm thread with a native stack for "<<stackrecursionlimit<<" recursions");
+		stackrecursionlimit = min(stackrecursionlimit,uint32_t(8*1024*1024/VM_NATIVE_FRAME_SIZE));
+		limits.max_recursion = min(limits.max_recursion,stackrecursionlimit);
+		t = SDL_CreateThread(Run,"ABCVm",this);
+	}
+#else
 	t = SDL_CreateThread(Run,"ABCVm",this);
+#endif
 }
 
 void ABCVm::shutdown()
@@ -941,6 +994,7 @@ void ABCVm::shutdown()
 		//Signal the Vm thread
 		event_queue_mutex.lock();
 		shuttingdown=true;
+		sleeping=false;
 		sem_event_cond.signal();
 		event_queue_mutex.unlock();
 		//Wait for the vm thread
@@ -954,6 +1008,7 @@ void ABCVm::addDeletableObject(ASObject *obj)
 {
 	Locker l(event_queue_mutex);
 	deletableObjects.push_back(obj);
+	lockedEventsPending=true;
 }
 
 void ABCVm::finalize()
@@ -961,7 +1016,24 @@ void ABCVm::finalize()
 	//The event queue may be not empty if the VM has been been started
 	if(status==CREATED && !events_queue.empty())
 		LOG(LOG_ERROR, "Events queue is not empty as expected");
-	events_queue.clear();
+	//Events added while the vm was shutting down may still be in the inboxes
+	drainInbox(incomingEvents);
+	drainInbox(incomingIdleEvents);
+	events_queue.insert(events_queue.end(),incomingEvents.overflow.begin(),incomingEvents.overflow.end());
+	events_queue.insert(events_queue.end(),incomingIdleEvents.overflow.begin(),incomingIdleEvents.overflow.end());
+	events_queue.insert(events_queue.end(),prependedEvents.begin(),prependedEvents.end());
+	incomingEvents.overflow.clear();
+	incomingIdleEvents.overflow.clear();
+	prependedEvents.clear();
+	while(!events_queue.empty())
+	{
+		queuedEvent& e=events_queue.front();
+		if(e.dispatcher)
+			e.dispatcher->decRef();
+		e.event->decRef();
+		events_queue.pop_front();
+	}
+	queuedEventCount=0;
 }
 
 
@@ -983,12 +1055,113 @@ ABCVm::~ABCVm()
 		delete (*it);
 		it++;
 	}
-	delete[] stacktrace;
+	delete[] framestack;
 }
 
 int ABCVm::getEventQueueSize()
 {
-	return events_queue.size();
+	return queuedEventCount;
+}
+
+int64_t ABCVm::getMaxEventLatency()
+{
+	return maxEventLatency.exchange(0);
+}
+
+ABCVm::queuedEvent ABCVm::makeQueuedEvent(_NR<EventDispatcher>& obj, _R<Event>& ev)
+{
+	queuedEvent e;
+	e.dispatcher=obj.getPtr();
+	if(e.dispatcher)
+		e.dispatcher->incRef();
+	e.event=ev.getPtr();
+	e.event->incRef();
+	e.time=g_get_monotonic_time();
+	return e;
+}
+
+void ABCVm::pushEvent(eventInbox& inbox, const queuedEvent& e, bool wakeup)
+{
+	queuedEventCount++;
+	//Once an event went to the overflow list, all following events have to go there too to keep them in order
+	if(!inbox.overflowing.load() && inbox.ring.push(e))
+	{
+		if(!wakeup)
+			return;
+		//Pairs with the fence in waitForEvents: either the vm thread sees the new event or we see it sleeping
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(sleeping.load())
+		{
+			Locker l(event_queue_mutex);
+			sleeping=false;
+			sem_event_cond.signal();
+		}
+		return;
+	}
+	Locker l(event_queue_mutex);
+	inbox.overflow.push_back(e);
+	inbox.overflowing=true;
+	if(!wakeup)
+		return;
+	lockedEventsPending=true;
+	if(sleeping)
+	{
+		sleeping=false;
+		sem_event_cond.signal();
+	}
+}
+
+void ABCVm::drainInbox(eventInbox& inbox)
+{
+	queuedEvent e;
+	while(inbox.ring.pop(e))
+		events_queue.push_back(e);
+}
+
+void ABCVm::drainEvents()
+{
+	drainInbox(incomingEvents);
+	if(!lockedEventsPending.load())
+		return;
+	std::vector<ASObject*> deletable;
+	event_queue_mutex.lock();
+	lockedEventsPending=false;
+	//The events in the overflow list were added after the ones still in the ring
+	drainInbox(incomingEvents);
+	events_queue.insert(events_queue.end(),incomingEvents.overflow.begin(),incomingEvents.overflow.end());
+	incomingEvents.overflow.clear();
+	incomingEvents.overflowing=false;
+	//The last prepended event has to be handled first
+	for (auto it = prependedEvents.begin(); it != prependedEvents.end(); it++)
+		events_queue.push_front(*it);
+	prependedEvents.clear();
+	deletable.swap(deletableObjects);
+	event_queue_mutex.unlock();
+	for (auto it = deletable.begin(); it != deletable.end(); it++)
+		(*it)->decRef();
+}
+
+void ABCVm::waitForEvents()
+{
+	drainEvents();
+	while(events_queue.empty() && !shuttingdown)
+	{
+		sleeping=true;
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		//An event may have been added before sleeping was set
+		drainEvents();
+		if(!events_queue.empty())
+		{
+			sleeping=false;
+			break;
+		}
+		event_queue_mutex.lock();
+		while(sleeping && !shuttingdown)
+			sem_event_cond.wait(event_queue_mutex);
+		sleeping=false;
+		event_queue_mutex.unlock();
+		drainEvents();
+	}
 }
 
 void ABCVm::publicHandleEvent(EventDispatcher* dispatcher, _R<Event> event)
@@ -1281,6 +1454,13 @@ void ABCVm::handleEvent(std::pair<_NR<EventDispatcher>, _R<Event> > e)
 					m_sys->stage->advanceFrame();
 				break;
 			}
+			case BROADCAST_FRAME:
+			{
+				BroadcastFrameEvent* ev=static_cast<BroadcastFrameEvent*>(e.second.getPtr());
+				LOG(LOG_CALLS,"BROADCAST_FRAME "<<m_sys->getStringFromUniqueId(ev->eventNameId));
+				broadcastFrameEvent(ev);
+				break;
+			}
 			case ROOTCONSTRUCTEDEVENT:
 			{
 				RootConstructedEvent* ev=static_cast<RootConstructedEvent*>(e.second.getPtr());
@@ -1290,13 +1470,17 @@ void ABCVm::handleEvent(std::pair<_NR<EventDispatcher>, _R<Event> > e)
 			}
 			case IDLE_EVENT:
 			{
-				Locker l(event_queue_mutex);
-				while (!idleevents_queue.empty())
+				drainInbox(incomingIdleEvents);
+				if(incomingIdleEvents.overflowing)
 				{
-					events_queue.push_back(idleevents_queue.front());
-					idleevents_queue.pop_front();
+					Locker l(event_queue_mutex);
+					drainInbox(incomingIdleEvents);
+					events_queue.insert(events_queue.end(),incomingIdleEvents.overflow.begin(),incomingIdleEvents.overflow.end());
+					incomingIdleEvents.overflow.clear();
+					incomingIdleEvents.overflowing=false;
 				}
 				isIdle = true;
+				m_sys->flushExactRasterQueue();
 #ifndef NDEBUG
 //				if (getEventQueueSize() == 0)
 //					ASObject::dumpObjectCounters(100);
@@ -1345,6 +1529,48 @@ void ABCVm::handleEvent(std::pair<_NR<EventDispatcher>, _R<Event> > e)
 	//LOG(LOG_INFO,"handleEvent done:"<<e.second->type);
 }
 
+void ABCVm::broadcastFrameEvent(BroadcastFrameEvent* ev)
+{
+	// take the listeners, a listener may cause another frame event to be handled
+	std::vector<DisplayObject*> listeners;
+	listeners.swap(ev->listeners);
+	if (!listeners.empty())
+	{
+		if(ev->event.isNull() || !ev->event->isLastRef())
+			ev->event = _MR(Class<Event>::getInstanceS(m_sys,m_sys->getStringFromUniqueId(ev->eventNameId)));
+		else
+		{
+			ev->event->eventPhase = 0;
+			ev->event->defaultPrevented = false;
+		}
+		ev->event->incRef();
+		_R<Event> event = _MR(ev->event.getPtr());
+		// same as handling one queued event for every listener, an exception only affects its own listener
+		for(uint32_t i=0;i<listeners.size();i++)
+		{
+			if(!shuttingdown)
+			{
+				try
+				{
+					listeners[i]->onNewEvent(event.getPtr());
+					publicHandleEvent(listeners[i],event);
+					m_sys->flushInvalidationQueue();
+					listeners[i]->afterHandleEvent(event.getPtr());
+				}
+				catch(...)
+				{
+					handleEventError();
+					m_sys->flushInvalidationQueue();
+				}
+			}
+			listeners[i]->decRef();
+		}
+	}
+	// the buffer is kept for the listeners of the next frame
+	listeners.clear();
+	ev->listeners.swap(listeners);
+}
+
 bool ABCVm::prependEvent(_NR<EventDispatcher> obj ,_R<Event> ev, bool force)
 {
 	/* We have to run waitable events directly,
@@ -1357,8 +1583,6 @@ bool ABCVm::prependEvent(_NR<EventDispatcher> obj ,_R<Event> ev, bool force)
 		return true;
 	}
 
-	Locker l(event_queue_mutex);
-
 	//If the system should terminate new events are not accepted
 	if(shuttingdown)
 		return false;
@@ -1366,11 +1590,25 @@ bool ABCVm::prependEvent(_NR<EventDispatcher> obj ,_R<Event> ev, bool force)
 	if (!obj.isNull())
 		obj->onNewEvent(ev.getPtr());
 
-	if (isIdle || force)
-		events_queue.push_front(pair<_NR<EventDispatcher>,_R<Event>>(obj, ev));
+	if (!isIdle && !force)
+		pushEvent(incomingEvents,makeQueuedEvent(obj,ev),true);
+	else if (isVmThread())
+	{
+		queuedEventCount++;
+		events_queue.push_front(makeQueuedEvent(obj,ev));
+	}
 	else
-		events_queue.push_back(pair<_NR<EventDispatcher>,_R<Event>>(obj, ev));
-	sem_event_cond.signal();
+	{
+		Locker l(event_queue_mutex);
+		queuedEventCount++;
+		prependedEvents.push_back(makeQueuedEvent(obj,ev));
+		lockedEventsPending=true;
+		if(sleeping)
+		{
+			sleeping=false;
+			sem_event_cond.signal();
+		}
+	}
 	return true;
 }
 
@@ -1390,9 +1628,6 @@ bool ABCVm::addEvent(_NR<EventDispatcher> obj ,_R<Event> ev)
 		return true;
 	}
 
-
-	Locker l(event_queue_mutex);
-
 	//If the system should terminate new events are not accepted
 	if(shuttingdown)
 	{
@@ -1402,19 +1637,20 @@ bool ABCVm::addEvent(_NR<EventDispatcher> obj ,_R<Event> ev)
 	}
 	if (!obj.isNull())
 		obj->onNewEvent(ev.getPtr());
-	events_queue.push_back(pair<_NR<EventDispatcher>,_R<Event>>(obj, ev));
 	RELEASE_WRITE(ev->queued,true);
-	sem_event_cond.signal();
+	pushEvent(incomingEvents,makeQueuedEvent(obj,ev),true);
+	//The vm may have stopped before the event was added, so nobody would signal it
+	if(shuttingdown && ev->is<WaitableEvent>())
+		ev->as<WaitableEvent>()->signal();
 	return true;
 }
 void ABCVm::addIdleEvent(_NR<EventDispatcher> obj ,_R<Event> ev)
 {
-	Locker l(event_queue_mutex);
 	//If the system should terminate new events are not accepted
 	if(shuttingdown)
 		return;
-	idleevents_queue.push_back(pair<_NR<EventDispatcher>,_R<Event>>(obj, ev));
 	RELEASE_WRITE(ev->queued,true);
+	pushEvent(incomingIdleEvents,makeQueuedEvent(obj,ev),false);
 }
 
 Class_inherit* ABCVm::findClassInherit(const string& s, RootMovieClip* root)
@@ -1479,24 +1715,24 @@ void ABCVm::checkExternalCallEvent()
 {
 	if (shuttingdown)
 		return;
-	event_queue_mutex.lock();
-	if (events_queue.size() == 0)
-	{
-		event_queue_mutex.unlock();
+	drainEvents();
+	if (events_queue.empty())
 		return;
-	}
-	pair<_NR<EventDispatcher>,_R<Event>> e=events_queue.front();
-	if (e.first.isNull() && e.second->getEventType() == EXTERNAL_CALL)
+	const queuedEvent& e=events_queue.front();
+	if (e.dispatcher == nullptr && e.event->getEventType() == EXTERNAL_CALL)
 		handleFrontEvent();
-	else
-		event_queue_mutex.unlock();
 }
 void ABCVm::handleFrontEvent()
 {
-	pair<_NR<EventDispatcher>,_R<Event>> e=events_queue.front();
+	queuedEvent q=events_queue.front();
 	events_queue.pop_front();
-
-	event_queue_mutex.unlock();
+	queuedEventCount--;
+	int64_t latency=g_get_monotonic_time()-q.time;
+	int64_t maxlatency=maxEventLatency.load(std::memory_order_relaxed);
+	while(latency>maxlatency && !maxEventLatency.compare_exchange_weak(maxlatency,latency,std::memory_order_relaxed))
+		;
+	//The references owned by the queue are moved to the pair
+	pair<_NR<EventDispatcher>,_R<Event>> e(_MNR(q.dispatcher),_MR(q.event));
 	try
 	{
 		//handle event without lock
@@ -1510,6 +1746,18 @@ void ABCVm::handleFrontEvent()
 		if (!e.first.isNull())
 			e.first->afterHandleEvent(e.second.getPtr());
 	}
+	catch(...)
+	{
+		handleEventError();
+	}
+}
+
+void ABCVm::handleEventError()
+{
+	try
+	{
+		throw;
+	}
 	catch(LightsparkException& e)
 	{
 		LOG(LOG_ERROR,_("Error in VM ") << e.cause);
@@ -1696,6 +1944,7 @@ int ABCVm::Run(void* d)
 
 	/* set TLS variable for isVmThread() */
         tls_set(is_vm_thread, GINT_TO_POINTER(1));
+	th->initNativeStackBounds();
 #ifndef NDEBUG
 	inStartupOrClose= false;
 #endif
@@ -1789,23 +2038,19 @@ int ABCVm::Run(void* d)
 #endif
 	while(true)
 	{
-		th->event_queue_mutex.lock();
-		while(th->events_queue.empty() && !th->shuttingdown)
-			th->sem_event_cond.wait(th->event_queue_mutex);
-		for (auto it = th->deletableObjects.begin(); it != th->deletableObjects.end(); it++)
-			(*it)->decRef();
-		th->deletableObjects.clear();
+		//Events of other threads are moved in batches, prepended events are picked up immediately
+		if(th->events_queue.empty())
+			th->waitForEvents();
+		else if(th->lockedEventsPending.load(std::memory_order_relaxed))
+			th->drainEvents();
 		if(th->shuttingdown)
 		{
 			//If the queue is empty stop immediately
 			if(th->events_queue.empty())
-			{
-				th->event_queue_mutex.unlock();
 				break;
-			}
 			else if(firstMissingEvents)
 			{
-				LOG(LOG_INFO,th->events_queue.size() << _(" events missing before exit"));
+				LOG(LOG_INFO,th->queuedEventCount << _(" events missing before exit"));
 				firstMissingEvents = false;
 			}
 		}
@@ -1836,13 +2081,18 @@ int ABCVm::Run(void* d)
 void ABCVm::signalEventWaiters()
 {
 	assert(shuttingdown);
-	//we do not need a lock because th->shuttingdown keeps other events from being enqueued
+	//th->shuttingdown keeps other events from being enqueued, events added meanwhile are signaled by addEvent
+	drainEvents();
 	while(!events_queue.empty())
 	{
-		pair<_NR<EventDispatcher>,_R<Event>> e=events_queue.front();
+		queuedEvent e=events_queue.front();
 		events_queue.pop_front();
-		if(e.second->is<WaitableEvent>())
-			e.second->as<WaitableEvent>()->signal();
+		queuedEventCount--;
+		if(e.event->is<WaitableEvent>())
+			e.event->as<WaitableEvent>()->signal();
+		if(e.dispatcher)
+			e.dispatcher->decRef();
+		e.event->decRef();
 	}
 }
 
@@ -53,6 +53,24 @@ namespace legacy {
 }
 #endif // LLVM_ENABLED
 
+// The baseline jit emits x86-64 code and registers its unwind info with libgcc
+#if defined(ENABLE_BASELINE_JIT) && defined(__x86_64__) && defined(__linux__) && defined(__GNUC__) && !defined(PROFILING_SUPPORT)
+#define BASELINE_JIT_ENABLED 1
+#endif
+
+// number of events that can be added to the vm event queue before it falls back to a locked list
+#define EVENT_INBOX_SIZE 4096
+
+// average number of bytes of the frame stack used by a recursive call, the recursion limit is derived from it
+#define VM_FRAME_SIZE_ESTIMATE 1024
+// number of bytes of the native stack of the vm thread reserved for a recursive call when sizing the stack,
+// the actual use depends on the call path (native callbacks, jit code), so the stack pointer is checked as well
+#define VM_NATIVE_FRAME_SIZE 4096
+// number of bytes at the end of the native stack of the vm thread left for native code and for throwing the StackOverflowError
+#define VM_NATIVE_STACK_RESERVE (256*1024)
+// the native stack of the vm thread is never made larger than VM_MAX_RECURSION*VM_NATIVE_FRAME_SIZE
+#define VM_MAX_RECURSION 65536
+
 namespace lightspark
 {
 
@@ -75,6 +93,23 @@ inline stack_entry make_stack_entry(llvm::Value* v, STACK_TYPE t)
 
 bool isVmThread();
 
+#ifdef BASELINE_JIT_ENABLED
+/*
+ * Native code generated by the baseline jit for a hot method.
+ * entry runs the method from context->exec_pos and returns when the return value is set
+ * or when execution leaves the compiled code, the interpreter takes over in that case
+ */
+struct baselinejit_code
+{
+	void (*entry)(call_context* context);
+	uint8_t* mapping;
+	size_t mappingsize;
+	std::vector<void*> dispatchtable;
+	std::vector<uint8_t> unwindinfo;
+};
+void freeBaselineJit(baselinejit_code* code);
+#endif
+
 class method_info
 {
 friend std::istream& operator>>(std::istream& in, method_info& v);
@@ -133,6 +168,10 @@ public:
 	bool needsscope;
 	bool needscoerceresult;
 	call_context cc;
+#ifdef BASELINE_JIT_ENABLED
+	baselinejit_code* nativecode;
+	uint32_t nativeHitCount;
+#endif
 	method_info():
 #ifdef LLVM_ENABLED
 		llvmf(nullptr),
@@ -142,10 +181,26 @@ public:
 		validProfName(false),
 #endif
 		f(nullptr),context(nullptr),body(nullptr),returnType(nullptr),hasExplicitTypes(false),needsscope(false),needscoerceresult(true),cc(this)
+#ifdef BASELINE_JIT_ENABLED
+		,nativecode(nullptr),nativeHitCount(0)
+#endif
 	{
 	}
 	~method_info()
 	{
+		freePreloadedCode();
+	}
+	// frees the code and call_context buffers created when preloading, cold methods are preloaded again when they get hot
+	void freePreloadedCode()
+	{
+#ifdef BASELINE_JIT_ENABLED
+		if (nativecode)
+		{
+			freeBaselineJit(nativecode);
+			nativecode=nullptr;
+		}
+		nativeHitCount=0;
+#endif
 		if (cc.locals)
 		{
 			delete[] cc.locals;
@@ -323,7 +378,8 @@ private:
 	SDL_Thread* t;
 	enum STATUS { CREATED=0, STARTED, TERMINATED };
 	STATUS status;
-	bool isIdle;
+	// set by the vm thread at the end of a frame, reset by SystemState::tick and read by prependEvent from any thread
+	std::atomic<bool> isIdle;
 
 	void registerClassesFlashAccessibility(Global* builtin);
 	void registerClassesFlashConcurrent(Global* builtin);
@@ -358,12 +414,19 @@ private:
 	//If you change a definition here, update the opcode_table_* entry in abc_codesynth
 	static ASObject *hasNext(ASObject* obj, ASObject* cur_index); 
 	static bool hasNext2(call_context* th, int n, int m); 
+	// the application domain is only looked up on the first domain memory access of a call
+	static inline ApplicationDomain* getDomainMemoryOwner(call_context* th)
+	{
+		if(USUALLY_FALSE(th->domainMemoryOwner==nullptr))
+			th->domainMemoryOwner=th->mi->context->root->applicationDomain.getPtr();
+		return th->domainMemoryOwner;
+	}
 	template<class T>
 	static void loadIntN(call_context* th)
 	{
 		RUNTIME_STACK_POP_CREATE(th,arg1);
 		uint32_t addr=asAtomHandler::toUInt(*arg1);
-		ApplicationDomain* appDomain = th->mi->context->root->applicationDomain.getPtr();
+		ApplicationDomain* appDomain = getDomainMemoryOwner(th);
 		T ret=appDomain->readFromDomainMemory<T>(addr);
 		ASATOM_DECREF_POINTER(arg1);
 		RUNTIME_STACK_PUSH(th,asAtomHandler::fromInt(ret));
@@ -377,14 +440,14 @@ private:
 		ASATOM_DECREF_POINTER(arg1);
 		int32_t val=asAtomHandler::toInt(*arg2);
 		ASATOM_DECREF_POINTER(arg2);
-		ApplicationDomain* appDomain = th->mi->context->root->applicationDomain.getPtr();
+		ApplicationDomain* appDomain = getDomainMemoryOwner(th);
 		appDomain->writeToDomainMemory<T>(addr, val);
 	}
 	template<class T>
 	static void loadIntN(call_context* th,asAtom& ret, asAtom& arg1)
 	{
 		uint32_t addr=asAtomHandler::toUInt(arg1);
-		ApplicationDomain* appDomain = th->mi->context->root->applicationDomain.getPtr();
+		ApplicationDomain* appDomain = getDomainMemoryOwner(th);
 		T res=appDomain->readFromDomainMemory<T>(addr);
 		ret = asAtomHandler::fromInt(res);
 	}
@@ -393,7 +456,7 @@ private:
 	{
 		uint32_t addr=asAtomHandler::toUInt(arg1);
 		int32_t val=asAtomHandler::toInt(arg2);
-		ApplicationDomain* appDomain = th->mi->context->root->applicationDomain.getPtr();
+		ApplicationDomain* appDomain = getDomainMemoryOwner(th);
 		appDomain->writeToDomainMemory<T>(addr, val);
 	}
 	static void loadFloat(call_context* th);
@@ -583,16 +646,59 @@ private:
 #endif
 
 	//Synchronization
+	// protects the overflow lists of the event inboxes, prependedEvents and deletableObjects
 	Mutex event_queue_mutex;
+	// signaled when the vm thread is sleeping and a new event is added
 	Cond sem_event_cond;
 
 	//Event handling
 	volatile bool shuttingdown;
 	typedef std::pair<_NR<EventDispatcher>,_R<Event>> eventType;
-	std::deque<eventType, reporter_allocator<eventType>> events_queue;
-	std::deque<eventType, reporter_allocator<eventType>> idleevents_queue;
+	struct queuedEvent
+	{
+		// the queue owns a reference to both, dispatcher may be null
+		EventDispatcher* dispatcher;
+		Event* event;
+		// time when the event was added (in microseconds), used for the latency statistics
+		int64_t time;
+	};
+	/*
+	 * Events added by any thread without taking a lock.
+	 * When the ring is full, events are added to the overflow list until the vm thread has emptied it,
+	 * so that the events of every thread stay in order
+	 */
+	struct eventInbox
+	{
+		MPSCQueue<queuedEvent,EVENT_INBOX_SIZE> ring;
+		std::deque<queuedEvent> overflow;
+		std::atomic<bool> overflowing;
+		eventInbox():overflowing(false) {}
+	};
+	eventInbox incomingEvents;
+	eventInbox incomingIdleEvents;
+	// events prepended by other threads, they are moved to the front of events_queue by the vm thread
+	std::deque<queuedEvent> prependedEvents;
+	// set when prependedEvents, deletableObjects or an overflow list is not empty
+	std::atomic<bool> lockedEventsPending;
+	// set by the vm thread before it waits for new events
+	std::atomic<bool> sleeping;
+	// only accessed by the vm thread
+	std::deque<queuedEvent, reporter_allocator<queuedEvent>> events_queue;
+	// statistics
+	std::atomic<int32_t> queuedEventCount;
+	std::atomic<int64_t> maxEventLatency;
+	static queuedEvent makeQueuedEvent(_NR<EventDispatcher>& obj, _R<Event>& ev);
+	// wakeup is false for idle events, they are only handled after the next frame
+	void pushEvent(eventInbox& inbox, const queuedEvent& e, bool wakeup);
+	void drainInbox(eventInbox& inbox);
+	// moves the events added by other threads to events_queue, only called by the vm thread
+	void drainEvents();
+	void waitForEvents();
 	void handleEvent(std::pair<_NR<EventDispatcher>,_R<Event> > e);
 	void handleFrontEvent();
+	void broadcastFrameEvent(BroadcastFrameEvent* ev);
+	// handles the exception currently thrown while handling an event, like an uncaught exception of the VM
+	void handleEventError();
 	void signalEventWaiters();
 	void buildClassAndInjectBase(const std::string& s, _R<RootMovieClip> base);
 	Class_inherit* findClassInherit(const std::string& s, RootMovieClip* r);
@@ -629,6 +735,8 @@ private:
 	static void abc_ifnge_local_local(call_context* context);
 
 	static void abc_jump(call_context* context);// 0x10
+	// counts a backward branch of a cold method and executes it
+	static void abc_coldbranch(call_context* context);
 	static void abc_iftrue(call_context* context);
 	static void abc_iftrue_constant(call_context* context);
 	static void abc_iftrue_local(call_context* context);
@@ -1211,6 +1319,22 @@ private:
 
 	static void abc_invalidinstruction(call_context* context);
 
+	// superinstructions run two or three consecutive instructions without going through the dispatch loop
+	template<abc_function first, abc_function second>
+	static void abc_fused2(call_context* context);
+	template<abc_function first, abc_function second, abc_function third>
+	static void abc_fused3(call_context* context);
+	struct superinstruction
+	{
+		abc_function first;
+		abc_function second;
+		abc_function third;
+		abc_function fused;
+	};
+	// generated by tools/superinstgen from opcode profiles, terminated by an entry with first==nullptr
+	static const superinstruction superinstructions[];
+	static void applySuperinstructions(std::vector<preloadedcodedata>& code);
+
 public:
 	static abc_function abcfunctions[];
 	call_context* currentCallContext;
@@ -1244,9 +1368,13 @@ public:
 	void registerClassesAVM1();
 	static int Run(void* d);
 	static void executeFunction(call_context* context);
+#ifdef BASELINE_JIT_ENABLED
+	static void compileBaselineJit(method_info* mi);
+#endif
 #ifndef NDEBUG
 	static void dumpOpcodeCounters(uint32_t threshhold);
 	static void clearOpcodeCounters();
+	static void saveOpcodeProfile(const tiny_string& filename);
 #endif
 	
 	static void preloadFunction(SyntheticFunction *function);
@@ -1271,6 +1399,8 @@ public:
 	bool prependEvent(_NR<EventDispatcher>, _R<Event> , bool force=false) DLL_PUBLIC;
 	void addIdleEvent(_NR<EventDispatcher>,_R<Event> ) DLL_PUBLIC;
 	int getEventQueueSize();
+	// returns the longest time (in microseconds) an event waited in the queue since the last call
+	int64_t getMaxEventLatency();
 	void shutdown();
 	bool hasEverStarted() const { return status!=CREATED; }
 	void addDeletableObject(ASObject *obj);
@@ -1290,13 +1420,25 @@ public:
 		uint32_t name;
 		void set(asAtom o, uint32_t n) { object=o; name=n; }
 	};
-	stacktrace_entry* stacktrace;
+	// grows with the recursion depth up to limits.max_recursion
+	std::vector<stacktrace_entry> stacktrace;
+	void growStacktrace();
+	// called by the vm thread, sets nativestacklow
+	void initNativeStackBounds();
 	FORCE_INLINE call_context* incStack(asAtom o, uint32_t f)
 	{
-		if(USUALLY_FALSE(cur_recursion == limits.max_recursion))
+		if(USUALLY_FALSE(cur_recursion >= limits.max_recursion))
 		{
 			throwStackOverflow();
 		}
+		// addresses outside of the native stack of the vm thread are never in the reserved range
+		char stackmarker;
+		if(USUALLY_FALSE(uintptr_t(&stackmarker)-nativestacklow < VM_NATIVE_STACK_RESERVE))
+		{
+			throwStackOverflow();
+		}
+		if(USUALLY_FALSE(cur_recursion == stacktrace.size()))
+			growStacktrace();
 		stacktrace[cur_recursion].set(o,f);
 		++cur_recursion; //increment current recursion depth
 		return currentCallContext;
@@ -1308,6 +1450,31 @@ public:
 	}
 	void throwStackOverflow();
 
+	/* Contiguous memory for the frames of recursive calls (call_context, locals and stacks).
+	 * Frames are allocated and released in LIFO order by SyntheticFunction::call */
+	uint8_t* framestack;
+	uint8_t* framestackptr;
+	uint8_t* framestackend;
+	FORCE_INLINE uint8_t* allocFrame(size_t size)
+	{
+		size = (size+15)&~size_t(15);
+		if(USUALLY_FALSE(size > size_t(framestackend-framestackptr)))
+			throwStackOverflow();
+		uint8_t* frame = framestackptr;
+		framestackptr+=size;
+		return frame;
+	}
+	FORCE_INLINE void releaseFrame(uint8_t* frame)
+	{
+		framestackptr = frame;
+	}
+
+	/* maximum recursion depth the frame stack and the native stack of the vm thread are sized for */
+	uint32_t stackrecursionlimit;
+	/* lowest address and size of the native stack of the vm thread, which grows downwards */
+	uintptr_t nativestacklow;
+	size_t nativestacksize;
+	uint32_t getStackRecursionLimit() const { return stackrecursionlimit; }
 	struct abc_limits {
 		/* maxmium number of recursion allowed. See ScriptLimitsTag */
 		uint32_t max_recursion;
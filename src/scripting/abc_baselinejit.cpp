@@ -0,0 +1,397 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+/*
+ * Baseline jit for the preloaded interpreter code.
+ *
+ * Every preloaded instruction of a hot method becomes a small native stub that stores
+ * context->exec_pos and calls the instruction's abc_function directly, so the indirect
+ * call and the loop of ABCVm::executeFunction disappear. When the handler leaves exec_pos
+ * at the next instruction execution falls through to the next stub, otherwise (taken
+ * branches, lookupswitch, exception handlers) the stub jumps through a dispatch table
+ * indexed by exec_pos. Unconditional jumps, nops, integer local increments and integer
+ * compare-and-branch instructions are inlined and only call their handler when an
+ * operand is not an int.
+ *
+ * Handlers throw ASObject* to signal ActionScript exceptions, so the generated code
+ * uses a fixed frame layout that is described to the unwinder with a small .eh_frame.
+ */
+
+#include "scripting/abc.h"
+#include "compat.h"
+#include "scripting/abcutils.h"
+
+#ifdef BASELINE_JIT_ENABLED
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstring>
+
+extern "C" void __register_frame(void* begin);
+extern "C" void __deregister_frame(void* begin);
+
+using namespace std;
+using namespace lightspark;
+
+namespace
+{
+// methods with more preloaded instructions than this are left to the interpreter
+const uint32_t baselinejit_max_instructions=32768;
+
+enum JITREG { RAX=0, RCX=1, RDX=2, RBX=3, RSP=4, RBP=5, RSI=6, RDI=7, R12=12, R13=13, R14=14 };
+enum JITCOND { COND_AE=0x3, COND_E=0x4, COND_NE=0x5, COND_L=0xc, COND_GE=0xd, COND_LE=0xe, COND_G=0xf };
+
+/*
+ * Minimal x86-64 assembler for the stub templates
+ * register usage of the generated code:
+ * rbx: call_context, r12: first preloaded instruction, r13: dispatch table, r14: return value slot
+ */
+class NativeEmitter
+{
+private:
+	std::vector<int32_t> labels;
+	std::vector<std::pair<uint32_t,uint32_t>> fixups;
+	void rel32(uint32_t label)
+	{
+		fixups.push_back(make_pair(uint32_t(code.size()),label));
+		emit32(0);
+	}
+	void modrm(uint8_t op, JITREG r, JITREG base, int32_t disp)
+	{
+		emit({uint8_t(0x48|((r>>3)<<2)|(base>>3)), op, uint8_t(0x80|((r&7)<<3)|(base&7))});
+		if ((base&7)==RSP)
+			emit({0x24});
+		emit32(disp);
+	}
+public:
+	std::vector<uint8_t> code;
+	uint32_t newLabel()
+	{
+		labels.push_back(-1);
+		return labels.size()-1;
+	}
+	void bind(uint32_t label) { labels[label]=code.size(); }
+	int32_t labelPos(uint32_t label) const { return labels[label]; }
+	void emit(std::initializer_list<uint8_t> bytes) { code.insert(code.end(),bytes); }
+	void emit32(uint32_t v)
+	{
+		for (uint32_t i = 0; i < 4; i++)
+			code.push_back(v>>(i*8));
+	}
+	void emit64(uint64_t v)
+	{
+		for (uint32_t i = 0; i < 8; i++)
+			code.push_back(v>>(i*8));
+	}
+	// movabs r, imm64
+	void movImm64(JITREG r, uint64_t v)
+	{
+		emit({uint8_t(0x48|(r>>3)), uint8_t(0xb8+(r&7))});
+		emit64(v);
+	}
+	// mov r, [base+disp]
+	void load(JITREG r, JITREG base, int32_t disp) { modrm(0x8b,r,base,disp); }
+	// mov [base+disp], r
+	void store(JITREG base, int32_t disp, JITREG r) { modrm(0x89,r,base,disp); }
+	void jmp(uint32_t label)
+	{
+		emit({0xe9});
+		rel32(label);
+	}
+	void jcc(JITCOND cond, uint32_t label)
+	{
+		emit({0x0f, uint8_t(0x80|cond)});
+		rel32(label);
+	}
+	// jne label if the 32 bit register r does not hold an ATOM_INTEGER tag
+	void checkInteger(JITREG r, uint32_t label)
+	{
+		emit({0x89, uint8_t(0xc0|((r&7)<<3))}); // mov eax, r
+		emit({0x83, 0xe0, 0x07}); // and eax, 7
+		emit({0x83, 0xf8, ATOM_INTEGER}); // cmp eax, ATOM_INTEGER
+		jcc(COND_NE,label);
+	}
+	bool resolve()
+	{
+		for (auto it = fixups.begin(); it != fixups.end(); it++)
+		{
+			if (labels[it->second] < 0)
+				return false;
+			int32_t rel = labels[it->second]-int32_t(it->first+4);
+			memcpy(&code[it->first],&rel,4);
+		}
+		return true;
+	}
+};
+
+/*
+ * .eh_frame data (one CIE and one FDE) describing the frame of the generated code:
+ * push rbp; mov rbp,rsp; push rbx; push r12; push r13; push r14
+ */
+void buildUnwindInfo(std::vector<uint8_t>& info, uint8_t* start, size_t len)
+{
+	static const uint8_t cie[] = {
+		0x14, 0x00, 0x00, 0x00, // length
+		0x00, 0x00, 0x00, 0x00, // CIE id
+		0x01, 'z', 'R', 0x00, // version, augmentation
+		0x01, 0x78, 0x10, // code alignment 1, data alignment -8, return address register rip
+		0x01, 0x00, // augmentation data: absolute pointers
+		0x0c, 0x07, 0x08, // DW_CFA_def_cfa rsp+8
+		0x90, 0x01, // DW_CFA_offset rip, cfa-8
+		0x00, 0x00 // padding
+	};
+	static const uint8_t fdeinstructions[] = {
+		0x41, 0x0e, 0x10, 0x86, 0x02, // push rbp: DW_CFA_def_cfa_offset 16, DW_CFA_offset rbp, cfa-16
+		0x43, 0x0d, 0x06, // mov rbp,rsp: DW_CFA_def_cfa_register rbp
+		0x41, 0x83, 0x03, // push rbx: DW_CFA_offset rbx, cfa-24
+		0x42, 0x8c, 0x04, // push r12: DW_CFA_offset r12, cfa-32
+		0x42, 0x8d, 0x05, // push r13: DW_CFA_offset r13, cfa-40
+		0x42, 0x8e, 0x06 // push r14: DW_CFA_offset r14, cfa-48
+	};
+	info.assign(cie,cie+sizeof(cie));
+	uint32_t fdestart = info.size();
+	// pad the FDE with DW_CFA_nop to keep entries 8 byte aligned
+	uint32_t fdelength = (4+4+8+8+1+sizeof(fdeinstructions)+7)/8*8-4;
+	uint32_t ciepointer = fdestart+4;
+	uint64_t pcbegin = uint64_t(start);
+	uint64_t pcrange = len;
+	info.resize(fdestart+4+fdelength+4,0);
+	memcpy(&info[fdestart],&fdelength,4);
+	memcpy(&info[fdestart+4],&ciepointer,4);
+	memcpy(&info[fdestart+8],&pcbegin,8);
+	memcpy(&info[fdestart+16],&pcrange,8);
+	// info[fdestart+24] is the empty augmentation data length
+	memcpy(&info[fdestart+25],fdeinstructions,sizeof(fdeinstructions));
+	// the zero terminator is already in place
+}
+
+Mutex baselinejit_mutex;
+}
+
+void lightspark::freeBaselineJit(baselinejit_code* code)
+{
+	__deregister_frame(code->unwindinfo.data());
+	munmap(code->mapping,code->mappingsize);
+	delete code;
+}
+
+void ABCVm::compileBaselineJit(method_info* mi)
+{
+	static_assert((sizeof(preloadedcodedata)&(sizeof(preloadedcodedata)-1))==0,"dispatch assumes power of two instruction size");
+	if (!mi->context->root->getSystemState()->useBaselineJit)
+		return;
+	Locker l(baselinejit_mutex);
+	if (mi->nativecode)
+		return;
+	std::vector<preloadedcodedata>& preloaded = mi->body->preloadedcode;
+	const uint32_t count = preloaded.size();
+	if (count == 0 || count > baselinejit_max_instructions)
+		return;
+	uint32_t shift = 0;
+	while ((1U<<shift) < sizeof(preloadedcodedata))
+		shift++;
+
+	const int32_t EXEC_POS = offsetof(call_context,exec_pos);
+	const int32_t LOCALS = offsetof(call_context,locals);
+	const int32_t LOCALSLOTS = offsetof(call_context,localslots);
+
+	NativeEmitter e;
+	// one label per instruction, the label after the last instruction leaves the compiled code
+	for (uint32_t i = 0; i <= count; i++)
+		e.newLabel();
+	const uint32_t dispatch = e.newLabel();
+	const uint32_t exit = e.newLabel();
+
+	e.emit({0x55}); // push rbp
+	e.emit({0x48, 0x89, 0xe5}); // mov rbp, rsp
+	e.emit({0x53}); // push rbx
+	e.emit({0x41, 0x54}); // push r12
+	e.emit({0x41, 0x55}); // push r13
+	e.emit({0x41, 0x56}); // push r14
+	e.emit({0x48, 0x89, 0xfb}); // mov rbx, rdi
+	e.load(R14,RBX,LOCALS);
+	e.emit({0x49, 0x81, 0xc6}); // add r14, returnvaluepos*sizeof(asAtom)
+	e.emit32(mi->body->getReturnValuePos()*sizeof(asAtom));
+	e.movImm64(R12,uint64_t(preloaded.data()));
+	baselinejit_code* res = new baselinejit_code();
+	res->dispatchtable.resize(count);
+	e.movImm64(R13,uint64_t(res->dispatchtable.data()));
+
+	e.bind(dispatch);
+	e.load(RAX,RBX,EXEC_POS);
+	e.emit({0x4c, 0x29, 0xe0}); // sub rax, r12
+	e.emit({0x48, 0xc1, 0xe8, uint8_t(shift)}); // shr rax, shift
+	e.emit({0x48, 0x3d}); // cmp rax, count
+	e.emit32(count);
+	e.jcc(COND_AE,exit);
+	e.emit({0x41, 0xff, 0x64, 0xc5, 0x00}); // jmp [r13+rax*8]
+
+	e.bind(exit);
+	e.bind(count);
+	e.emit({0x41, 0x5e}); // pop r14
+	e.emit({0x41, 0x5d}); // pop r13
+	e.emit({0x41, 0x5c}); // pop r12
+	e.emit({0x5b}); // pop rbx
+	e.emit({0x5d}); // pop rbp
+	e.emit({0xc3}); // ret
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		e.bind(i);
+		const preloadedcodedata& instr = preloaded[i];
+		const abc_function f = instr.func;
+		if (f == abc_nop || f == abc_label)
+			continue;
+		const int64_t target = int64_t(i)+instr.arg3_int;
+		const bool targetvalid = target >= 0 && target < count;
+		if (f == abc_jump && targetvalid)
+		{
+			e.jmp(target);
+			continue;
+		}
+		e.movImm64(RAX,uint64_t(&preloaded[i]));
+		e.store(RBX,EXEC_POS,RAX);
+
+		// inlined fast paths for int operands
+		uint32_t slowpath = UINT32_MAX;
+		if (f == abc_inclocal_i_optimized || f == abc_declocal_i_optimized)
+		{
+			const bool inc = f == abc_inclocal_i_optimized;
+			slowpath = e.newLabel();
+			e.load(RDX,RBX,LOCALSLOTS);
+			e.load(RDX,RDX,instr.arg1_uint*sizeof(asAtom*));
+			e.load(RCX,RDX,0);
+			e.checkInteger(RCX,slowpath);
+			e.emit({0x48, 0xc1, 0xf9, 0x03}); // sar rcx, 3
+			// leave overflow to the handler
+			e.emit({0x81, 0xf9}); // cmp ecx, INT32_MAX / INT32_MIN
+			e.emit32(inc ? INT32_MAX : INT32_MIN);
+			e.jcc(COND_E,slowpath);
+			if (inc)
+				e.emit({0x83, 0xc1, 0x01}); // add ecx, 1
+			else
+				e.emit({0x83, 0xe9, 0x01}); // sub ecx, 1
+			e.emit({0x48, 0x63, 0xc9}); // movsxd rcx, ecx
+			e.emit({0x48, 0xc1, 0xe1, 0x03}); // shl rcx, 3
+			e.emit({0x48, 0x83, 0xc9, ATOM_INTEGER}); // or rcx, ATOM_INTEGER
+			e.store(RDX,0,RCX);
+			e.jmp(i+1);
+		}
+		else if (targetvalid)
+		{
+			JITCOND cond = COND_E;
+			bool localconstant = false;
+			bool inlined = true;
+			if (f == abc_iflt_local_local || f == abc_ifnge_local_local)
+				cond = COND_L;
+			else if (f == abc_iflt_local_constant || f == abc_ifnge_local_constant)
+				cond = COND_L, localconstant = true;
+			else if (f == abc_ifle_local_local)
+				cond = COND_LE;
+			else if (f == abc_ifle_local_constant)
+				cond = COND_LE, localconstant = true;
+			else if (f == abc_ifgt_local_local)
+				cond = COND_G;
+			else if (f == abc_ifgt_local_constant)
+				cond = COND_G, localconstant = true;
+			else if (f == abc_ifge_local_local || f == abc_ifnlt_local_local)
+				cond = COND_GE;
+			else if (f == abc_ifge_local_constant || f == abc_ifnlt_local_constant)
+				cond = COND_GE, localconstant = true;
+			else if (f == abc_ifeq_local_local)
+				cond = COND_E;
+			else if (f == abc_ifeq_local_constant)
+				cond = COND_E, localconstant = true;
+			else if (f == abc_ifne_local_local)
+				cond = COND_NE;
+			else if (f == abc_ifne_local_constant)
+				cond = COND_NE, localconstant = true;
+			else
+				inlined = false;
+			// only int constants can be compared inline
+			if (inlined && localconstant && (instr.arg2_constant->uintval&0x7) != ATOM_INTEGER)
+				inlined = false;
+			if (inlined)
+			{
+				// int atoms compare like their raw values, as in asAtomHandler::isLess
+				slowpath = e.newLabel();
+				e.load(RAX,RBX,LOCALSLOTS);
+				e.load(RCX,RAX,instr.local_pos1*sizeof(asAtom*));
+				if (localconstant)
+					e.movImm64(RDX,instr.arg2_constant->uintval);
+				else
+				{
+					e.load(RDX,RAX,instr.local_pos2*sizeof(asAtom*));
+					e.load(RDX,RDX,0);
+				}
+				e.load(RCX,RCX,0);
+				e.checkInteger(RCX,slowpath);
+				if (!localconstant)
+					e.checkInteger(RDX,slowpath);
+				e.emit({0x48, 0x39, 0xd1}); // cmp rcx, rdx
+				e.jcc(cond,target);
+				e.jmp(i+1);
+			}
+		}
+		if (slowpath != UINT32_MAX)
+			e.bind(slowpath);
+
+		e.emit({0x48, 0x89, 0xdf}); // mov rdi, rbx
+		e.movImm64(RAX,uint64_t(f));
+		e.emit({0xff, 0xd0}); // call rax
+		e.emit({0x49, 0x83, 0x3e, 0x00}); // cmp qword [r14], 0 (return value still invalid?)
+		e.jcc(COND_NE,exit);
+		e.load(RAX,RBX,EXEC_POS);
+		e.movImm64(RCX,uint64_t(preloaded.data()+i+1));
+		e.emit({0x48, 0x39, 0xc8}); // cmp rax, rcx
+		e.jcc(COND_NE,dispatch);
+	}
+	e.jmp(count);
+
+	if (!e.resolve())
+	{
+		delete res;
+		return;
+	}
+	const size_t pagesize = sysconf(_SC_PAGESIZE);
+	res->mappingsize = (e.code.size()+pagesize-1)/pagesize*pagesize;
+	void* mapping = mmap(nullptr,res->mappingsize,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+	if (mapping == MAP_FAILED)
+	{
+		LOG(LOG_ERROR,"baseline jit: unable to allocate executable memory");
+		delete res;
+		return;
+	}
+	res->mapping = (uint8_t*)mapping;
+	memcpy(res->mapping,e.code.data(),e.code.size());
+	if (mprotect(res->mapping,res->mappingsize,PROT_READ|PROT_EXEC) != 0)
+	{
+		LOG(LOG_ERROR,"baseline jit: unable to make code executable");
+		munmap(res->mapping,res->mappingsize);
+		delete res;
+		return;
+	}
+	for (uint32_t i = 0; i < count; i++)
+		res->dispatchtable[i] = res->mapping+e.labelPos(i);
+	buildUnwindInfo(res->unwindinfo,res->mapping,e.code.size());
+	__register_frame(res->unwindinfo.data());
+	res->entry = (void (*)(call_context*))res->mapping;
+	LOG(LOG_CALLS,"baseline jit: compiled "<<count<<" instructions to "<<e.code.size()<<" bytes");
+	mi->nativecode = res;
+}
+#endif
@@ -28,6 +28,9 @@
 #include "parsing/streams.h"
 #include <string>
 #include <sstream>
+#include <fstream>
+#include <tuple>
+#include <unordered_map>
 
 using namespace std;
 using namespace lightspark;
@@ -62,19 +65,73 @@ void ABCVm::checkPropertyExceptionInteger(ASObject* obj,int index, asAtom& prop)
 
 #ifndef NDEBUG
 std::map<abc_function,uint32_t> opcodecounter;
+// sequences of two and three instructions executed one after the other, keyed by index into ABCVm::abcfunctions
+std::map<std::pair<uint32_t,uint32_t>,uint32_t> opcodepaircounter;
+std::map<std::tuple<uint32_t,uint32_t,uint32_t>,uint32_t> opcodetriplecounter;
+
+static uint32_t opcodeIndex(abc_function f);
+static void countOpcode(preloadedcodedata* pos, preloadedcodedata*& prevpos, uint32_t* prevopcodes)
+{
+	uint32_t c = opcodecounter[pos->func];
+	opcodecounter[pos->func] = c+1;
+	uint32_t opcode = opcodeIndex(pos->func);
+	// only count sequences that a superinstruction can replace, i.e. that follow each other in the code
+	if (!prevpos || pos != prevpos+1 || opcode == UINT32_MAX)
+		prevopcodes[0] = prevopcodes[1] = UINT32_MAX;
+	if (prevopcodes[1] != UINT32_MAX)
+	{
+		opcodepaircounter[make_pair(prevopcodes[1],opcode)]++;
+		if (prevopcodes[0] != UINT32_MAX)
+			opcodetriplecounter[make_tuple(prevopcodes[0],prevopcodes[1],opcode)]++;
+	}
+	prevopcodes[0] = prevopcodes[1];
+	prevopcodes[1] = opcode;
+	prevpos = pos;
+}
+
 void ABCVm::dumpOpcodeCounters(uint32_t threshhold)
 {
 	auto it = opcodecounter.begin();
 	while (it != opcodecounter.end())
 	{
 		if (it->second > threshhold)
-			LOG(LOG_INFO,"opcode counter:"<<hex<<it->first<<":"<<dec<<it->second);
+			LOG(LOG_INFO,"opcode counter:"<<hex<<opcodeIndex(it->first)<<":"<<dec<<it->second);
 		it++;
 	}
+	for (auto itp = opcodepaircounter.begin(); itp != opcodepaircounter.end(); itp++)
+	{
+		if (itp->second > threshhold)
+			LOG(LOG_INFO,"opcode pair counter:"<<hex<<itp->first.first<<" "<<itp->first.second<<":"<<dec<<itp->second);
+	}
+	for (auto itt = opcodetriplecounter.begin(); itt != opcodetriplecounter.end(); itt++)
+	{
+		if (itt->second > threshhold)
+			LOG(LOG_INFO,"opcode triple counter:"<<hex<<get<0>(itt->first)<<" "<<get<1>(itt->first)<<" "<<get<2>(itt->first)<<":"<<dec<<itt->second);
+	}
 }
 void ABCVm::clearOpcodeCounters()
 {
 	opcodecounter.clear();
+	opcodepaircounter.clear();
+	opcodetriplecounter.clear();
+}
+/*
+ * Appends the sequence counters to filename, one "count opcode..." line per sequence.
+ * Profiles of several runs can be concatenated and fed to tools/superinstgen
+ */
+void ABCVm::saveOpcodeProfile(const tiny_string& filename)
+{
+	ofstream f(filename.raw_buf(),ios::app);
+	if (!f)
+	{
+		LOG(LOG_ERROR,"unable to write opcode profile to "<<filename);
+		return;
+	}
+	f << hex;
+	for (auto itp = opcodepaircounter.begin(); itp != opcodepaircounter.end(); itp++)
+		f << dec << itp->second << hex << " 0x" << itp->first.first << " 0x" << itp->first.second << endl;
+	for (auto itt = opcodetriplecounter.begin(); itt != opcodetriplecounter.end(); itt++)
+		f << dec << itt->second << hex << " 0x" << get<0>(itt->first) << " 0x" << get<1>(itt->first) << " 0x" << get<2>(itt->first) << endl;
 }
 #endif
 
@@ -92,6 +149,19 @@ void ABCVm::executeFunction(call_context* context)
 #endif
 
 	asAtom* ret = &context->locals[context->mi->body->getReturnValuePos()];
+#ifdef BASELINE_JIT_ENABLED
+	//This is a hot function, compile it to native code and run that as long as possible
+	const uint32_t baselinejit_hit_threshold=50;
+	method_info* mi = context->mi;
+	if (!mi->nativecode && context->exec_pos == mi->body->preloadedcode.data() && ++mi->nativeHitCount == baselinejit_hit_threshold)
+		compileBaselineJit(mi);
+	if (mi->nativecode)
+		mi->nativecode->entry(context);
+#endif
+#ifndef NDEBUG
+	preloadedcodedata* prevpos = nullptr;
+	uint32_t prevopcodes[2] = { UINT32_MAX, UINT32_MAX };
+#endif
 	while(asAtomHandler::isInvalid(*ret))
 	{
 #ifdef PROFILING_SUPPORT
@@ -100,8 +170,7 @@ void ABCVm::executeFunction(call_context* context)
 		//LOG(LOG_INFO,"stack:"<<(context->stackp-context->stack));
 
 #ifndef NDEBUG
-		uint32_t c = opcodecounter[context->exec_pos->func];
-		opcodecounter[context->exec_pos->func] = c+1;
+		countOpcode(context->exec_pos,prevpos,prevopcodes);
 #endif
 		// context->exec_pos points to the current instruction, every abc_function has to make sure
 		// it points to the next valid instruction after execution
@@ -961,6 +1030,62 @@ abc_function ABCVm::abcfunctions[]={
 	abc_invalidinstruction
 };
 
+#ifndef NDEBUG
+static uint32_t opcodeIndex(abc_function f)
+{
+	static std::unordered_map<abc_function,uint32_t> indexes;
+	if (indexes.empty())
+	{
+		for (uint32_t i = sizeof(ABCVm::abcfunctions)/sizeof(abc_function); i > 0; i--)
+			indexes[ABCVm::abcfunctions[i-1]] = i-1;
+	}
+	auto it = indexes.find(f);
+	return it == indexes.end() ? UINT32_MAX : it->second;
+}
+#endif
+
+/*
+ * Replaces the handlers at the start of the hot instruction sequences listed in
+ * ABCVm::superinstructions by their fused versions. The following instructions stay
+ * in place, so jumps into the middle of a sequence still work
+ */
+void ABCVm::applySuperinstructions(std::vector<preloadedcodedata>& code)
+{
+	if (!superinstructions[0].first)
+		return;
+	static std::multimap<std::pair<abc_function,abc_function>,const superinstruction*> fusedhandlers;
+	static Mutex fusedhandlersMutex;
+	{
+		Locker l(fusedhandlersMutex);
+		if (fusedhandlers.empty())
+		{
+			for (const superinstruction* it = superinstructions; it->first; it++)
+				fusedhandlers.insert(make_pair(make_pair(it->first,it->second),it));
+		}
+	}
+	for (uint32_t i = 0; i+1 < code.size(); i++)
+	{
+		auto range = fusedhandlers.equal_range(make_pair(code[i].func,code[i+1].func));
+		const superinstruction* found = nullptr;
+		for (auto it = range.first; it != range.second; it++)
+		{
+			// prefer the longest sequence
+			if (!it->second->third)
+			{
+				if (!found)
+					found = it->second;
+			}
+			else if (i+2 < code.size() && code[i+2].func == it->second->third)
+			{
+				found = it->second;
+				break;
+			}
+		}
+		if (found)
+			code[i].func = found->fused;
+	}
+}
+
 struct operands;
 struct preloadedcodebuffer
 {
@@ -987,7 +1112,9 @@ struct preloadstate
 	method_info* mi;
 	std::vector<preloadedcodebuffer> preloadedcode;
 	bool duplocalresult;
-	preloadstate(method_info* _mi):mi(_mi),duplocalresult(false) {}
+	// method is preloaded for the cold tier, without optimizations that need lookahead
+	bool cold;
+	preloadstate(method_info* _mi):mi(_mi),duplocalresult(false),cold(false) {}
 };
 
 struct operands
@@ -1291,6 +1418,12 @@ bool canCallFunctionDirect(ASObject* obj,multiname* name)
 
 bool checkForLocalResult(preloadstate& state,memorystream& code,uint32_t opcode_jumpspace, Class_base* restype,int preloadpos=-1,int preloadlocalpos=-1, bool checkchanged=false,bool fromdup = false)
 {
+	if (state.cold)
+	{
+		// cold methods always put results on the stack, this avoids scanning the following code
+		clearOperands(state,false,nullptr,checkchanged);
+		return false;
+	}
 	bool res = false;
 	uint32_t resultpos=0;
 	uint32_t pos = code.tellg()+1;
@@ -2759,11 +2892,32 @@ void ABCVm::preloadFunction(SyntheticFunction* function)
 		}
 		it++;
 	}
+	// Methods are preloaded in the cold tier on their first call, as most of them are called only once (class and
+	// script initializers, constructors of singletons...). The cold tier does no type inference and no name resolution,
+	// all instructions use their generic versions. Calls and backward jumps of cold methods are counted, when they
+	// reach coldpreload_hit_threshold the method is preloaded with all optimizations on its next call
+	const int coldpreload_min_code_length=32;
+	state.cold = mi->body->coldhitcount == 0 && code_len >= coldpreload_min_code_length;
+	mi->body->coldpreload = state.cold;
+	if (state.cold)
+	{
+		if (!mi->body->exceptions.empty())
+			mi->body->abcexceptions = mi->body->exceptions;
+		// without the second pass nothing is known about the locals
+		state.unchangedlocals.clear();
+		for (uint32_t i = 0; i < state.localtypes.size(); i++)
+		{
+			state.localtypes[i] = nullptr;
+			state.defaultlocaltypes[i] = nullptr;
+			state.defaultlocaltypescacheable[i] = false;
+		}
+	}
+
 	// second pass:
 	// - compute types of the locals and detect if they don't change during execution
 	Class_base* currenttype=nullptr;
 	memorystream codetypes(mi->body->code.data(), code_len);
-	while(!codetypes.atend())
+	while(!state.cold && !codetypes.atend())
 	{
 		uint8_t prevopcode=opcode;
 		opcode = codetypes.readbyte();
@@ -3038,6 +3192,12 @@ void ABCVm::preloadFunction(SyntheticFunction* function)
 			typestack.push_back(typestackentry(nullptr,false));
 			itcurEx++;
 		}
+		if (state.cold)
+		{
+			// the cold tier doesn't use the types of the stack entries
+			for (auto ittype = typestack.begin(); ittype != typestack.end(); ittype++)
+				*ittype = typestackentry(nullptr,false);
+		}
 		uint8_t prevopcode=opcode;
 		opcode = code.readbyte();
 		//LOG(LOG_INFO,"preload pass3 opcode:"<<function->getSystemState()->getStringFromUniqueId(function->functionname)<<" "<< code.tellg()-1<<" "<<state.operandlist.size()<<" "<<typestack.size()<<" "<<hex<<(int)opcode);
@@ -3334,7 +3494,7 @@ void ABCVm::preloadFunction(SyntheticFunction* function)
 				uint32_t t =code.readu30();
 				removetypestack(typestack,mi->context->constant_pool.multinames[t].runtimeargs);
 				asAtom o=asAtomHandler::invalidAtom;
-				if (function->inClass && function->inClass->isSealed && (scopelist.begin()==scopelist.end() || !scopelist.back())) // class method
+				if (!state.cold && function->inClass && function->inClass->isSealed && (scopelist.begin()==scopelist.end() || !scopelist.back())) // class method
 				{
 					bool found = false;
 					multiname* name=mi->context->getMultiname(t,nullptr);
@@ -3420,7 +3580,11 @@ void ABCVm::preloadFunction(SyntheticFunction* function)
 				multiname* name=mi->context->getMultiname(t,nullptr);
 				if (!name || !name->isStatic)
 					throwError<VerifyError>(kIllegalOpMultinameError,"getlex","multiname not static");
-				if (function->inClass) // class method
+				if (state.cold)
+				{
+					// cold methods look up the name when it is executed
+				}
+				else if (function->inClass) // class method
 				{
 					if (function->isStatic)
 					{
@@ -6056,5 +6220,25 @@ void ABCVm::preloadFunction(SyntheticFunction* function)
 		if ((*itc).cachedslot3)
 			mi->body->preloadedcode[mi->body->preloadedcode.size()-1].local3.pos+= mi->body->getReturnValuePos()+1+mi->body->localresultcount;
 	}
+	if (state.cold)
+	{
+		// backward jumps of cold methods count the iterations of loops
+		mi->body->coldbranches.clear();
+		for (auto itb = jumppositions.begin(); itb != jumppositions.end(); itb++)
+		{
+			preloadedcodedata& branch = mi->body->preloadedcode[itb->first];
+			if (branch.arg3_int <= 0)
+			{
+				mi->body->coldbranches.push_back(make_pair(uint32_t(itb->first),branch.func));
+				branch.func = abc_coldbranch;
+			}
+		}
+		return;
+	}
+#ifndef NDEBUG
+	// the profile has to see the original instructions
+	if (function->getSystemState()->getOpcodeProfileOutput().empty())
+#endif
+		applySuperinstructions(mi->body->preloadedcode);
 }
 
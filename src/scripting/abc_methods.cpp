@@ -142,6 +142,18 @@ void ABCVm::abc_jump(call_context* context)
 	LOG_CALL("jump:"<<(*context->exec_pos).arg3_int);
 	context->exec_pos += (*context->exec_pos).arg3_int;
 }
+void ABCVm::abc_coldbranch(call_context* context)
+{
+	method_body_info* body = context->mi->body;
+	if (body->coldhitcount != UINT32_MAX)
+		++body->coldhitcount;
+	// the branch itself is executed by the function it replaced
+	uint32_t pos = context->exec_pos-body->preloadedcode.data();
+	auto it = lower_bound(body->coldbranches.begin(),body->coldbranches.end(),pos,
+			[](const std::pair<uint32_t,abc_function>& b, uint32_t p) { return b.first < p; });
+	assert(it != body->coldbranches.end() && it->first == pos);
+	it->second(context);
+}
 void ABCVm::abc_iftrue(call_context* context)
 {
 	RUNTIME_STACK_POP_CREATE(context,v1);
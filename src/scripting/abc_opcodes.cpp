@@ -1192,10 +1192,10 @@ ASObject* ABCVm::add(ASObject* val2, ASObject* val1)
 	}
 	else if(val1->is<ASString>() || val2->is<ASString>())
 	{
-		tiny_string a = val1->toString();
-		tiny_string b = val2->toString();
-		LOG_CALL("add " << a << '+' << b);
-		res = abstract_s(val1->getSystemState(),a + b);
+		asAtom a = asAtomHandler::fromObject(val1);
+		asAtom b = asAtomHandler::fromObject(val2);
+		LOG_CALL("add " << val1->toString() << '+' << val2->toString());
+		res = ASString::concatenate(val1->getSystemState(),a,b);
 		val1->decRef();
 		val2->decRef();
 		return res;
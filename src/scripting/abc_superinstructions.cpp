@@ -0,0 +1,89 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+/* This file is generated by tools/superinstgen - DO NOT EDIT */
+
+#include "scripting/abc.h"
+
+using namespace lightspark;
+
+// every fused handler checks that the previous handler fell through before running the next one
+template<abc_function first, abc_function second>
+void ABCVm::abc_fused2(call_context* context)
+{
+	preloadedcodedata* next = context->exec_pos+1;
+	first(context);
+	if (context->exec_pos == next)
+		second(context);
+}
+template<abc_function first, abc_function second, abc_function third>
+void ABCVm::abc_fused3(call_context* context)
+{
+	preloadedcodedata* next = context->exec_pos+1;
+	first(context);
+	if (context->exec_pos != next)
+		return;
+	second(context);
+	if (context->exec_pos == next+1)
+		third(context);
+}
+
+const ABCVm::superinstruction ABCVm::superinstructions[]={
+	{ abc_add_i_local_constant_localresult, abc_li8_local, nullptr, abc_fused2<abc_add_i_local_constant_localresult,abc_li8_local> }, // 0
+	{ abc_add_i_local_constant_localresult, abc_li8_local_localresult, nullptr, abc_fused2<abc_add_i_local_constant_localresult,abc_li8_local_localresult> }, // 0
+	{ abc_add_i_local_constant_localresult, abc_li16_local, nullptr, abc_fused2<abc_add_i_local_constant_localresult,abc_li16_local> }, // 0
+	{ abc_add_i_local_constant_localresult, abc_li16_local_localresult, nullptr, abc_fused2<abc_add_i_local_constant_localresult,abc_li16_local_localresult> }, // 0
+	{ abc_add_i_local_constant_localresult, abc_li32_local, nullptr, abc_fused2<abc_add_i_local_constant_localresult,abc_li32_local> }, // 0
+	{ abc_add_i_local_constant_localresult, abc_li32_local_localresult, nullptr, abc_fused2<abc_add_i_local_constant_localresult,abc_li32_local_localresult> }, // 0
+	{ abc_add_i_local_constant_localresult, abc_lf32_local, nullptr, abc_fused2<abc_add_i_local_constant_localresult,abc_lf32_local> }, // 0
+	{ abc_add_i_local_constant_localresult, abc_lf32_local_localresult, nullptr, abc_fused2<abc_add_i_local_constant_localresult,abc_lf32_local_localresult> }, // 0
+	{ abc_add_i_local_constant_localresult, abc_lf64_local, nullptr, abc_fused2<abc_add_i_local_constant_localresult,abc_lf64_local> }, // 0
+	{ abc_add_i_local_constant_localresult, abc_lf64_local_localresult, nullptr, abc_fused2<abc_add_i_local_constant_localresult,abc_lf64_local_localresult> }, // 0
+	{ abc_add_i_local_constant_localresult, abc_si8_constant_local, nullptr, abc_fused2<abc_add_i_local_constant_localresult,abc_si8_constant_local> }, // 0
+	{ abc_add_i_local_constant_localresult, abc_si8_local_local, nullptr, abc_fused2<abc_add_i_local_constant_localresult,abc_si8_local_local> }, // 0
+	{ abc_add_i_local_constant_localresult, abc_si16_constant_local, nullptr, abc_fused2<abc_add_i_local_constant_localresult,abc_si16_constant_local> }, // 0
+	{ abc_add_i_local_constant_localresult, abc_si16_local_local, nullptr, abc_fused2<abc_add_i_local_constant_localresult,abc_si16_local_local> }, // 0
+	{ abc_add_i_local_constant_localresult, abc_si32_constant_local, nullptr, abc_fused2<abc_add_i_local_constant_localresult,abc_si32_constant_local> }, // 0
+	{ abc_add_i_local_constant_localresult, abc_si32_local_local, nullptr, abc_fused2<abc_add_i_local_constant_localresult,abc_si32_local_local> }, // 0
+	{ abc_add_i_local_constant_localresult, abc_sf32_constant_local, nullptr, abc_fused2<abc_add_i_local_constant_localresult,abc_sf32_constant_local> }, // 0
+	{ abc_add_i_local_constant_localresult, abc_sf32_local_local, nullptr, abc_fused2<abc_add_i_local_constant_localresult,abc_sf32_local_local> }, // 0
+	{ abc_add_i_local_constant_localresult, abc_sf64_constant_local, nullptr, abc_fused2<abc_add_i_local_constant_localresult,abc_sf64_constant_local> }, // 0
+	{ abc_add_i_local_constant_localresult, abc_sf64_local_local, nullptr, abc_fused2<abc_add_i_local_constant_localresult,abc_sf64_local_local> }, // 0
+	{ abc_add_local_constant_localresult, abc_li8_local, nullptr, abc_fused2<abc_add_local_constant_localresult,abc_li8_local> }, // 0
+	{ abc_add_local_constant_localresult, abc_li8_local_localresult, nullptr, abc_fused2<abc_add_local_constant_localresult,abc_li8_local_localresult> }, // 0
+	{ abc_add_local_constant_localresult, abc_li16_local, nullptr, abc_fused2<abc_add_local_constant_localresult,abc_li16_local> }, // 0
+	{ abc_add_local_constant_localresult, abc_li16_local_localresult, nullptr, abc_fused2<abc_add_local_constant_localresult,abc_li16_local_localresult> }, // 0
+	{ abc_add_local_constant_localresult, abc_li32_local, nullptr, abc_fused2<abc_add_local_constant_localresult,abc_li32_local> }, // 0
+	{ abc_add_local_constant_localresult, abc_li32_local_localresult, nullptr, abc_fused2<abc_add_local_constant_localresult,abc_li32_local_localresult> }, // 0
+	{ abc_add_local_constant_localresult, abc_lf32_local, nullptr, abc_fused2<abc_add_local_constant_localresult,abc_lf32_local> }, // 0
+	{ abc_add_local_constant_localresult, abc_lf32_local_localresult, nullptr, abc_fused2<abc_add_local_constant_localresult,abc_lf32_local_localresult> }, // 0
+	{ abc_add_local_constant_localresult, abc_lf64_local, nullptr, abc_fused2<abc_add_local_constant_localresult,abc_lf64_local> }, // 0
+	{ abc_add_local_constant_localresult, abc_lf64_local_localresult, nullptr, abc_fused2<abc_add_local_constant_localresult,abc_lf64_local_localresult> }, // 0
+	{ abc_add_local_constant_localresult, abc_si8_constant_local, nullptr, abc_fused2<abc_add_local_constant_localresult,abc_si8_constant_local> }, // 0
+	{ abc_add_local_constant_localresult, abc_si8_local_local, nullptr, abc_fused2<abc_add_local_constant_localresult,abc_si8_local_local> }, // 0
+	{ abc_add_local_constant_localresult, abc_si16_constant_local, nullptr, abc_fused2<abc_add_local_constant_localresult,abc_si16_constant_local> }, // 0
+	{ abc_add_local_constant_localresult, abc_si16_local_local, nullptr, abc_fused2<abc_add_local_constant_localresult,abc_si16_local_local> }, // 0
+	{ abc_add_local_constant_localresult, abc_si32_constant_local, nullptr, abc_fused2<abc_add_local_constant_localresult,abc_si32_constant_local> }, // 0
+	{ abc_add_local_constant_localresult, abc_si32_local_local, nullptr, abc_fused2<abc_add_local_constant_localresult,abc_si32_local_local> }, // 0
+	{ abc_add_local_constant_localresult, abc_sf32_constant_local, nullptr, abc_fused2<abc_add_local_constant_localresult,abc_sf32_constant_local> }, // 0
+	{ abc_add_local_constant_localresult, abc_sf32_local_local, nullptr, abc_fused2<abc_add_local_constant_localresult,abc_sf32_local_local> }, // 0
+	{ abc_add_local_constant_localresult, abc_sf64_constant_local, nullptr, abc_fused2<abc_add_local_constant_localresult,abc_sf64_constant_local> }, // 0
+	{ abc_add_local_constant_localresult, abc_sf64_local_local, nullptr, abc_fused2<abc_add_local_constant_localresult,abc_sf64_local_local> }, // 0
+	{ nullptr, nullptr, nullptr, nullptr }
+};
@@ -313,7 +313,7 @@ struct localconstantslot
 
 struct method_body_info
 {
-	method_body_info():localresultcount(0),hit_count(0),codeStatus(ORIGINAL){}
+	method_body_info():localresultcount(0),hit_count(0),codeStatus(ORIGINAL),coldpreload(false),coldhitcount(0){}
 	u30 method;
 	u30 max_stack;
 	u30 local_count;
@@ -333,6 +333,14 @@ struct method_body_info
 	// list of local/slot pairs that were optimized away
 	std::vector<localconstantslot> localconstantslots;
 	std::vector<preloadedcodedata> preloadedcode;
+	// true if the method was preloaded without type inference ("cold" tier)
+	bool coldpreload;
+	// number of calls and backward branches of a cold method, it is preloaded with all optimizations when it gets hot
+	uint32_t coldhitcount;
+	// positions of the backward branches of a cold method in preloadedcode and the functions executing them, sorted by position
+	std::vector<std::pair<uint32_t,abc_function>> coldbranches;
+	// exceptions with positions in the abc code, preloading replaces them with positions in preloadedcode
+	std::vector<exception_info_abc> abcexceptions;
 	inline uint16_t getReturnValuePos() const { return returnvaluepos; }
 };
 
@@ -32,6 +32,7 @@ class ASObject;
 class Class_base;
 union asAtom;
 class SyntheticFunction;
+class ApplicationDomain;
 
 struct scope_entry
 {
@@ -71,13 +72,15 @@ struct call_context
 	 * Defaults to empty string according to ECMA-357 13.1.1.1
 	 */
 	uint32_t defaultNamespaceUri;
+	/* Cached for the domain memory opcodes, NULL until the first access */
+	ApplicationDomain* domainMemoryOwner;
 	call_context(method_info* _mi):
 		locals(nullptr),stack(nullptr),
 		stackp(nullptr),exec_pos(nullptr),
 		max_stackp(nullptr),
 		parent_scope_stack(nullptr),curr_scope_stack(0),argarrayposition(-1),
 		scope_stack(nullptr),scope_stack_dynamic(nullptr),localslots(nullptr),mi(_mi),
-		inClass(nullptr),defaultNamespaceUri(0)
+		inClass(nullptr),defaultNamespaceUri(0),domainMemoryOwner(nullptr)
 	{
 	}
 	static void handleError(int errorcode);
@@ -350,13 +350,13 @@ ASFUNCTIONBODY_ATOM(avmplusDomain,_setDomainMemory)
 	avmplusDomain* th = asAtomHandler::as<avmplusDomain>(obj);
 	if (b.isNull())
 	{
-		th->appdomain->domainMemory = b;
+		th->appdomain->setDomainMemory(b);
 		return;
 	}
 		
 	if (b->getLength() < MIN_DOMAIN_MEMORY_LIMIT)
 		throwError<RangeError>(kEndOfFileError);
-	th->appdomain->domainMemory = b;
+	th->appdomain->setDomainMemory(b);
 }
 
 ASFUNCTIONBODY_ATOM(lightspark,casi32)
@@ -22,6 +22,7 @@
 #include "scripting/flash/display/flashdisplay.h"
 #include "backends/rendering.h"
 #include "backends/image.h"
+#include "platforms/pixelkernels.h"
 #include "swf.h"
 
 using namespace std;
@@ -179,18 +180,10 @@ void BitmapContainer::setPixel(int32_t x, int32_t y, uint32_t color, bool setAlp
 	uint32_t *p=reinterpret_cast<uint32_t *>(&data[y*stride + 4*x]);
 	if(setAlpha)
 	{
-		if (ispremultiplied || (((*p)&0xff000000) == 0xff000000))
+		if (ispremultiplied)
 			*p=color;
 		else
-		{
-			uint32_t res = 0;
-			uint32_t alpha = ((color >> 24)&0xff);
-			res |= ((((color >> 0) &0xff) * alpha)&0xff) << 0;
-			res |= ((((color >> 8) &0xff) * alpha)&0xff) << 8;
-			res |= ((((color >> 16) &0xff) * alpha)&0xff) << 16;
-			res |= alpha<<24;
-			*p=res;
-		}
+			pixelToPremultipliedRow(&color,p,1);
 	}
 	else
 		*p=(*p & 0xff000000) | (color & 0x00ffffff);
@@ -202,25 +195,11 @@ uint32_t BitmapContainer::getPixel(int32_t x, int32_t y,bool premultiplied) cons
 		return 0;
 
 	const uint32_t *p=reinterpret_cast<const uint32_t *>(&data[y*stride + 4*x]);
+	uint32_t res=*p;
+	// return value with "un-multiplied" alpha: ceiling(value*255/alpha)
 	if (!premultiplied)
-	{
-		uint32_t res = 0;
-		uint32_t alpha = ((*p >> 24)&0xff);
-		if (alpha && alpha != 0xff)
-		{
-			// return value with "un-multiplied" alpha: ceiling(value*255/alpha)
-			uint32_t b = ((*p) >> 0) &0xff;
-			uint32_t g = ((*p) >> 8) &0xff;
-			uint32_t r = ((*p) >> 16) &0xff;
-			//x/y + (x % y != 0);
-			res |= (((b*0xff)/alpha+((b*0xff)%alpha ? 1:0))&0xff) << 0;
-			res |= (((g*0xff)/alpha+((g*0xff)%alpha ? 1:0))&0xff) << 8;
-			res |= (((r*0xff)/alpha+((r*0xff)%alpha ? 1:0))&0xff) << 16;
-			res |= alpha<<24;
-			return res;
-		}
-	}
-	return *p;
+		pixelToUnpremultipliedRow(p,&res,1);
+	return res;
 }
 
 void BitmapContainer::copyRectangle(_R<BitmapContainer> source,
@@ -251,24 +230,19 @@ void BitmapContainer::copyRectangle(_R<BitmapContainer> source,
 				4*copyWidth);
 		}
 	}
+	else if (source.getPtr() == this)
+	{
+		// the regions may overlap, so the source is copied first
+		vector<uint32_t> sourcePixels(copyWidth*copyHeight);
+		for (int i=0; i<copyHeight; i++)
+			memcpy(&sourcePixels[i*copyWidth], getScanline(sy+i)+sx, 4*copyWidth);
+		for (int i=0; i<copyHeight; i++)
+			pixelBlendRow(&sourcePixels[i*copyWidth], getScanline(clippedY+i)+clippedX, copyWidth);
+	}
 	else
 	{
-		uint8_t* sourcedata = &source->data[0];
-		bool needsdeletion = false;
-		if (sourcedata == &data[0])
-		{
-			// cairo doesn't work if source and destination buffers are the same 
-			sourcedata = new uint8_t[data.size()];
-			memcpy (sourcedata,&data[0],data.size());
-			needsdeletion = true;
-		}
-		//Slow path using Cairo
-		CairoRenderContext ctxt(&data[0], width, height,false);
-		ctxt.simpleBlit(clippedX, clippedY, sourcedata,
-				source->getWidth(), source->getHeight(),
-				sx, sy, copyWidth, copyHeight);
-		if (needsdeletion)
-			delete[] sourcedata;
+		for (int i=0; i<copyHeight; i++)
+			pixelBlendRow(source->getScanline(sy+i)+sx, getScanline(clippedY+i)+clippedX, copyWidth);
 	}
 }
 
@@ -277,18 +251,10 @@ void BitmapContainer::fillRectangle(const RECT& inputRect, uint32_t color, bool
 	RECT clippedRect;
 	clipRect(inputRect, clippedRect);
 
+	if (!useAlpha)
+		color = 0xFF000000 | (color & 0xFFFFFF);
 	for(int32_t y=clippedRect.Ymin;y<clippedRect.Ymax;y++)
-	{
-		for(int32_t x=clippedRect.Xmin;x<clippedRect.Xmax;x++)
-		{
-			uint32_t offset=y*stride + x*4;
-			uint32_t* ptr=(uint32_t*)(getData()+offset);
-			if (useAlpha)
-				*ptr = color;
-			else
-				*ptr = 0xFF000000 | (color & 0xFFFFFF);
-		}
-	}
+		std::fill_n(getScanline(y)+clippedRect.Xmin, clippedRect.Xmax-clippedRect.Xmin, color);
 }
 
 bool BitmapContainer::scroll(int32_t x, int32_t y)
@@ -487,7 +453,7 @@ void BitmapContainer::clipRect(_R<BitmapContainer> source, const RECT& sourceRec
 	outputY = dTop;
 }
 
-std::vector<uint32_t> BitmapContainer::getPixelVector(const RECT& inputRect) const
+std::vector<uint32_t> BitmapContainer::getPixelVector(const RECT& inputRect, bool premultiplied) const
 {
 	RECT rect;
 	clipRect(inputRect, rect);
@@ -496,13 +462,16 @@ std::vector<uint32_t> BitmapContainer::getPixelVector(const RECT& inputRect) con
 	if ((rect.Xmax - rect.Xmin <= 0) || (rect.Ymax - rect.Ymin <= 0))
 		return result;
 
-	result.reserve((rect.Xmax - rect.Xmin)*(rect.Ymax - rect.Ymin));
+	int32_t rowWidth = rect.Xmax - rect.Xmin;
+	result.resize(rowWidth*(rect.Ymax - rect.Ymin));
+	uint32_t* dst = &result[0];
 	for (int32_t y=rect.Ymin; y<rect.Ymax; y++)
 	{
-		for (int32_t x=rect.Xmin; x<rect.Xmax; x++)
-		{
-			result.push_back(*getDataNoBoundsChecking(x, y));
-		}
+		if (premultiplied)
+			memcpy(dst, getScanline(y)+rect.Xmin, 4*rowWidth);
+		else
+			pixelToUnpremultipliedRow(getScanline(y)+rect.Xmin, dst, rowWidth);
+		dst += rowWidth;
 	}
 
 	return result;
@@ -75,7 +75,10 @@ public:
 	void setAlpha(int32_t x, int32_t y, uint8_t alpha);
 	void setPixel(int32_t x, int32_t y, uint32_t color, bool setAlpha, bool ispremultiplied=true);
 	uint32_t getPixel(int32_t x, int32_t y, bool premultiplied=true) const;
-	std::vector<uint32_t> getPixelVector(const RECT& rect) const;
+	std::vector<uint32_t> getPixelVector(const RECT& rect, bool premultiplied=true) const;
+	// returns the first pixel of row y, there is no bounds checking
+	uint32_t* getScanline(int32_t y) { return (uint32_t*)&data[y*stride]; }
+	const uint32_t* getScanline(int32_t y) const { return (const uint32_t*)&data[y*stride]; }
 	void copyRectangle(_R<BitmapContainer> source, 
 			   const RECT& sourceRect,
 			   int32_t destX, int32_t destY,
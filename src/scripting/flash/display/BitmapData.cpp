@@ -27,7 +27,8 @@
 #include "scripting/flash/utils/ByteArray.h"
 #include "scripting/flash/filters/flashfilters.h"
 #include "backends/rendering.h"
-#include "3rdparty/perlinnoise/PerlinNoise.hpp"
+#include "platforms/pixelkernels.h"
+#include "swf.h"
 
 #include <cstdlib> 
 
@@ -96,7 +97,7 @@ void BitmapData::sinit(Class_base* c)
 	c->setDeclaredMethodByQName("noise","",Class<IFunction>::getFunction(c->getSystemState(),noise),NORMAL_METHOD,true);
 	c->setDeclaredMethodByQName("perlinNoise","",Class<IFunction>::getFunction(c->getSystemState(),perlinNoise),NORMAL_METHOD,true);
 	c->setDeclaredMethodByQName("threshold","",Class<IFunction>::getFunction(c->getSystemState(),threshold),NORMAL_METHOD,true);
-	c->setDeclaredMethodByQName("merge","",Class<IFunction>::getFunction(c->getSystemState(),threshold),NORMAL_METHOD,true);
+	c->setDeclaredMethodByQName("merge","",Class<IFunction>::getFunction(c->getSystemState(),merge),NORMAL_METHOD,true);
 	c->setDeclaredMethodByQName("paletteMap","",Class<IFunction>::getFunction(c->getSystemState(),paletteMap),NORMAL_METHOD,true);
 	// properties
 	c->setDeclaredMethodByQName("height","",Class<IFunction>::getFunction(c->getSystemState(),_getHeight),GETTER_METHOD,true);
@@ -141,6 +142,44 @@ void BitmapData::notifyUsers() const
 		(*it)->updatedData();
 }
 
+/*
+ * The source region is copied before any row is stored, so source and this may be the same BitmapData
+ */
+template<class F>
+void BitmapData::forEachUnpremultipliedRow(BitmapData* source, const RECT& sourceRect, int32_t destX, int32_t destY, F f)
+{
+	RECT clippedSourceRect;
+	int32_t clippedDestX;
+	int32_t clippedDestY;
+	pixels->clipRect(source->pixels, sourceRect, destX, destY,
+			 clippedSourceRect, clippedDestX, clippedDestY);
+	int32_t regionWidth = clippedSourceRect.Xmax - clippedSourceRect.Xmin;
+	int32_t regionHeight = clippedSourceRect.Ymax - clippedSourceRect.Ymin;
+	if (regionWidth <= 0 || regionHeight <= 0)
+		return;
+
+	vector<uint32_t> sourcePixels = source->pixels->getPixelVector(clippedSourceRect, false);
+	vector<uint32_t> row(regionWidth);
+	for (int32_t y=0; y<regionHeight; y++)
+	{
+		pixelToUnpremultipliedRow(pixels->getScanline(clippedDestY+y)+clippedDestX, row.data(), regionWidth);
+		f(&sourcePixels[y*regionWidth], row.data(), regionWidth);
+		storeUnpremultipliedRow(row.data(), clippedDestX, clippedDestY+y, regionWidth);
+	}
+}
+
+void BitmapData::storeUnpremultipliedRow(const uint32_t* row, int32_t x, int32_t y, uint32_t count)
+{
+	uint32_t* dest = pixels->getScanline(y)+x;
+	if (transparent)
+		pixelToPremultipliedRow(row, dest, count);
+	else
+	{
+		for (uint32_t i=0; i<count; i++)
+			dest[i] = 0xFF000000 | row[i];
+	}
+}
+
 ASFUNCTIONBODY_ATOM(BitmapData,_constructor)
 {
 	int32_t width;
@@ -409,19 +448,7 @@ ASFUNCTIONBODY_ATOM(BitmapData,fillRect)
 		throwError<TypeError>(kNullPointerError, "rect");
 
 	if (th->transparent)
-	{
-		//premultiply alpha
-		uint32_t res = 0;
-		uint32_t alpha = ((color >> 24)&0xff);
-		if (alpha != 0xff)
-		{
-			res |= ((((color >> 0) &0xff) * alpha)&0xff) << 0;
-			res |= ((((color >> 8) &0xff) * alpha)&0xff) << 8;
-			res |= ((((color >> 16) &0xff) * alpha)&0xff) << 16;
-			res |= alpha<<24;
-			color = res;
-		}
-	}
+		pixelToPremultipliedRow(&color, &color, 1);
 	th->pixels->fillRectangle(rect->getRect(), color, th->transparent);
 	th->notifyUsers();
 }
@@ -457,13 +484,23 @@ ASFUNCTIONBODY_ATOM(BitmapData,copyPixels)
 
 ASFUNCTIONBODY_ATOM(BitmapData,generateFilterRect)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"BitmapData::generateFilterRect is just a stub");
 	BitmapData* th = asAtomHandler::as<BitmapData>(obj);
+	_NR<Rectangle> sourceRect;
+	_NR<BitmapFilter> filter;
+	ARG_UNPACK_ATOM (sourceRect)(filter);
 	if(th->pixels.isNull())
 		throw Class<ArgumentError>::getInstanceS(sys,"Disposed BitmapData", 2015);
+	if (sourceRect.isNull())
+		throwError<TypeError>(kNullPointerError, "sourceRect");
+	if (filter.isNull())
+		throwError<TypeError>(kNullPointerError, "filter");
+	number_t left,top,right,bottom;
+	filter->getMargins(left,top,right,bottom);
 	Rectangle *rect=Class<Rectangle>::getInstanceS(sys);
-	rect->width=th->pixels->getWidth();
-	rect->height=th->pixels->getHeight();
+	rect->x=sourceRect->x-ceil(left);
+	rect->y=sourceRect->y-ceil(top);
+	rect->width=sourceRect->width+ceil(left)+ceil(right);
+	rect->height=sourceRect->height+ceil(top)+ceil(bottom);
 	ret = asAtomHandler::fromObject(rect);
 }
 
@@ -601,39 +638,20 @@ ASFUNCTIONBODY_ATOM(BitmapData,copyChannel)
 	if (destPoint.isNull())
 		throwError<TypeError>(kNullPointerError, "destPoint");
 
+	if(source->pixels.isNull())
+		throw Class<ArgumentError>::getInstanceS(sys,"Disposed BitmapData", 2015);
+
 	unsigned int sourceShift = BitmapDataChannel::channelShift(sourceChannel);
 	unsigned int destShift = BitmapDataChannel::channelShift(destChannel);
-
-	RECT clippedSourceRect;
-	int32_t clippedDestX;
-	int32_t clippedDestY;
-	th->pixels->clipRect(source->pixels, sourceRect->getRect(),
-				 destPoint->getX(), destPoint->getY(),
-				 clippedSourceRect, clippedDestX, clippedDestY);
-	int regionWidth = clippedSourceRect.Xmax - clippedSourceRect.Xmin;
-	int regionHeight = clippedSourceRect.Ymax - clippedSourceRect.Ymin;
-
-	if (regionWidth < 0 || regionHeight < 0)
+	// the alpha channel of opaque bitmaps can't be changed
+	if (!th->transparent && destShift == 24)
 		return;
 
-	uint32_t constantChannelsMask = ~(0xFF << destShift);
-	for (int32_t y=0; y<regionHeight; y++)
-	{
-		for (int32_t x=0; x<regionWidth; x++)
+	th->forEachUnpremultipliedRow(source.getPtr(), sourceRect->getRect(), destPoint->getX(), destPoint->getY(),
+		[sourceShift, destShift](const uint32_t* src, uint32_t* dst, uint32_t count)
 		{
-			int32_t sx = clippedSourceRect.Xmin+x;
-			int32_t sy = clippedSourceRect.Ymin+y;
-			uint32_t sourcePixel = source->pixels->getPixel(sx, sy,false);
-			uint32_t channel = (sourcePixel >> sourceShift) & 0xFF;
-			int32_t dx = clippedDestX + x;
-			int32_t dy = clippedDestY + y;
-			uint32_t oldPixel = th->pixels->getPixel(dx, dy,sourceChannel == BitmapDataChannel::ALPHA);
-			uint32_t destChannelValue = channel << destShift;
-
-			uint32_t newColor = ((oldPixel & constantChannelsMask) | destChannelValue);
-			th->pixels->setPixel(dx, dy, newColor, true,sourceChannel == BitmapDataChannel::ALPHA);
-		}
-	}
+			pixelCopyChannelRow(src, dst, count, sourceShift, destShift);
+		});
 
 	th->notifyUsers();
 }
@@ -787,7 +805,7 @@ ASFUNCTIONBODY_ATOM(BitmapData,getPixels)
 		throwError<TypeError>(kNullPointerError, "rect");
 
 	ByteArray *ba = Class<ByteArray>::getInstanceS(sys);
-	vector<uint32_t> pixelvec = th->pixels->getPixelVector(rect->getRect());
+	vector<uint32_t> pixelvec = th->pixels->getPixelVector(rect->getRect(), false);
 	vector<uint32_t>::const_iterator it;
 	for (it=pixelvec.begin(); it!=pixelvec.end(); ++it)
 		ba->writeUnsignedInt(ba->endianIn(*it));
@@ -809,7 +827,7 @@ ASFUNCTIONBODY_ATOM(BitmapData,getVector)
 	asAtom v=asAtomHandler::invalidAtom;
 	Template<Vector>::getInstanceS(v,sys,Class<UInteger>::getClass(sys),NullRef);
 	Vector *result = asAtomHandler::as<Vector>(v);
-	vector<uint32_t> pixelvec = th->pixels->getPixelVector(rect->getRect());
+	vector<uint32_t> pixelvec = th->pixels->getPixelVector(rect->getRect(), false);
 	vector<uint32_t>::const_iterator it;
 	for (it=pixelvec.begin(); it!=pixelvec.end(); ++it)
 	{
@@ -836,17 +854,24 @@ ASFUNCTIONBODY_ATOM(BitmapData,setPixels)
 
 	RECT rect;
 	th->pixels->clipRect(inputRect->getRect(), rect);
+	if (rect.Xmax <= rect.Xmin)
+		return;
 
+	vector<uint32_t> row(rect.Xmax-rect.Xmin);
 	for (int32_t y=rect.Ymin; y<rect.Ymax; y++)
 	{
-		for (int32_t x=rect.Xmin; x<rect.Xmax; x++)
+		for (uint32_t i=0; i<row.size(); i++)
 		{
-			uint32_t pixel;
-			if (!inputByteArray->readUnsignedInt(pixel))
+			if (!inputByteArray->readUnsignedInt(row[i]))
+			{
+				th->storeUnpremultipliedRow(row.data(), rect.Xmin, y, i);
+				th->notifyUsers();
 				throwError<EOFError>(kEOFError);
-			th->pixels->setPixel(x, y, pixel, th->transparent);
+			}
 		}
+		th->storeUnpremultipliedRow(row.data(), rect.Xmin, y, row.size());
 	}
+	th->notifyUsers();
 }
 
 ASFUNCTIONBODY_ATOM(BitmapData,setVector)
@@ -867,20 +892,29 @@ ASFUNCTIONBODY_ATOM(BitmapData,setVector)
 	RECT rect;
 	th->pixels->clipRect(inputRect->getRect(), rect);
 
+	if (rect.Xmax <= rect.Xmin)
+		return;
+
+	vector<uint32_t> row(rect.Xmax-rect.Xmin);
 	unsigned int i = 0;
 	for (int32_t y=rect.Ymin; y<rect.Ymax; y++)
 	{
-		for (int32_t x=rect.Xmin; x<rect.Xmax; x++)
+		for (uint32_t x=0; x<row.size(); x++)
 		{
 			if (i >= inputVector->size())
+			{
+				th->storeUnpremultipliedRow(row.data(), rect.Xmin, y, x);
+				th->notifyUsers();
 				throwError<RangeError>(kParamRangeError);
+			}
 
 			asAtom v = inputVector->at(i);
-			uint32_t pixel = asAtomHandler::toUInt(v);
-			th->pixels->setPixel(x, y, pixel, th->transparent);
+			row[x] = asAtomHandler::toUInt(v);
 			i++;
 		}
+		th->storeUnpremultipliedRow(row.data(), rect.Xmin, y, row.size());
 	}
+	th->notifyUsers();
 }
 
 ASFUNCTIONBODY_ATOM(BitmapData,colorTransform)
@@ -898,37 +932,23 @@ ASFUNCTIONBODY_ATOM(BitmapData,colorTransform)
 
 	RECT rect;
 	th->pixels->clipRect(inputRect->getRect(), rect);
-	
-	vector<uint32_t> pixelvec = th->pixels->getPixelVector(rect);
+	if (rect.Xmax <= rect.Xmin)
+		return;
 
-	unsigned int i = 0;
+	// the color transform is a diagonal color matrix, channels are in the order b,g,r,a
+	float matrix[16] = {0};
+	matrix[0] = inputColorTransform->blueMultiplier;
+	matrix[5] = inputColorTransform->greenMultiplier;
+	matrix[10] = inputColorTransform->redMultiplier;
+	matrix[15] = th->transparent ? inputColorTransform->alphaMultiplier : 1.0;
+	float offsets[4] = { float(inputColorTransform->blueOffset), float(inputColorTransform->greenOffset),
+			     float(inputColorTransform->redOffset), th->transparent ? float(inputColorTransform->alphaOffset) : 0.0f };
 	for (int32_t y=rect.Ymin; y<rect.Ymax; y++)
 	{
-		for (int32_t x=rect.Xmin; x<rect.Xmax; x++)
-		{
-
-			uint32_t pixel = pixelvec[i];
-
-			int a, r, g, b;
-			a = ((pixel >> 24 )&0xff) * inputColorTransform->alphaMultiplier + inputColorTransform->alphaOffset;
-			if (a > 255) a = 255;
-			if (a < 0) a = 0;
-			r = ((pixel >> 16 )&0xff) * inputColorTransform->redMultiplier + inputColorTransform->redOffset;
-			if (r > 255) r = 255;
-			if (r < 0) r = 0;
-			g = ((pixel >> 8 )&0xff) * inputColorTransform->greenMultiplier + inputColorTransform->greenOffset;
-			if (g > 255) g = 255;
-			if (g < 0) g = 0;
-			b = ((pixel )&0xff) * inputColorTransform->blueMultiplier + inputColorTransform->blueOffset;
-			if (b > 255) b = 255;
-			if (b < 0) b = 0;
-			
-			pixel = (a<<24) | (r<<16) | (g<<8) | b;
-			
-			th->pixels->setPixel(x, y, pixel, th->transparent);
-			i++;
-		}
+		uint32_t* row = th->pixels->getScanline(y)+rect.Xmin;
+		pixelColorMatrixRow(row, row, rect.Xmax-rect.Xmin, matrix, offsets);
 	}
+	th->notifyUsers();
 }
 ASFUNCTIONBODY_ATOM(BitmapData,compare)
 {
@@ -956,48 +976,81 @@ ASFUNCTIONBODY_ATOM(BitmapData,compare)
 	rect.Ymin = 0;
 	rect.Ymax = th->getHeight();
 	
-	vector<uint32_t> pixelvec = th->pixels->getPixelVector(rect);
-	vector<uint32_t> otherpixelvec = otherBitmapData->pixels->getPixelVector(rect);
-	
+	vector<uint32_t> pixelvec = th->pixels->getPixelVector(rect, false);
+	vector<uint32_t> otherpixelvec = otherBitmapData->pixels->getPixelVector(rect, false);
+	if (pixelvec.empty())
+	{
+		asAtomHandler::setInt(ret,sys,0);
+		return;
+	}
+
 	BitmapData* res = Class<BitmapData>::getInstanceS(sys,rect.Xmax,rect.Ymax);
-	unsigned int i = 0;
 	bool different = false;
 	for (int32_t y=rect.Ymin; y<rect.Ymax; y++)
 	{
-		for (int32_t x=rect.Xmin; x<rect.Xmax; x++)
-		{
-
-			uint32_t pixel = pixelvec[i];
-			uint32_t otherpixel = otherpixelvec[i];
-			if (pixel == otherpixel)
-				res->pixels->setPixel(x, y, 0, true);
-			else if ((pixel & 0x00FFFFFF) == (otherpixel & 0x00FFFFFF))
-			{
-				different = true;
-				res->pixels->setPixel(x, y, ((pixel & 0xFF000000) - (otherpixel & 0xFF000000)) | 0x00FFFFFF , true);
-			}
-			else 
-			{
-				different = true;
-				res->pixels->setPixel(x, y, ((pixel & 0x00FFFFFF) - (otherpixel & 0x00FFFFFF)), true);
-			}
-			i++;
-		}
+		uint32_t* row = res->pixels->getScanline(y);
+		different |= pixelCompareRow(&pixelvec[y*rect.Xmax], &otherpixelvec[y*rect.Xmax], row, rect.Xmax);
+		pixelToPremultipliedRow(row, row, rect.Xmax);
 	}
 	if (!different)
+	{
+		res->decRef();
 		asAtomHandler::setInt(ret,sys,0);
+	}
 	else
 		ret = asAtomHandler::fromObject(res);
 }
 
 ASFUNCTIONBODY_ATOM(BitmapData,applyFilter)
 {
+	BitmapData* th = asAtomHandler::as<BitmapData>(obj);
 	_NR<BitmapData> sourceBitmapData;
 	_NR<Rectangle> sourceRect;
 	_NR<Point> destPoint;
 	_NR<BitmapFilter> filter;
 	ARG_UNPACK_ATOM (sourceBitmapData)(sourceRect)(destPoint)(filter);
-	LOG(LOG_NOT_IMPLEMENTED,"BitmapData.applyFilter not implemented");
+	if(th->pixels.isNull())
+		throw Class<ArgumentError>::getInstanceS(sys,"Disposed BitmapData", 2015);
+	if (sourceBitmapData.isNull())
+		throwError<TypeError>(kNullPointerError, "sourceBitmapData");
+	if (sourceRect.isNull())
+		throwError<TypeError>(kNullPointerError, "sourceRect");
+	if (destPoint.isNull())
+		throwError<TypeError>(kNullPointerError, "destPoint");
+	if (filter.isNull())
+		throwError<TypeError>(kNullPointerError, "filter");
+	if(sourceBitmapData->pixels.isNull())
+		throw Class<ArgumentError>::getInstanceS(sys,"Disposed BitmapData", 2015);
+
+	// the filter works on the source rectangle grown by the area the filter may draw on,
+	// pixels outside of the source rectangle are transparent
+	number_t left,top,right,bottom;
+	filter->getMargins(left,top,right,bottom);
+	RECT rect=sourceRect->getRect();
+	int32_t marginLeft=ceil(left);
+	int32_t marginTop=ceil(top);
+	int32_t width=rect.Xmax-rect.Xmin+marginLeft+int32_t(ceil(right));
+	int32_t height=rect.Ymax-rect.Ymin+marginTop+int32_t(ceil(bottom));
+	if (width<=0 || height<=0)
+		return;
+	vector<uint32_t> buffer(width*height,0);
+	RECT clippedSource;
+	sourceBitmapData->pixels->clipRect(rect,clippedSource);
+	int32_t copyWidth=clippedSource.Xmax-clippedSource.Xmin;
+	for (int32_t y=clippedSource.Ymin;y<clippedSource.Ymax && copyWidth>0;y++)
+		memcpy(&buffer[(y-rect.Ymin+marginTop)*width+clippedSource.Xmin-rect.Xmin+marginLeft],
+		       sourceBitmapData->pixels->getScanline(y)+clippedSource.Xmin,4*copyWidth);
+	filter->applyFilter(buffer.data(),width,height,1.0,1.0);
+	// only the destination rectangle is written, what the filter drew on the margins is dropped
+	int32_t destX=destPoint->getX();
+	int32_t destY=destPoint->getY();
+	RECT clippedDest;
+	th->pixels->clipRect(RECT(destX,destX+rect.Xmax-rect.Xmin,destY,destY+rect.Ymax-rect.Ymin),clippedDest);
+	copyWidth=clippedDest.Xmax-clippedDest.Xmin;
+	for (int32_t y=clippedDest.Ymin;y<clippedDest.Ymax && copyWidth>0;y++)
+		memcpy(th->pixels->getScanline(y)+clippedDest.Xmin,
+		       &buffer[(y-destY+marginTop)*width+clippedDest.Xmin-destX+marginLeft],4*copyWidth);
+	th->notifyUsers();
 }
 
 ASFUNCTIONBODY_ATOM(BitmapData,noise)
@@ -1012,37 +1065,59 @@ ASFUNCTIONBODY_ATOM(BitmapData,noise)
 	unsigned int channelOptions;
 	bool grayScale;
 	ARG_UNPACK_ATOM(randomSeed)(low, 0) (high, 255) (channelOptions, 7) (grayScale, false);
-	
-	srand(randomSeed);
 
-	uint32_t range = high-low;
+	low = min(low, 255U);
+	high = min(high, 255U);
+	uint32_t range = high >= low ? high-low+1 : 1;
+	int32_t width = th->getWidth();
 
-	for (int32_t x=0; x<th->getWidth(); x++)
+	// every row has its own generator, so the result doesn't depend on the order the rows are computed in
+	sys->runParallel(th->getHeight(), [th, randomSeed, low, range, channelOptions, grayScale, width](uint32_t y)
 	{
-		for (int32_t y=0; y<th->getHeight(); y++)
+		uint32_t state = uint32_t(randomSeed)*0x9E3779B9 ^ (y+1)*0x85EBCA6B;
+		auto next = [&state, low, range]()
 		{
-			uint32_t pixel = 0x000000ff;
-			
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return (state % range) + low;
+		};
+		if (state == 0)
+			state = 0x6D2B79F5;
+		vector<uint32_t> row(width);
+		for (int32_t x=0; x<width; x++)
+		{
+			uint32_t pixel;
 			if (grayScale)
 			{
-				uint8_t v = (rand() % range + low) & 0xff;
-				pixel |= v<<24 | v<<16 | v<<8;
+				uint32_t v = next();
+				pixel = v<<16 | v<<8 | v;
 			}
 			else
 			{
-				if((channelOptions & 0x1) == 0x1) // R
-					pixel |= ((rand() % range + low) & 0xff)<<24;
-				if((channelOptions & 0x2) == 0x2) // G
-					pixel |= ((rand() % range + low) & 0xff)<<16;
-				if((channelOptions & 0x4) == 0x4) // B
-					pixel |= ((rand() % range + low) & 0xff)<<8;
-				if((channelOptions & 0x8) == 0x8) // A
-					pixel |= ((rand() % range + low) & 0xff);
+				pixel = 0;
+				if(channelOptions & BitmapDataChannel::RED)
+					pixel |= next()<<16;
+				if(channelOptions & BitmapDataChannel::GREEN)
+					pixel |= next()<<8;
+				if(channelOptions & BitmapDataChannel::BLUE)
+					pixel |= next();
 			}
-			th->pixels->setPixel(x, y,pixel,true,true);
+			if(channelOptions & BitmapDataChannel::ALPHA)
+				pixel |= next()<<24;
+			else
+				pixel |= 0xFF000000;
+			row[x] = pixel;
 		}
-	}
+		th->storeUnpremultipliedRow(row.data(), 0, y, width);
+	});
+	th->notifyUsers();
 }
+
+/*
+ * Implements the turbulence function of the SVG feTurbulence filter, which is what Flash uses.
+ * Each channel is computed one octave at a time over a whole row with pixelNoiseRow
+ */
 ASFUNCTIONBODY_ATOM(BitmapData,perlinNoise)
 {
 	BitmapData* th = asAtomHandler::as<BitmapData>(obj);
@@ -1060,55 +1135,122 @@ ASFUNCTIONBODY_ATOM(BitmapData,perlinNoise)
 	_NR<Array> offsets;
 	ARG_UNPACK_ATOM(baseX)(baseY)(numOctaves)(randomSeed)(stitch) (fractalNoise) (channelOptions, 7) (grayScale, false) (offsets, NullRef);
 
+	int32_t width = th->getWidth();
+	int32_t height = th->getHeight();
+	number_t freqX = baseX != 0 ? 1.0/baseX : 0;
+	number_t freqY = baseY != 0 ? 1.0/baseY : 0;
+
+	PixelNoiseStitch stitchInfo;
 	if (stitch)
-		LOG(LOG_NOT_IMPLEMENTED,"perlinNoise: parameter stitch is ignored");
-	if (fractalNoise)
-		LOG(LOG_NOT_IMPLEMENTED,"perlinNoise: parameter fractalNoise is ignored");
-	if (!offsets.isNull())
-		LOG(LOG_NOT_IMPLEMENTED,"perlinNoise: parameter offsets is ignored");
+	{
+		// the frequencies are adjusted to get an integral number of lattice cells over the bitmap
+		auto adjust = [](number_t freq, int32_t size)
+		{
+			if (freq == 0)
+				return freq;
+			number_t lo = floor(size*freq)/size;
+			number_t hi = ceil(size*freq)/size;
+			return (lo != 0 && freq/lo < hi/freq) ? lo : hi;
+		};
+		freqX = adjust(freqX, width);
+		freqY = adjust(freqY, height);
+		stitchInfo.width = int32_t(width*freqX+0.5);
+		stitchInfo.wrapX = 4096+stitchInfo.width;
+		stitchInfo.height = int32_t(height*freqY+0.5);
+		stitchInfo.wrapY = 4096+stitchInfo.height;
+	}
 
-	const siv::PerlinNoise perlin(randomSeed);
-	for (int32_t x=0; x<th->getWidth(); x++)
+	struct Octave
 	{
-		for (int32_t y=0; y<th->getHeight(); y++)
+		number_t offsetX;
+		number_t offsetY;
+		PixelNoiseStitch stitch;
+	};
+	vector<Octave> octaves(numOctaves);
+	for (uint32_t i=0; i<numOctaves; i++)
+	{
+		Octave& o = octaves[i];
+		o.offsetX = 0;
+		o.offsetY = 0;
+		if (!offsets.isNull() && i < offsets->size())
 		{
-			uint32_t pixel = 0x000000ff;
-			number_t v1 = perlin.octaveNoise0_1(x / baseX, y / baseY, numOctaves);
-			if (grayScale)
+			asAtom p = offsets->at(i);
+			if (asAtomHandler::is<Point>(p))
 			{
-				uint8_t v = v1 >= 1.0 ? 255 : v1 <= 0.0 ? 0 : static_cast<std::uint8_t>(v1 * 255.0 + 0.5);
-				pixel |= v<<24 | v<<16 | v<<8;
+				o.offsetX = asAtomHandler::as<Point>(p)->getX();
+				o.offsetY = asAtomHandler::as<Point>(p)->getY();
 			}
-			else
+		}
+		o.stitch = stitchInfo;
+		if (stitch)
+		{
+			stitchInfo.width *= 2;
+			stitchInfo.wrapX = 2*stitchInfo.wrapX-4096;
+			stitchInfo.height *= 2;
+			stitchInfo.wrapY = 2*stitchInfo.wrapY-4096;
+		}
+	}
+
+	// noise channel used for every destination channel (b,g,r,a), -1 if the channel is not generated
+	int32_t channels[4] = { -1, -1, -1, -1 };
+	uint32_t noiseChannels = 0;
+	if (grayScale)
+		channels[0] = channels[1] = channels[2] = noiseChannels++;
+	else
+	{
+		if (channelOptions & BitmapDataChannel::RED)
+			channels[2] = noiseChannels++;
+		if (channelOptions & BitmapDataChannel::GREEN)
+			channels[1] = noiseChannels++;
+		if (channelOptions & BitmapDataChannel::BLUE)
+			channels[0] = noiseChannels++;
+	}
+	if ((channelOptions & BitmapDataChannel::ALPHA) && th->transparent)
+		channels[3] = noiseChannels++;
+
+	const PixelNoiseLattice lattice(randomSeed);
+	sys->runParallel(height, [&](uint32_t y)
+	{
+		vector<number_t> sums(noiseChannels*width, 0);
+		for (uint32_t c=0; c<noiseChannels; c++)
+		{
+			// every octave doubles the frequency and halves the contribution
+			number_t scale = 1;
+			for (uint32_t i=0; i<numOctaves; i++)
 			{
-				if((channelOptions & 0x1) == 0x1) // R
-				{
-					uint32_t v = v1 >= 1.0 ? 255 : v1 <= 0.0 ? 0 : static_cast<std::uint32_t>(v1 * UINT32_MAX + 0.5);
-					pixel |= v&0xff000000;
-				}
-				if((channelOptions & 0x2) == 0x2) // G
-				{
-					uint32_t v = v1 >= 1.0 ? 255 : v1 <= 0.0 ? 0 : static_cast<std::uint32_t>(v1 * UINT32_MAX + 0.5);
-					pixel |= v&0x00ff0000;
-				}
-				if((channelOptions & 0x4) == 0x4) // B
-				{
-					uint32_t v = v1 >= 1.0 ? 255 : v1 <= 0.0 ? 0 : static_cast<std::uint32_t>(v1 * UINT32_MAX + 0.5);
-					pixel |= v&0x0000ff00;
-				}
-				if((channelOptions & 0x8) == 0x8) // A
+				const Octave& o = octaves[i];
+				pixelNoiseRow(lattice, c, o.offsetX*freqX/scale, freqX/scale, (y+o.offsetY)*freqY/scale,
+					      stitch ? &o.stitch : nullptr, !fractalNoise, scale, &sums[c*width], width);
+				scale *= 0.5;
+			}
+		}
+		vector<uint32_t> row(width);
+		for (int32_t x=0; x<width; x++)
+		{
+			uint32_t pixel = 0;
+			for (uint32_t c=0; c<4; c++)
+			{
+				uint32_t v = c == 3 ? 0xff : 0;
+				if (channels[c] >= 0)
 				{
-					uint32_t v = v1 >= 1.0 ? 255 : v1 <= 0.0 ? 0 : static_cast<std::uint32_t>(v1 * UINT32_MAX + 0.5);
-					pixel |= v&0x000000ff;
+					number_t n = sums[channels[c]*width+x];
+					n = fractalNoise ? (n*255+255)/2 : n*255;
+					v = n >= 255 ? 255 : n <= 0 ? 0 : uint32_t(n);
 				}
+				pixel |= v << (c*8);
 			}
-			th->pixels->setPixel(x, y,pixel,true,true);
-			//LOG(LOG_INFO,"perlinnoise pixel:"<<x<<" "<<y<<" "<<hex<<th->pixels->getPixel(x,y)<<" "<<grayScale);
+			row[x] = pixel;
 		}
-	}
+		th->storeUnpremultipliedRow(row.data(), 0, y, width);
+	});
+	th->notifyUsers();
 }
 ASFUNCTIONBODY_ATOM(BitmapData,threshold)
 {
+	BitmapData* th = asAtomHandler::as<BitmapData>(obj);
+	if(th->pixels.isNull())
+		throw Class<ArgumentError>::getInstanceS(sys,"Disposed BitmapData", 2015);
+
 	_NR<BitmapData> sourceBitmapData;
 	_NR<Rectangle> sourceRect;
 	_NR<Point> destPoint;
@@ -1119,10 +1261,47 @@ ASFUNCTIONBODY_ATOM(BitmapData,threshold)
 	bool copySource;
 	ARG_UNPACK_ATOM(sourceBitmapData)(sourceRect)(destPoint)(operation)(threshold) (color,0) (mask, 0xFFFFFFFF) (copySource, false);
 
-	LOG(LOG_NOT_IMPLEMENTED,"BitmapData.threshold not implemented");
+	if (sourceBitmapData.isNull())
+		throwError<TypeError>(kNullPointerError, "sourceBitmapData");
+	if (sourceRect.isNull())
+		throwError<TypeError>(kNullPointerError, "sourceRect");
+	if (destPoint.isNull())
+		throwError<TypeError>(kNullPointerError, "destPoint");
+	if(sourceBitmapData->pixels.isNull())
+		throw Class<ArgumentError>::getInstanceS(sys,"Disposed BitmapData", 2015);
+
+	PIXEL_THRESHOLD_OP op;
+	if (operation == "<")
+		op = THRESHOLD_LESS;
+	else if (operation == "<=")
+		op = THRESHOLD_LESS_EQUAL;
+	else if (operation == ">")
+		op = THRESHOLD_GREATER;
+	else if (operation == ">=")
+		op = THRESHOLD_GREATER_EQUAL;
+	else if (operation == "==")
+		op = THRESHOLD_EQUAL;
+	else if (operation == "!=")
+		op = THRESHOLD_NOT_EQUAL;
+	else
+		throwError<ArgumentError>(kInvalidArgumentError, "operation");
+
+	uint32_t matched = 0;
+	th->forEachUnpremultipliedRow(sourceBitmapData.getPtr(), sourceRect->getRect(), destPoint->getX(), destPoint->getY(),
+		[&](const uint32_t* src, uint32_t* dst, uint32_t count)
+		{
+			matched += pixelThresholdRow(src, dst, count, op, threshold, color, mask, copySource);
+		});
+
+	th->notifyUsers();
+	asAtomHandler::setUInt(ret,sys,matched);
 }
 ASFUNCTIONBODY_ATOM(BitmapData,merge)
 {
+	BitmapData* th = asAtomHandler::as<BitmapData>(obj);
+	if(th->pixels.isNull())
+		throw Class<ArgumentError>::getInstanceS(sys,"Disposed BitmapData", 2015);
+
 	_NR<BitmapData> sourceBitmapData;
 	_NR<Rectangle> sourceRect;
 	_NR<Point> destPoint;
@@ -1132,11 +1311,30 @@ ASFUNCTIONBODY_ATOM(BitmapData,merge)
 	uint32_t alphaMultiplier;
 	ARG_UNPACK_ATOM(sourceBitmapData)(sourceRect) (destPoint) (redMultiplier) (greenMultiplier) (blueMultiplier) (alphaMultiplier);
 
-	LOG(LOG_NOT_IMPLEMENTED,"BitmapData.merge not implemented");
+	if (sourceBitmapData.isNull())
+		throwError<TypeError>(kNullPointerError, "sourceBitmapData");
+	if (sourceRect.isNull())
+		throwError<TypeError>(kNullPointerError, "sourceRect");
+	if (destPoint.isNull())
+		throwError<TypeError>(kNullPointerError, "destPoint");
+	if(sourceBitmapData->pixels.isNull())
+		throw Class<ArgumentError>::getInstanceS(sys,"Disposed BitmapData", 2015);
+
+	uint32_t multipliers[4] = { min(blueMultiplier, 256U), min(greenMultiplier, 256U),
+				    min(redMultiplier, 256U), min(alphaMultiplier, 256U) };
+	th->forEachUnpremultipliedRow(sourceBitmapData.getPtr(), sourceRect->getRect(), destPoint->getX(), destPoint->getY(),
+		[&multipliers](const uint32_t* src, uint32_t* dst, uint32_t count)
+		{
+			pixelMergeRow(src, dst, count, multipliers);
+		});
+
+	th->notifyUsers();
 }
 ASFUNCTIONBODY_ATOM(BitmapData,paletteMap)
 {
-//	BitmapData* th = asAtomHandler::as<BitmapData>(obj);
+	BitmapData* th = asAtomHandler::as<BitmapData>(obj);
+	if(th->pixels.isNull())
+		throw Class<ArgumentError>::getInstanceS(sys,"Disposed BitmapData", 2015);
 
 	_NR<BitmapData> sourceBitmapData;
 	_NR<Rectangle> sourceRect;
@@ -1147,6 +1345,39 @@ ASFUNCTIONBODY_ATOM(BitmapData,paletteMap)
 	_NR<Array> alphaArray;
 	ARG_UNPACK_ATOM(sourceBitmapData)(sourceRect) (destPoint) (redArray, NullRef) (greenArray, NullRef) (blueArray, NullRef) (alphaArray, NullRef);
 
-	LOG(LOG_NOT_IMPLEMENTED,"BitmapData.paletteMap not implemented");
+	if (sourceBitmapData.isNull())
+		throwError<TypeError>(kNullPointerError, "sourceBitmapData");
+	if (sourceRect.isNull())
+		throwError<TypeError>(kNullPointerError, "sourceRect");
+	if (destPoint.isNull())
+		throwError<TypeError>(kNullPointerError, "destPoint");
+	if(sourceBitmapData->pixels.isNull())
+		throw Class<ArgumentError>::getInstanceS(sys,"Disposed BitmapData", 2015);
+
+	// channels without an array are copied unchanged
+	vector<uint32_t> tables(4*256);
+	Array* arrays[4] = { blueArray.getPtr(), greenArray.getPtr(), redArray.getPtr(), alphaArray.getPtr() };
+	for (uint32_t c=0; c<4; c++)
+	{
+		for (uint32_t i=0; i<256; i++)
+		{
+			if (arrays[c] == nullptr)
+				tables[c*256+i] = i << (c*8);
+			else if (i < arrays[c]->size())
+			{
+				asAtom v = arrays[c]->at(i);
+				tables[c*256+i] = asAtomHandler::toUInt(v);
+			}
+			else
+				tables[c*256+i] = 0;
+		}
+	}
+	th->forEachUnpremultipliedRow(sourceBitmapData.getPtr(), sourceRect->getRect(), destPoint->getX(), destPoint->getY(),
+		[&tables](const uint32_t* src, uint32_t* dst, uint32_t count)
+		{
+			pixelPaletteMapRow(src, dst, count, tables.data());
+		});
+
+	th->notifyUsers();
 }
 
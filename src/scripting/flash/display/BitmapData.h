@@ -39,6 +39,14 @@ private:
 	//Bitmap will take care of removing itself when needed
 	std::set<Bitmap*> users;
 	void notifyUsers() const;
+	/*
+	 * Calls f(sourceRow, destRow, width) for every row of the region of source copied to destX,destY.
+	 * Both rows contain unpremultiplied pixels, destRow is stored afterwards
+	 */
+	template<class F>
+	void forEachUnpremultipliedRow(BitmapData* source, const RECT& sourceRect, int32_t destX, int32_t destY, F f);
+	// stores count unpremultiplied pixels starting at x,y, the alpha channel is ignored for opaque bitmaps
+	void storeUnpremultipliedRow(const uint32_t* row, int32_t x, int32_t y, uint32_t count);
 public:
 	BitmapData(Class_base* c);
 	BitmapData(Class_base* c, _R<BitmapContainer> b);
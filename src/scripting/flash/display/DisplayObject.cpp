@@ -27,6 +27,7 @@
 #include "scripting/flash/geom/flashgeom.h"
 #include "scripting/flash/accessibility/flashaccessibility.h"
 #include "scripting/flash/display/BitmapData.h"
+#include "scripting/flash/filters/flashfilters.h"
 #include "scripting/flash/geom/flashgeom.h"
 #include <algorithm>
 
@@ -98,7 +99,7 @@ bool DisplayObject::Render(RenderContext& ctxt, bool force)
 
 DisplayObject::DisplayObject(Class_base* c):EventDispatcher(c),matrix(Class<Matrix>::getInstanceS(c->getSystemState())),tx(0),ty(0),rotation(0),
 	sx(1),sy(1),alpha(1.0),blendMode(BLENDMODE_NORMAL),isLoadedRoot(false),ClipDepth(0),maskOf(),parent(nullptr),constructed(false),useLegacyMatrix(true),
-	needsTextureRecalculation(true),textureRecalculationSkippable(false),onStage(false),
+	needsTextureRecalculation(true),textureRecalculationSkippable(false),filtersChanged(false),onStage(false),
 	visible(true),mask(),invalidateQueueNext(),loaderInfo(),loadedFrom(c->getSystemState()->mainClip),hasChanged(true),legacy(false),cacheAsBitmap(false),
 	name(BUILTIN_STRINGS::EMPTY)
 {
@@ -157,6 +158,7 @@ bool DisplayObject::destruct()
 	onStage=false;
 	visible=true;
 	filters.reset();
+	filtersChanged=false;
 	legacy=false;
 	cacheAsBitmap=false;
 	name=BUILTIN_STRINGS::EMPTY;
@@ -234,7 +236,6 @@ ASFUNCTIONBODY_GETTER_SETTER_STRINGID(DisplayObject,name);
 ASFUNCTIONBODY_GETTER_SETTER(DisplayObject,accessibilityProperties);
 //TODO: Use a callback for the cacheAsBitmap getter, since it should use computeCacheAsBitmap
 ASFUNCTIONBODY_GETTER_SETTER(DisplayObject,cacheAsBitmap);
-ASFUNCTIONBODY_SETTER(DisplayObject,filters);
 ASFUNCTIONBODY_GETTER_SETTER(DisplayObject,scrollRect);
 ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(DisplayObject, rotationX);
 ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(DisplayObject, rotationY);
@@ -253,6 +254,50 @@ ASFUNCTIONBODY_ATOM(DisplayObject,_getter_filters)
 	th->filters->incRef();
 	ret = asAtomHandler::fromObject(th->filters.getPtr());
 }
+ASFUNCTIONBODY_ATOM(DisplayObject,_setter_filters)
+{
+	if(!asAtomHandler::is<DisplayObject>(obj))
+		throw Class<ArgumentError>::getInstanceS(sys,"Function applied to wrong object");
+	if(argslen != 1)
+		throw Class<ArgumentError>::getInstanceS(sys,"Wrong number of arguments in setter");
+	DisplayObject* th=asAtomHandler::as<DisplayObject>(obj);
+	th->filters = ArgumentConversionAtom<_NR<Array>>::toConcrete(sys,args[0],th->filters);
+	// filter objects may have been modified, so the object is always rendered again, even if the same array is assigned
+	th->filtersChanged=true;
+	th->hasChanged=true;
+	if(th->onStage)
+		th->requestInvalidation(sys);
+}
+void DisplayObject::cloneFilters(std::vector<BitmapFilter*>& result) const
+{
+	if (filters.isNull())
+		return;
+	for (uint32_t i = 0; i < filters->size(); i++)
+	{
+		asAtom f = filters->at(i);
+		if (asAtomHandler::is<BitmapFilter>(f))
+			result.push_back(asAtomHandler::as<BitmapFilter>(f)->cloneFilter());
+	}
+}
+bool DisplayObject::getFilterMargins(number_t& left, number_t& top, number_t& right, number_t& bottom) const
+{
+	left=top=right=bottom=0;
+	if (filters.isNull())
+		return false;
+	for (uint32_t i = 0; i < filters->size(); i++)
+	{
+		asAtom f = filters->at(i);
+		if (!asAtomHandler::is<BitmapFilter>(f))
+			continue;
+		number_t l,t,r,b;
+		asAtomHandler::as<BitmapFilter>(f)->getMargins(l,t,r,b);
+		left+=l;
+		top+=t;
+		right+=r;
+		bottom+=b;
+	}
+	return left > 0 || top > 0 || right > 0 || bottom > 0;
+}
 bool DisplayObject::computeCacheAsBitmap() const
 {
 	return cacheAsBitmap || (!filters.isNull() && filters->size()!=0);
@@ -510,7 +555,8 @@ bool DisplayObject::defaultRender(RenderContext& ctxt) const
 	ctxt.renderTextured(*surface.tex, surface.xOffset,surface.yOffset,
 			surface.tex->width, surface.tex->height,
 			surface.alpha, RenderContext::RGB_MODE,
-			surface.rotation,surface.xOffsetTransformed,surface.yOffsetTransformed,surface.widthTransformed,surface.heightTransformed,surface.xscale, surface.yscale,
+			surface.rotation,surface.xOffsetTransformed,surface.yOffsetTransformed,surface.widthTransformed,surface.heightTransformed,
+			surface.xscale/surface.rasterScale, surface.yscale/surface.rasterScale,
 			surface.redMultiplier, surface.greenMultiplier, surface.blueMultiplier, surface.alphaMultiplier,
 			surface.redOffset, surface.greenOffset, surface.blueOffset, surface.alphaOffset,
 			surface.isMask, surface.hasMask,0.0,RGB());
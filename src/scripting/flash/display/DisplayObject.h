@@ -29,6 +29,7 @@ namespace lightspark
 {
 
 class AccessibilityProperties;
+class BitmapFilter;
 class DisplayObjectContainer;
 class LoaderInfo;
 class RenderContext;
@@ -95,6 +96,7 @@ private:
 	bool useLegacyMatrix;
 	bool needsTextureRecalculation;
 	bool textureRecalculationSkippable;
+	bool filtersChanged;
 	void gatherMaskIDrawables(std::vector<IDrawable::MaskData>& masks) const;
 	std::map<uint32_t,asAtom> avm1variables;
 	std::map<uint32_t,_NR<AVM1Function>> avm1functions;
@@ -153,6 +155,18 @@ public:
 	void resetNeedsTextureRecalculation() { needsTextureRecalculation=false; }
 	bool getNeedsTextureRecalculation() const { return needsTextureRecalculation; }
 	bool getTextureRecalculationSkippable() const { return textureRecalculationSkippable; }
+	// set when the filters property is assigned, reset when the object is rasterized again
+	bool getFiltersChanged() const { return filtersChanged; }
+	void resetFiltersChanged() { filtersChanged=false; }
+	/**
+	 * Adds clones of all filters to result, the clones are owned by the caller
+	 */
+	void cloneFilters(std::vector<BitmapFilter*>& result) const;
+	/**
+	 * Computes the space needed around the object by all filters, in pixels
+	 * @return false if no filter needs any space
+	 */
+	bool getFilterMargins(number_t& left, number_t& top, number_t& right, number_t& bottom) const;
 	// this may differ from the main clip if this instance was generated from a loaded swf, not from the main clip
 	RootMovieClip* loadedFrom;
 	// this is reset after the drawjob is done to ensure a changed DisplayObject is only rendered once
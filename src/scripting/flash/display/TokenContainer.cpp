@@ -28,12 +28,14 @@
 using namespace lightspark;
 using namespace std;
 
-TokenContainer::TokenContainer(DisplayObject* _o, MemoryAccount* _m) : owner(_o),tokens(reporter_allocator<GeomToken>(_m)), scaling(1.0f)
+TokenContainer::TokenContainer(DisplayObject* _o, MemoryAccount* _m) : owner(_o),tokens(reporter_allocator<GeomToken>(_m)), scaling(1.0f),rasterBucket(0),
+	requestedScale(0),requestedScaleFrame(0),exactRasterScheduled(false),filtersApplied(false)
 {
 }
 
 TokenContainer::TokenContainer(DisplayObject* _o, MemoryAccount* _m, const tokensVector& _tokens, float _scaling) :
-	owner(_o), tokens(reporter_allocator<GeomToken>(_m)), scaling(_scaling)
+	owner(_o), tokens(reporter_allocator<GeomToken>(_m)), scaling(_scaling),rasterBucket(0),
+	requestedScale(0),requestedScaleFrame(0),exactRasterScheduled(false),filtersApplied(false)
 
 {
 	tokens.filltokens.assign(_tokens.filltokens.begin(),_tokens.filltokens.end());
@@ -334,6 +336,28 @@ IDrawable* TokenContainer::invalidate(DisplayObject* target, const MATRIX& initi
 		//No contents, nothing to do
 		return nullptr;
 	}
+	float xscale = owner->getConcatenatedMatrix().getScaleX();
+	float yscale = owner->getConcatenatedMatrix().getScaleY();
+	// the filters have to be applied to the composed subtree of a container, this is not implemented yet,
+	// so only the graphics of objects without children are filtered
+	bool hasFilters = !owner->filters.isNull() && owner->filters->size()!=0
+		&& !(owner->is<DisplayObjectContainer>() && owner->as<DisplayObjectContainer>()->hasChildren());
+	// filter distances are in stage pixels, the bounds are grown to leave space for blurs and shadows
+	number_t filterleft,filtertop,filterright,filterbottom;
+	if (hasFilters && owner->getFilterMargins(filterleft,filtertop,filterright,filterbottom) && xscale != 0 && yscale != 0)
+	{
+		bxmin-=filterleft/fabs(xscale);
+		bxmax+=filterright/fabs(xscale);
+		bymin-=filtertop/fabs(yscale);
+		bymax+=filterbottom/fabs(yscale);
+	}
+	// filtered objects can't share the texture of the DefineShapeTag
+	if (owner->getFiltersChanged() || hasFilters != filtersApplied || (hasFilters && !owner->cachedSurface.isChunkOwner))
+	{
+		owner->resetFiltersChanged();
+		owner->setNeedsTextureRecalculation();
+	}
+	filtersApplied = hasFilters;
 	//Compute the matrix and the masks that are relevant
 	MATRIX totalMatrix;
 	std::vector<IDrawable::MaskData> masks;
@@ -343,8 +367,8 @@ IDrawable* TokenContainer::invalidate(DisplayObject* target, const MATRIX& initi
 	int offx,offy;
 	owner->getSystemState()->stageCoordinateMapping(owner->getSystemState()->getRenderThread()->windowWidth,owner->getSystemState()->getRenderThread()->windowHeight,offx,offy, scalex,scaley);
 
-	bool isMask;
-	bool hasMask;
+	bool isMask=false;
+	bool hasMask=false;
 	if (target)
 	{
 		owner->computeMasksAndMatrix(target,masks,totalMatrix,false,isMask,hasMask);
@@ -355,8 +379,6 @@ IDrawable* TokenContainer::invalidate(DisplayObject* target, const MATRIX& initi
 	width = bxmax-bxmin;
 	height = bymax-bymin;
 	float rotation = owner->getConcatenatedMatrix().getRotation();
-	float xscale = owner->getConcatenatedMatrix().getScaleX();
-	float yscale = owner->getConcatenatedMatrix().getScaleY();
 	float redMultiplier=1.0;
 	float greenMultiplier=1.0;
 	float blueMultiplier=1.0;
@@ -393,16 +415,99 @@ IDrawable* TokenContainer::invalidate(DisplayObject* target, const MATRIX& initi
 		blueOffset=ct->blueOffset;
 		alphaOffset=ct->alphaOffset;
 	}
-	return new CairoTokenRenderer(tokens,totalMatrix
-				, x*scalex, y*scaley, width*scalex, height*scaley
+	// When drawing on stage the tokens are rasterized at their concatenated scale. While that scale changes,
+	// they are rasterized at the scale bucket just above it instead and scaled by the GPU.
+	// Masks and textures shared with the DefineShapeTag are always rasterized unscaled
+	SystemState* sys = owner->getSystemState();
+	bool useScaleBuckets = target==sys->stage && masks.empty() && !isMask && !hasMask && owner->cachedSurface.isChunkOwner;
+	float scale = max(fabs(xscale),fabs(yscale));
+	bool exactRaster = false;
+	if (useScaleBuckets)
+	{
+		if (requestedScale != scale && requestedScale != 0)
+		{
+			requestedScaleFrame = sys->getRenderFrame();
+			if (!exactRasterScheduled)
+			{
+				exactRasterScheduled = true;
+				sys->scheduleExactRaster(owner,this);
+			}
+		}
+		else if (!exactRasterScheduled || sys->getRenderFrame()-requestedScaleFrame >= EXACT_RASTER_STABLE_FRAMES)
+		{
+			exactRasterScheduled = false;
+			exactRaster = scale > 0;
+		}
+		requestedScale = scale;
+	}
+	int32_t bucket = useScaleBuckets && !exactRaster ? ScaleBucketCache::bucketForScale(scale) : 0;
+	float rasterScale = exactRaster ? scale : ScaleBucketCache::scaleForBucket(bucket);
+	// very large rasters are limited to the memory budget of the cache and scaled up by the GPU
+	if (exactRaster && width*scalex*height*scaley*rasterScale*rasterScale*4 > ScaleBucketCache::MEMORY_BUDGET)
+		rasterScale = sqrt(ScaleBucketCache::MEMORY_BUDGET/(width*scalex*height*scaley*4));
+	int32_t rasterWidth = width*scalex*rasterScale;
+	int32_t rasterHeight = height*scaley*rasterScale;
+	uint8_t* cachedRaster=nullptr;
+	if (owner->getNeedsTextureRecalculation())
+		rasterCache.clear();
+	else if (exactRaster && rasterBucket != EXACT_RASTER_BUCKET)
+		owner->setNeedsTextureRecalculation(true);
+	else if (useScaleBuckets && !exactRaster && bucket != rasterBucket)
+	{
+		// the current texture stays visible and is scaled by the GPU until the raster for the new bucket is uploaded
+		owner->setNeedsTextureRecalculation(true);
+		cachedRaster = rasterCache.lookup(bucket,rasterWidth,rasterHeight);
+	}
+	if (useScaleBuckets)
+		rasterBucket = exactRaster ? EXACT_RASTER_BUCKET : bucket;
+	IDrawable* res;
+	if (cachedRaster)
+		res = new CachedRasterRenderer(cachedRaster
+				, x*scalex, y*scaley, rasterWidth, rasterHeight
+				, rx*scalex,ry*scaley,rwidth*scalex,rheight*scaley,rotation
+				, xscale, yscale
+				, isMask, hasMask
+				, owner->getConcatenatedAlpha(), masks
+				, redMultiplier,greenMultiplier,blueMultiplier,alphaMultiplier
+				, redOffset,greenOffset,blueOffset,alphaOffset
+				, rasterScale);
+	else
+		res = new CairoTokenRenderer(tokens,totalMatrix
+				, x*scalex, y*scaley, rasterWidth, rasterHeight
 				, rx*scalex,ry*scaley,rwidth*scalex,rheight*scaley,rotation
 				, xscale, yscale
 				, isMask, hasMask
-				, scaling,owner->getConcatenatedAlpha(), masks
+				, scaling*rasterScale,owner->getConcatenatedAlpha(), masks
 				, redMultiplier,greenMultiplier,blueMultiplier,alphaMultiplier
 				, redOffset,greenOffset,blueOffset,alphaOffset
 				, smoothing
-				,bxmin*scaling,bymin*scaling);
+				,bxmin*scaling,bymin*scaling
+				, rasterScale, useScaleBuckets && !exactRaster ? &rasterCache : nullptr, bucket, rasterCache.getGeneration());
+	if (hasFilters && owner->getNeedsTextureRecalculation() && xscale != 0 && yscale != 0)
+	{
+		// the drawable is rendered outside of the vm thread, so it gets its own copies of the filters
+		std::vector<BitmapFilter*> filters;
+		owner->cloneFilters(filters);
+		if (!filters.empty())
+			res->setFilters(filters,scalex*rasterScale/fabs(xscale),scaley*rasterScale/fabs(yscale));
+	}
+	return res;
+}
+
+bool TokenContainer::requestExactRaster(uint32_t frame)
+{
+	if (!exactRasterScheduled)
+		return true;
+	if (frame-requestedScaleFrame < EXACT_RASTER_STABLE_FRAMES)
+		return false;
+	if (owner->isOnStage())
+	{
+		owner->hasChanged=true;
+		requestInvalidation(owner->getSystemState());
+	}
+	else
+		exactRasterScheduled = false;
+	return true;
 }
 
 _NR<DisplayObject> TokenContainer::hitTestImpl(_NR<DisplayObject> last, number_t x, number_t y, DisplayObject::HIT_TYPE type) const
@@ -33,6 +33,9 @@ class DisplayObject;
 class InteractiveObject;
 class DefineMorphShapeTag;
 
+// Frames the scale of a shape on stage has to stay unchanged before it is rasterized at its exact scale
+#define EXACT_RASTER_STABLE_FRAMES 2
+
 class TokenContainer
 {
 	friend class Graphics;
@@ -63,6 +66,20 @@ public:
 	uint16_t getCurrentLineWidth() const;
 	float scaling;
 protected:
+	/* rasterizations of the tokens at the scales used so far */
+	ScaleBucketCache rasterCache;
+	/* the scale bucket of the latest requested rasterization, EXACT_RASTER_BUCKET if it is at the exact scale */
+	int32_t rasterBucket;
+	static const int32_t EXACT_RASTER_BUCKET=INT32_MIN;
+	/*
+	 * While the scale of a shape on stage changes its bucket raster is scaled by the GPU,
+	 * once the scale has been stable for EXACT_RASTER_STABLE_FRAMES it is rasterized at the exact scale
+	 */
+	float requestedScale;
+	uint32_t requestedScaleFrame;
+	bool exactRasterScheduled;
+	/* true if the filters of the owner were applied to the latest requested rasterization */
+	bool filtersApplied;
 	TokenContainer(DisplayObject* _o, MemoryAccount* _m);
 	TokenContainer(DisplayObject* _o, MemoryAccount* _m, const tokensVector& _tokens, float _scaling);
 	IDrawable* invalidate(DisplayObject* target, const MATRIX& initialMatrix, bool smoothing);
@@ -74,6 +91,12 @@ protected:
 	_NR<DisplayObject> hitTestImpl(_NR<DisplayObject> last, number_t x, number_t y, DisplayObject::HIT_TYPE type) const;
 	bool renderImpl(RenderContext& ctxt) const;
 	bool tokensEmpty() const { return tokens.empty(); }
+public:
+	/*
+	 * Called by the SystemState at the end of every frame while an exact raster is scheduled,
+	 * returns false as long as the scale is not stable yet
+	 */
+	bool requestExactRaster(uint32_t frame);
 };
 
 }
@@ -3326,6 +3326,8 @@ void Shape::setupShape(DefineShapeTag* tag, float _scaling)
 	fromTag = tag;
 	cachedSurface.isChunkOwner=false;
 	cachedSurface.tex=&tag->chunk;
+	cachedSurface.rasterScale=1.0;
+	rasterBucket=0;
 	if (tag->chunk.isValid()) // Shape texture was already created, so we don't have to redo it
 		resetNeedsTextureRecalculation();
 	scaling=_scaling;
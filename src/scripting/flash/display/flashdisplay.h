@@ -137,6 +137,7 @@ public:
 	void _removeAllChildren();
 	void removeAVM1Listeners() override;
 	int getChildIndex(_R<DisplayObject> child);
+	bool hasChildren() const { return !dynamicDisplayList.empty(); }
 	DisplayObjectContainer(Class_base* c);
 	bool destruct() override;
 	void finalize() override;
@@ -582,13 +582,22 @@ void EventDispatcher::buildTraits(ASObject* o)
 {
 }
 
+EventDispatcher::handlermap::iterator EventDispatcher::findHandlers(uint32_t eventNameId)
+{
+	auto it=lower_bound(handlers.begin(),handlers.end(),eventNameId,
+		[](const std::pair<uint32_t,list<listener>>& h, uint32_t id) { return h.first < id; });
+	if(it!=handlers.end() && it->first!=eventNameId)
+		return handlers.end();
+	return it;
+}
+
 void EventDispatcher::dumpHandlers()
 {
-	std::map<tiny_string,list<listener> >::iterator it=handlers.begin();
+	handlermap::iterator it=handlers.begin();
 	for(;it!=handlers.end();++it)
 	{
 		for (auto it2 = it->second.begin();it2 != it->second.end(); it2++)
-			LOG(LOG_INFO, it->first<<":"<<asAtomHandler::toDebugString(it2->f));
+			LOG(LOG_INFO, getSystemState()->getStringFromUniqueId(it->first)<<":"<<asAtomHandler::toDebugString(it2->f));
 	}
 }
 
@@ -607,11 +616,11 @@ ASFUNCTIONBODY_ATOM(EventDispatcher,addEventListener)
 	if(argslen>=4)
 		priority=asAtomHandler::toInt(args[3]);
 
-	const tiny_string& eventName=asAtomHandler::toString(args[0],sys);
+	uint32_t eventNameId=asAtomHandler::toStringId(args[0],sys);
 
-	if(th->is<DisplayObject>() && (eventName=="enterFrame"
-				|| eventName=="exitFrame"
-				|| eventName=="frameConstructed") )
+	if(th->is<DisplayObject>() && (eventNameId==BUILTIN_STRINGS::STRING_ENTERFRAME
+				|| eventNameId==BUILTIN_STRINGS::STRING_EXITFRAME
+				|| eventNameId==BUILTIN_STRINGS::STRING_FRAMECONSTRUCTED) )
 	{
 		th->incRef();
 		th->getSystemState()->registerFrameListener(_MR(th->as<DisplayObject>()));
@@ -620,21 +629,24 @@ ASFUNCTIONBODY_ATOM(EventDispatcher,addEventListener)
 	{
 		Locker l(th->handlersMutex);
 		//Search if any listener is already registered for the event
-		list<listener>& listeners=th->handlers[eventName];
+		auto h=lower_bound(th->handlers.begin(),th->handlers.end(),eventNameId,
+			[](const std::pair<uint32_t,list<listener>>& h, uint32_t id) { return h.first < id; });
+		if(h==th->handlers.end() || h->first!=eventNameId)
+			h=th->handlers.insert(h,make_pair(eventNameId,list<listener>()));
+		list<listener>& listeners=h->second;
 		ASATOM_INCREF(args[1]);
 		const listener newListener(args[1], priority, useCapture);
 		//Ordered insertion
 		list<listener>::iterator insertionPoint=upper_bound(listeners.begin(),listeners.end(),newListener);
 		listeners.insert(insertionPoint,newListener);
 	}
-	th->eventListenerAdded(eventName);
+	th->eventListenerAdded(sys->getStringFromUniqueId(eventNameId));
 }
 
 ASFUNCTIONBODY_ATOM(EventDispatcher,_hasEventListener)
 {
 	EventDispatcher* th=asAtomHandler::as<EventDispatcher>(obj);
-	const tiny_string& eventName=asAtomHandler::toString(args[0],sys);
-	asAtomHandler::setBool(ret,th->hasEventListener(eventName));
+	asAtomHandler::setBool(ret,th->hasEventListener(asAtomHandler::toStringId(args[0],sys)));
 }
 
 ASFUNCTIONBODY_ATOM(EventDispatcher,removeEventListener)
@@ -646,7 +658,7 @@ ASFUNCTIONBODY_ATOM(EventDispatcher,removeEventListener)
 	if(!asAtomHandler::isString(args[0]) || !asAtomHandler::isFunction(args[1]))
 		throw RunTimeException("Type mismatch in EventDispatcher::removeEventListener");
 
-	const tiny_string& eventName=asAtomHandler::toString(args[0],sys);
+	uint32_t eventNameId=asAtomHandler::toStringId(args[0],sys);
 
 	bool useCapture=false;
 	if(argslen>=3)
@@ -654,7 +666,7 @@ ASFUNCTIONBODY_ATOM(EventDispatcher,removeEventListener)
 
 	{
 		Locker l(th->handlersMutex);
-		map<tiny_string, list<listener> >::iterator h=th->handlers.find(eventName);
+		handlermap::iterator h=th->findHandlers(eventNameId);
 		if(h==th->handlers.end())
 		{
 			LOG(LOG_CALLS,_("Event not found"));
@@ -673,12 +685,12 @@ ASFUNCTIONBODY_ATOM(EventDispatcher,removeEventListener)
 	}
 
 	// Only unregister the enterFrame listener _after_ the handlers have been erased.
-	if(th->is<DisplayObject>() && (eventName=="enterFrame"
-					|| eventName=="exitFrame"
-					|| eventName=="frameConstructed")
-				&& (!th->hasEventListener("enterFrame")
-					&& !th->hasEventListener("exitFrame")
-					&& !th->hasEventListener("frameConstructed")) )
+	if(th->is<DisplayObject>() && (eventNameId==BUILTIN_STRINGS::STRING_ENTERFRAME
+					|| eventNameId==BUILTIN_STRINGS::STRING_EXITFRAME
+					|| eventNameId==BUILTIN_STRINGS::STRING_FRAMECONSTRUCTED)
+				&& (!th->hasEventListener(BUILTIN_STRINGS::STRING_ENTERFRAME)
+					&& !th->hasEventListener(BUILTIN_STRINGS::STRING_EXITFRAME)
+					&& !th->hasEventListener(BUILTIN_STRINGS::STRING_FRAMECONSTRUCTED)) )
 	{
 		th->incRef();
 		th->getSystemState()->unregisterFrameListener(_MR(th->as<DisplayObject>()));
@@ -744,12 +756,13 @@ void EventDispatcher::handleEvent(_R<Event> e)
 {
 	check();
 	e->check();
+	uint32_t eventNameId=getSystemState()->getUniqueStringId(e->type);
 	Locker l(handlersMutex);
-	map<tiny_string, list<listener> >::iterator h=handlers.find(e->type);
+	handlermap::iterator h=findHandlers(eventNameId);
 	if(h==handlers.end())
 		return;
 
-	LOG(LOG_CALLS, _("Handling event ") << h->first);
+	LOG(LOG_CALLS, _("Handling event ") << e->type);
 
 	//Create a temporary copy of the listeners, as the list can be modified during the calls
 	vector<listener> tmpListener(h->second.begin(),h->second.end());
@@ -779,9 +792,14 @@ void EventDispatcher::handleEvent(_R<Event> e)
 }
 
 bool EventDispatcher::hasEventListener(const tiny_string& eventName)
+{
+	return hasEventListener(getSystemState()->getUniqueStringId(eventName));
+}
+
+bool EventDispatcher::hasEventListener(uint32_t eventNameId)
 {
 	Locker l(handlersMutex);
-	if(handlers.find(eventName)==handlers.end())
+	if(findHandlers(eventNameId)==handlers.end())
 		return false;
 	else
 		return true;
@@ -1104,6 +1122,15 @@ ABCContextInitEvent::ABCContextInitEvent(ABCContext* c, bool l):Event(nullptr, "
 AVM1InitActionEvent::AVM1InitActionEvent(RootMovieClip* r,  _NR<MovieClip> c):Event(nullptr, "AVM1InitActionEvent"),root(r),clip(c)
 {
 }
+void BroadcastFrameEvent::finalize()
+{
+	for(auto it=listeners.begin();it!=listeners.end();it++)
+		(*it)->decRef();
+	listeners.clear();
+	event.reset();
+	Event::finalize();
+}
+
 void AVM1InitActionEvent::finalize()
 {
 	root = nullptr;
@@ -32,7 +32,7 @@ namespace lightspark
 
 enum EVENT_TYPE { EVENT=0, BIND_CLASS, SHUTDOWN, SYNC, MOUSE_EVENT,
 	FUNCTION, EXTERNAL_CALL, CONTEXT_INIT, INIT_FRAME,
-	FLUSH_INVALIDATION_QUEUE, ADVANCE_FRAME, PARSE_RPC_MESSAGE,EXECUTE_FRAMESCRIPT,TEXTINPUT_EVENT,IDLE_EVENT,AVM1INITACTION_EVENT,ROOTCONSTRUCTEDEVENT };
+	FLUSH_INVALIDATION_QUEUE, ADVANCE_FRAME, PARSE_RPC_MESSAGE,EXECUTE_FRAMESCRIPT,TEXTINPUT_EVENT,IDLE_EVENT,AVM1INITACTION_EVENT,ROOTCONSTRUCTEDEVENT,BROADCAST_FRAME };
 
 class ABCContext;
 class DictionaryTag;
@@ -363,7 +363,10 @@ class EventDispatcher: public ASObject, public IEventDispatcher
 {
 private:
 	Mutex handlersMutex;
-	std::map<tiny_string,std::list<listener> > handlers;
+	// the listeners of every event type, sorted by the unique string id of the event type
+	typedef std::vector<std::pair<uint32_t,std::list<listener>>> handlermap;
+	handlermap handlers;
+	handlermap::iterator findHandlers(uint32_t eventNameId);
 	/*
 	 * This will be used when a target is passed to EventDispatcher constructor
 	 */
@@ -383,6 +386,7 @@ public:
 	void handleEvent(_R<Event> e);
 	void dumpHandlers();
 	bool hasEventListener(const tiny_string& eventName);
+	bool hasEventListener(uint32_t eventNameId);
 	virtual void defaultEventBehavior(_R<Event> e) {}
 	virtual void afterExecution(_R<Event> e) {}
 	ASFUNCTION_ATOM(_constructor);
@@ -529,6 +533,25 @@ public:
 	AdvanceFrameEvent(_NR<DisplayObject> m=NullRef): Event(nullptr,"AdvanceFrameEvent"),clip(m) {}
 	EVENT_TYPE getEventType() const override { return ADVANCE_FRAME; }
 };
+/*
+ * Sends enterFrame, frameConstructed or exitFrame to all frame listeners with a single queue entry.
+ * The listeners are collected when the event is added, so listeners added later don't get the event of this frame
+ */
+class BroadcastFrameEvent: public Event
+{
+friend class ABCVm;
+friend class SystemState;
+private:
+	uint32_t eventNameId;
+	// the event sent to the listeners, it is reused for the next frame if no script kept a reference to it
+	_NR<Event> event;
+	// a reference is held for every listener until it got the event
+	std::vector<DisplayObject*> listeners;
+public:
+	BroadcastFrameEvent(uint32_t _eventNameId): Event(nullptr,"BroadcastFrameEvent"),eventNameId(_eventNameId) {}
+	void finalize() override;
+	EVENT_TYPE getEventType() const override { return BROADCAST_FRAME; }
+};
 class RootConstructedEvent: public Event
 {
 friend class ABCVm;
@@ -22,10 +22,242 @@
 #include "scripting/argconv.h"
 #include "scripting/flash/display/BitmapData.h"
 #include "scripting/flash/geom/flashgeom.h"
+#include "scripting/toplevel/Array.h"
+#include "platforms/pixelkernels.h"
 
 using namespace std;
 using namespace lightspark;
 
+namespace
+{
+enum GLOW_MODE { GLOW_INNER, GLOW_OUTER, GLOW_FULL };
+
+inline uint32_t mul8(uint32_t c, uint32_t a)
+{
+	return (c*a+127)/255;
+}
+
+inline uint32_t clamp8(number_t v)
+{
+	return v>=255 ? 255 : (v>0 ? uint32_t(v) : 0);
+}
+
+inline uint32_t premultipliedColor(uint32_t rgb, uint32_t a)
+{
+	return (a<<24) | (mul8((rgb>>16)&0xff,a)<<16) | (mul8((rgb>>8)&0xff,a)<<8) | mul8(rgb&0xff,a);
+}
+
+// multiplies all channels of a premultiplied pixel with a/255
+inline uint32_t scalePixel(uint32_t p, uint32_t a)
+{
+	return (mul8(p>>24,a)<<24) | (mul8((p>>16)&0xff,a)<<16) | (mul8((p>>8)&0xff,a)<<8) | mul8(p&0xff,a);
+}
+
+inline uint32_t addPixels(uint32_t p, uint32_t q)
+{
+	uint32_t ret=0;
+	for (uint32_t i=0;i<32;i+=8)
+		ret|=min(((p>>i)&0xff)+((q>>i)&0xff),255u)<<i;
+	return ret;
+}
+
+// box blur radius for a blur amount of the filter, box blurs are 2*radius+1 pixels wide
+uint32_t blurRadius(number_t blur, number_t scale)
+{
+	number_t r=blur*scale/2;
+	if (!(r>0))
+		return 0;
+	return r>255 ? 255 : uint32_t(r);
+}
+
+int32_t blurPasses(int32_t quality)
+{
+	return quality<0 ? 0 : (quality>15 ? 15 : quality);
+}
+
+void boxBlur(uint32_t* data, uint32_t width, uint32_t height, uint32_t radiusX, uint32_t radiusY, int32_t passes)
+{
+	if (width==0 || height==0)
+		return;
+	vector<uint32_t> row(width);
+	vector<uint32_t> copy;
+	vector<int32_t> sums;
+	// repeated box blurs approximate a gaussian blur
+	for (int32_t pass=0;pass<passes;pass++)
+	{
+		if (radiusX)
+		{
+			for (uint32_t y=0;y<height;y++)
+			{
+				uint32_t* line=data+y*width;
+				pixelBoxBlurRow(line,row.data(),width,radiusX);
+				memcpy(line,row.data(),width*4);
+			}
+		}
+		if (radiusY)
+		{
+			copy.assign(data,data+width*height);
+			sums.assign(width*4,0);
+			float scale=1.0f/(2*radiusY+1);
+			for (uint32_t y=0;y<=radiusY && y<height;y++)
+				pixelBoxBlurAccumulateRow(sums.data(),copy.data()+y*width,nullptr,width);
+			for (uint32_t y=0;y<height;y++)
+			{
+				pixelBoxBlurStoreRow(sums.data(),data+y*width,width,scale);
+				pixelBoxBlurAccumulateRow(sums.data(),
+						y+radiusY+1<height ? copy.data()+(y+radiusY+1)*width : nullptr,
+						y>=radiusY ? copy.data()+(y-radiusY)*width : nullptr,width);
+			}
+		}
+	}
+}
+
+// the alpha channel of data moved by dx,dy and blurred, stored as grey pixels
+void blurredAlpha(const uint32_t* data, uint32_t width, uint32_t height, int32_t dx, int32_t dy,
+		uint32_t radiusX, uint32_t radiusY, int32_t passes, vector<uint32_t>& out)
+{
+	out.assign(width*height,0);
+	for (int32_t y=0;y<int32_t(height);y++)
+	{
+		int32_t sy=y-dy;
+		if (sy<0 || sy>=int32_t(height))
+			continue;
+		for (int32_t x=0;x<int32_t(width);x++)
+		{
+			int32_t sx=x-dx;
+			if (sx<0 || sx>=int32_t(width))
+				continue;
+			out[y*width+x]=(data[sy*width+sx]>>24)*0x01010101;
+		}
+	}
+	boxBlur(out.data(),width,height,radiusX,radiusY,passes);
+}
+
+// turns the blurred alpha into glow pixels of a single color
+void colorizeGlow(vector<uint32_t>& glow, bool inner, number_t strength, number_t alpha, uint32_t color)
+{
+	for (auto it=glow.begin();it!=glow.end();++it)
+	{
+		uint32_t a=(*it)>>24;
+		if (inner)
+			a=255-a;
+		*it=premultipliedColor(color,clamp8(clamp8(a*strength)*alpha));
+	}
+}
+
+void compositeGlow(uint32_t* data, const vector<uint32_t>& glow, GLOW_MODE mode, bool knockout, bool hideObject)
+{
+	for (uint32_t i=0;i<glow.size();i++)
+	{
+		uint32_t s=data[i];
+		uint32_t g=glow[i];
+		switch (mode)
+		{
+			case GLOW_OUTER:
+				if (hideObject && !knockout)
+					data[i]=g;
+				else
+				{
+					g=scalePixel(g,255-(s>>24));
+					data[i]=knockout ? g : addPixels(s,g);
+				}
+				break;
+			case GLOW_INNER:
+				// the glow is drawn on top of the object and only inside of it
+				data[i]=scalePixel(g,s>>24);
+				if (!knockout && !hideObject)
+					data[i]=addPixels(data[i],scalePixel(s,255-(g>>24)));
+				break;
+			case GLOW_FULL:
+				data[i]=(knockout || hideObject) ? g : addPixels(g,scalePixel(s,255-(g>>24)));
+				break;
+		}
+	}
+}
+
+GLOW_MODE glowModeFromType(const tiny_string& type)
+{
+	if (type=="outer")
+		return GLOW_OUTER;
+	if (type=="full")
+		return GLOW_FULL;
+	return GLOW_INNER;
+}
+
+number_t arrayNumber(Array* a, uint32_t index)
+{
+	asAtom v=a->at(index);
+	return asAtomHandler::toNumber(v);
+}
+
+// filters keep private copies of their arrays, so clones can be used outside of the vm thread
+_NR<Array> cloneArray(SystemState* sys, const _NR<Array>& a)
+{
+	if (a.isNull())
+		return NullRef;
+	Array* ret=Class<Array>::getInstanceSNoArgs(sys);
+	for (uint32_t i=0;i<a->size();i++)
+		ret->push(asAtomHandler::fromNumber(sys,arrayNumber(a.getPtr(),i),false));
+	return _MR(ret);
+}
+
+// 256 premultiplied colors interpolated from the gradient arrays of the gradient filters
+void buildGradientPalette(const _NR<Array>& colors, const _NR<Array>& alphas, const _NR<Array>& ratios, uint32_t* palette)
+{
+	uint32_t count=0;
+	if (!colors.isNull() && !alphas.isNull() && !ratios.isNull())
+		count=min(colors->size(),min(alphas->size(),ratios->size()));
+	if (count==0)
+	{
+		memset(palette,0,256*4);
+		return;
+	}
+	uint32_t k=0;
+	for (uint32_t i=0;i<256;i++)
+	{
+		while (k+1<count && arrayNumber(ratios.getPtr(),k+1)<=i)
+			k++;
+		number_t r0=arrayNumber(ratios.getPtr(),k);
+		uint32_t c0=uint32_t(arrayNumber(colors.getPtr(),k));
+		number_t a0=arrayNumber(alphas.getPtr(),k);
+		if (k+1>=count || i<=r0)
+		{
+			palette[i]=premultipliedColor(c0,clamp8(a0*255));
+			continue;
+		}
+		number_t r1=arrayNumber(ratios.getPtr(),k+1);
+		uint32_t c1=uint32_t(arrayNumber(colors.getPtr(),k+1));
+		number_t a1=arrayNumber(alphas.getPtr(),k+1);
+		number_t t=(i-r0)/(r1-r0);
+		uint32_t rgb=0;
+		for (uint32_t j=0;j<24;j+=8)
+			rgb|=clamp8(((c0>>j)&0xff)*(1-t)+((c1>>j)&0xff)*t)<<j;
+		palette[i]=premultipliedColor(rgb,clamp8((a0*(1-t)+a1*t)*255));
+	}
+}
+
+void shadowOffset(number_t distance, number_t angle, number_t scalex, number_t scaley, int32_t& dx, int32_t& dy)
+{
+	dx=lrint(distance*cos(angle*M_PI/180.0)*scalex);
+	dy=lrint(distance*sin(angle*M_PI/180.0)*scaley);
+}
+
+void blurMargins(number_t blurX, number_t blurY, int32_t quality, number_t distance, number_t angle,
+		number_t& left, number_t& top, number_t& right, number_t& bottom)
+{
+	int32_t passes=blurPasses(quality);
+	number_t dx=distance*cos(angle*M_PI/180.0);
+	number_t dy=distance*sin(angle*M_PI/180.0);
+	left=right=max(blurX,0.0)/2*passes;
+	top=bottom=max(blurY,0.0)/2*passes;
+	left+=max(-dx,0.0);
+	right+=max(dx,0.0);
+	top+=max(-dy,0.0);
+	bottom+=max(dy,0.0);
+}
+
+}
+
 void BitmapFilter::sinit(Class_base* c)
 {
 	CLASS_SETUP(c, ASObject, _constructorNotInstantiatable, CLASS_SEALED);
@@ -43,6 +275,16 @@ ASFUNCTIONBODY_ATOM(BitmapFilter,clone)
 	ret = asAtomHandler::fromObject(th->cloneImpl());
 }
 
+void BitmapFilter::applyFilter(uint32_t* data, uint32_t width, uint32_t height, number_t scalex, number_t scaley)
+{
+	LOG(LOG_NOT_IMPLEMENTED,"applyFilter not implemented for "<<this->toDebugString());
+}
+
+void BitmapFilter::getMargins(number_t& left, number_t& top, number_t& right, number_t& bottom) const
+{
+	left=top=right=bottom=0;
+}
+
 GlowFilter::GlowFilter(Class_base* c):
 	BitmapFilter(c,SUBTYPE_GLOWFILTER), alpha(1.0), blurX(6.0), blurY(6.0), color(0xFF0000),
 	inner(false), knockout(false), quality(1), strength(2.0)
@@ -52,7 +294,6 @@ GlowFilter::GlowFilter(Class_base* c,const GLOWFILTER& filter):
 	BitmapFilter(c,SUBTYPE_GLOWFILTER), alpha(filter.GlowColor.af()), blurX(filter.BlurX), blurY(filter.BlurY), color(RGB(filter.GlowColor.Red,filter.GlowColor.Green,filter.GlowColor.Blue).toUInt()),
 	inner(filter.InnerGlow), knockout(filter.Knockout), quality(filter.Passes), strength(filter.Strength)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"GlowFilter from Tag");
 }
 
 void GlowFilter::sinit(Class_base* c)
@@ -88,7 +329,6 @@ ASFUNCTIONBODY_ATOM(GlowFilter,_constructor)
 		(th->quality, 1)
 		(th->inner, false)
 		(th->knockout, false);
-	LOG(LOG_NOT_IMPLEMENTED,"GlowFilter does nothing");
 }
 
 BitmapFilter* GlowFilter::cloneImpl() const
@@ -105,6 +345,22 @@ BitmapFilter* GlowFilter::cloneImpl() const
 	return cloned;
 }
 
+void GlowFilter::applyFilter(uint32_t* data, uint32_t width, uint32_t height, number_t scalex, number_t scaley)
+{
+	vector<uint32_t> glow;
+	blurredAlpha(data,width,height,0,0,blurRadius(blurX,scalex),blurRadius(blurY,scaley),blurPasses(quality),glow);
+	colorizeGlow(glow,inner,strength,alpha,color);
+	compositeGlow(data,glow,inner ? GLOW_INNER : GLOW_OUTER,knockout,false);
+}
+
+void GlowFilter::getMargins(number_t& left, number_t& top, number_t& right, number_t& bottom) const
+{
+	if (inner)
+		BitmapFilter::getMargins(left,top,right,bottom);
+	else
+		blurMargins(blurX,blurY,quality,0,0,left,top,right,bottom);
+}
+
 DropShadowFilter::DropShadowFilter(Class_base* c):
 	BitmapFilter(c,SUBTYPE_DROPSHADOWFILTER), alpha(1.0), angle(45), blurX(4.0), blurY(4.0),
 	color(0), distance(4.0), hideObject(false), inner(false),
@@ -116,7 +372,6 @@ DropShadowFilter::DropShadowFilter(Class_base* c,const DROPSHADOWFILTER& filter)
 	color(RGB(filter.DropShadowColor.Red,filter.DropShadowColor.Green,filter.DropShadowColor.Blue).toUInt()), distance(filter.Distance), hideObject(false), inner(filter.InnerShadow),
 	knockout(filter.Knockout), quality(filter.Passes), strength(filter.Strength)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"DropShadowFilter from Tag");
 }
 
 
@@ -162,7 +417,6 @@ ASFUNCTIONBODY_ATOM(DropShadowFilter,_constructor)
 		(th->inner, false)
 		(th->knockout, false)
 		(th->hideObject, false);
-	LOG(LOG_NOT_IMPLEMENTED,"DropShadowFilter does nothing");
 }
 
 BitmapFilter* DropShadowFilter::cloneImpl() const
@@ -182,6 +436,24 @@ BitmapFilter* DropShadowFilter::cloneImpl() const
 	return cloned;
 }
 
+void DropShadowFilter::applyFilter(uint32_t* data, uint32_t width, uint32_t height, number_t scalex, number_t scaley)
+{
+	int32_t dx,dy;
+	shadowOffset(distance,angle,scalex,scaley,dx,dy);
+	vector<uint32_t> shadow;
+	blurredAlpha(data,width,height,dx,dy,blurRadius(blurX,scalex),blurRadius(blurY,scaley),blurPasses(quality),shadow);
+	colorizeGlow(shadow,inner,strength,alpha,color);
+	compositeGlow(data,shadow,inner ? GLOW_INNER : GLOW_OUTER,knockout,hideObject);
+}
+
+void DropShadowFilter::getMargins(number_t& left, number_t& top, number_t& right, number_t& bottom) const
+{
+	if (inner)
+		BitmapFilter::getMargins(left,top,right,bottom);
+	else
+		blurMargins(blurX,blurY,quality,distance,angle,left,top,right,bottom);
+}
+
 GradientGlowFilter::GradientGlowFilter(Class_base* c):
 	BitmapFilter(c,SUBTYPE_GRADIENTGLOWFILTER),distance(4.0),angle(45), blurX(4.0), blurY(4.0), strength(1), quality(1), type("inner"), knockout(false)
 {
@@ -191,7 +463,6 @@ GradientGlowFilter::GradientGlowFilter(Class_base* c, const GRADIENTGLOWFILTER&
 	type("inner"),// TODO: is type set based on "onTop" ?
 	knockout(filter.Knockout)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"GradientGlowFilter from Tag");
 	if (filter.GradientColors.size())
 	{
 		colors = _MR(Class<Array>::getInstanceSNoArgs(c->getSystemState()));
@@ -248,8 +519,24 @@ ASFUNCTIONBODY_GETTER_SETTER(GradientGlowFilter, knockout);
 
 ASFUNCTIONBODY_ATOM(GradientGlowFilter,_constructor)
 {
-	//GradientGlowFilter *th = obj.as<GradientGlowFilter>();
-	LOG(LOG_NOT_IMPLEMENTED,"GradientGlowFilter is not implemented");
+	GradientGlowFilter *th = asAtomHandler::as<GradientGlowFilter>(obj);
+	_NR<Array> c;
+	_NR<Array> a;
+	_NR<Array> r;
+	ARG_UNPACK_ATOM (th->distance, 4.0)
+		(th->angle, 45)
+		(c, NullRef)
+		(a, NullRef)
+		(r, NullRef)
+		(th->blurX, 4.0)
+		(th->blurY, 4.0)
+		(th->strength, 1)
+		(th->quality, 1)
+		(th->type, "inner")
+		(th->knockout, false);
+	th->colors=cloneArray(sys,c);
+	th->alphas=cloneArray(sys,a);
+	th->ratios=cloneArray(sys,r);
 }
 
 BitmapFilter* GradientGlowFilter::cloneImpl() const
@@ -257,9 +544,9 @@ BitmapFilter* GradientGlowFilter::cloneImpl() const
 	GradientGlowFilter *cloned = Class<GradientGlowFilter>::getInstanceS(getSystemState());
 	cloned->distance = distance;
 	cloned->angle = angle;
-	cloned->colors = colors;
-	cloned->alphas = alphas;
-	cloned->ratios = ratios;
+	cloned->colors = cloneArray(getSystemState(),colors);
+	cloned->alphas = cloneArray(getSystemState(),alphas);
+	cloned->ratios = cloneArray(getSystemState(),ratios);
 	cloned->blurX = blurX;
 	cloned->blurY = blurY;
 	cloned->strength = strength;
@@ -269,6 +556,33 @@ BitmapFilter* GradientGlowFilter::cloneImpl() const
 	return cloned;
 }
 
+void GradientGlowFilter::applyFilter(uint32_t* data, uint32_t width, uint32_t height, number_t scalex, number_t scaley)
+{
+	uint32_t palette[256];
+	buildGradientPalette(colors,alphas,ratios,palette);
+	GLOW_MODE mode=glowModeFromType(type);
+	int32_t dx,dy;
+	shadowOffset(distance,angle,scalex,scaley,dx,dy);
+	vector<uint32_t> glow;
+	blurredAlpha(data,width,height,dx,dy,blurRadius(blurX,scalex),blurRadius(blurY,scaley),blurPasses(quality),glow);
+	for (auto it=glow.begin();it!=glow.end();++it)
+	{
+		uint32_t a=(*it)>>24;
+		if (mode==GLOW_INNER)
+			a=255-a;
+		*it=palette[clamp8(a*strength)];
+	}
+	compositeGlow(data,glow,mode,knockout,false);
+}
+
+void GradientGlowFilter::getMargins(number_t& left, number_t& top, number_t& right, number_t& bottom) const
+{
+	if (glowModeFromType(type)==GLOW_INNER)
+		BitmapFilter::getMargins(left,top,right,bottom);
+	else
+		blurMargins(blurX,blurY,quality,distance,angle,left,top,right,bottom);
+}
+
 BevelFilter::BevelFilter(Class_base* c):
 	BitmapFilter(c,SUBTYPE_BEVELFILTER), angle(45), blurX(4.0), blurY(4.0),distance(4.0),
 	highlightAlpha(1.0), highlightColor(0xFFFFFF),
@@ -284,7 +598,6 @@ BevelFilter::BevelFilter(Class_base* c,const BEVELFILTER& filter):
 	shadowAlpha(filter.ShadowColor.af()), shadowColor(RGB(filter.ShadowColor.Red,filter.ShadowColor.Green,filter.ShadowColor.Blue).toUInt()),
 	strength(filter.Strength), type("inner") // TODO: is type set based on "onTop" ?
 {
-	LOG(LOG_NOT_IMPLEMENTED,"BevelFilter from Tag");
 }
 
 void BevelFilter::sinit(Class_base* c)
@@ -303,23 +616,34 @@ void BevelFilter::sinit(Class_base* c)
 	REGISTER_GETTER_SETTER(c,strength);
 	REGISTER_GETTER_SETTER(c,type);
 }
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(BevelFilter,angle);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(BevelFilter,blurX);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(BevelFilter,blurY);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(BevelFilter,distance);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(BevelFilter,highlightAlpha);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(BevelFilter,highlightColor);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(BevelFilter,knockout);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(BevelFilter,quality);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(BevelFilter,shadowAlpha);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(BevelFilter,shadowColor);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(BevelFilter,strength);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(BevelFilter,type);
+ASFUNCTIONBODY_GETTER_SETTER(BevelFilter,angle);
+ASFUNCTIONBODY_GETTER_SETTER(BevelFilter,blurX);
+ASFUNCTIONBODY_GETTER_SETTER(BevelFilter,blurY);
+ASFUNCTIONBODY_GETTER_SETTER(BevelFilter,distance);
+ASFUNCTIONBODY_GETTER_SETTER(BevelFilter,highlightAlpha);
+ASFUNCTIONBODY_GETTER_SETTER(BevelFilter,highlightColor);
+ASFUNCTIONBODY_GETTER_SETTER(BevelFilter,knockout);
+ASFUNCTIONBODY_GETTER_SETTER(BevelFilter,quality);
+ASFUNCTIONBODY_GETTER_SETTER(BevelFilter,shadowAlpha);
+ASFUNCTIONBODY_GETTER_SETTER(BevelFilter,shadowColor);
+ASFUNCTIONBODY_GETTER_SETTER(BevelFilter,strength);
+ASFUNCTIONBODY_GETTER_SETTER(BevelFilter,type);
  
 ASFUNCTIONBODY_ATOM(BevelFilter,_constructor)
 {
-	//BevelFilter *th = obj.as<BevelFilter>();
-	LOG(LOG_NOT_IMPLEMENTED,"BevelFilter is not implemented");
+	BevelFilter *th = asAtomHandler::as<BevelFilter>(obj);
+	ARG_UNPACK_ATOM (th->distance, 4.0)
+		(th->angle, 45)
+		(th->highlightColor, 0xFFFFFF)
+		(th->highlightAlpha, 1.0)
+		(th->shadowColor, 0x000000)
+		(th->shadowAlpha, 1.0)
+		(th->blurX, 4.0)
+		(th->blurY, 4.0)
+		(th->strength, 1)
+		(th->quality, 1)
+		(th->type, "inner")
+		(th->knockout, false);
 }
 
 BitmapFilter* BevelFilter::cloneImpl() const
@@ -339,6 +663,43 @@ BitmapFilter* BevelFilter::cloneImpl() const
 	cloned->type = type;
 	return cloned;
 }
+
+void BevelFilter::applyFilter(uint32_t* data, uint32_t width, uint32_t height, number_t scalex, number_t scaley)
+{
+	int32_t dx,dy;
+	shadowOffset(distance,angle,scalex,scaley,dx,dy);
+	uint32_t radiusX=blurRadius(blurX,scalex);
+	uint32_t radiusY=blurRadius(blurY,scaley);
+	int32_t passes=blurPasses(quality);
+	// the shadow is on the edges facing away from the light, the highlight on the opposite ones
+	vector<uint32_t> shadowSide;
+	vector<uint32_t> highlightSide;
+	blurredAlpha(data,width,height,dx,dy,radiusX,radiusY,passes,shadowSide);
+	blurredAlpha(data,width,height,-dx,-dy,radiusX,radiusY,passes,highlightSide);
+	for (uint32_t i=0;i<shadowSide.size();i++)
+	{
+		number_t v=(int32_t(shadowSide[i]>>24)-int32_t(highlightSide[i]>>24))*strength;
+		if (v>0)
+			shadowSide[i]=premultipliedColor(shadowColor,clamp8(clamp8(v)*shadowAlpha));
+		else
+			shadowSide[i]=premultipliedColor(highlightColor,clamp8(clamp8(-v)*highlightAlpha));
+	}
+	compositeGlow(data,shadowSide,glowModeFromType(type),knockout,false);
+}
+
+void BevelFilter::getMargins(number_t& left, number_t& top, number_t& right, number_t& bottom) const
+{
+	if (glowModeFromType(type)==GLOW_INNER)
+		BitmapFilter::getMargins(left,top,right,bottom);
+	else
+	{
+		blurMargins(blurX,blurY,quality,0,0,left,top,right,bottom);
+		left+=fabs(distance);
+		top+=fabs(distance);
+		right+=fabs(distance);
+		bottom+=fabs(distance);
+	}
+}
 ColorMatrixFilter::ColorMatrixFilter(Class_base* c):
 	BitmapFilter(c,SUBTYPE_COLORMATRIXFILTER)
 {
@@ -346,7 +707,6 @@ ColorMatrixFilter::ColorMatrixFilter(Class_base* c):
 ColorMatrixFilter::ColorMatrixFilter(Class_base* c,const COLORMATRIXFILTER& filter):
 	BitmapFilter(c,SUBTYPE_COLORMATRIXFILTER)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"ColorMatrixFilter from Tag");
 	matrix = _MR(Class<Array>::getInstanceSNoArgs(c->getSystemState()));
 	for (uint32_t i = 0; i < 20 ; i++)
 	{
@@ -366,19 +726,33 @@ ASFUNCTIONBODY_GETTER_SETTER(ColorMatrixFilter, matrix);
 ASFUNCTIONBODY_ATOM(ColorMatrixFilter,_constructor)
 {
 	ColorMatrixFilter *th = asAtomHandler::as<ColorMatrixFilter>(obj);
-	ARG_UNPACK_ATOM(th->matrix,NullRef);
-	LOG(LOG_NOT_IMPLEMENTED,"ColorMatrixFilter does nothing");
+	_NR<Array> m;
+	ARG_UNPACK_ATOM(m,NullRef);
+	th->matrix=cloneArray(sys,m);
 }
 
 BitmapFilter* ColorMatrixFilter::cloneImpl() const
 {
 	ColorMatrixFilter *cloned = Class<ColorMatrixFilter>::getInstanceS(getSystemState());
-	if (!matrix.isNull())
+	cloned->matrix = cloneArray(getSystemState(),matrix);
+	return cloned;
+}
+
+void ColorMatrixFilter::applyFilter(uint32_t* data, uint32_t width, uint32_t height, number_t scalex, number_t scaley)
+{
+	if (matrix.isNull() || matrix->size()<20)
+		return;
+	// the pixel kernels use the channels in b,g,r,a order
+	static const uint32_t channelIndex[4]={2,1,0,3};
+	float m[16];
+	float offsets[4];
+	for (uint32_t dst=0;dst<4;dst++)
 	{
-		matrix->incRef();
-		cloned->matrix = matrix;
+		for (uint32_t src=0;src<4;src++)
+			m[channelIndex[src]*4+channelIndex[dst]]=arrayNumber(matrix.getPtr(),dst*5+src);
+		offsets[channelIndex[dst]]=arrayNumber(matrix.getPtr(),dst*5+4);
 	}
-	return cloned;
+	pixelColorMatrixRow(data,data,width*height,m,offsets);
 }
 BlurFilter::BlurFilter(Class_base* c):
 	BitmapFilter(c,SUBTYPE_BLURFILTER),blurX(4.0),blurY(4.0),quality(1)
@@ -387,7 +761,6 @@ BlurFilter::BlurFilter(Class_base* c):
 BlurFilter::BlurFilter(Class_base* c,const BLURFILTER& filter):
 	BitmapFilter(c,SUBTYPE_BLURFILTER),blurX(filter.BlurX),blurY(filter.BlurY),quality(filter.Passes)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"BlurFilter from Tag");
 }
 
 void BlurFilter::sinit(Class_base* c)
@@ -405,7 +778,6 @@ ASFUNCTIONBODY_ATOM(BlurFilter,_constructor)
 {
 	BlurFilter *th = asAtomHandler::as<BlurFilter>(obj);
 	ARG_UNPACK_ATOM(th->blurX,4.0)(th->blurY,4.0)(th->quality,1);
-	LOG(LOG_NOT_IMPLEMENTED,"BlurFilter is not implemented");
 }
 
 BitmapFilter* BlurFilter::cloneImpl() const
@@ -417,6 +789,16 @@ BitmapFilter* BlurFilter::cloneImpl() const
 	return cloned;
 }
 
+void BlurFilter::applyFilter(uint32_t* data, uint32_t width, uint32_t height, number_t scalex, number_t scaley)
+{
+	boxBlur(data,width,height,blurRadius(blurX,scalex),blurRadius(blurY,scaley),blurPasses(quality));
+}
+
+void BlurFilter::getMargins(number_t& left, number_t& top, number_t& right, number_t& bottom) const
+{
+	blurMargins(blurX,blurY,quality,0,0,left,top,right,bottom);
+}
+
 ConvolutionFilter::ConvolutionFilter(Class_base* c):
 	BitmapFilter(c,SUBTYPE_CONVOLUTIONFILTER),
 	alpha(0.0),
@@ -440,7 +822,6 @@ ConvolutionFilter::ConvolutionFilter(Class_base* c, const CONVOLUTIONFILTER& fil
 	matrixY((uint32_t)filter.MatrixY),
 	preserveAlpha(filter.PreserveAlpha)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"ConvolutionFilter from Tag");
 	if (filter.Matrix.size())
 	{
 		matrix = _MR(Class<Array>::getInstanceSNoArgs(c->getSystemState()));
@@ -466,20 +847,30 @@ void ConvolutionFilter::sinit(Class_base* c)
 	REGISTER_GETTER_SETTER(c,matrixY);
 	REGISTER_GETTER_SETTER(c,preserveAlpha);
 }
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(ConvolutionFilter,alpha);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(ConvolutionFilter,bias);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(ConvolutionFilter,clamp);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(ConvolutionFilter,color);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(ConvolutionFilter,divisor);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(ConvolutionFilter,matrix);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(ConvolutionFilter,matrixX);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(ConvolutionFilter,matrixY);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(ConvolutionFilter,preserveAlpha);
+ASFUNCTIONBODY_GETTER_SETTER(ConvolutionFilter,alpha);
+ASFUNCTIONBODY_GETTER_SETTER(ConvolutionFilter,bias);
+ASFUNCTIONBODY_GETTER_SETTER(ConvolutionFilter,clamp);
+ASFUNCTIONBODY_GETTER_SETTER(ConvolutionFilter,color);
+ASFUNCTIONBODY_GETTER_SETTER(ConvolutionFilter,divisor);
+ASFUNCTIONBODY_GETTER_SETTER(ConvolutionFilter,matrix);
+ASFUNCTIONBODY_GETTER_SETTER(ConvolutionFilter,matrixX);
+ASFUNCTIONBODY_GETTER_SETTER(ConvolutionFilter,matrixY);
+ASFUNCTIONBODY_GETTER_SETTER(ConvolutionFilter,preserveAlpha);
 
 ASFUNCTIONBODY_ATOM(ConvolutionFilter,_constructor)
 {
-	//ConvolutionFilter *th = obj.as<ConvolutionFilter>();
-	LOG(LOG_NOT_IMPLEMENTED,"ConvolutionFilter is not implemented");
+	ConvolutionFilter *th = asAtomHandler::as<ConvolutionFilter>(obj);
+	_NR<Array> m;
+	ARG_UNPACK_ATOM (th->matrixX, 0)
+		(th->matrixY, 0)
+		(m, NullRef)
+		(th->divisor, 1.0)
+		(th->bias, 0.0)
+		(th->preserveAlpha, true)
+		(th->clamp, true)
+		(th->color, 0)
+		(th->alpha, 0.0);
+	th->matrix=cloneArray(sys,m);
 }
 
 BitmapFilter* ConvolutionFilter::cloneImpl() const
@@ -490,15 +881,73 @@ BitmapFilter* ConvolutionFilter::cloneImpl() const
 	cloned->clamp = clamp;
 	cloned->color = color;
 	cloned->divisor = divisor;
-	cloned->matrix = matrix;
+	cloned->matrix = cloneArray(getSystemState(),matrix);
 	cloned-> matrixX = matrixX;
 	cloned-> matrixY = matrixY;
 	cloned->preserveAlpha = preserveAlpha;
 	return cloned;
 }
 
+void ConvolutionFilter::applyFilter(uint32_t* data, uint32_t width, uint32_t height, number_t scalex, number_t scaley)
+{
+	uint32_t mx=matrixX>0 ? uint32_t(matrixX) : 0;
+	uint32_t my=matrixY>0 ? uint32_t(matrixY) : 0;
+	if (mx==0 || my==0 || matrix.isNull() || width==0 || height==0)
+		return;
+	vector<float> weights(mx*my,0);
+	for (uint32_t i=0;i<weights.size() && i<matrix->size();i++)
+		weights[i]=arrayNumber(matrix.getPtr(),i);
+	vector<float> source(width*height*4);
+	pixelUnpremultiplyRow(data,source.data(),width*height);
+	// the source is padded with the edge pixels or the default color
+	uint32_t ox=mx/2;
+	uint32_t oy=my/2;
+	uint32_t paddedWidth=width+mx-1;
+	uint32_t paddedHeight=height+my-1;
+	float outside[4]={float(color&0xff),float((color>>8)&0xff),float((color>>16)&0xff),float(clamp8(alpha*255))};
+	vector<float> padded(paddedWidth*paddedHeight*4);
+	for (uint32_t py=0;py<paddedHeight;py++)
+	{
+		int32_t sy=int32_t(py)-int32_t(oy);
+		bool insideY=sy>=0 && sy<int32_t(height);
+		sy=max(0,min(sy,int32_t(height)-1));
+		for (uint32_t px=0;px<paddedWidth;px++)
+		{
+			int32_t sx=int32_t(px)-int32_t(ox);
+			bool insideX=sx>=0 && sx<int32_t(width);
+			sx=max(0,min(sx,int32_t(width)-1));
+			const float* p=(clamp || (insideX && insideY)) ? &source[(sy*width+sx)*4] : outside;
+			memcpy(&padded[(py*paddedWidth+px)*4],p,4*sizeof(float));
+		}
+	}
+	float scale=divisor!=0 ? 1.0/divisor : 1.0;
+	vector<float> row(width*4);
+	for (uint32_t y=0;y<height;y++)
+	{
+		pixelConvolveRow(&padded[y*paddedWidth*4],paddedWidth*4,row.data(),width,weights.data(),mx,my,scale,bias);
+		if (preserveAlpha)
+		{
+			for (uint32_t x=0;x<width;x++)
+				row[x*4+3]=source[(y*width+x)*4+3];
+		}
+		pixelPremultiplyRow(row.data(),data+y*width,width);
+	}
+}
+
 DisplacementMapFilter::DisplacementMapFilter(Class_base* c):
-	BitmapFilter(c,SUBTYPE_DISPLACEMENTFILTER)
+	BitmapFilter(c,SUBTYPE_DISPLACEMENTFILTER),
+	hasMapSnapshot(false),
+	mapWidth(0),
+	mapHeight(0),
+	mapX(0),
+	mapY(0),
+	alpha(0.0),
+	color(0),
+	componentX(0),
+	componentY(0),
+	mode("wrap"),
+	scaleX(0.0),
+	scaleY(0.0)
 {
 }
 
@@ -515,20 +964,28 @@ void DisplacementMapFilter::sinit(Class_base* c)
 	REGISTER_GETTER_SETTER(c,scaleX);
 	REGISTER_GETTER_SETTER(c,scaleY);
 }
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(DisplacementMapFilter,alpha);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(DisplacementMapFilter,color);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(DisplacementMapFilter,componentX);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(DisplacementMapFilter,componentY);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(DisplacementMapFilter,mapBitmap);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(DisplacementMapFilter,mapPoint);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(DisplacementMapFilter,mode);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(DisplacementMapFilter,scaleX);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(DisplacementMapFilter,scaleY);
+ASFUNCTIONBODY_GETTER_SETTER(DisplacementMapFilter,alpha);
+ASFUNCTIONBODY_GETTER_SETTER(DisplacementMapFilter,color);
+ASFUNCTIONBODY_GETTER_SETTER(DisplacementMapFilter,componentX);
+ASFUNCTIONBODY_GETTER_SETTER(DisplacementMapFilter,componentY);
+ASFUNCTIONBODY_GETTER_SETTER(DisplacementMapFilter,mapBitmap);
+ASFUNCTIONBODY_GETTER_SETTER(DisplacementMapFilter,mapPoint);
+ASFUNCTIONBODY_GETTER_SETTER(DisplacementMapFilter,mode);
+ASFUNCTIONBODY_GETTER_SETTER(DisplacementMapFilter,scaleX);
+ASFUNCTIONBODY_GETTER_SETTER(DisplacementMapFilter,scaleY);
 
 ASFUNCTIONBODY_ATOM(DisplacementMapFilter,_constructor)
 {
-	//DisplacementMapFilter *th = obj.as<DisplacementMapFilter>();
-	LOG(LOG_NOT_IMPLEMENTED,"DisplacementMapFilter is not implemented");
+	DisplacementMapFilter *th = asAtomHandler::as<DisplacementMapFilter>(obj);
+	ARG_UNPACK_ATOM (th->mapBitmap, NullRef)
+		(th->mapPoint, NullRef)
+		(th->componentX, 0)
+		(th->componentY, 0)
+		(th->scaleX, 0.0)
+		(th->scaleY, 0.0)
+		(th->mode, "wrap")
+		(th->color, 0)
+		(th->alpha, 0.0);
 }
 
 BitmapFilter* DisplacementMapFilter::cloneImpl() const
@@ -546,6 +1003,104 @@ BitmapFilter* DisplacementMapFilter::cloneImpl() const
 	return cloned;
 }
 
+BitmapFilter* DisplacementMapFilter::cloneFilter() const
+{
+	DisplacementMapFilter* cloned=static_cast<DisplacementMapFilter*>(cloneImpl());
+	// AS code may change the map while the clone is applied in another thread
+	cloned->mapBitmap.reset();
+	cloned->mapPoint.reset();
+	snapshotMap(cloned->mapPixels,cloned->mapWidth,cloned->mapHeight,cloned->mapX,cloned->mapY);
+	cloned->hasMapSnapshot=true;
+	return cloned;
+}
+
+void DisplacementMapFilter::snapshotMap(std::vector<uint32_t>& pixels, int32_t& width, int32_t& height, int32_t& x, int32_t& y) const
+{
+	width=height=0;
+	x=mapPoint.isNull() ? 0 : mapPoint->getX();
+	y=mapPoint.isNull() ? 0 : mapPoint->getY();
+	if (mapBitmap.isNull())
+		return;
+	_NR<BitmapContainer> map=mapBitmap->getBitmapContainer();
+	if (map.isNull() || map->isEmpty())
+		return;
+	width=map->getWidth();
+	height=map->getHeight();
+	pixels=map->getPixelVector(RECT(0,width,0,height),false);
+}
+
+void DisplacementMapFilter::applyFilter(uint32_t* data, uint32_t width, uint32_t height, number_t scalex, number_t scaley)
+{
+	if (width==0 || height==0)
+		return;
+	std::vector<uint32_t> localPixels;
+	int32_t mw,mh,px,py;
+	const std::vector<uint32_t>* map=&mapPixels;
+	if (hasMapSnapshot)
+	{
+		mw=mapWidth;
+		mh=mapHeight;
+		px=mapX;
+		py=mapY;
+	}
+	else
+	{
+		snapshotMap(localPixels,mw,mh,px,py);
+		map=&localPixels;
+	}
+	if (mw==0 || mh==0)
+		return;
+	// BitmapDataChannel values are 1 (red), 2 (green), 4 (blue) and 8 (alpha)
+	auto channelShift=[](uint32_t component) -> int32_t
+	{
+		switch (component)
+		{
+			case 1: return 16;
+			case 2: return 8;
+			case 4: return 0;
+			case 8: return 24;
+		}
+		return -1;
+	};
+	int32_t shiftX=channelShift(componentX);
+	int32_t shiftY=channelShift(componentY);
+	uint32_t outside=premultipliedColor(color,clamp8(alpha*255));
+	vector<uint32_t> source(data,data+width*height);
+	int32_t w=width;
+	int32_t h=height;
+	for (int32_t y=0;y<h;y++)
+	{
+		for (int32_t x=0;x<w;x++)
+		{
+			int32_t dx=0;
+			int32_t dy=0;
+			int32_t mx=x-px;
+			int32_t my=y-py;
+			if (mx>=0 && my>=0 && mx<mw && my<mh)
+			{
+				uint32_t m=(*map)[my*mw+mx];
+				if (shiftX>=0)
+					dx=lrint(((int32_t((m>>shiftX)&0xff)-128)*scaleX/256)*scalex);
+				if (shiftY>=0)
+					dy=lrint(((int32_t((m>>shiftY)&0xff)-128)*scaleY/256)*scaley);
+			}
+			int32_t sx=x+dx;
+			int32_t sy=y+dy;
+			uint32_t& out=data[y*width+x];
+			if (sx>=0 && sy>=0 && sx<w && sy<h)
+				out=source[sy*width+sx];
+			else if (mode=="clamp")
+				out=source[max(0,min(sy,h-1))*width+max(0,min(sx,w-1))];
+			else if (mode=="ignore")
+				out=source[y*width+x];
+			else if (mode=="color")
+				out=outside;
+			else
+				out=source[((sy%h+h)%h)*width+((sx%w+w)%w)];
+		}
+	}
+}
+
 GradientBevelFilter::GradientBevelFilter(Class_base* c):
 	BitmapFilter(c,SUBTYPE_GRADIENTBEVELFILTER),
 	angle(45),
@@ -569,7 +1124,6 @@ GradientBevelFilter::GradientBevelFilter(Class_base* c, const GRADIENTBEVELFILTE
 	strength(filter.Strength),
 	type("inner") // TODO: is type set based on "onTop" ?
 {
-	LOG(LOG_NOT_IMPLEMENTED,"GradientBevelFilter from Tag");
 	if (filter.GradientColors.size())
 	{
 		colors = _MR(Class<Array>::getInstanceSNoArgs(c->getSystemState()));
@@ -611,41 +1165,93 @@ void GradientBevelFilter::sinit(Class_base* c)
 	REGISTER_GETTER_SETTER(c,type);
 }
 
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(GradientBevelFilter,alphas);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(GradientBevelFilter,angle);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(GradientBevelFilter,blurX);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(GradientBevelFilter,blurY);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(GradientBevelFilter,colors);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(GradientBevelFilter,distance);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(GradientBevelFilter,knockout);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(GradientBevelFilter,quality);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(GradientBevelFilter,ratios);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(GradientBevelFilter,strength);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(GradientBevelFilter,type);
+ASFUNCTIONBODY_GETTER_SETTER(GradientBevelFilter,alphas);
+ASFUNCTIONBODY_GETTER_SETTER(GradientBevelFilter,angle);
+ASFUNCTIONBODY_GETTER_SETTER(GradientBevelFilter,blurX);
+ASFUNCTIONBODY_GETTER_SETTER(GradientBevelFilter,blurY);
+ASFUNCTIONBODY_GETTER_SETTER(GradientBevelFilter,colors);
+ASFUNCTIONBODY_GETTER_SETTER(GradientBevelFilter,distance);
+ASFUNCTIONBODY_GETTER_SETTER(GradientBevelFilter,knockout);
+ASFUNCTIONBODY_GETTER_SETTER(GradientBevelFilter,quality);
+ASFUNCTIONBODY_GETTER_SETTER(GradientBevelFilter,ratios);
+ASFUNCTIONBODY_GETTER_SETTER(GradientBevelFilter,strength);
+ASFUNCTIONBODY_GETTER_SETTER(GradientBevelFilter,type);
 
 ASFUNCTIONBODY_ATOM(GradientBevelFilter,_constructor)
 {
-	//GradientBevelFilter *th = obj.as<GradientBevelFilter>();
-	LOG(LOG_NOT_IMPLEMENTED,"GradientBevelFilter is not implemented");
+	GradientBevelFilter *th = asAtomHandler::as<GradientBevelFilter>(obj);
+	_NR<Array> c;
+	_NR<Array> a;
+	_NR<Array> r;
+	ARG_UNPACK_ATOM (th->distance, 4.0)
+		(th->angle, 45)
+		(c, NullRef)
+		(a, NullRef)
+		(r, NullRef)
+		(th->blurX, 4.0)
+		(th->blurY, 4.0)
+		(th->strength, 1)
+		(th->quality, 1)
+		(th->type, "inner")
+		(th->knockout, false);
+	th->colors=cloneArray(sys,c);
+	th->alphas=cloneArray(sys,a);
+	th->ratios=cloneArray(sys,r);
 }
 
 BitmapFilter* GradientBevelFilter::cloneImpl() const
 {
 	GradientBevelFilter* cloned = Class<GradientBevelFilter>::getInstanceS(getSystemState());
-	cloned->alphas = alphas;
+	cloned->alphas = cloneArray(getSystemState(),alphas);
 	cloned->angle = angle;
 	cloned->blurX = blurX;
 	cloned->blurY = blurY;
-	cloned->colors = colors;
+	cloned->colors = cloneArray(getSystemState(),colors);
 	cloned->distance = distance;
 	cloned->knockout = knockout;
 	cloned->quality = quality;
-	cloned->ratios = ratios;
+	cloned->ratios = cloneArray(getSystemState(),ratios);
 	cloned->strength = strength;
 	cloned->type = type;
 	return cloned;
 }
 
+void GradientBevelFilter::applyFilter(uint32_t* data, uint32_t width, uint32_t height, number_t scalex, number_t scaley)
+{
+	uint32_t palette[256];
+	buildGradientPalette(colors,alphas,ratios,palette);
+	int32_t dx,dy;
+	shadowOffset(distance,angle,scalex,scaley,dx,dy);
+	uint32_t radiusX=blurRadius(blurX,scalex);
+	uint32_t radiusY=blurRadius(blurY,scaley);
+	int32_t passes=blurPasses(quality);
+	vector<uint32_t> shadowSide;
+	vector<uint32_t> highlightSide;
+	blurredAlpha(data,width,height,dx,dy,radiusX,radiusY,passes,shadowSide);
+	blurredAlpha(data,width,height,-dx,-dy,radiusX,radiusY,passes,highlightSide);
+	// the highlight uses the start of the gradient, the shadow its end
+	for (uint32_t i=0;i<shadowSide.size();i++)
+	{
+		number_t v=(int32_t(shadowSide[i]>>24)-int32_t(highlightSide[i]>>24))*strength;
+		shadowSide[i]=palette[clamp8(128+v/2)];
+	}
+	compositeGlow(data,shadowSide,glowModeFromType(type),knockout,false);
+}
+
+void GradientBevelFilter::getMargins(number_t& left, number_t& top, number_t& right, number_t& bottom) const
+{
+	if (glowModeFromType(type)==GLOW_INNER)
+		BitmapFilter::getMargins(left,top,right,bottom);
+	else
+	{
+		blurMargins(blurX,blurY,quality,0,0,left,top,right,bottom);
+		left+=fabs(distance);
+		top+=fabs(distance);
+		right+=fabs(distance);
+		bottom+=fabs(distance);
+	}
+}
+
 ShaderFilter::ShaderFilter(Class_base* c):
 	BitmapFilter(c,SUBTYPE_SHADERFILTER)
 {
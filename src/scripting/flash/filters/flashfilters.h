@@ -34,6 +34,20 @@ public:
 	BitmapFilter(Class_base* c, CLASS_SUBTYPE st=SUBTYPE_BITMAPFILTER):ASObject(c,T_OBJECT,st){}
 	static void sinit(Class_base* c);
 	ASFUNCTION_ATOM(clone);
+	/*
+	 * Returns a copy of the filter for rendering. It must not share mutable
+	 * objects with this filter, as it is applied in a worker thread
+	 */
+	virtual BitmapFilter* cloneFilter() const { return cloneImpl(); }
+	/*
+	 * Applies the filter in place to width*height premultiplied ARGB pixels.
+	 * scalex and scaley convert the distances of the filter to pixels of the buffer
+	 */
+	virtual void applyFilter(uint32_t* data, uint32_t width, uint32_t height, number_t scalex, number_t scaley);
+	/*
+	 * How far the filtered image may extend beyond the unfiltered one on each side
+	 */
+	virtual void getMargins(number_t& left, number_t& top, number_t& right, number_t& bottom) const;
 };
 
 class GlowFilter: public BitmapFilter
@@ -53,6 +67,8 @@ public:
 	GlowFilter(Class_base* c,const GLOWFILTER& filter);
 	static void sinit(Class_base* c);
 	ASFUNCTION_ATOM(_constructor);
+	void applyFilter(uint32_t* data, uint32_t width, uint32_t height, number_t scalex, number_t scaley) override;
+	void getMargins(number_t& left, number_t& top, number_t& right, number_t& bottom) const override;
 };
 
 class DropShadowFilter: public BitmapFilter
@@ -75,6 +91,8 @@ public:
 	DropShadowFilter(Class_base* c,const DROPSHADOWFILTER& filter);
 	static void sinit(Class_base* c);
 	ASFUNCTION_ATOM(_constructor);
+	void applyFilter(uint32_t* data, uint32_t width, uint32_t height, number_t scalex, number_t scaley) override;
+	void getMargins(number_t& left, number_t& top, number_t& right, number_t& bottom) const override;
 };
 
 class GradientGlowFilter: public BitmapFilter
@@ -86,6 +104,8 @@ public:
 	GradientGlowFilter(Class_base* c, const GRADIENTGLOWFILTER& filter);
 	static void sinit(Class_base* c);
 	ASFUNCTION_ATOM(_constructor);
+	void applyFilter(uint32_t* data, uint32_t width, uint32_t height, number_t scalex, number_t scaley) override;
+	void getMargins(number_t& left, number_t& top, number_t& right, number_t& bottom) const override;
 	ASPROPERTY_GETTER_SETTER(number_t,distance);
 	ASPROPERTY_GETTER_SETTER(number_t, angle);
 	ASPROPERTY_GETTER_SETTER(_NR<Array>,colors);
@@ -108,6 +128,8 @@ public:
 	BevelFilter(Class_base* c,const BEVELFILTER& filter);
 	static void sinit(Class_base* c);
 	ASFUNCTION_ATOM(_constructor);
+	void applyFilter(uint32_t* data, uint32_t width, uint32_t height, number_t scalex, number_t scaley) override;
+	void getMargins(number_t& left, number_t& top, number_t& right, number_t& bottom) const override;
 	ASPROPERTY_GETTER_SETTER(number_t, angle);
 	ASPROPERTY_GETTER_SETTER(number_t,blurX);
 	ASPROPERTY_GETTER_SETTER(number_t,blurY);
@@ -130,6 +152,7 @@ public:
 	ColorMatrixFilter(Class_base* c,const COLORMATRIXFILTER& filter);
 	static void sinit(Class_base* c);
 	ASFUNCTION_ATOM(_constructor);
+	void applyFilter(uint32_t* data, uint32_t width, uint32_t height, number_t scalex, number_t scaley) override;
 	ASPROPERTY_GETTER_SETTER(_NR<Array>, matrix);
 };
 class BlurFilter: public BitmapFilter
@@ -141,6 +164,8 @@ public:
 	BlurFilter(Class_base* c,const BLURFILTER& filter);
 	static void sinit(Class_base* c);
 	ASFUNCTION_ATOM(_constructor);
+	void applyFilter(uint32_t* data, uint32_t width, uint32_t height, number_t scalex, number_t scaley) override;
+	void getMargins(number_t& left, number_t& top, number_t& right, number_t& bottom) const override;
 	ASPROPERTY_GETTER_SETTER(number_t, blurX);
 	ASPROPERTY_GETTER_SETTER(number_t, blurY);
 	ASPROPERTY_GETTER_SETTER(int, quality);
@@ -154,6 +179,7 @@ public:
 	ConvolutionFilter(Class_base* c,const CONVOLUTIONFILTER& filter);
 	static void sinit(Class_base* c);
 	ASFUNCTION_ATOM(_constructor);
+	void applyFilter(uint32_t* data, uint32_t width, uint32_t height, number_t scalex, number_t scaley) override;
 	ASPROPERTY_GETTER_SETTER(number_t,alpha);
 	ASPROPERTY_GETTER_SETTER(number_t,bias);
 	ASPROPERTY_GETTER_SETTER(bool, clamp);
@@ -168,10 +194,20 @@ class DisplacementMapFilter: public BitmapFilter
 {
 private:
 	BitmapFilter* cloneImpl() const override;
+	/* unpremultiplied copy of mapBitmap and mapPoint, taken when cloned for rendering */
+	bool hasMapSnapshot;
+	std::vector<uint32_t> mapPixels;
+	int32_t mapWidth;
+	int32_t mapHeight;
+	int32_t mapX;
+	int32_t mapY;
+	void snapshotMap(std::vector<uint32_t>& pixels, int32_t& width, int32_t& height, int32_t& x, int32_t& y) const;
 public:
 	DisplacementMapFilter(Class_base* c);
 	static void sinit(Class_base* c);
 	ASFUNCTION_ATOM(_constructor);
+	BitmapFilter* cloneFilter() const override;
+	void applyFilter(uint32_t* data, uint32_t width, uint32_t height, number_t scalex, number_t scaley) override;
 	ASPROPERTY_GETTER_SETTER(number_t,alpha);
 	ASPROPERTY_GETTER_SETTER(uint32_t,color);
 	ASPROPERTY_GETTER_SETTER(uint32_t,componentX);
@@ -191,6 +227,8 @@ public:
 	GradientBevelFilter(Class_base* c, const GRADIENTBEVELFILTER& filter);
 	static void sinit(Class_base* c);
 	ASFUNCTION_ATOM(_constructor);
+	void applyFilter(uint32_t* data, uint32_t width, uint32_t height, number_t scalex, number_t scaley) override;
+	void getMargins(number_t& left, number_t& top, number_t& right, number_t& bottom) const override;
 	ASPROPERTY_GETTER_SETTER(_NR<Array>, alphas);
 	ASPROPERTY_GETTER_SETTER(number_t, angle);
 	ASPROPERTY_GETTER_SETTER(number_t, blurX);
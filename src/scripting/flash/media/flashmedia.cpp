@@ -25,6 +25,7 @@
 #include "backends/audio.h"
 #include "backends/rendering.h"
 #include "backends/streamcache.h"
+#include "platforms/audiokernels.h"
 #include "scripting/argconv.h"
 #include <unistd.h>
 
@@ -358,14 +359,14 @@ _NR<DisplayObject> Video::hitTestImpl(_NR<DisplayObject> last, number_t x, numbe
 }
 
 Sound::Sound(Class_base* c)
-	:EventDispatcher(c),downloader(nullptr),soundData(new MemoryStreamCache(c->getSystemState())),rawDataStreamDecoder(nullptr),rawDataStartPosition(0),
+	:EventDispatcher(c),downloader(nullptr),soundData(new MemoryStreamCache(c->getSystemState())),extractor(nullptr),
 	 container(true),format(CODEC_NONE, 0, 0),bytesLoaded(0),bytesTotal(0),length(-1)
 {
 	subtype=SUBTYPE_SOUND;
 }
 
 Sound::Sound(Class_base* c, _R<StreamCache> data, AudioFormat _format, number_t duration_in_ms)
-	:EventDispatcher(c),downloader(nullptr),soundData(data),rawDataStreamDecoder(nullptr),rawDataStartPosition(0),
+	:EventDispatcher(c),downloader(nullptr),soundData(data),extractor(nullptr),
 	 container(false),format(_format),
 	 bytesLoaded(soundData->getReceivedLength()),
 	 bytesTotal(soundData->getReceivedLength()),length(duration_in_ms)
@@ -377,9 +378,19 @@ Sound::~Sound()
 {
 	if(downloader && getSystemState()->downloadManager)
 		getSystemState()->downloadManager->destroy(downloader);
-	if (rawDataStreamDecoder)
-		delete rawDataStreamDecoder;
-	rawDataStreamDecoder=nullptr;
+#ifdef ENABLE_LIBAVCODEC
+	delete extractor;
+#endif
+}
+
+void Sound::setSoundData(_R<StreamCache> data)
+{
+	soundData = data;
+#ifdef ENABLE_LIBAVCODEC
+	// the extractor decodes the previous data
+	delete extractor;
+	extractor = nullptr;
+#endif
 }
 
 void Sound::sinit(Class_base* c)
@@ -416,7 +427,7 @@ ASFUNCTIONBODY_ATOM(Sound,load)
 		urlRequest->getPostData(th->postData);
 	}
 	_R<StreamCache> c(_MR(new MemoryStreamCache(th->getSystemState())));
-	th->soundData = c;
+	th->setSoundData(c);
 
 	if(!th->url.isValid())
 	{
@@ -480,7 +491,8 @@ ASFUNCTIONBODY_ATOM(Sound,play)
  			th->soundChannel->play(startTime);
 			return;
 		}
-		SoundChannel* s = Class<SoundChannel>::getInstanceS(sys,th->soundData, th->format);
+		// sounds with a given format are created from DefineSound tags
+		SoundChannel* s = Class<SoundChannel>::getInstanceS(sys,th->soundData, th->format,true,true);
 		s->setStartTime(startTime);
 		ret = asAtomHandler::fromObjectNoPrimitive(s);
 	}
@@ -499,69 +511,34 @@ ASFUNCTIONBODY_ATOM(Sound,extract)
 {
 	Sound* th=asAtomHandler::as<Sound>(obj);
 	_NR<ByteArray> target;
-	int32_t length;
-	int32_t startPosition;
+	number_t length;
+	number_t startPosition;
 	ARG_UNPACK_ATOM(target)(length)(startPosition,-1);
-	int32_t readcount=0;
-	if (!target.isNull())
-	{
-		std::streambuf *sbuf = th->soundData->createReader();
-		istream s(sbuf);
-		s.exceptions ( istream::failbit | istream::badbit );
-		
-		int32_t readcount=0;
-		try
-		{
+	uint32_t readcount=0;
 #ifdef ENABLE_LIBAVCODEC
-			if (th->rawDataStreamDecoder && startPosition >= 0)
-			{
-				delete th->rawDataStreamDecoder;
-				th->rawDataStreamDecoder= nullptr;
-			}
-			if (startPosition < 0)
-				startPosition = th->rawDataStartPosition;
-			if (th->rawDataStreamDecoder== nullptr)
-				th->rawDataStreamDecoder=new FFMpegStreamDecoder(nullptr,sys->getEngineData(),s,&th->format,th->soundData->hasTerminated() ? th->soundData->getReceivedLength() : -1);
-			if(!th->rawDataStreamDecoder->isValid())
-			{
-				LOG(LOG_ERROR,"invalid streamDecoder");
-				delete th->rawDataStreamDecoder;
-				th->rawDataStreamDecoder=nullptr;
-			}
-			else
-			{
-				uint8_t* data = new uint8_t[length];
-				while(true)
-				{
-					bool decodingSuccess=th->rawDataStreamDecoder->decodeNextFrame();
-					if(decodingSuccess==false || !th->rawDataStreamDecoder->audioDecoder)
-						break;
-					if(th->rawDataStreamDecoder->audioDecoder)
-					{
-						uint8_t buf[MAX_AUDIO_FRAME_SIZE];
-						uint32_t read = th->rawDataStreamDecoder->audioDecoder->copyFrame((int16_t *)buf, MAX_AUDIO_FRAME_SIZE);
-						th->rawDataStartPosition += min(read,uint32_t(length-readcount));
-						if (th->rawDataStartPosition > startPosition)
-						{
-							memcpy(data+readcount,buf,min(read,uint32_t(length-readcount)));
-							readcount+=read;
-						}
-						if (th->rawDataStartPosition-startPosition >= length)
-							break;
-					}
-				}
-				target->writeBytes(data,readcount);
-				delete[] data;
-			}
-#endif //ENABLE_LIBAVCODEC
-		}
-		catch(exception& e)
+	if (!target.isNull() && length >= 1)
+	{
+		if (!th->extractor)
+			th->extractor=new AudioExtractor(sys->getEngineData(),th->soundData,th->format);
+		// without a startPosition extraction continues where the last call stopped
+		uint64_t position = startPosition >= 0 ? uint64_t(startPosition) : th->extractor->getPosition();
+		uint32_t frames = length < UINT32_MAX ? uint32_t(length) : UINT32_MAX;
+		float buf[2*4096];
+		while (readcount < frames)
 		{
-			LOG(LOG_ERROR, _("Exception in extracting sound data: ")<<e.what());
+			uint32_t read = th->extractor->extract(buf, min(frames-readcount, uint32_t(4096)), position+readcount);
+			if (!read)
+				break;
+			// the samples are written like writeFloat does
+			uint32_t* values = reinterpret_cast<uint32_t*>(buf);
+			for (uint32_t i = 0; i < read*2; i++)
+				values[i] = target->endianIn(values[i]);
+			target->writeBytes(reinterpret_cast<uint8_t*>(buf),read*8);
+			readcount += read;
 		}
-		delete sbuf;
 	}
-	ret = asAtomHandler::fromInt(readcount);
+#endif //ENABLE_LIBAVCODEC
+	ret = asAtomHandler::fromUInt(readcount);
 }
 
 ASFUNCTIONBODY_ATOM(Sound,loadCompressedDataFromByteArray)
@@ -572,7 +549,7 @@ ASFUNCTIONBODY_ATOM(Sound,loadCompressedDataFromByteArray)
 
 	ARG_UNPACK_ATOM(bytes)(bytesLength);
 	_R<StreamCache> c(_MR(new MemoryStreamCache(th->getSystemState())));
-	th->soundData = c;
+	th->setSoundData(c);
 	if (bytes)
 	{
 		uint8_t* buf = new uint8_t[bytesLength];
@@ -678,12 +655,54 @@ ASFUNCTIONBODY_ATOM(SoundMixer,computeSpectrum)
 	bool FFTMode;
 	int stretchFactor;
 	ARG_UNPACK_ATOM (output) (FFTMode,false) (stretchFactor,0);
+	if (output.isNull())
+		throwError<TypeError>(kNullPointerError);
+	// 512 frames of the mixer output are used, taken every 2^stretchFactor frames
+	const uint32_t size = 512;
+	uint32_t stride = 1<<min(max(stretchFactor,0),2);
+	int16_t history[size*4*2];
+	float samples[size*4*2];
+	sys->audioManager->getMixedHistory(history, size*stride);
+	audioS16ToFloat(history, samples, size*stride*2);
+	float left[size];
+	float right[size];
+	for (uint32_t i = 0; i < size; i++)
+	{
+		left[i] = samples[i*stride*2];
+		right[i] = samples[i*stride*2+1];
+	}
+	// 256 values for each channel
+	float result[size];
+	if (FFTMode)
+	{
+		// both channels are transformed at once as real and imaginary part and separated afterwards
+		static const AudioFFT fft(size);
+		fft.transform(left, right);
+		for (uint32_t k = 0; k < size/2; k++)
+		{
+			uint32_t n = (size-k)%size;
+			float lr = (left[k]+left[n])/2;
+			float li = (right[k]-right[n])/2;
+			float rr = (right[k]+right[n])/2;
+			float ri = (left[n]-left[k])/2;
+			// a full scale sine results in 1
+			result[k] = sqrtf(lr*lr+li*li)*2/size;
+			result[size/2+k] = sqrtf(rr*rr+ri*ri)*2/size;
+		}
+	}
+	else
+	{
+		// the most recent samples
+		memcpy(result, left+size/2, size/2*sizeof(float));
+		memcpy(result+size/2, right+size/2, size/2*sizeof(float));
+	}
+	uint32_t* values = reinterpret_cast<uint32_t*>(result);
+	for (uint32_t i = 0; i < size; i++)
+		values[i] = output->endianIn(values[i]);
 	output->setLength(0);
 	output->setPosition(0);
-	for (int i = 0; i < 4*512; i++) // 512 floats
-		output->writeByte(0);
+	output->writeBytes(reinterpret_cast<uint8_t*>(result), size*sizeof(float));
 	output->setPosition(0);
-	LOG(LOG_NOT_IMPLEMENTED,"SoundMixer.computeSpectrum not implemented");
 }
 
 void SoundLoaderContext::sinit(Class_base* c)
@@ -706,9 +725,9 @@ ASFUNCTIONBODY_ATOM(SoundLoaderContext,_constructor)
 ASFUNCTIONBODY_GETTER_SETTER(SoundLoaderContext,bufferTime);
 ASFUNCTIONBODY_GETTER_SETTER(SoundLoaderContext,checkPolicyFile);
 
-SoundChannel::SoundChannel(Class_base* c, _NR<StreamCache> _stream, AudioFormat _format, bool autoplay)
+SoundChannel::SoundChannel(Class_base* c, _NR<StreamCache> _stream, AudioFormat _format, bool autoplay, bool _embedded)
 	: EventDispatcher(c),stream(_stream),stopped(true),terminated(true),audioDecoder(nullptr),audioStream(nullptr),
-	format(_format),oldVolume(-1.0),startTime(0),restartafterabort(false),soundTransform(_MR(Class<SoundTransform>::getInstanceS(c->getSystemState()))),
+	format(_format),startTime(0),restartafterabort(false),streaming(false),embedded(_embedded),soundTransform(_MR(Class<SoundTransform>::getInstanceS(c->getSystemState()))),
 	leftPeak(1),rightPeak(1)
 {
 	subtype=SUBTYPE_SOUNDCHANNEL;
@@ -722,6 +741,7 @@ SoundChannel::~SoundChannel()
 
 void SoundChannel::appendStreamBlock(unsigned char *buf, int len)
 {
+	streaming=true;
 	if (stream)
 		SoundStreamBlockTag::decodeSoundBlock(stream.getPtr(),format.codec,buf,len);
 }
@@ -729,6 +749,8 @@ void SoundChannel::appendStreamBlock(unsigned char *buf, int len)
 void SoundChannel::play(number_t starttime)
 {
 	mutex.lock();
+	// sounds played from decoded samples have no job to wait for
+	stopDecodedSound();
 	if (!ACQUIRE_READ(stopped))
 	{
 		RELEASE_WRITE(stopped,true);
@@ -761,7 +783,7 @@ void SoundChannel::play(number_t starttime)
 		mutex.lock();
 		restartafterabort=false;
 		startTime = starttime;
-		if (!stream.isNull() && ACQUIRE_READ(stopped))
+		if (!stream.isNull() && ACQUIRE_READ(stopped) && !playDecodedSound())
 		{
 			// Start playback
 			incRef();
@@ -774,7 +796,8 @@ void SoundChannel::play(number_t starttime)
 }
 void SoundChannel::resume()
 {
-	if (!stream.isNull() && ACQUIRE_READ(stopped))
+	Locker l(mutex);
+	if (!stream.isNull() && ACQUIRE_READ(stopped) && !playDecodedSound())
 	{
 		// Start playback
 		incRef();
@@ -784,6 +807,79 @@ void SoundChannel::resume()
 	}
 }
 
+/*
+ * Short embedded sounds are decoded once by the AudioManager and played from memory,
+ * without a job decoding them again. Called with mutex locked
+ */
+bool SoundChannel::playDecodedSound()
+{
+	AudioManager* manager = getSystemState()->audioManager;
+	if (!manager || !embedded || streaming || format.codec == CODEC_NONE || format.codec == LINEAR_PCM_FLOAT_BE
+			|| !stream->hasTerminated() || stream->hasFailed())
+		return false;
+	_NR<DecodedSound> sound = manager->getDecodedSound(stream, format);
+	if (sound.isNull())
+		return false;
+	AudioStream* s = manager->createStream(sound, this, startTime);
+	if (!s)
+		return false;
+	// released when the stream is deleted, the listener can't run before mutex is unlocked
+	incRef();
+	audioStream = s;
+	RELEASE_WRITE(stopped,false);
+	applySoundTransform();
+	return true;
+}
+
+/*
+ * Stops a stream started by playDecodedSound, returns false if no such stream is playing.
+ * Called with mutex locked
+ */
+bool SoundChannel::stopDecodedSound()
+{
+	if (!audioStream || !audioStream->isDecodedSound())
+		return false;
+	AudioStream* s = audioStream;
+	audioStream=nullptr;
+	RELEASE_WRITE(stopped,true);
+	startTime = s->getPlayedTime();
+	// if the mixer already removed the stream, audioStreamFinished will delete it
+	if (getSystemState()->audioManager->detachStream(s))
+	{
+		delete s;
+		releaseDecodedSoundRef();
+	}
+	return true;
+}
+
+void SoundChannel::releaseDecodedSoundRef()
+{
+	// ensure that this is moved to freelist in vm thread
+	if (getVm(getSystemState()))
+		getVm(getSystemState())->addDeletableObject(this);
+	else
+		this->decRef();
+}
+
+void SoundChannel::audioStreamFinished(AudioStream* s, bool completed)
+{
+	mutex.lock();
+	if (audioStream == s)
+	{
+		audioStream=nullptr;
+		startTime=0;
+		RELEASE_WRITE(stopped,true);
+		if (completed)
+		{
+			incRef();
+			getVm(getSystemState())->addEvent(_MR(this),_MR(Class<Event>::getInstanceS(getSystemState(),"soundComplete")));
+		}
+	}
+	mutex.unlock();
+	delete s;
+	releaseDecodedSoundRef();
+}
+
 void SoundChannel::markFinished()
 {
 	if (stream)
@@ -823,6 +919,23 @@ void SoundChannel::validateSoundTransform(_NR<SoundTransform> oldValue)
 		soundTransform = oldValue;
 		throwError<TypeError>(kNullPointerError, "soundTransform");
 	}
+	Locker l(mutex);
+	applySoundTransform();
+}
+
+/*
+ * Passes volume and panning of soundTransform to the mixer, called with mutex locked
+ */
+void SoundChannel::applySoundTransform()
+{
+	if (!audioStream || soundTransform.isNull())
+		return;
+	audioStream->setVolume(soundTransform->volume);
+	number_t pan = soundTransform->pan;
+	number_t left = pan > 0 ? 1.0-pan : 1.0;
+	number_t right = pan < 0 ? 1.0+pan : 1.0;
+	audioStream->setPanning(soundTransform->leftToLeft*left, soundTransform->leftToRight*right,
+				soundTransform->rightToLeft*left, soundTransform->rightToRight*right);
 }
 
 ASFUNCTIONBODY_ATOM(SoundChannel,_constructor)
@@ -901,12 +1014,8 @@ void SoundChannel::playStream()
 
 			if(audioStream)
 			{
-				//TODO: use soundTransform->pan
-				if(soundTransform && soundTransform->volume != oldVolume)
-				{
-					audioStream->setVolume(soundTransform->volume);
-					oldVolume = soundTransform->volume;
-				}
+				Locker l(mutex);
+				applySoundTransform();
 			}
 			
 			if(threadAborting)
@@ -981,6 +1090,11 @@ void SoundChannel::jobFence()
 void SoundChannel::threadAbort()
 {
 	mutex.lock();
+	if (stopDecodedSound())
+	{
+		mutex.unlock();
+		return;
+	}
 	if (ACQUIRE_READ(stopped))
 	{
 		mutex.unlock();
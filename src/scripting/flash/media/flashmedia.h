@@ -25,6 +25,7 @@
 #include "timer.h"
 #include "backends/graphics.h"
 #include "backends/decoder.h"
+#include "backends/audio.h"
 #include "backends/netutils.h"
 #include "scripting/flash/display/DisplayObject.h"
 
@@ -33,6 +34,7 @@ namespace lightspark
 
 class AudioStream;
 class AudioDecoder;
+class AudioExtractor;
 class NetStream;
 class StreamCache;
 class SoundChannel;
@@ -46,8 +48,8 @@ protected:
 	Downloader* downloader;
 	_R<StreamCache> soundData;
 	_NR<SoundChannel> soundChannel;
-	StreamDecoder* rawDataStreamDecoder;
-	int32_t rawDataStartPosition;
+	// decoder kept between calls to extract
+	AudioExtractor* extractor;
 	// If container is true, audio format is parsed from
 	// soundData. If container is false, soundData is raw samples
 	// and format is defined by format member.
@@ -60,6 +62,7 @@ protected:
 	void setBytesTotal(uint32_t b);
 	void setBytesLoaded(uint32_t b);
 	_NR<ProgressEvent> progressEvent;
+	void setSoundData(_R<StreamCache> data);
 public:
 	Sound(Class_base* c);
 	Sound(Class_base* c, _R<StreamCache> soundData, AudioFormat format, number_t duration_in_ms);
@@ -88,7 +91,7 @@ public:
 	ASFUNCTION_ATOM(_constructor);
 };
 
-class SoundChannel : public EventDispatcher, public IThreadJob
+class SoundChannel : public EventDispatcher, public IThreadJob, public IAudioStreamListener
 {
 private:
 	_NR<StreamCache> stream;
@@ -98,13 +101,20 @@ private:
 	AudioDecoder* audioDecoder;
 	AudioStream* audioStream;
 	AudioFormat format;
-	number_t oldVolume;
 	void validateSoundTransform(_NR<SoundTransform>);
+	void applySoundTransform();
 	void playStream();
+	bool playDecodedSound();
+	bool stopDecodedSound();
+	void releaseDecodedSoundRef();
 	number_t startTime;
 	bool restartafterabort;
+	// set if the data is appended while playing, such sounds are never decoded in advance
+	bool streaming;
+	// set if the data comes from a DefineSound tag, only such sounds are decoded in advance
+	bool embedded;
 public:
-	SoundChannel(Class_base* c, _NR<StreamCache> stream=NullRef, AudioFormat format=AudioFormat(CODEC_NONE,0,0), bool autoplay=true);
+	SoundChannel(Class_base* c, _NR<StreamCache> stream=NullRef, AudioFormat format=AudioFormat(CODEC_NONE,0,0), bool autoplay=true, bool embedded=false);
 	~SoundChannel();
 	void appendStreamBlock(unsigned char* buf, int len);
 	void play(number_t starttime=0);
@@ -126,6 +136,9 @@ public:
 	void execute();
 	void jobFence();
 	void threadAbort();
+
+	//IAudioStreamListener interface
+	void audioStreamFinished(AudioStream* s, bool completed) override;
 };
 
 class Video: public DisplayObject
@@ -1579,14 +1579,20 @@ ASFUNCTIONBODY_ATOM(NetStream,play2)
 ASFUNCTIONBODY_ATOM(NetStream,seek)
 {
 	NetStream* th=asAtomHandler::as<NetStream>(obj);
-	int pos;
+	number_t pos;
 	ARG_UNPACK_ATOM(pos);
+	if (std::isnan(pos) || pos < 0)
+		pos = 0;
 	
 	th->countermutex.lock();
 	if (th->streamDecoder)
 	{
 		th->streamDecoder->jumpToPosition(pos*1000);
-		th->streamTime=pos;
+		//The stream time is in milliseconds, the frames decoded so far are not buffered anymore
+		th->streamTime=pos*1000;
+		th->prevstreamtime=th->streamTime;
+		if (th->frameRate)
+			th->prevstreamtime-=uint32_t(th->framesdecoded/th->frameRate*1000);
 	}
 	th->countermutex.unlock();
 	if(th->paused)
@@ -2053,7 +2059,10 @@ void NetStream::execute()
 		if(audioDecoder)
 			audioDecoder->setFlushing();
 		if(videoDecoder)
+		{
+			videoDecoder->drainFrames();
 			videoDecoder->setFlushing();
+		}
 		
 		if(audioDecoder)
 			audioDecoder->waitFlushed();
@@ -204,7 +204,8 @@ ASFUNCTIONBODY_ATOM(Capabilities,_getScreenDPI)
 	asAtomHandler::setNumber(ret,sys,dpi);
 }
 
-ApplicationDomain::ApplicationDomain(Class_base* c, _NR<ApplicationDomain> p):ASObject(c,T_OBJECT,SUBTYPE_APPLICATIONDOMAIN),parentDomain(p)
+ApplicationDomain::ApplicationDomain(Class_base* c, _NR<ApplicationDomain> p):ASObject(c,T_OBJECT,SUBTYPE_APPLICATIONDOMAIN),parentDomain(p),
+	domainMemoryBuffer(nullptr),domainMemoryLength(0)
 {
 }
 
@@ -221,7 +222,7 @@ void ApplicationDomain::sinit(Class_base* c)
 	REGISTER_GETTER(c,parentDomain);
 }
 
-ASFUNCTIONBODY_GETTER_SETTER(ApplicationDomain,domainMemory);
+ASFUNCTIONBODY_GETTER_SETTER_CB(ApplicationDomain,domainMemory,domainMemoryChanged);
 ASFUNCTIONBODY_GETTER(ApplicationDomain,parentDomain);
 
 void ApplicationDomain::buildTraits(ASObject* o)
@@ -231,7 +232,7 @@ void ApplicationDomain::buildTraits(ASObject* o)
 void ApplicationDomain::finalize()
 {
 	ASObject::finalize();
-	domainMemory.reset();
+	setDomainMemory(NullRef);
 	for(auto it = instantiatedTemplates.begin(); it != instantiatedTemplates.end(); ++it)
 		it->second->finalize();
 	//Free template instantations by decRef'ing them
@@ -466,13 +467,52 @@ ASObject* ApplicationDomain::getVariableByMultinameOpportunistic(const multiname
 	return nullptr;
 }
 
-void ApplicationDomain::checkDomainMemory()
+ByteArray* ApplicationDomain::checkDomainMemory()
 {
 	if(domainMemory.isNull())
 	{
-		domainMemory = _NR<ByteArray>(Class<ByteArray>::getInstanceS(this->getSystemState()));
-		domainMemory->setLength(MIN_DOMAIN_MEMORY_LIMIT);
+		ByteArray* mem = Class<ByteArray>::getInstanceS(this->getSystemState());
+		mem->setLength(MIN_DOMAIN_MEMORY_LIMIT);
+		setDomainMemory(_NR<ByteArray>(mem));
 	}
+	return domainMemory.getPtr();
+}
+
+void ApplicationDomain::checkDomainMemoryRange(uint32_t addr, uint32_t size)
+{
+	checkDomainMemory();
+	if(uint64_t(addr)+size > domainMemoryLength)
+		throwError<RangeError>(kInvalidRangeError);
+}
+
+void ApplicationDomain::domainMemoryChanged(_NR<ByteArray> oldValue)
+{
+	if (oldValue == domainMemory)
+		return;
+	if (!oldValue.isNull())
+	{
+		// the list is already empty if the ByteArray has been finalized before this domain
+		auto& owners = oldValue->domainMemoryOwners;
+		auto it = std::find(owners.begin(),owners.end(),this);
+		if (it != owners.end())
+			owners.erase(it);
+	}
+	if (!domainMemory.isNull())
+		domainMemory->domainMemoryOwners.push_back(this);
+	updateDomainMemory();
+}
+
+void ApplicationDomain::setDomainMemory(_NR<ByteArray> mem)
+{
+	_NR<ByteArray> oldValue = domainMemory;
+	domainMemory = mem;
+	domainMemoryChanged(oldValue);
+}
+
+void ApplicationDomain::updateDomainMemory()
+{
+	domainMemoryBuffer = domainMemory.isNull() ? nullptr : domainMemory->getBufferNoCheck();
+	domainMemoryLength = domainMemory.isNull() ? 0 : domainMemory->getLength();
 }
 
 LoaderContext::LoaderContext(Class_base* c):
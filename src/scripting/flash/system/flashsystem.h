@@ -89,27 +89,34 @@ public:
 	ASFUNCTION_ATOM(getDefinition);
 	ASPROPERTY_GETTER_SETTER(_NR<ByteArray>, domainMemory);
 	ASPROPERTY_GETTER(_NR<ApplicationDomain>, parentDomain);
+	/*
+	 * Buffer and length of domainMemory, they are refreshed when domainMemory is set
+	 * and by the ByteArray when its buffer changes. The length is 0 if there is no
+	 * domain memory yet, so the range check fails and the slow path creates it
+	 */
+	uint8_t* domainMemoryBuffer;
+	uint32_t domainMemoryLength;
+	void domainMemoryChanged(_NR<ByteArray> oldValue);
+	void setDomainMemory(_NR<ByteArray> mem);
+	void updateDomainMemory();
+	// the sum is done in 64 bits, so a single compare is enough for the range check
 	template<class T>
 	T readFromDomainMemory(uint32_t addr)
 	{
-		checkDomainMemory();
-		uint32_t bufLen=domainMemory->getLength();
-		if(bufLen < (addr+sizeof(T)))
-			throwError<RangeError>(kInvalidRangeError);
-		uint8_t* buf=domainMemory->getBufferNoCheck();
-		return *reinterpret_cast<T*>(buf+addr);
+		if(USUALLY_FALSE(uint64_t(addr)+sizeof(T) > domainMemoryLength))
+			checkDomainMemoryRange(addr,sizeof(T));
+		return *reinterpret_cast<T*>(domainMemoryBuffer+addr);
 	}
 	template<class T>
 	void writeToDomainMemory(uint32_t addr, T val)
 	{
-		checkDomainMemory();
-		uint32_t bufLen=domainMemory->getLength();
-		if(bufLen < (addr+sizeof(T)))
-			throwError<RangeError>(kInvalidRangeError);
-		uint8_t* buf=domainMemory->getBufferNoCheck();
-		*reinterpret_cast<T*>(buf+addr)=val;
+		if(USUALLY_FALSE(uint64_t(addr)+sizeof(T) > domainMemoryLength))
+			checkDomainMemoryRange(addr,sizeof(T));
+		*reinterpret_cast<T*>(domainMemoryBuffer+addr)=val;
 	}
-	void checkDomainMemory();
+	// creates the domain memory if there is none yet and throws a RangeError if the access is out of it
+	void checkDomainMemoryRange(uint32_t addr, uint32_t size);
+	ByteArray* checkDomainMemory();
 };
 
 class LoaderContext: public ASObject
@@ -25,6 +25,9 @@
 #include "parsing/amf3_generator.h"
 #include "scripting/argconv.h"
 #include "scripting/flash/errors/flasherrors.h"
+#include "parsing/streams.h"
+#include "backends/config.h"
+#include "scripting/flash/system/flashsystem.h"
 #include <sstream>
 #include <zlib.h>
 #include <glib.h>
@@ -164,9 +167,16 @@ uint8_t* ByteArray::getBufferIntern(unsigned int size, bool enableResize)
 	{
 		len=size;
 	}
+	bufferChanged();
 	return bytes;
 }
 
+void ByteArray::notifyDomainMemoryOwners()
+{
+	for (auto it = domainMemoryOwners.begin(); it != domainMemoryOwners.end(); it++)
+		(*it)->updateDomainMemory();
+}
+
 uint16_t ByteArray::endianIn(uint16_t value)
 {
 	if(littleEndian)
@@ -318,6 +328,7 @@ void ByteArray::setLength(uint32_t newLen)
 		real_len = newLen;
 	}
 	len = newLen;
+	bufferChanged();
 	if (position > len)
 		position = (len > 0 ? len-1 : 0);
 }
@@ -1241,6 +1252,7 @@ void ByteArray::acquireBuffer(uint8_t* buf, int bufLen)
 	bytes=buf;
 	real_len=bufLen;
 	len=bufLen;
+	bufferChanged();
 #ifdef MEMORY_USAGE_PROFILING
 	getClass()->memoryAccount->addBytes(real_len);
 #endif
@@ -1369,77 +1381,131 @@ void ByteArray::removeFrontBytes(int count)
 	memmove(bytes,bytes+count,count);
 	position -= count;
 	len -= count;
+	bufferChanged();
 }
 
 
 
-void ByteArray::compress_zlib()
+// buffers bigger than this are deflated in chunks on the thread pool
+#define PARALLEL_DEFLATE_MIN_SIZE (1024*1024)
+#define DEFLATE_CHUNK_SIZE (256*1024)
+// every chunk uses the end of the previous one as dictionary, like the matches of a single stream could
+#define DEFLATE_DICTIONARY_SIZE 32768
+
+/*
+ * Deflates size bytes starting at start of data as raw deflate blocks. Chunks but the last end with a
+ * sync flush, so the output of all chunks can be concatenated into a single stream.
+ */
+static bool deflateChunk(const uint8_t* data, uint32_t start, uint32_t size, bool last, int level, vector<uint8_t>& out)
+{
+	z_stream strm;
+	strm.zalloc=Z_NULL;
+	strm.zfree=Z_NULL;
+	strm.opaque=Z_NULL;
+	if(deflateInit2(&strm, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY)!=Z_OK)
+		return false;
+	if(start)
+	{
+		uint32_t dictionary=min(uint32_t(DEFLATE_DICTIONARY_SIZE),start);
+		deflateSetDictionary(&strm, data+start-dictionary, dictionary);
+	}
+	// room for the empty stored block of the sync flush
+	out.resize(deflateBound(&strm, size)+16);
+	strm.next_in=(Bytef*)data+start;
+	strm.avail_in=size;
+	strm.next_out=&out[0];
+	strm.avail_out=out.size();
+	int ret=deflate(&strm, last ? Z_FINISH : Z_SYNC_FLUSH);
+	bool ok=last ? ret==Z_STREAM_END : (ret==Z_OK && strm.avail_in==0 && strm.avail_out!=0);
+	out.resize(strm.total_out);
+	deflateEnd(&strm);
+	return ok;
+}
+
+void ByteArray::compress_zlib(bool raw)
 {
 	if(len==0)
 		return;
 
-	unsigned long buflen=compressBound(len);
+	int level=Config::getConfig()->getCompressionLevel();
+	if(level<Z_DEFAULT_COMPRESSION || level>Z_BEST_COMPRESSION)
+		level=Z_DEFAULT_COMPRESSION;
+	uint32_t count=len<PARALLEL_DEFLATE_MIN_SIZE ? 1 : (len+DEFLATE_CHUNK_SIZE-1)/DEFLATE_CHUNK_SIZE;
+	vector<vector<uint8_t>> chunks(count);
+	vector<uLong> checksums(count);
+	vector<uint8_t> failed(count,0);
+	auto compressChunk=[&](uint32_t i)
+	{
+		uint32_t start=i*DEFLATE_CHUNK_SIZE;
+		uint32_t size=count==1 ? len : min(uint32_t(DEFLATE_CHUNK_SIZE),len-start);
+		failed[i]=!deflateChunk(bytes, start, size, i==count-1, level, chunks[i]);
+		if(!raw)
+			checksums[i]=adler32(adler32(0,Z_NULL,0), bytes+start, size);
+	};
+	if(count==1)
+		compressChunk(0);
+	else
+		getSystemState()->runParallel(count, compressChunk);
+
+	size_t buflen=raw ? 0 : 6;
+	for(uint32_t i=0;i<count;i++)
+	{
+		if(failed[i])
+			throw RunTimeException("zlib compress failed");
+		buflen+=chunks[i].size();
+	}
 	uint8_t *compressed=(uint8_t*) malloc(buflen);
 	assert_and_throw(compressed);
-
-	if(compress(compressed, &buflen, bytes, len)!=Z_OK)
+	uint8_t* p=compressed;
+	if(!raw)
+	{
+		// zlib header with the default window size and the level hint
+		int levelHint=level==Z_DEFAULT_COMPRESSION ? 2 : level<2 ? 0 : level<6 ? 1 : level==6 ? 2 : 3;
+		*p++=0x78;
+		*p=levelHint<<6;
+		*p+=31-(0x7800+*p)%31;
+		p++;
+	}
+	uLong checksum=checksums[0];
+	for(uint32_t i=0;i<count;i++)
+	{
+		memcpy(p, chunks[i].data(), chunks[i].size());
+		p+=chunks[i].size();
+		if(!raw && i>0)
+			checksum=adler32_combine(checksum, checksums[i], min(uint32_t(DEFLATE_CHUNK_SIZE),len-i*DEFLATE_CHUNK_SIZE));
+	}
+	if(!raw)
 	{
-		free(compressed);
-		throw RunTimeException("zlib compress failed");
+		*p++=checksum>>24;
+		*p++=checksum>>16;
+		*p++=checksum>>8;
+		*p++=checksum;
 	}
 
 	acquireBuffer(compressed, buflen);
 	position=buflen;
 }
 
-void ByteArray::uncompress_zlib()
+void ByteArray::uncompress_zlib(bool raw)
 {
-	z_stream strm;
-	int status;
-
 	if(len==0)
 		return;
 
-	strm.zalloc=Z_NULL;
-	strm.zfree=Z_NULL;
-	strm.opaque=Z_NULL;
-	strm.avail_in=len;
-	strm.next_in=bytes;
-	strm.total_out=0;
-	status=inflateInit(&strm);
-	if(status==Z_VERSION_ERROR)
+	vector<uint8_t> buf;
+	zlib_inflater inflater(raw);
+	if(!inflater.append(bytes, len, buf) || !inflater.isFinished())
 		throw Class<IOError>::getInstanceS(getSystemState(),"not valid compressed data");
-	else if(status!=Z_OK)
-		throw RunTimeException("zlib uncompress failed");
 
-	vector<uint8_t> buf(3*len);
-	do
-	{
-		strm.next_out=&buf[strm.total_out];
-		strm.avail_out=buf.size()-strm.total_out;
-		status=inflate(&strm, Z_NO_FLUSH);
-
-		if(status!=Z_OK && status!=Z_STREAM_END)
-		{
-			inflateEnd(&strm);
-			throw Class<IOError>::getInstanceS(getSystemState(),"not valid compressed data");
-		}
-
-		if(strm.avail_out==0)
-			buf.resize(buf.size()+len);
-	} while(status!=Z_STREAM_END);
-
-	inflateEnd(&strm);
-
-	len=strm.total_out;
+	len=buf.size();
 #ifdef MEMORY_USAGE_PROFILING
 	getClass()->memoryAccount->addBytes(len-real_len);
 #endif
 	real_len = len;
 	uint8_t* bytes2=(uint8_t*) realloc(bytes, len);
-	assert_and_throw(bytes2);
+	assert_and_throw(bytes2 || len==0);
 	bytes = bytes2;
-	memcpy(bytes, &buf[0], len);
+	bufferChanged();
+	memcpy(bytes, buf.data(), len);
 	position=0;
 }
 
@@ -1469,7 +1535,7 @@ ASFUNCTIONBODY_ATOM(ByteArray,_deflate)
 {
 	ByteArray* th=asAtomHandler::as<ByteArray>(obj);
 	th->lock();
-	th->compress_zlib();
+	th->compress_zlib(true);
 	th->unlock();
 }
 
@@ -1477,7 +1543,7 @@ ASFUNCTIONBODY_ATOM(ByteArray,_inflate)
 {
 	ByteArray* th=asAtomHandler::as<ByteArray>(obj);
 	th->lock();
-	th->uncompress_zlib();
+	th->uncompress_zlib(true);
 	th->unlock();
 }
 
@@ -1495,6 +1561,7 @@ ASFUNCTIONBODY_ATOM(ByteArray,clear)
 	th->bytes = NULL;
 	th->len=0;
 	th->real_len=0;
+	th->bufferChanged();
 	th->position=0;
 	th->unlock();
 }
@@ -26,6 +26,7 @@
 
 namespace lightspark
 {
+class ApplicationDomain;
 
 class DLL_PUBLIC ByteArray: public ASObject, public IDataInput, public IDataOutput
 {
@@ -42,10 +43,20 @@ protected:
 	uint8_t* bytes;
 	uint32_t real_len;
 	uint32_t len;
-	void compress_zlib();
-	void uncompress_zlib();
+	// raw selects the deflate format without zlib header and checksum
+	void compress_zlib(bool raw=false);
+	void uncompress_zlib(bool raw=false);
 	Mutex mutex;
 	uint8_t* getBufferIntern(unsigned int size, bool enableResize);
+	// application domains using this ByteArray as domain memory, they cache its buffer and length
+	std::vector<ApplicationDomain*> domainMemoryOwners;
+	void notifyDomainMemoryOwners();
+	// has to be called whenever bytes or len change
+	FORCE_INLINE void bufferChanged()
+	{
+		if (USUALLY_FALSE(!domainMemoryOwners.empty()))
+			notifyDomainMemoryOwners();
+	}
 	
 public:
 	FORCE_INLINE void lock()
@@ -194,6 +205,7 @@ public:
 			if(len<size)
 			{
 				len=size;
+				bufferChanged();
 			}
 			return bytes;
 		}
@@ -29,20 +29,20 @@
 using namespace std;
 using namespace lightspark;
 
-ASString::ASString(Class_base* c):ASObject(c,T_STRING),currentindex(0),hasId(true),datafilled(true)
+ASString::ASString(Class_base* c):ASObject(c,T_STRING),currentindex(0),ropeleft(nullptr),ropebytes(0),ropedepth(0),hasId(true),datafilled(true)
 {
 	stringId = BUILTIN_STRINGS::EMPTY;
 }
 
-ASString::ASString(Class_base* c,const string& s) : ASObject(c,T_STRING),data(s),currentindex(0),hasId(false),datafilled(true)
+ASString::ASString(Class_base* c,const string& s) : ASObject(c,T_STRING),data(s),currentindex(0),ropeleft(nullptr),ropebytes(0),ropedepth(0),hasId(false),datafilled(true)
 {
 }
 
-ASString::ASString(Class_base* c,const tiny_string& s) : ASObject(c,T_STRING),data(s),currentindex(0),hasId(false),datafilled(true)
+ASString::ASString(Class_base* c,const tiny_string& s) : ASObject(c,T_STRING),data(s),currentindex(0),ropeleft(nullptr),ropebytes(0),ropedepth(0),hasId(false),datafilled(true)
 {
 }
 
-ASString::ASString(Class_base* c,const char* s) : ASObject(c,T_STRING),data(s, /*copy:*/true),currentindex(0),hasId(false),datafilled(true)
+ASString::ASString(Class_base* c,const char* s) : ASObject(c,T_STRING),data(s, /*copy:*/true),currentindex(0),ropeleft(nullptr),ropebytes(0),ropedepth(0),hasId(false),datafilled(true)
 {
 }
 
@@ -52,6 +52,64 @@ ASString::ASString(Class_base* c,const char* s, uint32_t len) : ASObject(c,T_STR
 	hasId = false;
 	datafilled=true;
 	currentindex=0;
+	ropeleft=nullptr;
+	ropebytes=0;
+	ropedepth=0;
+}
+
+// concatenations resulting in shorter strings are done immediately
+#define ROPE_MIN_BYTES 256
+// limits the number of nodes kept alive by a rope, and the recursion when they are destroyed
+#define ROPE_MAX_DEPTH 1024
+
+void ASString::flatten()
+{
+	// collect the nodes down the left side of the rope, the right part of every node is stored in its data
+	std::vector<ASString*> nodes;
+	ASString* n = this;
+	while (n->ropeleft)
+	{
+		nodes.push_back(n);
+		n = n->ropeleft;
+	}
+	tiny_string res = n->getData();
+	for (auto it = nodes.rbegin(); it != nodes.rend(); it++)
+		res += (*it)->data;
+	data = res;
+	datafilled = true;
+	ropeleft->decRef();
+	ropeleft = nullptr;
+	ropebytes = 0;
+	ropedepth = 0;
+}
+
+ASString* ASString::concatenate(SystemState* sys, asAtom& a, asAtom& b)
+{
+	ASObject* o = asAtomHandler::getObject(a);
+	tiny_string right = asAtomHandler::toString(b,sys);
+	if (o && o->is<ASString>())
+	{
+		ASString* left = o->as<ASString>();
+		uint32_t leftbytes = left->ropeleft ? left->ropebytes : left->getData().numBytes();
+		if (leftbytes+right.numBytes() >= ROPE_MIN_BYTES)
+		{
+			if (left->ropedepth >= ROPE_MAX_DEPTH)
+				left->flatten();
+			ASString* res = Class<ASString>::getInstanceSNoArgs(sys);
+			left->incRef();
+			res->ropeleft = left;
+			res->ropebytes = leftbytes+right.numBytes();
+			res->ropedepth = left->ropedepth+1;
+			res->data = right;
+			res->stringId = UINT32_MAX;
+			res->hasId = false;
+			res->datafilled = false;
+			return res;
+		}
+	}
+	tiny_string s = asAtomHandler::toString(a,sys);
+	s += right;
+	return abstract_s(sys,s)->as<ASString>();
 }
 
 ASFUNCTIONBODY_ATOM(ASString,_constructor)
@@ -820,7 +878,7 @@ ASFUNCTIONBODY_ATOM(ASString,indexOf)
 		startIndex=asAtomHandler::toInt(args[1]);
 	startIndex = imin(imax(startIndex, 0), data.numChars());
 
-	size_t pos = data.find(arg0.raw_buf(), startIndex);
+	size_t pos = data.find(arg0, startIndex);
 	if(pos == data.npos)
 		asAtomHandler::setInt(ret,sys,-1);
 	else
@@ -846,7 +904,7 @@ ASFUNCTIONBODY_ATOM(ASString,lastIndexOf)
 
 	startIndex = imin(startIndex, data.numChars());
 
-	size_t pos=data.rfind(val.raw_buf(), startIndex);
+	size_t pos=data.rfind(val, startIndex);
 	if(pos==data.npos)
 		asAtomHandler::setInt(ret,sys,-1);
 	else
@@ -1076,12 +1134,21 @@ ASFUNCTIONBODY_ATOM(ASString,replace)
 
 ASFUNCTIONBODY_ATOM(ASString,concat)
 {
-	tiny_string data = asAtomHandler::toString(obj,sys);
-	ASString* res=abstract_s(sys,data)->as<ASString>();
+	ASObject* res;
+	if (asAtomHandler::isObject(obj) && asAtomHandler::getObjectNoCheck(obj)->is<ASString>())
+	{
+		// strings are immutable, so obj itself can be the start of the result
+		res = asAtomHandler::getObjectNoCheck(obj);
+		res->incRef();
+	}
+	else
+		res = abstract_s(sys,asAtomHandler::toString(obj,sys));
 	for(unsigned int i=0;i<argslen;i++)
 	{
-		res->hasId = false;
-		res->getData()+=asAtomHandler::toString(args[i],sys).raw_buf();
+		asAtom a = asAtomHandler::fromObject(res);
+		ASObject* s = concatenate(sys,a,args[i]);
+		res->decRef();
+		res = s;
 	}
 
 	ret = asAtomHandler::fromObject(res);
@@ -45,6 +45,13 @@ private:
 	// speeds up iterating over all chars in the string
 	CharIterator currentpos;
 	uint32_t currentindex;
+
+	// lazy concatenation (rope): while ropeleft is set, the string is the content of ropeleft
+	// followed by data, and the concatenation is only done on the first access to the content
+	ASString* ropeleft;
+	uint32_t ropebytes;
+	uint32_t ropedepth;
+	void flatten();
 public:
 	ASString(Class_base* c);
 	ASString(Class_base* c, const std::string& s);
@@ -58,18 +65,32 @@ public:
 	{
 		if (!datafilled)
 		{
-			data = getSystemState()->getStringFromUniqueId(stringId);
-			datafilled = true;
+			if (ropeleft)
+				flatten();
+			else
+			{
+				data = getSystemState()->getStringFromUniqueId(stringId);
+				datafilled = true;
+			}
 		}
 		return data;
 	}
 	FORCE_INLINE bool isEmpty() const
 	{
+		if (ropeleft)
+			return false;
 		if (hasId)
 			return stringId == BUILTIN_STRINGS::EMPTY || stringId == UINT32_MAX;
 		return data.empty();
 	}
 
+	/*
+	 * returns a new string containing a followed by b
+	 * if a is a String object and the result is long enough, the concatenation is delayed until the content is needed,
+	 * so that building a string by repeated appending doesn't copy the whole string every time
+	 */
+	static ASString* concatenate(SystemState* sys, asAtom& a, asAtom& b);
+
 	static void sinit(Class_base* c);
 	static void buildTraits(ASObject* o);
 	ASFUNCTION_ATOM(_constructor);
@@ -112,6 +133,13 @@ public:
 	inline bool destruct() 
 	{ 
 		data.clear(); 
+		if (ropeleft)
+		{
+			ropeleft->decRef();
+			ropeleft=nullptr;
+			ropebytes=0;
+			ropedepth=0;
+		}
 		hasId = false;
 		datafilled=false; 
 		if (!destructIntern())
@@ -29,7 +29,7 @@
 using namespace std;
 using namespace lightspark;
 
-Array::Array(Class_base* c):ASObject(c,T_ARRAY),currentsize(0)
+Array::Array(Class_base* c):ASObject(c,T_ARRAY),currentsize(0),elementKind(ELEMENTS_INTEGER)
 {
 }
 
@@ -45,6 +45,7 @@ bool Array::destruct()
 	}
 	data_first.clear();
 	data_second.clear();
+	elementKind=ELEMENTS_INTEGER;
 	currentsize=0;
 	return destructIntern();
 }
@@ -158,11 +159,13 @@ ASFUNCTIONBODY_ATOM(Array,_concat)
 	
 	// copy values into new array
 	res->resize(th->size());
-	auto it1=th->data_first.begin();
-	for(;it1 != th->data_first.end();++it1)
+	res->data_first.assign(th->data_first.begin(),th->data_first.end());
+	res->elementKind=th->elementKind;
+	if (th->elementKind != ELEMENTS_INTEGER)
 	{
-		res->data_first.push_back(*it1);
-		ASATOM_INCREF((*it1));
+		auto it1=th->data_first.begin();
+		for(;it1 != th->data_first.end();++it1)
+			ASATOM_INCREF((*it1));
 	}
 	auto it2=th->data_second.begin();
 	for(;it2 != th->data_second.end();++it2)
@@ -487,6 +490,7 @@ ASFUNCTIONBODY_ATOM(Array, _reverse)
 		uint32_t size = th->size();
 		th->data_first.clear();
 		th->data_second.clear();
+		th->elementKind=ELEMENTS_INTEGER;
 		auto it=tmp.begin();
 		for(;it != tmp.end();++it)
 		{
@@ -497,6 +501,67 @@ ASFUNCTIONBODY_ATOM(Array, _reverse)
 	ret = asAtomHandler::fromObject(th);
 }
 
+/*
+ * returns the atom an element of an array with ELEMENTS_INTEGER kind has if it is strictly equal to v,
+ * or false if no integer element can be equal to v
+ */
+static bool getIntegerSearchAtom(SystemState* sys, const asAtom& v, asAtom& res)
+{
+	if ((v.uintval&0x7) == ATOM_INTEGER)
+	{
+		res = v;
+		return true;
+	}
+	if (!asAtomHandler::isNumeric(v))
+		return false;
+	number_t d = asAtomHandler::toNumber(v);
+#ifdef LIGHTSPARK_64
+	const number_t maxint = number_t(int64_t(1)<<60);
+#else
+	const number_t maxint = number_t(1<<28);
+#endif
+	if (std::isnan(d) || d != std::trunc(d) || d < -maxint || d > maxint)
+		return false;
+	asAtomHandler::setInt(res,sys,int64_t(d));
+	return true;
+}
+
+// integer atoms are strictly equal if their bits are equal, so the values can be compared four at a time without any type checks
+static int32_t findIntegerAtom(const std::vector<asAtom>& data, uint32_t start, LIGHTSPARK_ATOM_VALTYPE v)
+{
+	const asAtom* p = data.data();
+	uint32_t end = data.size();
+	uint32_t i = start;
+	for (; i+4 <= end; i+=4)
+	{
+		if ((p[i].uintval == v) | (p[i+1].uintval == v) | (p[i+2].uintval == v) | (p[i+3].uintval == v))
+			break;
+	}
+	for (; i < end; i++)
+	{
+		if (p[i].uintval == v)
+			return i;
+	}
+	return -1;
+}
+
+static int32_t findLastIntegerAtom(const std::vector<asAtom>& data, uint32_t start, LIGHTSPARK_ATOM_VALTYPE v)
+{
+	const asAtom* p = data.data();
+	int64_t i = start;
+	for (; i >= 3; i-=4)
+	{
+		if ((p[i].uintval == v) | (p[i-1].uintval == v) | (p[i-2].uintval == v) | (p[i-3].uintval == v))
+			break;
+	}
+	for (; i >= 0; i--)
+	{
+		if (p[i].uintval == v)
+			return i;
+	}
+	return -1;
+}
+
 ASFUNCTIONBODY_ATOM(Array,lastIndexOf)
 {
 	Array* th=asAtomHandler::as<Array>(obj);
@@ -540,6 +605,14 @@ ASFUNCTIONBODY_ATOM(Array,lastIndexOf)
 		else
 			i = j;
 	}
+	if (th->elementKind == ELEMENTS_INTEGER && th->data_second.empty() && i < th->data_first.size())
+	{
+		asAtom v=asAtomHandler::invalidAtom;
+		if (getIntegerSearchAtom(sys,arg0,v))
+			res = findLastIntegerAtom(th->data_first,i,v.uintval);
+		asAtomHandler::setInt(ret,sys,res);
+		return;
+	}
 	do
 	{
 		asAtom a=asAtomHandler::invalidAtom;
@@ -604,6 +677,14 @@ ASFUNCTIONBODY_ATOM(Array,shift)
 		asAtomHandler::setUndefined(ret);
 		return;
 	}
+	if (th->isPacked() && th->size() == th->currentsize)
+	{
+		// the reference is moved to the result
+		ret = th->data_first[0];
+		th->data_first.erase(th->data_first.begin());
+		th->currentsize--;
+		return;
+	}
 	if (th->data_first.size() > 0)
 		ret = th->data_first[0];
 	if (asAtomHandler::isInvalid(ret))
@@ -618,7 +699,10 @@ ASFUNCTIONBODY_ATOM(Array,shift)
 		if(it->first)
 		{
 			if (it->first == ARRAY_SIZE_THRESHOLD)
+			{
 				th->data_first[ARRAY_SIZE_THRESHOLD-1] = it->second;
+				th->updateElementKind(it->second);
+			}
 			else
 				tmp[it->first-1]=it->second;
 		}
@@ -687,6 +771,27 @@ ASFUNCTIONBODY_ATOM(Array,splice)
 		deleteCount=totalSize-startIndex;
 
 	res->resize(deleteCount);
+	uint32_t insertCount = argslen > 2 ? argslen-2 : 0;
+	if (th->isPacked() && totalSize == th->currentsize && totalSize-deleteCount+insertCount <= ARRAY_SIZE_THRESHOLD)
+	{
+		if (deleteCount && th->getSystemState()->getSwfVersion() < 13 && th->getClass() && th->getClass()->isSealed)
+			throwError<ReferenceError>(kReadSealedError,"splice",th->getClass()->getQualifiedClassName());
+		// move the deleted items to the return array and insert the new ones with a single move of the tail
+		auto itstart = th->data_first.begin()+startIndex;
+		res->data_first.assign(itstart,itstart+deleteCount);
+		res->elementKind=th->elementKind;
+		th->data_first.erase(itstart,itstart+deleteCount);
+		for(unsigned int i=2;i<argslen;i++)
+		{
+			ASATOM_INCREF(args[i]);
+			th->updateElementKind(args[i]);
+		}
+		if (insertCount)
+			th->data_first.insert(th->data_first.begin()+startIndex,args+2,args+argslen);
+		th->currentsize=th->data_first.size();
+		ret =asAtomHandler::fromObject(res);
+		return;
+	}
 	if(deleteCount)
 	{
 		// Derived classes may be sealed!
@@ -791,7 +896,13 @@ ASFUNCTIONBODY_ATOM(Array,indexOf)
 	if (index < 0) index = th->size()+ index;
 	if (index < 0) index = 0;
 
-	if ((uint32_t)index < th->data_first.size())
+	if ((uint32_t)index < th->data_first.size() && th->elementKind == ELEMENTS_INTEGER)
+	{
+		asAtom v=asAtomHandler::invalidAtom;
+		if (getIntegerSearchAtom(sys,arg0,v))
+			res = findIntegerAtom(th->data_first,index,v.uintval);
+	}
+	else if ((uint32_t)index < th->data_first.size())
 	{
 		for (auto it=th->data_first.begin()+index ; it != th->data_first.end(); ++it )
 		{
@@ -881,97 +992,128 @@ ASFUNCTIONBODY_ATOM(Array,_pop)
 }
 
 
-bool Array::sortComparatorDefault::operator()(const asAtom& d1, const asAtom& d2)
+sort_key Array::getSortKey(SystemState* sys, asAtom& value, bool isNumeric, bool isCaseInsensitive, bool useoldversion)
 {
-	asAtom o1 = d1;
-	asAtom o2 = d2;
+	sort_key key;
 	if(isNumeric)
 	{
-		number_t a=numeric_limits<double>::quiet_NaN();
-		number_t b=numeric_limits<double>::quiet_NaN();
 		if (useoldversion)
-		{
-			a=asAtomHandler::toInt(o1) & 0x1fffffff;
-			b=asAtomHandler::toInt(o2) & 0x1fffffff;
-		}
-		else
-		{
-			a=asAtomHandler::toNumber(o1);
-			b=asAtomHandler::toNumber(o2);
-		}
-		if((!asAtomHandler::isNumeric(o1) && std::isnan(a)) || (!asAtomHandler::isNumeric(o2) && std::isnan(b)))
-			throw RunTimeException("Cannot sort non number with Array.NUMERIC option");
-		if(isDescending)
-			return b>a;
+			key.num=asAtomHandler::toInt(value) & 0x1fffffff;
 		else
-			return a<b;
+			key.num=asAtomHandler::toNumber(value);
 	}
 	else
 	{
-		//Comparison is always in lexicographic order
-		tiny_string s1;
-		tiny_string s2;
-		s1=asAtomHandler::toString(o1,getSys());
-		s2=asAtomHandler::toString(o2,getSys());
-
-		if(isDescending)
+		key.str=asAtomHandler::toString(value,sys);
+		if(isCaseInsensitive)
 		{
-			//TODO: unicode support
-			if(isCaseInsensitive)
-				return s1.strcasecmp(s2)>0;
-			else
-				return s1>s2;
-		}
-		else
-		{
-			//TODO: unicode support
-			if(isCaseInsensitive)
-				return s1.strcasecmp(s2)<0;
-			else
-				return s1<s2;
+			//Comparing the collation keys gives the same order as tiny_string::strcasecmp
+			char* folded=g_utf8_casefold(key.str.raw_buf(),key.str.numBytes());
+			char* collated=g_utf8_collate_key(folded,-1);
+			key.str=tiny_string(collated,true);
+			g_free(collated);
+			g_free(folded);
 		}
 	}
+	return key;
 }
-// std::sort expects strict weak ordering for the comparison function
-// this is not guarranteed by user defined comparison functions, so we need out own sorting method.
-// TODO this is just a simple quicksort implementation, not optimized for performance
-void simplequicksortArray(std::vector<asAtom>& v, Array::sortComparatorWrapper& comp, int32_t lo, int32_t hi)
+
+//Maps a number to an integer with the same order, NaN is sorted after all numbers
+static uint64_t numberToSortBits(number_t n)
+{
+	if(std::isnan(n))
+		return UINT64_MAX;
+	//-0 and 0 are equal
+	if(n==0)
+		n=0;
+	uint64_t bits;
+	memcpy(&bits,&n,sizeof(bits));
+	return (bits&0x8000000000000000ULL) ? ~bits : bits|0x8000000000000000ULL;
+}
+
+typedef std::pair<uint64_t,asAtom> numericSortEntry;
+typedef std::pair<tiny_string,asAtom> stringSortEntry;
+
+struct numericSortEntryLess
 {
-	if (v.size() == 2)
+	bool operator()(const numericSortEntry& a, const numericSortEntry& b) const
 	{
-		if (comp.compare(v[0],v[1]) > 0)
-			std::swap(v[0],v[1]);
-		return;
+		return a.first < b.first;
 	}
-	if (lo < hi)
+};
+struct stringSortEntryLess
+{
+	bool isDescending;
+	stringSortEntryLess(bool d):isDescending(d) {}
+	bool operator()(const stringSortEntry& a, const stringSortEntry& b) const
 	{
-		asAtom pivot = v[lo];
-		int32_t i = lo - 1;
-		int32_t j = hi + 1;
-		while (true)
-		{
-			do
-			{
-				i++;
-			}
-			while (i < hi && (comp.compare(v[i],pivot) < 0));
-			
-			do
-			{
-				j--;
-			}
-			while (j >= 0 && (comp.compare(v[j],pivot) > 0));
-	
-			if (i >= j)
-				break;
+		return isDescending ? a.first > b.first : a.first < b.first;
+	}
+};
 
-			std::swap(v[i],v[j]);
+//Below this size the histograms of the radix sort cost more than comparing
+#define RADIX_SORT_MIN_SIZE 64
+
+//Stable LSD radix sort with 8 bit digits, digits that are the same for all keys are skipped
+static void radixSort(std::vector<numericSortEntry>& entries)
+{
+	uint32_t n=entries.size();
+	std::vector<uint32_t> counts(8*256,0);
+	for(auto it=entries.begin();it != entries.end();++it)
+	{
+		for(uint32_t d=0;d<8;d++)
+			counts[d*256+((it->first>>(d*8))&0xff)]++;
+	}
+	std::vector<numericSortEntry> tmp(n);
+	for(uint32_t d=0;d<8;d++)
+	{
+		uint32_t* c=&counts[d*256];
+		if(c[(entries[0].first>>(d*8))&0xff]==n)
+			continue;
+		uint32_t pos=0;
+		for(uint32_t i=0;i<256;i++)
+		{
+			uint32_t count=c[i];
+			c[i]=pos;
+			pos+=count;
 		}
-		if (j >= lo)
+		for(auto it=entries.begin();it != entries.end();++it)
+			tmp[c[(it->first>>(d*8))&0xff]++]=*it;
+		entries.swap(tmp);
+	}
+}
+
+void Array::sortDefault(SystemState* sys, std::vector<asAtom>& values, bool isNumeric, bool isCaseInsensitive, bool isDescending, bool useoldversion, bool nanIsError)
+{
+	if(isNumeric)
+	{
+		std::vector<numericSortEntry> entries;
+		entries.reserve(values.size());
+		for(auto it=values.begin();it != values.end();++it)
 		{
-			simplequicksortArray(v, comp, lo, j);
-			simplequicksortArray(v, comp, j + 1, hi);
+			number_t n=getSortKey(sys,*it,true,false,useoldversion).num;
+			if(std::isnan(n) && (nanIsError || !asAtomHandler::isNumeric(*it)))
+				throw RunTimeException("Cannot sort non number with Array.NUMERIC option");
+			uint64_t bits=numberToSortBits(n);
+			entries.push_back(make_pair(isDescending ? ~bits : bits,*it));
 		}
+		if(entries.size() < RADIX_SORT_MIN_SIZE)
+			stable_sort(entries.begin(),entries.end(),numericSortEntryLess());
+		else
+			radixSort(entries);
+		for(uint32_t i=0;i<entries.size();i++)
+			values[i]=entries[i].second;
+	}
+	else
+	{
+		//Comparison is always in lexicographic order
+		std::vector<stringSortEntry> entries;
+		entries.reserve(values.size());
+		for(auto it=values.begin();it != values.end();++it)
+			entries.push_back(make_pair(getSortKey(sys,*it,false,isCaseInsensitive).str,*it));
+		stable_sort(entries.begin(),entries.end(),stringSortEntryLess(isDescending));
+		for(uint32_t i=0;i<entries.size();i++)
+			values[i]=entries[i].second;
 	}
 }
 
@@ -1044,13 +1186,15 @@ ASFUNCTIONBODY_ATOM(Array,_sort)
 	if(asAtomHandler::isValid(comp))
 	{
 		sortComparatorWrapper c(comp);
-		simplequicksortArray(tmp,c,0,tmp.size()-1);
+		adaptiveSort<sortComparatorWrapper> sorter(tmp,c);
+		sorter.sort();
 	}
 	else
-		sort(tmp.begin(),tmp.end(),sortComparatorDefault(sys->getSwfVersion() < 11, isNumeric,isCaseInsensitive,isDescending));
+		sortDefault(sys,tmp,isNumeric,isCaseInsensitive,isDescending,sys->getSwfVersion() < 11,false);
 
 	th->data_first.clear();
 	th->data_second.clear();
+	th->elementKind=ELEMENTS_INTEGER;
 	std::vector<asAtom>::iterator ittmp=tmp.begin();
 	int i = 0;
 	for(;ittmp != tmp.end();++ittmp)
@@ -1067,48 +1211,24 @@ bool Array::sortOnComparator::operator()(const sorton_value& d1, const sorton_va
 	uint32_t i = 0;
 	for(;it != fields.end();++it)
 	{
-		asAtom obj1 = d1.sortvalues.at(i);
-		asAtom obj2 = d2.sortvalues.at(i);
+		const sort_key& k1 = d1.sortkeys[i];
+		const sort_key& k2 = d2.sortkeys[i];
 		i++;
+		//Equal values are ordered by the next field
 		if(it->isNumeric)
 		{
-			number_t a=numeric_limits<double>::quiet_NaN();
-			number_t b=numeric_limits<double>::quiet_NaN();
-			a=asAtomHandler::toNumber(obj1);
-			
-			b=asAtomHandler::toNumber(obj2);
-			
-			if((!asAtomHandler::isNumeric(obj1) && std::isnan(a)) || (!asAtomHandler::isNumeric(obj2) && std::isnan(b)))
-				throw RunTimeException("Cannot sort non number with Array.NUMERIC option");
-			if(it->isDescending)
-				return b>a;
-			else
-				return a<b;
+			if(k1.num < k2.num)
+				return !it->isDescending;
+			if(k2.num < k1.num)
+				return it->isDescending;
 		}
-		else
+		else if (k1.str != k2.str)
 		{
 			//Comparison is always in lexicographic order
-			tiny_string s1;
-			tiny_string s2;
-			s1=asAtomHandler::toString(obj1,sys);
-			s2=asAtomHandler::toString(obj2,sys);
-			if (s1 != s2)
-			{
-				if(it->isDescending)
-				{
-					if(it->isCaseInsensitive)
-						return s1.strcasecmp(s2)>0;
-					else
-						return s1>s2;
-				}
-				else
-				{
-					if(it->isCaseInsensitive)
-						return s1.strcasecmp(s2)<0;
-					else
-						return s1<s2;
-				}
-			}
+			if(it->isDescending)
+				return k1.str>k2.str;
+			else
+				return k1.str<k2.str;
 		}
 	}
 	return false;
@@ -1124,7 +1244,6 @@ ASFUNCTIONBODY_ATOM(Array,sortOn)
 	if(asAtomHandler::is<Array>(args[0]))
 	{
 		Array* obj=asAtomHandler::as<Array>(args[0]);
-		int n = 0;
 		for(uint32_t i = 0;i<obj->size();i++)
 		{
 			multiname sortfieldname(NULL);
@@ -1139,7 +1258,7 @@ ASFUNCTIONBODY_ATOM(Array,sortOn)
 			Array* opts=asAtomHandler::as<Array>(args[1]);
 			auto itopt=opts->data_first.begin();
 			int nopt = 0;
-			for(;itopt != opts->data_first.end() && nopt < n;++itopt)
+			for(;itopt != opts->data_first.end() && nopt < (int)sortfields.size();++itopt)
 			{
 				uint32_t options=0;
 				options = asAtomHandler::toInt(*itopt);
@@ -1213,10 +1332,21 @@ ASFUNCTIONBODY_ATOM(Array,sortOn)
 		tmp.push_back(v);
 	}
 	
-	sort(tmp.begin(),tmp.end(),sortOnComparator(sortfields,sys));
+	for (auto it=tmp.begin();it != tmp.end(); it++)
+	{
+		for (uint32_t i=0;i<sortfields.size();i++)
+		{
+			sort_key key = getSortKey(sys,it->sortvalues[i],sortfields[i].isNumeric,sortfields[i].isCaseInsensitive);
+			if(sortfields[i].isNumeric && std::isnan(key.num) && !asAtomHandler::isNumeric(it->sortvalues[i]))
+				throw RunTimeException("Cannot sort non number with Array.NUMERIC option");
+			it->sortkeys.push_back(key);
+		}
+	}
+	stable_sort(tmp.begin(),tmp.end(),sortOnComparator(sortfields));
 
 	th->data_first.clear();
 	th->data_second.clear();
+	th->elementKind=ELEMENTS_INTEGER;
 	std::vector<sorton_value>::iterator ittmp=tmp.begin();
 	uint32_t i = 0;
 	for(;ittmp != tmp.end();++ittmp)
@@ -1262,7 +1392,17 @@ ASFUNCTIONBODY_ATOM(Array,unshift)
 	// Derived classes may be sealed!
 	if (th->getSystemState()->getSwfVersion() > 12 && th->getClass() && th->getClass()->isSealed)
 		throwError<ReferenceError>(kWriteSealedError,"unshift",th->getClass()->getQualifiedClassName());
-	if (argslen > 0)
+	if (argslen > 0 && th->isPacked() && th->size() == th->currentsize && th->currentsize+argslen <= ARRAY_SIZE_THRESHOLD)
+	{
+		for(uint32_t i=0;i<argslen;i++)
+		{
+			ASATOM_INCREF(args[i]);
+			th->updateElementKind(args[i]);
+		}
+		th->data_first.insert(th->data_first.begin(),args,args+argslen);
+		th->currentsize+=argslen;
+	}
+	else if (argslen > 0)
 	{
 		th->resize(th->size()+argslen);
 		std::map<uint32_t,asAtom> tmp;
@@ -1282,6 +1422,7 @@ ASFUNCTIONBODY_ATOM(Array,unshift)
 		}
 		th->data_first.clear();
 		th->data_second.clear();
+		th->elementKind=ELEMENTS_INTEGER;
 		for (auto it=tmp.begin(); it != tmp.end(); ++it )
 		{
 			th->set(it->first,it->second,false);
@@ -1491,7 +1632,10 @@ ASFUNCTIONBODY_ATOM(Array,insertAt)
 	{
 		std::map<uint32_t,asAtom> tmp;
 		if (index < ARRAY_SIZE_THRESHOLD)
+		{
 			th->data_first.insert(th->data_first.begin()+index,o);
+			th->updateElementKind(o);
+		}
 		auto it=th->data_second.begin();
 		for (; it != th->data_second.end(); ++it )
 		{
@@ -1552,7 +1696,10 @@ ASFUNCTIONBODY_ATOM(Array,removeAt)
 	for (; it != th->data_second.end(); ++it )
 	{
 		if (it->first == ARRAY_SIZE_THRESHOLD)
+		{
 			th->data_first[ARRAY_SIZE_THRESHOLD-1]=it->second;
+			th->updateElementKind(it->second);
+		}
 		else
 			tmp[it->first-(it->first > (uint32_t)index ? 1 : 0)]=it->second;
 	}
@@ -1819,6 +1966,7 @@ bool Array::deleteVariableByMultiname(const multiname& name)
 	{
 		ASATOM_DECREF(data_first.at(index));
 		data_first[index]=asAtomHandler::invalidAtom;
+		elementKind=ELEMENTS_HOLEY;
 		return true;
 	}
 	
@@ -1992,12 +2140,12 @@ void Array::resize(uint64_t n)
 	{
 		if (n < data_first.size())
 		{
-			auto it1 = data_first.begin()+n;
-			while (it1 != data_first.end())
+			if (elementKind != ELEMENTS_INTEGER)
 			{
-				ASATOM_DECREF((*it1));
-				it1 = data_first.erase(it1);
+				for (auto it1 = data_first.begin()+n; it1 != data_first.end(); ++it1)
+					ASATOM_DECREF((*it1));
 			}
+			data_first.erase(data_first.begin()+n,data_first.end());
 		}
 		auto it2=data_second.begin();
 		while (it2 != data_second.end())
@@ -2149,10 +2297,16 @@ bool Array::set(unsigned int index, asAtom& o, bool checkbounds, bool addref)
 					ASATOM_DECREF(data_first.at(index));
 			}
 			else
+			{
+				// the values between the old end and index are holes
+				if (index > data_first.size())
+					elementKind = ELEMENTS_HOLEY;
 				data_first.resize(index+1);
+			}
 			if (addref && ret)
 				ASATOM_INCREF(o);
 			data_first[index]=o;
+			updateElementKind(o);
 		}
 		else
 		{
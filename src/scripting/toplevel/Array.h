@@ -22,6 +22,7 @@
 
 #include "asobject.h"
 #include <unordered_map>
+#include <algorithm>
 
 namespace lightspark
 {
@@ -37,13 +38,189 @@ struct sorton_field
 	multiname fieldname;
 	sorton_field(const multiname& sortfieldname):isNumeric(false),isCaseInsensitive(false),isDescending(false),fieldname(sortfieldname){}
 };
+// key of a value for the default comparison, computed once per value before sorting
+struct sort_key
+{
+	tiny_string str;
+	number_t num;
+	sort_key():num(0) {}
+};
 struct sorton_value
 {
 	std::vector<asAtom> sortvalues;
+	std::vector<sort_key> sortkeys;
 	asAtom dataAtom;
 	sorton_value(asAtom _dataAtom):dataAtom(_dataAtom) {}
 };
 
+/*
+ * Stable merge sort for user defined comparison functions, similar to timsort:
+ * already sorted (or strictly descending) runs are detected and short runs are extended by
+ * binary insertion sort, so presorted input needs few calls of the comparison function.
+ * The comparison function doesn't have to be consistent, the sort always terminates.
+ * C has to provide "number_t compare(const asAtom& a, const asAtom& b)"
+ */
+template<class C>
+class adaptiveSort
+{
+private:
+	struct run
+	{
+		uint32_t start;
+		uint32_t len;
+	};
+	std::vector<asAtom>& v;
+	C& comp;
+	std::vector<run> runs;
+	std::vector<asAtom> buf;
+	bool less(const asAtom& a, const asAtom& b) { return comp.compare(a,b) < 0; }
+	static uint32_t minRunLength(uint32_t n)
+	{
+		uint32_t r=0;
+		while(n >= 32)
+		{
+			r |= n&1;
+			n >>= 1;
+		}
+		return n+r;
+	}
+	uint32_t countRun(uint32_t lo, uint32_t hi)
+	{
+		uint32_t i=lo+1;
+		if(i==hi)
+			return 1;
+		if(less(v[i],v[lo]))
+		{
+			// only strictly descending runs are reversed to keep the sort stable
+			while(i+1 < hi && less(v[i+1],v[i]))
+				i++;
+			std::reverse(v.begin()+lo,v.begin()+i+1);
+		}
+		else
+		{
+			while(i+1 < hi && !less(v[i+1],v[i]))
+				i++;
+		}
+		return i+1-lo;
+	}
+	void binaryInsertionSort(uint32_t lo, uint32_t hi, uint32_t start)
+	{
+		for(uint32_t i=start;i<hi;i++)
+		{
+			asAtom pivot=v[i];
+			uint32_t left=lo;
+			uint32_t right=i;
+			while(left < right)
+			{
+				uint32_t mid=(left+right)/2;
+				if(less(pivot,v[mid]))
+					right=mid;
+				else
+					left=mid+1;
+			}
+			for(uint32_t j=i;j>left;j--)
+				v[j]=v[j-1];
+			v[left]=pivot;
+		}
+	}
+	void mergeAt(uint32_t n)
+	{
+		uint32_t start1=runs[n].start;
+		uint32_t end1=start1+runs[n].len;
+		uint32_t end2=end1+runs[n+1].len;
+		runs[n].len+=runs[n+1].len;
+		runs.erase(runs.begin()+n+1);
+		// elements of the first run that are not bigger than the first element of the second run are already in place
+		uint32_t left=start1;
+		uint32_t right=end1;
+		while(left < right)
+		{
+			uint32_t mid=(left+right)/2;
+			if(less(v[end1],v[mid]))
+				right=mid;
+			else
+				left=mid+1;
+		}
+		start1=left;
+		if(start1==end1)
+			return;
+		// elements of the second run that are not smaller than the last element of the first run are also in place
+		left=end1;
+		right=end2;
+		while(left < right)
+		{
+			uint32_t mid=(left+right)/2;
+			if(less(v[mid],v[end1-1]))
+				left=mid+1;
+			else
+				right=mid;
+		}
+		end2=left;
+		buf.assign(v.begin()+start1,v.begin()+end1);
+		uint32_t i=0;
+		uint32_t j=end1;
+		uint32_t k=start1;
+		while(i < buf.size() && j < end2)
+		{
+			if(less(v[j],buf[i]))
+				v[k++]=v[j++];
+			else
+				v[k++]=buf[i++];
+		}
+		while(i < buf.size())
+			v[k++]=buf[i++];
+	}
+	void mergeCollapse()
+	{
+		while(runs.size() > 1)
+		{
+			uint32_t n=runs.size()-2;
+			if((n > 0 && runs[n-1].len <= runs[n].len+runs[n+1].len) ||
+				(n > 1 && runs[n-2].len <= runs[n-1].len+runs[n].len))
+			{
+				if(runs[n-1].len < runs[n+1].len)
+					n--;
+			}
+			else if(runs[n].len > runs[n+1].len)
+				break;
+			mergeAt(n);
+		}
+	}
+public:
+	adaptiveSort(std::vector<asAtom>& _v, C& _comp):v(_v),comp(_comp) {}
+	void sort()
+	{
+		uint32_t n=v.size();
+		if(n < 2)
+			return;
+		uint32_t minrun=minRunLength(n);
+		uint32_t lo=0;
+		while(lo < n)
+		{
+			uint32_t len=countRun(lo,n);
+			if(len < minrun)
+			{
+				uint32_t forced=std::min(minrun,n-lo);
+				binaryInsertionSort(lo,lo+forced,lo+len);
+				len=forced;
+			}
+			run r;
+			r.start=lo;
+			r.len=len;
+			runs.push_back(r);
+			mergeCollapse();
+			lo+=len;
+		}
+		while(runs.size() > 1)
+		{
+			uint32_t n=runs.size()-2;
+			if(n > 0 && runs[n-1].len < runs[n+1].len)
+				n--;
+			mergeAt(n);
+		}
+	}
+};
+
 class Array: public ASObject
 {
 friend class ABCVm;
@@ -52,28 +229,40 @@ protected:
 	// data is split into a vector for the first ARRAY_SIZE_THRESHOLD indexes, and a map for bigger indexes
 	std::vector<asAtom> data_first;
 	std::unordered_map<uint32_t,asAtom> data_second;
+	/*
+	 * Kind of the values in data_first. Like the element kinds of JavaScript engines it only changes
+	 * to a more general kind, until data_first is cleared:
+	 * ELEMENTS_INTEGER: only unboxed integers, ELEMENTS_ANY: no holes, ELEMENTS_HOLEY: may contain invalid atoms
+	 */
+	enum ELEMENT_KIND { ELEMENTS_INTEGER=0, ELEMENTS_ANY=1, ELEMENTS_HOLEY=2 };
+	ELEMENT_KIND elementKind;
+	FORCE_INLINE void updateElementKind(const asAtom& o)
+	{
+		ELEMENT_KIND k;
+		if ((o.uintval&0x7) == ATOM_INTEGER)
+			k = ELEMENTS_INTEGER;
+		else if (asAtomHandler::isInvalid(o))
+			k = ELEMENTS_HOLEY;
+		else
+			k = ELEMENTS_ANY;
+		if (k > elementKind)
+			elementKind = k;
+	}
+	// all values are stored in data_first without holes, so it can be modified as a whole
+	FORCE_INLINE bool isPacked() const
+	{
+		return elementKind != ELEMENTS_HOLEY && data_second.empty() && currentsize == data_first.size();
+	}
 	
 	void outofbounds(unsigned int index) const;
 	~Array();
 private:
-	class sortComparatorDefault
-	{
-	private:
-		bool isNumeric;
-		bool isCaseInsensitive;
-		bool isDescending;
-		bool useoldversion;
-	public:
-		sortComparatorDefault(bool oldversion, bool n, bool ci, bool d):isNumeric(n),isCaseInsensitive(ci),isDescending(d),useoldversion(oldversion){}
-		bool operator()(const asAtom& d1, const asAtom& d2);
-	};
 	class sortOnComparator
 	{
 	private:
 		std::vector<sorton_field> fields;
-		SystemState* sys;
 	public:
-		sortOnComparator(const std::vector<sorton_field>& sf,SystemState* s):fields(sf),sys(s){}
+		sortOnComparator(const std::vector<sorton_field>& sf):fields(sf){}
 		bool operator()(const sorton_value& d1, const sorton_value& d2);
 	};
 	void constructorImpl(asAtom *args, const unsigned int argslen);
@@ -89,6 +278,13 @@ public:
 		number_t compare(const asAtom& d1, const asAtom& d2);
 	};
 	static bool isIntegerWithoutLeadingZeros(const tiny_string& value);
+	// computes the key of a value once, so that sorting doesn't have to convert the values for every comparison
+	static sort_key getSortKey(SystemState* sys, asAtom& value, bool isNumeric, bool isCaseInsensitive, bool useoldversion=false);
+	/*
+	 * Sorts the values with the default comparison (as strings or, with isNumeric, as numbers), also used by Vector.
+	 * NaN values are only allowed if they are numbers, unless nanIsError is set
+	 */
+	static void sortDefault(SystemState* sys, std::vector<asAtom>& values, bool isNumeric, bool isCaseInsensitive, bool isDescending, bool useoldversion, bool nanIsError);
 	enum SORTTYPE { CASEINSENSITIVE=1, DESCENDING=2, UNIQUESORT=4, RETURNINDEXEDARRAY=8, NUMERIC=16 };
 	Array(Class_base* c);
 	bool destruct() override;
@@ -777,47 +777,6 @@ ASFUNCTIONBODY_ATOM(Vector,indexOf)
 	}
 	asAtomHandler::setInt(ret,sys,res);
 }
-bool Vector::sortComparatorDefault::operator()(const asAtom& d1, const asAtom& d2)
-{
-	asAtom o1 = d1;
-	asAtom o2 = d2;
-	if(isNumeric)
-	{
-		number_t a=asAtomHandler::toNumber(o1);
-
-		number_t b=asAtomHandler::toNumber(o2);
-
-		if(std::isnan(a) || std::isnan(b))
-			throw RunTimeException("Cannot sort non number with Array.NUMERIC option");
-		if(isDescending)
-			return b>a;
-		else
-			return a<b;
-	}
-	else
-	{
-		//Comparison is always in lexicographic order
-		tiny_string s1 = asAtomHandler::toString(o1,getSys());
-		tiny_string s2 = asAtomHandler::toString(o2,getSys());
-
-		if(isDescending)
-		{
-			//TODO: unicode support
-			if(isCaseInsensitive)
-				return s1.strcasecmp(s2)>0;
-			else
-				return s1>s2;
-		}
-		else
-		{
-			//TODO: unicode support
-			if(isCaseInsensitive)
-				return s1.strcasecmp(s2)<0;
-			else
-				return s1<s2;
-		}
-	}
-}
 number_t Vector::sortComparatorWrapper::compare(const asAtom& d1, const asAtom& d2)
 {
 	asAtom objs[2];
@@ -837,49 +796,6 @@ number_t Vector::sortComparatorWrapper::compare(const asAtom& d1, const asAtom&
 	return asAtomHandler::toNumber(ret);
 }
 
-// std::sort expects strict weak ordering for the comparison function
-// this is not guarranteed by user defined comparison functions, so we need our own sorting method.
-// TODO this is just a simple quicksort implementation, not optimized for performance
-void simplequicksortVector(std::vector<asAtom>& v, Vector::sortComparatorWrapper& comp, int32_t lo, int32_t hi)
-{
-	if (v.size() == 2)
-	{
-		if (comp.compare(v[0],v[1]) > 0)
-			std::swap(v[0],v[1]);
-		return;
-	}
-	if (lo < hi)
-	{
-		asAtom pivot = v[lo];
-		int32_t i = lo - 1;
-		int32_t j = hi + 1;
-		while (true)
-		{
-			do
-			{
-				i++;
-			}
-			while (i < hi && (comp.compare(v[i],pivot) < 0));
-			
-			do
-			{
-				j--;
-			}
-			while (j >= 0 && (comp.compare(v[j],pivot) > 0));
-	
-			if (i >= j)
-				break;
-	
-			std::swap(v[i],v[j]);
-		}
-		if (j >= lo)
-		{
-			simplequicksortVector(v, comp, lo, j);
-			simplequicksortVector(v, comp, j + 1, hi);
-		}
-	}
-}
-
 ASFUNCTIONBODY_ATOM(Vector,_sort)
 {
 	if (argslen != 1)
@@ -917,10 +833,11 @@ ASFUNCTIONBODY_ATOM(Vector,_sort)
 	if(asAtomHandler::isValid(comp))
 	{
 		sortComparatorWrapper c(comp);
-		simplequicksortVector(tmp,c,0,tmp.size()-1);
+		adaptiveSort<sortComparatorWrapper> sorter(tmp,c);
+		sorter.sort();
 	}
 	else
-		sort(tmp.begin(),tmp.end(),sortComparatorDefault(isNumeric,isCaseInsensitive,isDescending));
+		Array::sortDefault(sys,tmp,isNumeric,isCaseInsensitive,isDescending,false,true);
 
 	th->vec.clear();
 	for(auto ittmp=tmp.begin();ittmp != tmp.end();++ittmp)
@@ -32,16 +32,6 @@ class Vector: public ASObject
 	bool fixed;
 	std::vector<asAtom, reporter_allocator<asAtom>> vec;
 	int capIndex(int i) const;
-	class sortComparatorDefault
-	{
-	private:
-		bool isNumeric;
-		bool isCaseInsensitive;
-		bool isDescending;
-	public:
-		sortComparatorDefault(bool n, bool ci, bool d):isNumeric(n),isCaseInsensitive(ci),isDescending(d){}
-		bool operator()(const asAtom& d1, const asAtom& d2);
-	};
 	asAtom getDefaultValue();
 public:
 	class sortComparatorWrapper
@@ -36,6 +36,11 @@ static bool ignoreWhitespace;
 static int32_t prettyIndent;
 static bool prettyPrinting;
 
+// a document is indexed when it is queried this often without modifications
+#define XML_NAME_INDEX_MIN_QUERIES 8
+
+uint32_t XML::nameindexbuilds = 0;
+
 void setDefaultXMLSettings()
 {
 	ignoreComments = true;
@@ -45,16 +50,16 @@ void setDefaultXMLSettings()
 	prettyPrinting = true;
 }
 
-XML::XML(Class_base* c):ASObject(c,T_OBJECT,SUBTYPE_XML),parentNode(0),nodetype((pugi::xml_node_type)0),isAttribute(false),nodenamespace_uri(BUILTIN_STRINGS::EMPTY),nodenamespace_prefix(BUILTIN_STRINGS::EMPTY),constructed(false)
+XML::XML(Class_base* c):ASObject(c,T_OBJECT,SUBTYPE_XML),parentNode(0),nodetype((pugi::xml_node_type)0),isAttribute(false),nodenamespace_uri(BUILTIN_STRINGS::EMPTY),nodenamespace_prefix(BUILTIN_STRINGS::EMPTY),modificationcount(0),nameindexqueries(0),nameindexmodification(0),indexbuild(0),constructed(false)
 {
 }
 
-XML::XML(Class_base* c, const std::string &str):ASObject(c,T_OBJECT,SUBTYPE_XML),parentNode(0),nodetype((pugi::xml_node_type)0),isAttribute(false),nodenamespace_uri(BUILTIN_STRINGS::EMPTY),nodenamespace_prefix(BUILTIN_STRINGS::EMPTY),constructed(false)
+XML::XML(Class_base* c, const std::string &str):ASObject(c,T_OBJECT,SUBTYPE_XML),parentNode(0),nodetype((pugi::xml_node_type)0),isAttribute(false),nodenamespace_uri(BUILTIN_STRINGS::EMPTY),nodenamespace_prefix(BUILTIN_STRINGS::EMPTY),modificationcount(0),nameindexqueries(0),nameindexmodification(0),indexbuild(0),constructed(false)
 {
-	createTree(buildFromString(str, getParseMode()),false);
+	createTreeFromString(str);
 }
 
-XML::XML(Class_base* c, const pugi::xml_node& _n, XML* parent, bool fromXMLList):ASObject(c,T_OBJECT,SUBTYPE_XML),parentNode(0),nodetype((pugi::xml_node_type)0),isAttribute(false),nodenamespace_uri(BUILTIN_STRINGS::EMPTY),nodenamespace_prefix(BUILTIN_STRINGS::EMPTY),constructed(false)
+XML::XML(Class_base* c, const pugi::xml_node& _n, XML* parent, bool fromXMLList):ASObject(c,T_OBJECT,SUBTYPE_XML),parentNode(0),nodetype((pugi::xml_node_type)0),isAttribute(false),nodenamespace_uri(BUILTIN_STRINGS::EMPTY),nodenamespace_prefix(BUILTIN_STRINGS::EMPTY),modificationcount(0),nameindexqueries(0),nameindexmodification(0),indexbuild(0),constructed(false)
 {
 	if (parent)
 	{
@@ -67,6 +72,8 @@ XML::XML(Class_base* c, const pugi::xml_node& _n, XML* parent, bool fromXMLList)
 bool XML::destruct()
 {
 	xmldoc.reset();
+	lazynode = pugi::xml_node();
+	lazydoc.reset();
 	parentNode.reset();
 	nodetype =(pugi::xml_node_type)0;
 	isAttribute = false;
@@ -79,6 +86,9 @@ bool XML::destruct()
 	attributelist.reset();
 	procinstlist.reset();
 	namespacedefs.clear();
+	nameindex.reset();
+	nameindexqueries=0;
+	indexbuild=0;
 	return destructIntern();
 }
 
@@ -211,7 +221,7 @@ ASFUNCTIONBODY_ATOM(XML,_constructor)
 	   asAtomHandler::is<Null>(args[0]) || 
 	   asAtomHandler::is<Undefined>(args[0]))
 	{
-		th->createTree(th->buildFromString("", getParseMode()),false);
+		th->createTreeFromString("");
 	}
 	else if(asAtomHandler::is<ByteArray>(args[0]))
 	{
@@ -220,8 +230,7 @@ ASFUNCTIONBODY_ATOM(XML,_constructor)
 		ByteArray* ba=asAtomHandler::as<ByteArray>(args[0]);
 		uint32_t len=ba->getLength();
 		const uint8_t* str=ba->getBuffer(len, false);
-		th->createTree(th->buildFromString(std::string((const char*)str,len), getParseMode(),
-					     getVm(sys)->getDefaultXMLNamespace()),false);
+		th->createTreeFromString(std::string((const char*)str,len));
 	}
 	else if(asAtomHandler::isString(args[0]) ||
 		asAtomHandler::is<Number>(args[0]) ||
@@ -231,24 +240,21 @@ ASFUNCTIONBODY_ATOM(XML,_constructor)
 	{
 		//By specs, XML constructor will only convert to string Numbers or Booleans
 		//ints are not explicitly mentioned, but they seem to work
-		th->createTree(th->buildFromString(asAtomHandler::toString(args[0],sys), getParseMode(),
-					     getVm(sys)->getDefaultXMLNamespace()),false);
+		th->createTreeFromString(asAtomHandler::toString(args[0],sys));
 	}
 	else if(asAtomHandler::is<XML>(args[0]))
 	{
-		th->createTree(th->buildFromString(asAtomHandler::as<XML>(args[0])->toXMLString_internal(), getParseMode(),
-					     getVm(sys)->getDefaultXMLNamespace()),false);
+		th->createTreeFromString(asAtomHandler::as<XML>(args[0])->toXMLString_internal());
 	}
 	else if(asAtomHandler::is<XMLList>(args[0]))
 	{
 		XMLList *list=asAtomHandler::as<XMLList>(args[0]);
 		_R<XML> reduced=list->reduceToXML();
-		th->createTree(th->buildFromString(reduced->toXMLString_internal(), getParseMode()),false);
+		th->createTreeFromString(reduced->toXMLString_internal());
 	}
 	else
 	{
-		th->createTree(th->buildFromString(asAtomHandler::toString(args[0],sys), getParseMode(),
-					     getVm(sys)->getDefaultXMLNamespace()),false);
+		th->createTreeFromString(asAtomHandler::toString(args[0],sys));
 	}
 }
 
@@ -392,6 +398,7 @@ void XML::handleNotification(const tiny_string& command, asAtom value, asAtom de
 }
 void XML::appendChild(_R<XML> newChild)
 {
+	treeModified();
 	if (newChild->constructed)
 	{
 		if (this == newChild.getPtr())
@@ -404,8 +411,8 @@ void XML::appendChild(_R<XML> newChild)
 			node = node->parentNode;
 		}
 		this->incRef();
-		newChild->parentNode = _NR<XML>(this);
-		childrenlist->append(newChild);
+		newChild->setParentNode(_NR<XML>(this));
+		getChildrenRef()->append(newChild);
 		handleNotification("nodeAdded",asAtomHandler::fromObject(newChild.getPtr()),asAtomHandler::nullAtom);
 	}
 }
@@ -682,7 +689,7 @@ const tiny_string XML::toXMLString_internal(bool pretty, uint32_t defaultnsprefi
 						res += "\"";
 					}
 				}
-				if (childrenlist.isNull() || childrenlist->nodes.size() == 0)
+				if (getChildrenRef().isNull() || getChildrenRef()->nodes.size() == 0)
 				{
 					res += "/>";
 					break;
@@ -690,10 +697,10 @@ const tiny_string XML::toXMLString_internal(bool pretty, uint32_t defaultnsprefi
 				res += ">";
 				tiny_string newindent;
 				bool bindent = (pretty && prettyPrinting && prettyIndent >=0 && 
-								!childrenlist.isNull() &&
-								(childrenlist->nodes.size() >1 || 
-								 (!childrenlist->nodes[0]->procinstlist.isNull()) ||
-								 (childrenlist->nodes[0]->nodetype != pugi::node_pcdata && childrenlist->nodes[0]->nodetype != pugi::node_cdata)));
+								!getChildrenRef().isNull() &&
+								(getChildrenRef()->nodes.size() >1 || 
+								 (!getChildrenRef()->nodes[0]->procinstlist.isNull()) ||
+								 (getChildrenRef()->nodes[0]->nodetype != pugi::node_pcdata && getChildrenRef()->nodes[0]->nodetype != pugi::node_cdata)));
 				if (bindent)
 				{
 					newindent = indent;
@@ -702,11 +709,11 @@ const tiny_string XML::toXMLString_internal(bool pretty, uint32_t defaultnsprefi
 						newindent += " ";
 					}
 				}
-				if (!childrenlist.isNull())
+				if (!getChildrenRef().isNull())
 				{
-					for (uint32_t i = 0; i < childrenlist->nodes.size(); i++)
+					for (uint32_t i = 0; i < getChildrenRef()->nodes.size(); i++)
 					{
-						_R<XML> child= childrenlist->nodes[i];
+						_R<XML> child= getChildrenRef()->nodes[i];
 						tiny_string tmpres = child->toXMLString_internal(pretty,defaultnsprefix,newindent.raw_buf(),false);
 						if (bindent && !tmpres.empty())
 							res += "\n";
@@ -751,11 +758,11 @@ ASFUNCTIONBODY_ATOM(XML,toXMLString)
 
 void XML::childrenImpl(XMLVector& ret, const tiny_string& name)
 {
-	if (!childrenlist.isNull())
+	if (!getChildrenRef().isNull())
 	{
-		for (uint32_t i = 0; i < childrenlist->nodes.size(); i++)
+		for (uint32_t i = 0; i < getChildrenRef()->nodes.size(); i++)
 		{
-			_R<XML> child= childrenlist->nodes[i];
+			_R<XML> child= getChildrenRef()->nodes[i];
 			if(name!="*" && child->nodename != name)
 				continue;
 			child->incRef();
@@ -766,9 +773,9 @@ void XML::childrenImpl(XMLVector& ret, const tiny_string& name)
 
 void XML::childrenImpl(XMLVector& ret, uint32_t index)
 {
-	if (constructed && !childrenlist.isNull() && index < childrenlist->nodes.size())
+	if (constructed && !getChildrenRef().isNull() && index < getChildrenRef()->nodes.size())
 	{
-		_R<XML> child= childrenlist->nodes[index];
+		_R<XML> child= getChildrenRef()->nodes[index];
 		child->incRef();
 		ret.push_back(child);
 	}
@@ -811,12 +818,12 @@ ASFUNCTIONBODY_ATOM(XML,children)
 ASFUNCTIONBODY_ATOM(XML,childIndex)
 {
 	XML* th=asAtomHandler::as<XML>(obj);
-	if (th->parentNode && !th->parentNode->childrenlist.isNull())
+	if (th->parentNode && !th->parentNode->getChildrenRef().isNull())
 	{
 		XML* parent = th->parentNode.getPtr();
-		for (uint32_t i = 0; i < parent->childrenlist->nodes.size(); i++)
+		for (uint32_t i = 0; i < parent->getChildrenRef()->nodes.size(); i++)
 		{
-			ASObject* o= parent->childrenlist->nodes[i].getPtr();
+			ASObject* o= parent->getChildrenRef()->nodes[i].getPtr();
 			if (o == th)
 			{
 				asAtomHandler::setUInt(ret,sys,i);
@@ -847,11 +854,11 @@ ASFUNCTIONBODY_ATOM(XML,valueOf)
 
 void XML::getText(XMLVector& ret)
 {
-	if (childrenlist.isNull())
+	if (getChildrenRef().isNull())
 		return;
-	for (uint32_t i = 0; i < childrenlist->nodes.size(); i++)
+	for (uint32_t i = 0; i < getChildrenRef()->nodes.size(); i++)
 	{
-		_R<XML> child= childrenlist->nodes[i];
+		_R<XML> child= getChildrenRef()->nodes[i];
 		if (child->getNodeKind() == pugi::node_pcdata  ||
 			child->getNodeKind() == pugi::node_cdata)
 		{
@@ -885,11 +892,11 @@ ASFUNCTIONBODY_ATOM(XML,elements)
 
 void XML::getElementNodes(const tiny_string& name, XMLVector& foundElements)
 {
-	if (childrenlist.isNull())
+	if (getChildrenRef().isNull())
 		return;
-	for (uint32_t i = 0; i < childrenlist->nodes.size(); i++)
+	for (uint32_t i = 0; i < getChildrenRef()->nodes.size(); i++)
 	{
-		_R<XML> child= childrenlist->nodes[i];
+		_R<XML> child= getChildrenRef()->nodes[i];
 		if(child->nodetype==pugi::node_element && (name.empty() || name == child->nodename))
 		{
 			child->incRef();
@@ -929,6 +936,7 @@ ASFUNCTIONBODY_ATOM(XML,inScopeNamespaces)
 ASFUNCTIONBODY_ATOM(XML,addNamespace)
 {
 	XML* th=asAtomHandler::as<XML>(obj);
+	th->treeModified();
 	_NR<ASObject> newNamespace;
 	ARG_UNPACK_ATOM(newNamespace);
 
@@ -1048,6 +1056,7 @@ ASFUNCTIONBODY_ATOM(XML,_setLocalName)
 
 void XML::setLocalName(const tiny_string& new_name)
 {
+	treeModified();
 	asAtom v =asAtomHandler::fromObject(abstract_s(getSystemState(),new_name));
 	if(!isXMLName(getSystemState(),v))
 	{
@@ -1060,6 +1069,7 @@ void XML::setLocalName(const tiny_string& new_name)
 ASFUNCTIONBODY_ATOM(XML,_setName)
 {
 	XML* th=asAtomHandler::as<XML>(obj);
+	th->treeModified();
 	_NR<ASObject> newName;
 	ARG_UNPACK_ATOM(newName);
 
@@ -1153,6 +1163,7 @@ ASFUNCTIONBODY_ATOM(XML,_setNamespace)
 
 void XML::setNamespace(uint32_t ns_uri, uint32_t ns_prefix)
 {
+	treeModified();
 	this->nodenamespace_prefix = ns_prefix;
 	this->nodenamespace_uri = ns_uri;
 	handleNotification("namespaceSet",asAtomHandler::fromObject(this),asAtomHandler::nullAtom);
@@ -1172,10 +1183,11 @@ XML *XML::copy()
 ASFUNCTIONBODY_ATOM(XML,_setChildren)
 {
 	XML* th=asAtomHandler::as<XML>(obj);
+	th->treeModified();
 	_NR<ASObject> newChildren;
 	ARG_UNPACK_ATOM(newChildren);
 
-	th->childrenlist->clear();
+	th->getChildrenRef()->clear();
 
 	if (newChildren->is<XML>())
 	{
@@ -1216,11 +1228,13 @@ ASFUNCTIONBODY_ATOM(XML,_normalize)
 
 void XML::normalize()
 {
-	childrenlist->normalize();
+	treeModified();
+	getChildrenRef()->normalize();
 }
 
 void XML::addTextContent(const tiny_string& str)
 {
+	treeModified();
 	assert(getNodeKind() == pugi::node_pcdata);
 
 	nodevalue += str;
@@ -1228,6 +1242,7 @@ void XML::addTextContent(const tiny_string& str)
 
 void XML::setTextContent(const tiny_string& content)
 {
+	treeModified();
 	if (getNodeKind() == pugi::node_pcdata ||
 	    isAttribute ||
 	    getNodeKind() == pugi::node_comment ||
@@ -1244,11 +1259,11 @@ bool XML::hasSimpleContent() const
 	if (getNodeKind() == pugi::node_comment ||
 		getNodeKind() == pugi::node_pi)
 		return false;
-	if (childrenlist.isNull())
+	if (getChildrenRef().isNull())
 		return true;
-	for(size_t i=0; i<childrenlist->nodes.size(); i++)
+	for(size_t i=0; i<getChildrenRef()->nodes.size(); i++)
 	{
-		if (childrenlist->nodes[i]->getNodeKind() == pugi::node_element)
+		if (getChildrenRef()->nodes[i]->getNodeKind() == pugi::node_element)
 			return false;
 	}
 	return true;
@@ -1265,7 +1280,160 @@ pugi::xml_node_type XML::getNodeKind() const
 }
 
 
+/*
+ * checks on the pugixml tree if the children of a not yet materialized node may contain elements
+ * (or the node and its children attributes) with the local name, so that the subtree doesn't have to be created
+ * if there can't be a match
+ */
+static bool lazySubtreeContainsName(const pugi::xml_node& root, const tiny_string& name, bool bIsAttribute)
+{
+	auto matches = [&name](const char* qname)
+	{
+		const char* localname = strchr(qname,':');
+		return strcmp(localname ? localname+1 : qname, name.raw_buf()) == 0;
+	};
+	pugi::xml_node node = root;
+	while (true)
+	{
+		if (bIsAttribute)
+		{
+			for (pugi::xml_attribute attr = node.first_attribute(); attr; attr = attr.next_attribute())
+			{
+				if (matches(attr.name()))
+					return true;
+			}
+		}
+		else if (node != root && node.type() == pugi::node_element && matches(node.name()))
+			return true;
+		if (node.first_child())
+			node = node.first_child();
+		else
+		{
+			while (node != root && !node.next_sibling())
+				node = node.parent();
+			if (node == root)
+				return false;
+			node = node.next_sibling();
+		}
+	}
+}
+
+void XML::treeModified() const
+{
+	const XML* root = this;
+	while (!root->parentNode.isNull())
+		root = root->parentNode.getPtr();
+	root->modificationcount++;
+	root->nameindex.reset();
+}
+
+xmlNameIndex* XML::getNameIndex() const
+{
+	const XML* root = this;
+	while (!root->parentNode.isNull())
+		root = root->parentNode.getPtr();
+	if (!root->nameindex)
+	{
+		// single queries are faster without the index
+		if (root->nameindexmodification != root->modificationcount)
+		{
+			root->nameindexmodification = root->modificationcount;
+			root->nameindexqueries = 0;
+		}
+		if (++root->nameindexqueries < XML_NAME_INDEX_MIN_QUERIES)
+			return nullptr;
+		xmlNameIndex* index = new xmlNameIndex();
+		index->buildid = ++nameindexbuilds;
+		uint32_t pos = 0;
+		if (!root->addToNameIndex(index,pos,UINT32_MAX))
+		{
+			// the tree can't be indexed, don't try again until it is modified
+			delete index;
+			root->nameindexqueries = 0;
+			return nullptr;
+		}
+		root->nameindex.reset(index);
+	}
+	return indexbuild == root->nameindex->buildid ? root->nameindex.get() : nullptr;
+}
+
+bool XML::addToNameIndex(xmlNameIndex* index, uint32_t& pos, uint32_t parentpos) const
+{
+	// a node contained in more than one children list has no unique position
+	if (indexbuild == index->buildid)
+		return false;
+	indexbuild = index->buildid;
+	indexpos = pos++;
+	indexparentpos = parentpos;
+	// like getDescendantsByQNameIntern the attributes and children of nodes that are not constructed are ignored
+	if (constructed && !attributelist.isNull())
+	{
+		for (auto it = attributelist->nodes.begin(); it != attributelist->nodes.end(); it++)
+		{
+			(*it)->indexpos = indexpos;
+			index->attributes[getSystemState()->getUniqueStringId((*it)->nodename)].push_back(*it);
+		}
+	}
+	// the children of lazily parsed nodes are not created for the index
+	if (constructed && lazynode)
+		index->lazynodes.push_back(lazynode);
+	else if (constructed && !childrenlist.isNull())
+	{
+		for (auto it = childrenlist->nodes.begin(); it != childrenlist->nodes.end(); it++)
+		{
+			index->elements[getSystemState()->getUniqueStringId((*it)->nodename)].push_back(*it);
+			if (!(*it)->addToNameIndex(index,pos,indexpos))
+				return false;
+		}
+	}
+	indexend = pos-1;
+	return true;
+}
+
+bool XML::nameInLazySubtrees(xmlNameIndex* index, const tiny_string& name, bool bIsAttribute) const
+{
+	if (index->lazynodes.empty())
+		return false;
+	auto& names = bIsAttribute ? index->lazyattributes : index->lazyelements;
+	auto it = names.insert(make_pair(getSystemState()->getUniqueStringId(name),false));
+	if (it.second)
+	{
+		for (auto itnode = index->lazynodes.begin(); itnode != index->lazynodes.end() && !it.first->second; itnode++)
+			it.first->second = lazySubtreeContainsName(*itnode, name, bIsAttribute);
+	}
+	return it.first->second;
+}
+
 void XML::getDescendantsByQName(const tiny_string& name, uint32_t ns, bool bIsAttribute, XMLVector& ret) const
+{
+	if (!constructed)
+		return;
+	xmlNameIndex* index = (name=="" || name=="*") ? nullptr : getNameIndex();
+	// names in lazily parsed subtrees are searched without the index, this creates the subtrees containing them
+	if (!index || nameInLazySubtrees(index, name, bIsAttribute))
+	{
+		getDescendantsByQNameIntern(name, ns, bIsAttribute, ret);
+		return;
+	}
+	auto& names = bIsAttribute ? index->attributes : index->elements;
+	auto it = names.find(getSystemState()->getUniqueStringId(name));
+	if (it == names.end())
+		return;
+	// the attributes of this node and all nodes behind it up to the end of its subtree
+	uint32_t first = bIsAttribute ? indexpos : indexpos+1;
+	auto itnode = std::lower_bound(it->second.begin(),it->second.end(),first,
+								   [](const _R<XML>& n, uint32_t p) { return n->indexpos < p; });
+	for (; itnode != it->second.end() && (*itnode)->indexpos <= indexend; itnode++)
+	{
+		if (ns == BUILTIN_STRINGS::STRING_WILDCARD || ns == (*itnode)->nodenamespace_uri)
+		{
+			(*itnode)->incRef();
+			ret.push_back(*itnode);
+		}
+	}
+}
+
+void XML::getDescendantsByQNameIntern(const tiny_string& name, uint32_t ns, bool bIsAttribute, XMLVector& ret) const
 {
 	if (!constructed)
 		return;
@@ -1282,17 +1450,20 @@ void XML::getDescendantsByQName(const tiny_string& name, uint32_t ns, bool bIsAt
 			}
 		}
 	}
-	if (childrenlist.isNull())
+	if (getChildrenRef().isNull())
 		return;
-	for (uint32_t i = 0; i < childrenlist->nodes.size(); i++)
+	for (uint32_t i = 0; i < getChildrenRef()->nodes.size(); i++)
 	{
-		_R<XML> child= childrenlist->nodes[i];
+		_R<XML> child= getChildrenRef()->nodes[i];
 		if(!bIsAttribute && (name=="" || name=="*" || (name == child->nodename && (ns == BUILTIN_STRINGS::STRING_WILDCARD || ns == child->nodenamespace_uri))))
 		{
 			child->incRef();
 			ret.push_back(child);
 		}
-		child->getDescendantsByQName(name, ns, bIsAttribute, ret);
+		// lazily parsed subtrees without matching names don't have to be created
+		if (child->lazynode && name!="" && name!="*" && !lazySubtreeContainsName(child->lazynode, name, bIsAttribute))
+			continue;
+		child->getDescendantsByQNameIntern(name, ns, bIsAttribute, ret);
 	}
 }
 
@@ -1473,17 +1644,36 @@ XML::XMLVector XML::getValuesByMultiname(_NR<XMLList> nodelist, const multiname&
 	}
 	else
 	{
+		auto nsmatch = [&](const _R<XML>& child)
+		{
+			uint32_t childnamespace_uri = child->nodenamespace_uri;
+			return hasAnyNS||
+					(namespace_uri.find(BUILTIN_STRINGS::STRING_WILDCARD)!= namespace_uri.end()) ||
+					(namespace_uri.size() == 0 && childnamespace_uri == BUILTIN_STRINGS::EMPTY) ||
+					(namespace_uri.find(childnamespace_uri) != namespace_uri.end());
+		};
+		xmlNameIndex* index = nodelist.getPtr() == childrenlist.getPtr() && !lazynode ? getNameIndex() : nullptr;
+		if (index)
+		{
+			// only the nodes with the name inside the subtree of this node have to be checked
+			auto it = index->elements.find(getSystemState()->getUniqueStringId(normalizedName));
+			if (it == index->elements.end())
+				return ret;
+			auto child = std::lower_bound(it->second.cbegin(),it->second.cend(),indexpos+1,
+										  [](const _R<XML>& n, uint32_t p) { return n->indexpos < p; });
+			for (; child != it->second.cend() && (*child)->indexpos <= indexend; child++)
+			{
+				if((*child)->indexparentpos == indexpos && nsmatch(*child))
+				{
+					(*child)->incRef();
+					ret.push_back(*child);
+				}
+			}
+			return ret;
+		}
 		for (auto child = nodes.cbegin(); child != nodes.cend(); child++)
 		{
-			uint32_t childnamespace_uri = (*child)->nodenamespace_uri;
-			
-			bool bmatch = (normalizedName==(*child)->nodename) &&
-						 (hasAnyNS||
-						  (namespace_uri.find(BUILTIN_STRINGS::STRING_WILDCARD)!= namespace_uri.end()) ||
-						  (namespace_uri.size() == 0 && childnamespace_uri == BUILTIN_STRINGS::EMPTY) ||
-						  (namespace_uri.find(childnamespace_uri) != namespace_uri.end())
-						 );
-			if(bmatch)
+			if(normalizedName==(*child)->nodename && nsmatch(*child))
 			{
 				(*child)->incRef();
 				ret.push_back(*child);
@@ -1538,7 +1728,7 @@ GET_VARIABLE_RESULT XML::getVariableByMultiname(asAtom& ret, const multiname& na
 		else
 			ret = asAtomHandler::fromObject(getSystemState()->getUndefinedRef());
 	}
-	else if (!childrenlist.isNull())
+	else if (!getChildrenRef().isNull())
 	{
 		if (normalizedName == "*")
 		{
@@ -1553,7 +1743,7 @@ GET_VARIABLE_RESULT XML::getVariableByMultiname(asAtom& ret, const multiname& na
 		}
 		else
 		{
-			const XMLVector& res=getValuesByMultiname(childrenlist,name);
+			const XMLVector& res=getValuesByMultiname(getChildrenRef(),name);
 			
 			if(res.empty() && (opt & FROM_GETLEX)!=0)
 				return GET_VARIABLE_RESULT::GETVAR_NORMAL;
@@ -1582,15 +1772,17 @@ multiname *XML::setVariableByMultiname(multiname& name, asAtom& o, CONST_ALLOWED
 }
 void XML::setVariableByInteger(int index, asAtom &o, ASObject::CONST_ALLOWED_FLAG allowConst)
 {
+	treeModified();
 	if (index < 0)
 	{
 		setVariableByInteger_intern(index,o,allowConst);
 		return;
 	}
-	childrenlist->setVariableByInteger(index,o,allowConst);
+	getChildrenRef()->setVariableByInteger(index,o,allowConst);
 }
 multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_ALLOWED_FLAG allowConst, bool replacetext)
 {
+	treeModified();
 	unsigned int index=0;
 	bool isAttr=name.isAttribute;
 	//Normalize the name to the string form
@@ -1620,8 +1812,8 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 		isAttr=true;
 		buf+=1;
 	}
-	if (childrenlist.isNull())
-		childrenlist = _MR(Class<XMLList>::getInstanceSNoArgs(getSystemState()));
+	if (getChildrenRef().isNull())
+		getChildrenRef() = _MR(Class<XMLList>::getInstanceSNoArgs(getSystemState()));
 	
 	if(isAttr)
 	{
@@ -1661,7 +1853,7 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 		{
 			_NR<XML> tmp = _MR<XML>(Class<XML>::getInstanceSNoArgs(getSystemState()));
 			this->incRef();
-			tmp->parentNode = _MR<XML>(this);
+			tmp->setParentNode(_MR<XML>(this));
 			tmp->nodetype = pugi::node_null;
 			tmp->isAttribute = true;
 			tmp->nodename = buf;
@@ -1675,14 +1867,14 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 	}
 	else if(XML::isValidMultiname(getSystemState(),name,index))
 	{
-		childrenlist->setVariableByMultinameIntern(name,o,allowConst,replacetext);
+		getChildrenRef()->setVariableByMultinameIntern(name,o,allowConst,replacetext);
 	}
 	else
 	{
 		bool notificationhandled = false;
 		bool found = false;
 		XMLVector tmpnodes;
-		for (auto it = childrenlist->nodes.begin(); it != childrenlist->nodes.end();it++)
+		for (auto it = getChildrenRef()->nodes.begin(); it != getChildrenRef()->nodes.end();it++)
 		{
 			_R<XML> tmpnode = *it;
 			
@@ -1711,7 +1903,7 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 						else
 						{
 							_R<XML> tmp = _MR<XML>(Class<XML>::getInstanceSNoArgs(getSystemState()));
-							tmp->parentNode = tmpnode;
+							tmp->setParentNode(tmpnode);
 							tmp->incRef();
 							tmp->nodetype = pugi::node_pcdata;
 							tmp->nodename = "text";
@@ -1719,8 +1911,8 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 							tmp->nodenamespace_prefix = BUILTIN_STRINGS::EMPTY;
 							tmp->nodevalue = asAtomHandler::toString(o,getSystemState());
 							tmp->constructed = true;
-							tmpnode->childrenlist->clear();
-							tmpnode->childrenlist->append(tmp);
+							tmpnode->getChildrenRef()->clear();
+							tmpnode->getChildrenRef()->append(tmp);
 						}
 						if (!found)
 							tmpnodes.push_back(tmpnode);
@@ -1730,7 +1922,7 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 					else
 					{
 						_NR<XML> tmp = _MR<XML>(asAtomHandler::getObject(o)->as<XML>());
-						tmp->parentNode = _MR<XML>(this);
+						tmp->setParentNode(_MR<XML>(this));
 						tmp->incRef();
 						if (!found)
 							tmpnodes.push_back(tmp);
@@ -1739,15 +1931,15 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 				}
 				else
 				{
-					if (tmpnode->childrenlist.isNull())
-						tmpnode->childrenlist = _MR(Class<XMLList>::getInstanceSNoArgs(getSystemState()));
+					if (tmpnode->getChildrenRef().isNull())
+						tmpnode->getChildrenRef() = _MR(Class<XMLList>::getInstanceSNoArgs(getSystemState()));
 					
-					if (tmpnode->childrenlist->nodes.size() == 1 && tmpnode->childrenlist->nodes[0]->nodetype == pugi::node_pcdata)
-						tmpnode->childrenlist->nodes[0]->nodevalue = asAtomHandler::toString(o,getSystemState());
+					if (tmpnode->getChildrenRef()->nodes.size() == 1 && tmpnode->getChildrenRef()->nodes[0]->nodetype == pugi::node_pcdata)
+						tmpnode->getChildrenRef()->nodes[0]->nodevalue = asAtomHandler::toString(o,getSystemState());
 					else
 					{
 						XML* newnode = createFromString(this->getSystemState(),asAtomHandler::toString(o,getSystemState()));
-						tmpnode->childrenlist->clear();
+						tmpnode->getChildrenRef()->clear();
 						asAtom v = asAtomHandler::fromObject(newnode);
 						tmpnode->setVariableByMultiname(name,v,allowConst);
 						if (newnode->getNodeKind() == pugi::node_pcdata)
@@ -1775,7 +1967,7 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 			if(asAtomHandler::getObject(o) && asAtomHandler::getObject(o)->is<XML>())
 			{
 				_R<XML> tmp = _MR<XML>(asAtomHandler::getObject(o)->as<XML>());
-				tmp->parentNode = _MR<XML>(this);
+				tmp->setParentNode(_MR<XML>(this));
 				tmp->incRef();
 				tmpnodes.push_back(tmp);
 			}
@@ -1813,12 +2005,12 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 				tmpstr +=">";
 				_NR<XML> tmp = _MR<XML>(createFromString(this->getSystemState(),tmpstr));
 				this->incRef();
-				tmp->parentNode = _MR<XML>(this);
+				tmp->setParentNode(_MR<XML>(this));
 				tmpnodes.push_back(tmp);
 			}
 		}
-		childrenlist->nodes.clear();
-		childrenlist->nodes.assign(tmpnodes.begin(),tmpnodes.end());
+		getChildrenRef()->nodes.clear();
+		getChildrenRef()->nodes.assign(tmpnodes.begin(),tmpnodes.end());
 		if (!notificationhandled)
 			handleNotification("nodeChanged",asAtomHandler::fromObject(this),asAtomHandler::nullAtom);
 	}
@@ -1876,12 +2068,12 @@ bool XML::hasProperty(const multiname& name, bool checkXMLPropsOnly, bool consid
 		// object is treated as a single-item XMLList.
 		return(index==0);
 	}
-	else if (!childrenlist.isNull())
+	else if (!getChildrenRef().isNull())
 	{
 		//Lookup children
-		for (uint32_t i = 0; i < childrenlist->nodes.size(); i++)
+		for (uint32_t i = 0; i < getChildrenRef()->nodes.size(); i++)
 		{
-			_R<XML> child= childrenlist->nodes[i];
+			_R<XML> child= getChildrenRef()->nodes[i];
 			bool name_match=(child->nodename == buf);
 			bool ns_match=ns_uri==BUILTIN_STRINGS::EMPTY || 
 				(child->nodenamespace_uri == ns_uri);
@@ -1900,6 +2092,7 @@ bool XML::hasPropertyByMultiname(const multiname& name, bool considerDynamic, bo
 
 bool XML::deleteVariableByMultiname(const multiname& name)
 {
+	treeModified();
 	unsigned int index=0;
 	if(name.isAttribute)
 	{
@@ -1937,8 +2130,8 @@ bool XML::deleteVariableByMultiname(const multiname& name)
 	}
 	else if(XML::isValidMultiname(getSystemState(),name,index))
 	{
-		if (!childrenlist.isNull())
-			childrenlist->nodes.erase(childrenlist->nodes.begin() + index);
+		if (!getChildrenRef().isNull())
+			getChildrenRef()->nodes.erase(getChildrenRef()->nodes.begin() + index);
 	}
 	else
 	{
@@ -1949,10 +2142,10 @@ bool XML::deleteVariableByMultiname(const multiname& name)
 			assert_and_throw(name.ns[0].kind==NAMESPACE);
 			ns_uri=name.ns[0].nsNameId;
 		}
-		if (!childrenlist.isNull() && childrenlist->nodes.size() > 0)
+		if (!getChildrenRef().isNull() && getChildrenRef()->nodes.size() > 0)
 		{
-			XMLList::XMLListVector::iterator it = childrenlist->nodes.end();
-			while (it != childrenlist->nodes.begin())
+			XMLList::XMLListVector::iterator it = getChildrenRef()->nodes.end();
+			while (it != getChildrenRef()->nodes.begin())
 			{
 				it--;
 				_R<XML> node = *it;
@@ -1961,7 +2154,7 @@ bool XML::deleteVariableByMultiname(const multiname& name)
 						(node->nodenamespace_uri == ns_uri && name.normalizedName(getSystemState()) == "") ||
 						(node->nodenamespace_uri == ns_uri && node->nodename == name.normalizedName(getSystemState())))
 				{
-					childrenlist->nodes.erase(it);
+					getChildrenRef()->nodes.erase(it);
 					handleNotification("nodeRemoved",asAtomHandler::fromObject(this),asAtomHandler::nullAtom);
 				}
 			}
@@ -2018,7 +2211,7 @@ uint32_t XML::getNamespacePrefixByURI(uint32_t uri, bool create)
 ASFUNCTIONBODY_ATOM(XML,_toString)
 {
 	XML* th=asAtomHandler::as<XML>(obj);
-	if (th->nodetype == pugi::node_element && th->hasSimpleContent() && (th->childrenlist.isNull() || th->childrenlist->nodes.empty()))
+	if (th->nodetype == pugi::node_element && th->hasSimpleContent() && (th->getChildrenRef().isNull() || th->getChildrenRef()->nodes.empty()))
 		ret = asAtomHandler::fromStringID(BUILTIN_STRINGS::EMPTY);
 	else
 		ret = asAtomHandler::fromObject(abstract_s(sys,th->toString_priv()));
@@ -2187,9 +2380,9 @@ void XML::CheckCyclicReference(XML* node)
 	XML* tmp = node;
 	if (tmp == this)
 		throwError<TypeError>(kXMLIllegalCyclicalLoop);
-	if (!childrenlist.isNull())
+	if (!getChildrenRef().isNull())
 	{
-		for (auto it = tmp->childrenlist->nodes.begin(); it != tmp->childrenlist->nodes.end(); it++)
+		for (auto it = tmp->getChildrenRef()->nodes.begin(); it != tmp->getChildrenRef()->nodes.end(); it++)
 		{
 			if ((*it).getPtr() == this)
 				throwError<TypeError>(kXMLIllegalCyclicalLoop);
@@ -2201,8 +2394,7 @@ void XML::CheckCyclicReference(XML* node)
 XML *XML::createFromString(SystemState* sys, const tiny_string &s,bool usefirstchild)
 {
 	XML* res = Class<XML>::getInstanceSNoArgs(sys);
-	pugi::xml_node root = res->buildFromString(s, getParseMode());
-	res->createTree(usefirstchild ? root.first_child() : root,false);
+	res->createTreeFromString(s,usefirstchild);
 	return res;
 }
 
@@ -2212,7 +2404,7 @@ XML *XML::createFromNode(const pugi::xml_node &_n, XML *parent, bool fromXMLList
 	if (parent)
 	{
 		parent->incRef();
-		res->parentNode = _NR<XML>(parent);
+		res->setParentNode(_NR<XML>(parent));
 	}
 	res->createTree(_n,fromXMLList);
 	return res;
@@ -2221,6 +2413,7 @@ XML *XML::createFromNode(const pugi::xml_node &_n, XML *parent, bool fromXMLList
 ASFUNCTIONBODY_ATOM(XML,insertChildAfter)
 {
 	XML* th=asAtomHandler::as<XML>(obj);
+	th->treeModified();
 	_NR<ASObject> child1;
 	_NR<ASObject> child2;
 	ARG_UNPACK_ATOM(child1)(child2);
@@ -2241,8 +2434,8 @@ ASFUNCTIONBODY_ATOM(XML,insertChildAfter)
 	}
 	else
 		child2 = _NR<XML>(createFromString(sys,child2->toString()));
-	if (th->childrenlist.isNull())
-		th->childrenlist = _MR(Class<XMLList>::getInstanceSNoArgs(sys));
+	if (th->getChildrenRef().isNull())
+		th->getChildrenRef() = _MR(Class<XMLList>::getInstanceSNoArgs(sys));
 	if (child1->is<Null>())
 	{
 		th->incRef();
@@ -2250,8 +2443,8 @@ ASFUNCTIONBODY_ATOM(XML,insertChildAfter)
 		{
 			th->incRef();
 			child2->incRef();
-			child2->as<XML>()->parentNode = _NR<XML>(th);
-			th->childrenlist->nodes.insert(th->childrenlist->nodes.begin(),_NR<XML>(child2->as<XML>()));
+			child2->as<XML>()->setParentNode(_NR<XML>(th));
+			th->getChildrenRef()->nodes.insert(th->getChildrenRef()->nodes.begin(),_NR<XML>(child2->as<XML>()));
 		}
 		else if (child2->is<XMLList>())
 		{
@@ -2259,9 +2452,9 @@ ASFUNCTIONBODY_ATOM(XML,insertChildAfter)
 			{
 				th->incRef();
 				(*it2)->incRef();
-				(*it2)->parentNode = _NR<XML>(th);
+				(*it2)->setParentNode(_NR<XML>(th));
 			}
-			th->childrenlist->nodes.insert(th->childrenlist->nodes.begin(),child2->as<XMLList>()->nodes.begin(), child2->as<XMLList>()->nodes.end());
+			th->getChildrenRef()->nodes.insert(th->getChildrenRef()->nodes.begin(),child2->as<XMLList>()->nodes.begin(), child2->as<XMLList>()->nodes.end());
 		}
 		th->incRef();
 		ret = asAtomHandler::fromObject(th);
@@ -2276,7 +2469,7 @@ ASFUNCTIONBODY_ATOM(XML,insertChildAfter)
 		}
 		child1 = child1->as<XMLList>()->nodes[0];
 	}
-	for (auto it = th->childrenlist->nodes.begin(); it != th->childrenlist->nodes.end(); it++)
+	for (auto it = th->getChildrenRef()->nodes.begin(); it != th->getChildrenRef()->nodes.end(); it++)
 	{
 		if ((*it).getPtr() == child1.getPtr())
 		{
@@ -2285,8 +2478,8 @@ ASFUNCTIONBODY_ATOM(XML,insertChildAfter)
 			{
 				th->incRef();
 				child2->incRef();
-				child2->as<XML>()->parentNode = _NR<XML>(th);
-				th->childrenlist->nodes.insert(it+1,_NR<XML>(child2->as<XML>()));
+				child2->as<XML>()->setParentNode(_NR<XML>(th));
+				th->getChildrenRef()->nodes.insert(it+1,_NR<XML>(child2->as<XML>()));
 			}
 			else if (child2->is<XMLList>())
 			{
@@ -2294,9 +2487,9 @@ ASFUNCTIONBODY_ATOM(XML,insertChildAfter)
 				{
 					th->incRef();
 					(*it2)->incRef();
-					(*it2)->parentNode = _NR<XML>(th);
+					(*it2)->setParentNode(_NR<XML>(th));
 				}
-				th->childrenlist->nodes.insert(it+1,child2->as<XMLList>()->nodes.begin(), child2->as<XMLList>()->nodes.end());
+				th->getChildrenRef()->nodes.insert(it+1,child2->as<XMLList>()->nodes.begin(), child2->as<XMLList>()->nodes.end());
 			}
 			ret = asAtomHandler::fromObject(th);
 			return;
@@ -2307,6 +2500,7 @@ ASFUNCTIONBODY_ATOM(XML,insertChildAfter)
 ASFUNCTIONBODY_ATOM(XML,insertChildBefore)
 {
 	XML* th=asAtomHandler::as<XML>(obj);
+	th->treeModified();
 	_NR<ASObject> child1;
 	_NR<ASObject> child2;
 	ARG_UNPACK_ATOM(child1)(child2);
@@ -2327,8 +2521,8 @@ ASFUNCTIONBODY_ATOM(XML,insertChildBefore)
 	else
 		child2 = _NR<XML>(createFromString(sys,child2->toString()));
 
-	if (th->childrenlist.isNull())
-		th->childrenlist = _MR(Class<XMLList>::getInstanceSNoArgs(sys));
+	if (th->getChildrenRef().isNull())
+		th->getChildrenRef() = _MR(Class<XMLList>::getInstanceSNoArgs(sys));
 	if (child1->is<Null>())
 	{
 		if (child2->is<XML>())
@@ -2341,8 +2535,8 @@ ASFUNCTIONBODY_ATOM(XML,insertChildBefore)
 			{
 				th->incRef();
 				(*it)->incRef();
-				(*it)->parentNode = _NR<XML>(th);
-				th->childrenlist->nodes.push_back(_NR<XML>(*it));
+				(*it)->setParentNode(_NR<XML>(th));
+				th->getChildrenRef()->nodes.push_back(_NR<XML>(*it));
 			}
 		}
 		th->incRef();
@@ -2358,7 +2552,7 @@ ASFUNCTIONBODY_ATOM(XML,insertChildBefore)
 		}
 		child1 = child1->as<XMLList>()->nodes[0];
 	}
-	for (auto it = th->childrenlist->nodes.begin(); it != th->childrenlist->nodes.end(); it++)
+	for (auto it = th->getChildrenRef()->nodes.begin(); it != th->getChildrenRef()->nodes.end(); it++)
 	{
 		if ((*it).getPtr() == child1.getPtr())
 		{
@@ -2367,8 +2561,8 @@ ASFUNCTIONBODY_ATOM(XML,insertChildBefore)
 			{
 				th->incRef();
 				child2->incRef();
-				child2->as<XML>()->parentNode = _NR<XML>(th);
-				th->childrenlist->nodes.insert(it,_NR<XML>(child2->as<XML>()));
+				child2->as<XML>()->setParentNode(_NR<XML>(th));
+				th->getChildrenRef()->nodes.insert(it,_NR<XML>(child2->as<XML>()));
 			}
 			else if (child2->is<XMLList>())
 			{
@@ -2376,9 +2570,9 @@ ASFUNCTIONBODY_ATOM(XML,insertChildBefore)
 				{
 					th->incRef();
 					(*it2)->incRef();
-					(*it2)->parentNode = _NR<XML>(th);
+					(*it2)->setParentNode(_NR<XML>(th));
 				}
-				th->childrenlist->nodes.insert(it,child2->as<XMLList>()->nodes.begin(), child2->as<XMLList>()->nodes.end());
+				th->getChildrenRef()->nodes.insert(it,child2->as<XMLList>()->nodes.begin(), child2->as<XMLList>()->nodes.end());
 			}
 			ret = asAtomHandler::fromObject(th);
 			return;
@@ -2421,6 +2615,7 @@ ASFUNCTIONBODY_ATOM(XML,removeNamespace)
 }
 void XML::RemoveNamespace(Namespace *ns)
 {
+	treeModified();
 	if (this->nodenamespace_uri == ns->getURI())
 	{
 		this->nodenamespace_uri = BUILTIN_STRINGS::EMPTY;
@@ -2435,9 +2630,9 @@ void XML::RemoveNamespace(Namespace *ns)
 			break;
 		}
 	}
-	if (childrenlist)
+	if (getChildrenRef())
 	{
-		for (auto it = childrenlist->nodes.begin(); it != childrenlist->nodes.end(); it++)
+		for (auto it = getChildrenRef()->nodes.begin(); it != getChildrenRef()->nodes.end(); it++)
 		{
 			(*it)->RemoveNamespace(ns);
 		}
@@ -2456,9 +2651,9 @@ ASFUNCTIONBODY_ATOM(XML,comments)
 }
 void XML::getComments(XMLVector& ret)
 {
-	if (childrenlist)
+	if (getChildrenRef())
 	{
-		for (auto it = childrenlist->nodes.begin(); it != childrenlist->nodes.end(); it++)
+		for (auto it = getChildrenRef()->nodes.begin(); it != getChildrenRef()->nodes.end(); it++)
 		{
 			if ((*it)->getNodeKind() == pugi::node_comment)
 			{
@@ -2480,9 +2675,9 @@ ASFUNCTIONBODY_ATOM(XML,processingInstructions)
 }
 void XML::getprocessingInstructions(XMLVector& ret, tiny_string name)
 {
-	if (childrenlist)
+	if (getChildrenRef())
 	{
-		for (auto it = childrenlist->nodes.begin(); it != childrenlist->nodes.end(); it++)
+		for (auto it = getChildrenRef()->nodes.begin(); it != getChildrenRef()->nodes.end(); it++)
 		{
 			if ((*it)->getNodeKind() == pugi::node_pi && (name == "*" || name == (*it)->nodename))
 			{
@@ -2539,10 +2734,10 @@ tiny_string XML::toString_priv()
 	}
 	else if (hasSimpleContent())
 	{
-		if (!childrenlist.isNull() && !childrenlist->nodes.empty())
+		if (!getChildrenRef().isNull() && !getChildrenRef()->nodes.empty())
 		{
-			auto it = childrenlist->nodes.begin();
-			while(it != childrenlist->nodes.end())
+			auto it = getChildrenRef()->nodes.begin();
+			while(it != getChildrenRef()->nodes.end())
 			{
 				if ((*it)->getNodeKind() != pugi::node_comment &&
 						(*it)->getNodeKind() != pugi::node_pi)
@@ -2674,12 +2869,12 @@ bool XML::nodesEqual(XML *a, XML *b) const
 	}
 	
 	// children
-	if (a->childrenlist.isNull())
-		return b->childrenlist.isNull() || b->childrenlist->nodes.size() == 0;
-	if (b->childrenlist.isNull())
-		return a->childrenlist.isNull() || a->childrenlist->nodes.size() == 0;
+	if (a->getChildrenRef().isNull())
+		return b->getChildrenRef().isNull() || b->getChildrenRef()->nodes.size() == 0;
+	if (b->getChildrenRef().isNull())
+		return a->getChildrenRef().isNull() || a->getChildrenRef()->nodes.size() == 0;
 	
-	return a->childrenlist->isEqual(b->childrenlist.getPtr());
+	return a->getChildrenRef()->isEqual(b->getChildrenRef().getPtr());
 }
 
 uint32_t XML::nextNameIndex(uint32_t cur_index)
@@ -2787,6 +2982,12 @@ void XML::createTree(const pugi::xml_node& rootnode,bool fromXMLList)
 				case pugi::node_element: // Element tag, i.e. '<node/>'
 				{
 					fillNode(this,node);
+					if (lazydoc)
+					{
+						lazynode = node;
+						done = true;
+						break;
+					}
 					pugi::xml_node_iterator it=node.begin();
 					while(it!=node.end())
 					{
@@ -2826,6 +3027,11 @@ void XML::createTree(const pugi::xml_node& rootnode,bool fromXMLList)
 			case pugi::node_element: // Element tag, i.e. '<node/>'
 			{
 				fillNode(this,node);
+				if (lazydoc)
+				{
+					lazynode = node;
+					break;
+				}
 				pugi::xml_node_iterator it=node.begin();
 				{
 					while(it!=node.end())
@@ -2854,11 +3060,12 @@ void XML::fillNode(XML* node, const pugi::xml_node &srcnode)
 	node->nodetype = srcnode.type();
 	node->nodename = srcnode.name();
 	node->nodevalue = srcnode.value();
+	uint32_t defaultns = node->lazydoc ? node->lazydoc->defaultnamespace : getVm(node->getSystemState())->getDefaultXMLNamespaceID();
 	if (!node->parentNode.isNull() && node->parentNode->nodenamespace_prefix == BUILTIN_STRINGS::EMPTY)
 		node->nodenamespace_uri = node->parentNode->nodenamespace_uri;
 	else
-		node->nodenamespace_uri = getVm(node->getSystemState())->getDefaultXMLNamespaceID();
-	if (ignoreWhitespace && node->nodetype == pugi::node_pcdata)
+		node->nodenamespace_uri = defaultns;
+	if ((node->lazydoc ? node->lazydoc->ignorewhitespace : ignoreWhitespace) && node->nodetype == pugi::node_pcdata)
 		node->nodevalue = node->removeWhitespace(node->nodevalue);
 	node->attributelist = _MR(Class<XMLList>::getInstanceSNoArgs(node->getSystemState()));
 	pugi::xml_attribute_iterator itattr;
@@ -2919,11 +3126,11 @@ void XML::fillNode(XML* node, const pugi::xml_node &srcnode)
 			continue;
 		_NR<XML> tmp = _MR<XML>(Class<XML>::getInstanceSNoArgs(node->getSystemState()));
 		node->incRef();
-		tmp->parentNode = _MR<XML>(node);
+		tmp->setParentNode(_MR<XML>(node));
 		tmp->nodetype = pugi::node_null;
 		tmp->isAttribute = true;
 		tmp->nodename = aname;
-		tmp->nodenamespace_uri = getVm(node->getSystemState())->getDefaultXMLNamespaceID();
+		tmp->nodenamespace_uri = defaultns;
 		pos = tmp->nodename.find(":");
 		if (pos != tiny_string::npos)
 		{
@@ -2962,6 +3169,48 @@ void XML::fillNode(XML* node, const pugi::xml_node &srcnode)
 	node->constructed=true;
 }
 
+void XML::createTreeFromString(const tiny_string& str, bool usefirstchild)
+{
+	if (str.numBytes() < XML_LAZY_PARSE_THRESHOLD)
+	{
+		pugi::xml_node root = buildFromString(str, getParseMode());
+		createTree(usefirstchild ? root.first_child() : root,false);
+		return;
+	}
+	// big documents are kept as pugixml tree, the XML objects of the children are only created when they are accessed
+	lazydoc = std::make_shared<lazyXMLDocument>();
+	lazydoc->defaultnamespace = getVm(getSystemState())->getDefaultXMLNamespaceID();
+	lazydoc->ignorewhitespace = ignoreWhitespace;
+	pugi::xml_node root = XMLBase::buildFromString(lazydoc->doc, str, getParseMode());
+	createTree(usefirstchild ? root.first_child() : root,false);
+	if (!lazynode)
+		lazydoc.reset();
+}
+
+void XML::materializeChildren() const
+{
+	// the children are only created, not modified, so this is considered const
+	XML* th = const_cast<XML*>(this);
+	// the name index of the document doesn't contain the new children
+	treeModified();
+	pugi::xml_node node = lazynode;
+	lazynode = pugi::xml_node();
+	for (pugi::xml_node_iterator it=node.begin(); it!=node.end(); ++it)
+	{
+		XML* child = Class<XML>::getInstanceSNoArgs(getSystemState());
+		th->incRef();
+		child->parentNode = _MR(th);
+		child->lazydoc = lazydoc;
+		child->createTree(*it,false);
+		if (!child->lazynode)
+			child->lazydoc.reset();
+		childrenlist->append(_MR(child));
+	}
+	// the document is kept alive by the children that still need it
+	th->lazydoc.reset();
+}
+
+
 ASFUNCTIONBODY_ATOM(XML,_prependChild)
 {
 	XML* th=asAtomHandler::as<XML>(obj);
@@ -3013,6 +3262,7 @@ ASFUNCTIONBODY_ATOM(XML,_prependChild)
 }
 void XML::prependChild(_R<XML> newChild)
 {
+	treeModified();
 	if (newChild->constructed)
 	{
 		if (this == newChild.getPtr())
@@ -3025,14 +3275,15 @@ void XML::prependChild(_R<XML> newChild)
 			node = node->parentNode;
 		}
 		this->incRef();
-		newChild->parentNode = _NR<XML>(this);
-		childrenlist->prepend(newChild);
+		newChild->setParentNode(_NR<XML>(this));
+		getChildrenRef()->prepend(newChild);
 	}
 }
 
 ASFUNCTIONBODY_ATOM(XML,_replace)
 {
 	XML* th=asAtomHandler::as<XML>(obj);
+	th->treeModified();
 	_NR<ASObject> propertyName;
 	_NR<ASObject> value;
 	ARG_UNPACK_ATOM(propertyName) (value);
@@ -3048,22 +3299,22 @@ ASFUNCTIONBODY_ATOM(XML,_replace)
 	{
 		if (value->is<XMLList>())
 		{
-			th->childrenlist->decRef();
+			th->getChildrenRef()->decRef();
 			value->incRef();
-			th->childrenlist = _NR<XMLList>(value->as<XMLList>());
+			th->getChildrenRef() = _NR<XMLList>(value->as<XMLList>());
 		}
 		else if (value->is<XML>())
 		{
-			th->childrenlist->clear();
+			th->getChildrenRef()->clear();
 			value->incRef();
-			th->childrenlist->append(_R<XML>(value->as<XML>()));
+			th->getChildrenRef()->append(_R<XML>(value->as<XML>()));
 		}
 		else
 		{
 			XML* x = createFromString(sys,value->toString());
 			x->incRef();
-			th->childrenlist->clear();
-			th->childrenlist->append(_R<XML>(x));
+			th->getChildrenRef()->clear();
+			th->getChildrenRef()->append(_R<XML>(x));
 		}
 		th->incRef();
 		ret = asAtomHandler::fromObject(th);
@@ -3078,7 +3329,7 @@ ASFUNCTIONBODY_ATOM(XML,_replace)
 	asAtom v = asAtomHandler::fromObject(value.getPtr());
 	if(XML::isValidMultiname(sys,name,index))
 	{
-		th->childrenlist->setVariableByMultinameIntern(name,v,CONST_NOT_ALLOWED,true);
+		th->getChildrenRef()->setVariableByMultinameIntern(name,v,CONST_NOT_ALLOWED,true);
 	}	
 	else if (th->hasPropertyByMultiname(name,true,false))
 	{
@@ -21,11 +21,41 @@
 #define SCRIPTING_TOPLEVEL_XML_H 1
 #include "asobject.h"
 #include "backends/xml_support.h"
+#include <memory>
+
+// XML sources of at least this size are parsed lazily
+#define XML_LAZY_PARSE_THRESHOLD 4096
 
 namespace lightspark
 {
 class Namespace;
 class XMLList;
+/*
+ * pugixml document of a lazily parsed XML tree, shared by all nodes whose children are not created yet.
+ * The settings used when parsing are kept, so that nodes created later get the same result
+ */
+struct lazyXMLDocument
+{
+	pugi::xml_document doc;
+	uint32_t defaultnamespace;
+	bool ignorewhitespace;
+};
+/*
+ * Elements and attributes of a document by name in document order, built for documents that are queried repeatedly.
+ * The attributes have the position of their element. Only created nodes are indexed, the children of lazily
+ * parsed nodes are looked up in their pugixml tree
+ */
+struct xmlNameIndex
+{
+	uint32_t buildid;
+	std::unordered_map<uint32_t,std::vector<_R<XML>>> elements;
+	std::unordered_map<uint32_t,std::vector<_R<XML>>> attributes;
+	// nodes of the document whose children are not created yet
+	std::vector<pugi::xml_node> lazynodes;
+	// names already looked up in the subtrees of lazynodes, true if they may be found there
+	std::unordered_map<uint32_t,bool> lazyelements;
+	std::unordered_map<uint32_t,bool> lazyattributes;
+};
 class XML: public ASObject, public XMLBase
 {
 friend class XMLList;
@@ -33,7 +63,10 @@ public:
 	typedef std::vector<_R<XML>> XMLVector;
 	typedef std::vector<_R<Namespace>> NSVector;
 private:
-	_NR<XMLList> childrenlist;
+	mutable _NR<XMLList> childrenlist;
+	// element whose children have not been created as XML objects yet
+	mutable pugi::xml_node lazynode;
+	std::shared_ptr<lazyXMLDocument> lazydoc;
 	_NR<XML> parentNode;
 	pugi::xml_node_type nodetype;
 	bool isAttribute;
@@ -45,9 +78,34 @@ private:
 	_NR<XMLList> procinstlist;
 	_NR<IFunction> notifierfunction;
 	NSVector namespacedefs;
+	// incremented on every modification of the document, only used at the root node
+	mutable uint32_t modificationcount;
+	static uint32_t nameindexbuilds;
+	// name index of the document, only kept at the root node
+	mutable std::unique_ptr<xmlNameIndex> nameindex;
+	mutable uint32_t nameindexqueries;
+	mutable uint32_t nameindexmodification;
+	// position of this node in the name index of its document, valid if indexbuild is the id of that index
+	mutable uint32_t indexbuild;
+	mutable uint32_t indexpos;
+	mutable uint32_t indexend;
+	mutable uint32_t indexparentpos;
+	xmlNameIndex* getNameIndex() const;
+	bool nameInLazySubtrees(xmlNameIndex* index, const tiny_string& name, bool bIsAttribute) const;
+	bool addToNameIndex(xmlNameIndex* index, uint32_t& pos, uint32_t parentpos) const;
+	void getDescendantsByQNameIntern(const tiny_string& name, uint32_t ns, bool bIsAttribute, XMLVector& ret) const;
 
 	void createTree(const pugi::xml_node &rootnode, bool fromXMLList);
+	void createTreeFromString(const tiny_string& str, bool usefirstchild=false);
 	static void fillNode(XML* node, const pugi::xml_node &srcnode);
+	void materializeChildren() const;
+	// all access to the children has to use this, so that lazily parsed children are created first
+	_NR<XMLList>& getChildrenRef() const
+	{
+		if (lazynode)
+			materializeChildren();
+		return childrenlist;
+	}
 	tiny_string toString_priv();
 	const char* nodekindString();
 	
@@ -150,10 +208,18 @@ public:
 	static unsigned int getParseMode();
 	static XML* createFromString(SystemState *sys, const tiny_string& s, bool usefirstchild=false);
 	static XML* createFromNode(const pugi::xml_node& _n, XML* parent=NULL, bool fromXMLList=false);
+	// has to be called before the document of this node is modified
+	void treeModified() const;
+	// moves this node to another parent, the document it leaves is modified
+	void setParentNode(_NR<XML> parent)
+	{
+		treeModified();
+		parentNode = parent;
+	}
 
 	const tiny_string getName() const { return nodename;}
 	uint32_t getNamespaceURI() const { return nodenamespace_uri;}
-	XMLList* getChildrenlist() { return childrenlist ? childrenlist.getPtr() : NULL; }
+	XMLList* getChildrenlist() { return getChildrenRef() ? childrenlist.getPtr() : NULL; }
 	
 	
 	void getDescendantsByQName(const tiny_string& name, uint32_t ns, bool bIsAttribute, XMLVector& ret) const;
@@ -673,6 +673,20 @@ void XMLList::clear()
 	nodes.clear();
 }
 
+void XMLList::treeModified() const
+{
+	const XML* lastparent = nullptr;
+	for (auto it = nodes.begin(); it != nodes.end(); it++)
+	{
+		// siblings are in the same document
+		if ((*it)->parentNode.isNull() || (*it)->parentNode.getPtr() != lastparent)
+			(*it)->treeModified();
+		lastparent = (*it)->parentNode.getPtr();
+	}
+	if (targetobject)
+		targetobject->treeModified();
+}
+
 void XMLList::removeNode(XML *node)
 {
 	XMLList::XMLListVector::iterator it = nodes.end();
@@ -682,7 +696,7 @@ void XMLList::removeNode(XML *node)
 		_R<XML> n = *it;
 		if (n.getPtr() == node)
 		{
-			node->parentNode = NullRef;
+			node->setParentNode(NullRef);
 			nodes.erase(it);
 			break;
 		}
@@ -722,8 +736,8 @@ void XMLList::getTargetVariables(const multiname& name,XML::XMLVector& retnodes)
 			{
 				retnodes.push_back(child);
 			}
-			if (child->childrenlist)
-				child->childrenlist->getTargetVariables(name,retnodes);
+			if (child->getChildrenRef())
+				child->getChildrenRef()->getTargetVariables(name,retnodes);
 		}
 	}
 }
@@ -842,6 +856,7 @@ multiname *XMLList::setVariableByMultiname(multiname& name, asAtom& o, CONST_ALL
 }
 void XMLList::setVariableByInteger(int index, asAtom &o, ASObject::CONST_ALLOWED_FLAG allowConst)
 {
+	treeModified();
 	if (index < 0)
 	{
 		setVariableByInteger_intern(index,o,allowConst);
@@ -876,6 +891,7 @@ void XMLList::setVariableByInteger(int index, asAtom &o, ASObject::CONST_ALLOWED
 
 multiname* XMLList::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_ALLOWED_FLAG allowConst, bool replacetext)
 {
+	treeModified();
 	assert_and_throw(implEnable);
 	unsigned int index=0;
 	XML::XMLVector retnodes;
@@ -963,25 +979,26 @@ multiname* XMLList::setVariableByMultinameIntern(multiname& name, asAtom& o, CON
 
 bool XMLList::deleteVariableByMultiname(const multiname& name)
 {
+	treeModified();
 	unsigned int index=0;
 	bool bdeleted = false;
 	
 	if(XML::isValidMultiname(getSystemState(),name,index))
 	{
 		_R<XML> node = nodes[index];
-		if (!node->parentNode.isNull() && node->parentNode->childrenlist.getPtr() != this)
+		if (!node->parentNode.isNull() && node->parentNode->getChildrenRef().getPtr() != this)
 		{
 			// the node to remove is also added to another list, so it has to be deleted there, too
 			if (node->parentNode)
 			{
-				XMLList::XMLListVector::iterator it = node->parentNode->childrenlist->nodes.end();
-				while (it != node->parentNode->childrenlist->nodes.begin())
+				XMLList::XMLListVector::iterator it = node->parentNode->getChildrenRef()->nodes.end();
+				while (it != node->parentNode->getChildrenRef()->nodes.begin())
 				{
 					it--;
 					_R<XML> n = *it;
 					if (n.getPtr() == node.getPtr())
 					{
-						node->parentNode->childrenlist->nodes.erase(it);
+						node->parentNode->getChildrenRef()->nodes.erase(it);
 						break;
 					}
 				}
@@ -1153,7 +1170,7 @@ void XMLList::replace(unsigned int idx, ASObject *o, const XML::XMLVector &retno
 		{
 			if (replacetext)
 			{
-				nodes[idx]->childrenlist->clear();
+				nodes[idx]->getChildrenRef()->clear();
 				nodes[idx]->nodetype = pugi::node_pcdata;
 				nodes[idx]->nodename = "text";
 				nodes[idx]->nodevalue = o->toString();
@@ -1162,17 +1179,17 @@ void XMLList::replace(unsigned int idx, ASObject *o, const XML::XMLVector &retno
 			}
 			else
 			{
-				nodes[idx]->childrenlist->clear();
+				nodes[idx]->getChildrenRef()->clear();
 				_R<XML> tmp = _MR<XML>(Class<XML>::getInstanceSNoArgs(getSystemState()));
 				nodes[idx]->incRef();
-				tmp->parentNode = nodes[idx];
+				tmp->setParentNode(nodes[idx]);
 				tmp->nodetype = pugi::node_pcdata;
 				tmp->nodename = "text";
 				tmp->nodenamespace_uri = BUILTIN_STRINGS::EMPTY;
 				tmp->nodenamespace_prefix = BUILTIN_STRINGS::EMPTY;
 				tmp->nodevalue = o->toString();
 				tmp->constructed = true;
-				nodes[idx]->childrenlist->append(tmp);
+				nodes[idx]->getChildrenRef()->append(tmp);
 			}
 		}
 		else
@@ -1185,7 +1202,7 @@ void XMLList::replace(unsigned int idx, ASObject *o, const XML::XMLVector &retno
 	{
 		if (replacetext)
 		{
-			nodes[idx]->childrenlist->clear();
+			nodes[idx]->getChildrenRef()->clear();
 			nodes[idx]->nodetype = pugi::node_pcdata;
 			nodes[idx]->nodename = "text";
 			nodes[idx]->nodevalue = o->toString();
@@ -1198,17 +1215,17 @@ void XMLList::replace(unsigned int idx, ASObject *o, const XML::XMLVector &retno
 				nodes[idx]->nodevalue = o->toString();
 			else 
 			{
-				nodes[idx]->childrenlist->clear();
+				nodes[idx]->getChildrenRef()->clear();
 				_R<XML> tmp = _MR<XML>(Class<XML>::getInstanceSNoArgs(getSystemState()));
 				nodes[idx]->incRef();
-				tmp->parentNode = nodes[idx];
+				tmp->setParentNode(nodes[idx]);
 				tmp->nodetype = pugi::node_pcdata;
 				tmp->nodename = "text";
 				tmp->nodenamespace_uri = BUILTIN_STRINGS::EMPTY;
 				tmp->nodenamespace_prefix = BUILTIN_STRINGS::EMPTY;
 				tmp->nodevalue = o->toString();
 				tmp->constructed = true;
-				nodes[idx]->childrenlist->append(tmp);
+				nodes[idx]->getChildrenRef()->append(tmp);
 			}
 		}
 	}
@@ -41,6 +41,8 @@ private:
 	void appendSingleNode(ASObject *x);
 	void replace(unsigned int i, ASObject *x, const XML::XMLVector& retnodes, CONST_ALLOWED_FLAG allowConst, bool replacetext);
 	void getTargetVariables(const multiname& name, XML::XMLVector& retnodes);
+	// has to be called before the nodes of this list or its target object are modified
+	void treeModified() const;
 public:
 	XMLList(Class_base* c);
 	/*
@@ -332,6 +332,33 @@ SyntheticFunction::SyntheticFunction(Class_base* c,method_info* m):IFunction(c,S
 	objfreelist = &c->freelist[1];
 }
 
+/*
+ * Memory of a recursive call to a SyntheticFunction, it is released
+ * when the call returns or an exception leaves it
+ */
+class recursiveFrame
+{
+private:
+	ABCVm* vm;
+	uint8_t* start;
+public:
+	call_context* cc;
+	recursiveFrame(ABCVm* _vm):vm(_vm),start(nullptr),cc(nullptr) {}
+	~recursiveFrame()
+	{
+		if (cc)
+			cc->~call_context();
+		if (start)
+			vm->releaseFrame(start);
+	}
+	uint8_t* alloc(size_t size)
+	{
+		uint8_t* mem = vm->allocFrame(size);
+		start = mem;
+		return mem;
+	}
+};
+
 /**
  * This prepares a new call_context and then executes the ABC bytecode function
  * by ABCVm::executeFunction() or through JIT.
@@ -345,7 +372,53 @@ void SyntheticFunction::call(asAtom& ret, asAtom& obj, asAtom *args, uint32_t nu
 		// this is a call to this method during preloading, it can happen when constructing objects for optimization detection
 		return;
 	}
+	/* setup call_context
+	 * the frame is allocated before the recursion depth is increased, so a stack overflow
+	 * doesn't leave the vm with a recursion that is never left */
+	bool recursive_call = codeStatus == method_body_info::USED;
+	call_context* cc = nullptr;
+	recursiveFrame frame(getVm(getSystemState()));
+	if (recursive_call)
+	{
+		// the call_context and all its buffers are taken from the frame stack of the vm in one block
+		uint32_t localcount = mi->body->getReturnValuePos()+1+mi->body->localresultcount;
+		uint32_t atomcount = localcount+mi->body->max_stack+1+mi->body->max_scope_depth;
+		uint32_t slotcount = mi->body->localconstantslots.size()+localcount;
+		uint8_t* mem = frame.alloc(sizeof(call_context)+atomcount*sizeof(asAtom)+slotcount*sizeof(asAtom*)+mi->body->max_scope_depth*sizeof(bool));
+		cc = frame.cc = new (mem) call_context(mi);
+		mem += sizeof(call_context);
+		cc->locals = (asAtom*)mem;
+		cc->stack = cc->locals+localcount;
+		cc->scope_stack = cc->stack+mi->body->max_stack+1;
+		cc->localslots = (asAtom**)(cc->scope_stack+mi->body->max_scope_depth);
+		cc->scope_stack_dynamic = (bool*)(cc->localslots+slotcount);
+		cc->max_stackp=cc->stack+cc->mi->body->max_stack;
+		cc->lastlocal = cc->locals+localcount;
+		for (uint32_t i = 0; i < localcount; i++)
+		{
+			cc->localslots[i] = &cc->locals[i];
+		}
+	}
+	else
+	{
+		cc = &mi->cc;
+	}
 	call_context* saved_cc = getVm(getSystemState())->incStack(obj,this->functionname);
+	const uint32_t coldpreload_hit_threshold=16;
+	if (mi->body->coldpreload && mi->body->coldhitcount != UINT32_MAX)
+		++mi->body->coldhitcount;
+	if (mi->body->coldpreload && codeStatus == method_body_info::PRELOADED && mi->body->coldhitcount >= coldpreload_hit_threshold)
+	{
+		// This cold method got hot and is not running, preload it with all optimizations
+		mi->freePreloadedCode();
+		mi->body->preloadedcode.clear();
+		mi->body->coldbranches.clear();
+		mi->body->localresultcount=0;
+		mi->body->localconstantslots.clear();
+		mi->body->exceptions = mi->body->abcexceptions;
+		mi->body->abcexceptions.clear();
+		mi->body->codeStatus = method_body_info::ORIGINAL;
+	}
 	if (codeStatus != method_body_info::PRELOADED && codeStatus != method_body_info::USED)
 	{
 		mi->body->codeStatus = method_body_info::PRELOADING;
@@ -420,32 +493,12 @@ void SyntheticFunction::call(asAtom& ret, asAtom& obj, asAtom *args, uint32_t nu
 		argumentsArray->setVariableByQName("callee","",this,DECLARED_TRAIT);
 	}
 
-	/* setup call_context */
-	bool recursive_call = codeStatus == method_body_info::USED;
-	call_context* cc = nullptr;
-	if (recursive_call)
-	{
-		cc = new call_context(mi);
-		cc->locals= g_newa(asAtom, mi->body->getReturnValuePos()+1+mi->body->localresultcount);
-		cc->stack = g_newa(asAtom, mi->body->max_stack+1);
-		cc->scope_stack=g_newa(asAtom, mi->body->max_scope_depth);
-		cc->scope_stack_dynamic=g_newa(bool, mi->body->max_scope_depth);
-		cc->max_stackp=cc->stackp+cc->mi->body->max_stack;
-		cc->lastlocal = cc->locals+mi->body->getReturnValuePos()+1+mi->body->localresultcount;
-		cc->localslots = g_newa(asAtom*,mi->body->localconstantslots.size()+mi->body->getReturnValuePos()+1+mi->body->localresultcount);
-		for (uint32_t i = 0; i < uint32_t(mi->body->getReturnValuePos()+1+mi->body->localresultcount); i++)
-		{
-			cc->localslots[i] = &cc->locals[i];
-		}
-	}
-	else
-	{
-		cc = &mi->cc;
-	}
 	cc->exec_pos = mi->body->preloadedcode.data();
 	cc->parent_scope_stack=func_scope.getPtr();
 	cc->defaultNamespaceUri = saved_cc ? saved_cc->defaultNamespaceUri : (uint32_t)BUILTIN_STRINGS::EMPTY;
 	cc->inClass = this->inClass;
+	// the application domain of the root may be switched while loading code, so it is looked up again on every call
+	cc->domainMemoryOwner = nullptr;
 	cc->stackp = cc->stack;
 
 	/* Set the current global object, each script in each DoABCTag has its own */
@@ -651,8 +704,6 @@ void SyntheticFunction::call(asAtom& ret, asAtom& obj, asAtom *args, uint32_t nu
 		(*it)->decRef();
 	}
 	cc->dynamicfunctions.clear();
-	if (recursive_call)
-		delete cc;
 }
 
 bool SyntheticFunction::destruct()
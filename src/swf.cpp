@@ -166,6 +166,32 @@ void SystemState::unregisterFrameListener(_R<DisplayObject> obj)
 	frameListeners.erase(obj);
 }
 
+void SystemState::getFrameListeners(std::vector<DisplayObject*>& listeners)
+{
+	Locker l(mutexFrameListeners);
+	for(auto it=frameListeners.begin();it!=frameListeners.end();it++)
+	{
+		(*it)->incRef();
+		listeners.push_back(it->getPtr());
+	}
+}
+
+void SystemState::addBroadcastFrameEvent(_NR<BroadcastFrameEvent>& ev, uint32_t eventNameId)
+{
+	{
+		Locker l(mutexFrameListeners);
+		if(frameListeners.empty())
+			return;
+	}
+	// the event of the last frame can be reused if it has already been handled
+	if(ev.isNull() || ACQUIRE_READ(ev->queued))
+		ev = _MR(new (unaccountedMemory) BroadcastFrameEvent(eventNameId));
+	// only the objects listening at this point of the frame get the event
+	getFrameListeners(ev->listeners);
+	ev->incRef();
+	currentVm->addEvent(NullRef,_MR(ev.getPtr()));
+}
+
 RootMovieClip* RootMovieClip::getInstance(_NR<LoaderInfo> li, _R<ApplicationDomain> appDomain, _R<SecurityDomain> secDomain)
 {
 	Class_base* movieClipClass = Class<MovieClip>::getClass(getSys());
@@ -207,7 +233,8 @@ static const char* builtinStrings[] = {"any", "void", "prototype", "Function", "
 									   "_target","this","_root","_parent","_global","super",
 									   "onEnterFrame","onMouseMove","onMouseDown","onMouseUp","onPress","onRelease","onReleaseOutside","onMouseWheel","onLoad",
 									   "object","undefined","boolean","number","string","function","onRollOver","onRollOut",
-									   "__proto__","target","flash.events:IEventDispatcher","addEventListener","removeEventListener","dispatchEvent","hasEventListener"
+									   "__proto__","target","flash.events:IEventDispatcher","addEventListener","removeEventListener","dispatchEvent","hasEventListener",
+									   "enterFrame","frameConstructed","exitFrame"
 									  };
 
 extern uint32_t asClassCount;
@@ -217,32 +244,18 @@ SystemState::SystemState(uint32_t fileSize, FLASH_MODE mode):
 	renderThread(nullptr),inputThread(nullptr),engineData(nullptr),dumpedSWFPathAvailable(0),
 	vmVersion(VMNONE),childPid(0),
 	parameters(NullRef),
-	invalidateQueueHead(NullRef),invalidateQueueTail(NullRef),lastUsedStringId(0),lastUsedNamespaceId(0x7fffffff),
+	invalidateQueueHead(NullRef),invalidateQueueTail(NullRef),renderFrame(0),lastUsedNamespaceId(0x7fffffff),
 	showProfilingData(false),allowFullscreen(false),flashMode(mode),swffilesize(fileSize),avm1global(nullptr),
-	currentVm(nullptr),builtinClasses(nullptr),useInterpreter(true),useFastInterpreter(false),useJit(false),ignoreUnhandledExceptions(false),exitOnError(ERROR_NONE),singleworker(true),
+	currentVm(nullptr),builtinClasses(nullptr),useInterpreter(true),useFastInterpreter(false),useJit(false),useBaselineJit(true),vmStackSize(16*1024*1024),ignoreUnhandledExceptions(false),exitOnError(ERROR_NONE),singleworker(true),
 	downloadManager(nullptr),extScriptObject(nullptr),scaleMode(SHOW_ALL),unaccountedMemory(nullptr),tagsMemory(nullptr),stringMemory(nullptr),textTokenMemory(nullptr),shapeTokenMemory(nullptr),morphShapeTokenMemory(nullptr),bitmapTokenMemory(nullptr),spriteTokenMemory(nullptr),
 	static_SoundMixer_bufferTime(0),isinitialized(false)
 {
 	//Forge the builtin strings
-	uniqueStringIDMap.reserve(LAST_BUILTIN_STRING);
-	tiny_string sempty;
-	uniqueStringMap.emplace(make_pair(sempty,lastUsedStringId));
-	uniqueStringIDMap.push_back(sempty);
-	lastUsedStringId++;
+	uniqueStrings.add(tiny_string());
 	for(uint32_t i=1;i<BUILTIN_STRINGS_CHAR_MAX;i++)
-	{
-		tiny_string s = tiny_string::fromChar(i);
-		uniqueStringMap.emplace(make_pair(s,lastUsedStringId));
-		uniqueStringIDMap.push_back(s);
-		lastUsedStringId++;
-	}
+		uniqueStrings.add(tiny_string::fromChar(i));
 	for(uint32_t i=BUILTIN_STRINGS_CHAR_MAX;i<LAST_BUILTIN_STRING;i++)
-	{
-		tiny_string s(builtinStrings[i-BUILTIN_STRINGS_CHAR_MAX]);
-		uniqueStringMap.emplace(make_pair(s,lastUsedStringId));
-		uniqueStringIDMap.push_back(s);
-		lastUsedStringId++;
-	}
+		uniqueStrings.add(tiny_string(builtinStrings[i-BUILTIN_STRINGS_CHAR_MAX]));
 	//Forge the empty namespace and make sure it gets id 0
 	nsNameAndKindImpl emptyNs(BUILTIN_STRINGS::EMPTY, NAMESPACE);
 	uint32_t nsId;
@@ -583,9 +596,13 @@ void SystemState::systemFinalize()
 {
 	invalidateQueueHead.reset();
 	invalidateQueueTail.reset();
+	exactRasterQueue.clear();
 	parameters.reset();
 	static_SoundMixer_soundTransform.reset();
 	frameListeners.clear();
+	enterFrameEvent.reset();
+	frameConstructedEvent.reset();
+	exitFrameEvent.reset();
 	for(auto it = sharedobjectmap.begin(); it != sharedobjectmap.end(); it++)
 		it->second->doFlush();
 	sharedobjectmap.clear();
@@ -613,6 +630,10 @@ void SystemState::destroy()
 {
 #ifdef PROFILING_SUPPORT
 	saveProfilingInformation();
+#endif
+#ifndef NDEBUG
+	if(!opcodeProfOut.empty())
+		ABCVm::saveOpcodeProfile(opcodeProfOut);
 #endif
 	terminated.wait();
 	//Acquire the mutex to sure that the engines are not being started right now
@@ -721,7 +742,6 @@ void SystemState::destroy()
 
 	for(auto it=profilingData.begin();it!=profilingData.end();it++)
 		delete *it;
-	uniqueStringMap.clear();
 }
 
 bool SystemState::isOnError() const
@@ -1134,6 +1154,10 @@ void SystemState::addJob(IThreadJob* j)
 {
 	threadPool->addJob(j);
 }
+void SystemState::runParallel(uint32_t count, const std::function<void(uint32_t)>& f)
+{
+	threadPool->runParallel(count,f);
+}
 void SystemState::addDownloadJob(IThreadJob* j)
 {
 	downloadThreadPool->addJob(j);
@@ -1245,6 +1269,25 @@ void SystemState::flushInvalidationQueue()
 	invalidateQueueHead=NullRef;
 	invalidateQueueTail=NullRef;
 }
+void SystemState::scheduleExactRaster(DisplayObject* d, TokenContainer* t)
+{
+	d->incRef();
+	exactRasterQueue.push_back(make_pair(_MR(d),t));
+}
+
+void SystemState::flushExactRasterQueue()
+{
+	renderFrame++;
+	auto it = exactRasterQueue.begin();
+	while (it != exactRasterQueue.end())
+	{
+		if (it->second->requestExactRaster(renderFrame))
+			it = exactRasterQueue.erase(it);
+		else
+			++it;
+	}
+}
+
 void SystemState::AsyncDrawJobCompleted(AsyncDrawJob *j)
 {
 	drawjobLock.lock();
@@ -1276,6 +1319,13 @@ const tiny_string& SystemState::getProfilingOutput() const
 }
 #endif
 
+#ifndef NDEBUG
+void SystemState::setOpcodeProfileOutput(const tiny_string& t)
+{
+	opcodeProfOut=t;
+}
+#endif
+
 void ThreadProfile::setTag(const std::string& t)
 {
 	Locker locker(mutex);
@@ -2079,18 +2129,7 @@ void SystemState::tick()
 	}
 
 	/* Step 2: Send enterFrame events, if needed */
-	{
-		Locker l(mutexFrameListeners);
-		if(!frameListeners.empty())
-		{
-			_R<Event> e(Class<Event>::getInstanceS(this,"enterFrame"));
-			auto it=frameListeners.begin();
-			for(;it!=frameListeners.end();it++)
-			{
-				getVm(this)->addEvent(*it,e);
-			}
-		}
-	}
+	addBroadcastFrameEvent(enterFrameEvent,BUILTIN_STRINGS::STRING_ENTERFRAME);
 
 	/* Step 3: create legacy objects, which are new in this frame (top-down),
 	 * run their constructors (bottom-up) */
@@ -2098,35 +2137,13 @@ void SystemState::tick()
 	currentVm->addEvent(NullRef, _MR(new (unaccountedMemory) InitFrameEvent(_MR(stage))));
 
 	/* Step 4: dispatch frameConstructed events */
-	{
-		Locker l(mutexFrameListeners);
-		if(!frameListeners.empty())
-		{
-			_R<Event> e(Class<Event>::getInstanceS(this,"frameConstructed"));
-			auto it=frameListeners.begin();
-			for(;it!=frameListeners.end();it++)
-			{
-				getVm(this)->addEvent(*it,e);
-			}
-		}
-	}
+	addBroadcastFrameEvent(frameConstructedEvent,BUILTIN_STRINGS::STRING_FRAMECONSTRUCTED);
 	/* Step 5: run all frameScripts (bottom-up) */
 	stage->incRef();
 	currentVm->addEvent(NullRef, _MR(new (unaccountedMemory) ExecuteFrameScriptEvent(_MR(stage))));
 
 	/* Step 6: dispatch exitFrame event */
-	{
-		Locker l(mutexFrameListeners);
-		if(!frameListeners.empty())
-		{
-			_R<Event> e(Class<Event>::getInstanceS(this,"exitFrame"));
-			auto it=frameListeners.begin();
-			for(;it!=frameListeners.end();it++)
-			{
-				getVm(this)->addEvent(*it,e);
-			}
-		}
-	}
+	addBroadcastFrameEvent(exitFrameEvent,BUILTIN_STRINGS::STRING_EXITFRAME);
 	/* TODO: Step 7: dispatch render event (Assuming stage.invalidate() has been called) */
 
 	/* Step 9: we are idle now, so we can handle all input events */
@@ -2157,24 +2174,12 @@ void SystemState::resizeCompleted()
 
 const tiny_string& SystemState::getStringFromUniqueId(uint32_t id) const
 {
-	Locker l(poolMutex);
-	assert(uniqueStringIDMap.size() > id);
-	return uniqueStringIDMap[id];
+	return uniqueStrings.getString(id);
 }
 
 uint32_t SystemState::getUniqueStringId(const tiny_string& s)
 {
-	Locker l(poolMutex);
-	auto it=uniqueStringMap.find(s);
-	if(it==uniqueStringMap.end())
-	{
-		auto ret=uniqueStringMap.insert(make_pair(s,lastUsedStringId));
-		uniqueStringIDMap.push_back(s);
-		assert(ret.second);
-		it=ret.first;
-		lastUsedStringId++;
-	}
-	return it->second;
+	return uniqueStrings.getId(s);
 }
 
 const nsNameAndKindImpl& SystemState::getNamespaceFromUniqueId(uint32_t id) const
@@ -27,12 +27,14 @@
 #include <map>
 #include <unordered_set>
 #include <string>
+#include <functional>
 #include "swftypes.h"
 #include "scripting/flash/display/flashdisplay.h"
 #include "scripting/flash/net/flashnet.h"
 #include "scripting/flash/utils/IntervalManager.h"
 #include "timer.h"
 #include "memory_support.h"
+#include "uniquestringpool.h"
 #include "platforms/engineutils.h"
 
 class uncompressing_filter;
@@ -263,6 +265,11 @@ private:
 
 	Mutex mutexFrameListeners;
 	std::set<_R<DisplayObject>> frameListeners;
+	// the events sending enterFrame, frameConstructed and exitFrame to the frame listeners, reused every frame
+	_NR<BroadcastFrameEvent> enterFrameEvent;
+	_NR<BroadcastFrameEvent> frameConstructedEvent;
+	_NR<BroadcastFrameEvent> exitFrameEvent;
+	void addBroadcastFrameEvent(_NR<BroadcastFrameEvent>& ev, uint32_t eventNameId);
 	/*
 	   The head of the invalidate queue
 	*/
@@ -275,6 +282,13 @@ private:
 	   The lock for the invalidate queue
 	*/
 	Mutex invalidateQueueLock;
+	/*
+	   Shapes shown as GPU scaled bucket rasters that wait for a raster at their exact scale,
+	   only accessed from the VM thread
+	*/
+	std::list<std::pair<_R<DisplayObject>,TokenContainer*>> exactRasterQueue;
+	// incremented at the end of every frame
+	uint32_t renderFrame;
 	
 	Mutex drawjobLock;
 	std::unordered_set<AsyncDrawJob*> drawJobsNew;
@@ -285,6 +299,12 @@ private:
 	*/
 	tiny_string profOut;
 #endif
+#ifndef NDEBUG
+	/*
+	   Output file for the opcode sequence profile
+	*/
+	tiny_string opcodeProfOut;
+#endif
 #ifdef MEMORY_USAGE_PROFILING
 	mutable Mutex memoryAccountsMutex;
 	std::list<MemoryAccount> memoryAccounts;
@@ -293,9 +313,7 @@ private:
 	 * Pooling support
 	 */
 	mutable Mutex poolMutex;
-	map<tiny_string, uint32_t> uniqueStringMap;
-	vector<tiny_string> uniqueStringIDMap;
-	uint32_t lastUsedStringId;
+	UniqueStringPool uniqueStrings;
 	map<nsNameAndKindImpl, uint32_t> uniqueNamespaceImplMap;
 	unordered_map<uint32_t,nsNameAndKindImpl> uniqueNamespaceIDMap;
 	//This needs to be atomic because it's decremented without the mutex held
@@ -417,6 +435,9 @@ public:
 	bool useInterpreter;
 	bool useFastInterpreter;
 	bool useJit;
+	bool useBaselineJit;
+	// size in bytes of the memory for frames of recursive ActionScript calls
+	uint32_t vmStackSize;
 	bool ignoreUnhandledExceptions;
 	ERROR_TYPE exitOnError;
 
@@ -433,6 +454,8 @@ public:
 
 	//Interfaces to the internal thread pool and timer thread
 	void addJob(IThreadJob* j) DLL_PUBLIC;
+	// calls f(i) for every i in [0,count) in parallel on the internal thread pool, see ThreadPool::runParallel
+	void runParallel(uint32_t count, const std::function<void(uint32_t)>& f);
 	// downloaders may be executed from inside a job from the main threadpool,
 	// so we use a second threadpool for them, to avoid deadlocks
 	void addDownloadJob(IThreadJob* j) DLL_PUBLIC;
@@ -481,10 +504,16 @@ public:
 	//enterFrame event management
 	void registerFrameListener(_R<DisplayObject> clip);
 	void unregisterFrameListener(_R<DisplayObject> clip);
+	// appends the current frame listeners to listeners, a reference is acquired for every listener
+	void getFrameListeners(std::vector<DisplayObject*>& listeners);
 
 	//Invalidation queue management
 	void addToInvalidateQueue(_R<DisplayObject> d) override;
 	void flushInvalidationQueue();
+	uint32_t getRenderFrame() const { return renderFrame; }
+	void scheduleExactRaster(DisplayObject* d, TokenContainer* t);
+	// called by the VM thread at the end of every frame, invalidates the shapes whose scale is stable
+	void flushExactRasterQueue();
 	void AsyncDrawJobCompleted(AsyncDrawJob* j);
 	void swapAsyncDrawJobQueue();
 
@@ -500,6 +529,10 @@ public:
 	const tiny_string& getProfilingOutput() const;
 	std::vector<ABCContext*> contextes;
 	void saveProfilingInformation();
+#endif
+#ifndef NDEBUG
+	void setOpcodeProfileOutput(const tiny_string& t) DLL_PUBLIC;
+	const tiny_string& getOpcodeProfileOutput() const { return opcodeProfOut; }
 #endif
 	MemoryAccount* allocateMemoryAccount(const tiny_string& name) DLL_PUBLIC;
 	MemoryAccount* unaccountedMemory;
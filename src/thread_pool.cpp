@@ -17,6 +17,9 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 **************************************************************************/
 #include <cassert>
+#include <atomic>
+#include <memory>
+#include <thread>
 
 #include "thread_pool.h"
 #include "exceptions.h"
@@ -26,6 +29,42 @@
 
 using namespace lightspark;
 
+namespace
+{
+/*
+ * State of a runParallel call, shared with the jobs as they may be executed after the call returned
+ */
+struct ParallelRange
+{
+	std::function<void(uint32_t)> f;
+	std::atomic<uint32_t> next;
+	std::atomic<uint32_t> done;
+	uint32_t count;
+	Semaphore finished;
+	ParallelRange(uint32_t c, const std::function<void(uint32_t)>& _f):f(_f),next(0),done(0),count(c),finished(0){}
+	void run()
+	{
+		uint32_t i;
+		while((i=next.fetch_add(1))<count)
+		{
+			f(i);
+			if(done.fetch_add(1)+1==count)
+				finished.signal();
+		}
+	}
+};
+
+class ParallelJob: public IThreadJob
+{
+private:
+	std::shared_ptr<ParallelRange> range;
+public:
+	ParallelJob(const std::shared_ptr<ParallelRange>& r):range(r){}
+	void execute() override { range->run(); }
+	void jobFence() override { delete this; }
+};
+}
+
 ThreadPool::ThreadPool(SystemState* s):num_jobs(0),stopFlag(false)
 {
 	m_sys=s;
@@ -147,3 +186,22 @@ void ThreadPool::addJob(IThreadJob* j)
 	num_jobs.signal();
 }
 
+
+void ThreadPool::runParallel(uint32_t count, const std::function<void(uint32_t)>& f)
+{
+	if(count==0)
+		return;
+	uint32_t cpus=std::max(1U,std::min(std::thread::hardware_concurrency(),uint32_t(NUM_THREADS)));
+	uint32_t helpers=std::min(count-1,cpus-1);
+	if(helpers==0 || stopFlag)
+	{
+		for(uint32_t i=0;i<count;i++)
+			f(i);
+		return;
+	}
+	std::shared_ptr<ParallelRange> range=std::make_shared<ParallelRange>(count,f);
+	for(uint32_t i=0;i<helpers;i++)
+		addJob(new ParallelJob(range));
+	range->run();
+	range->finished.wait();
+}
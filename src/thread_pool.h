@@ -23,6 +23,7 @@
 #include "compat.h"
 #include <deque>
 #include <cstdlib>
+#include <functional>
 #include "threading.h"
 
 namespace lightspark
@@ -53,6 +54,13 @@ public:
 	ThreadPool(SystemState* s);
 	~ThreadPool();
 	void addJob(IThreadJob* j);
+	/*
+	 * Calls f(i) for every i in [0,count) on the calling thread and on idle pool threads,
+	 * returns when all calls are done. Indices are handed out one at a time, so jobs that
+	 * start late find no work left and the call never waits for a busy pool.
+	 * f must not throw.
+	 */
+	void runParallel(uint32_t count, const std::function<void(uint32_t)>& f);
 	void forceStop();
 };
 
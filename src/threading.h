@@ -253,6 +253,68 @@ public:
 
 };
 
+/*
+ * Bounded queue with any number of producer threads and a single consumer thread.
+ * Neither push nor pop take a lock, push fails if the queue is full.
+ * Every slot has a sequence number telling if it can be written (sequence==position)
+ * or read (sequence==position+1) at the current position.
+ */
+template<class T, uint32_t size>
+class MPSCQueue
+{
+private:
+	static_assert((size&(size-1))==0, "size of MPSCQueue must be a power of 2");
+	struct slot
+	{
+		std::atomic<uint32_t> sequence;
+		T value;
+	};
+	slot slots[size];
+	// written by the producers, kept apart from the consumer position to avoid false sharing
+	std::atomic<uint32_t> tail;
+	char padding[64-sizeof(std::atomic<uint32_t>)];
+	uint32_t head;
+public:
+	MPSCQueue():tail(0),head(0)
+	{
+		for(uint32_t i=0;i<size;i++)
+			slots[i].sequence.store(i,std::memory_order_relaxed);
+	}
+	bool push(const T& v)
+	{
+		uint32_t pos=tail.load(std::memory_order_relaxed);
+		while(true)
+		{
+			slot& s=slots[pos&(size-1)];
+			int32_t diff=int32_t(s.sequence.load(std::memory_order_acquire)-pos);
+			if(diff==0)
+			{
+				if(tail.compare_exchange_weak(pos,pos+1,std::memory_order_relaxed))
+				{
+					s.value=v;
+					s.sequence.store(pos+1,std::memory_order_release);
+					return true;
+				}
+			}
+			else if(diff<0)
+				return false;
+			else
+				pos=tail.load(std::memory_order_relaxed);
+		}
+	}
+	// must only be called by the consumer thread
+	bool pop(T& v)
+	{
+		slot& s=slots[head&(size-1)];
+		if(s.sequence.load(std::memory_order_acquire)!=head+1)
+			return false;
+		v=s.value;
+		s.sequence.store(head+size,std::memory_order_release);
+		head++;
+		return true;
+	}
+};
+
 // This class represents the end time when waiting on a conditional
 // variable.
 class CondTime {
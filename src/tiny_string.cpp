@@ -17,6 +17,8 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 **************************************************************************/
 
+#include <algorithm>
+#include <new>
 #include "tiny_string.h"
 #include "exceptions.h"
 #include "swf.h"
@@ -54,8 +56,14 @@ tiny_string::tiny_string(const tiny_string& r):
 		buf=r.buf;
 		return;
 	}
-	if(stringSize > STATIC_SIZE)
-		createBuffer(stringSize);
+	//Dynamic buffers are shared until one of the strings is modified
+	if(r.type==DYNAMIC)
+	{
+		type=DYNAMIC;
+		buf=r.buf;
+		ATOMIC_INCREMENT(getDynamicBuffer()->refcount);
+		return;
+	}
 	memcpy(buf,r.buf,stringSize);
 }
 
@@ -74,6 +82,11 @@ tiny_string::~tiny_string()
 
 tiny_string& tiny_string::operator=(const tiny_string& s)
 {
+	if(this==&s)
+		return *this;
+	//take the reference before releasing our buffer, it may be the same one
+	if(s.type==DYNAMIC)
+		ATOMIC_INCREMENT(s.getDynamicBuffer()->refcount);
 	resetToStatic();
 	stringSize=s.stringSize;
 	//Fast path for static read-only strings
@@ -82,12 +95,13 @@ tiny_string& tiny_string::operator=(const tiny_string& s)
 		type=READONLY;
 		buf=s.buf;
 	}
-	else
+	else if(s.type==DYNAMIC)
 	{
-		if(stringSize > STATIC_SIZE)
-			createBuffer(stringSize);
-		memcpy(buf,s.buf,stringSize);
+		type=DYNAMIC;
+		buf=s.buf;
 	}
+	else
+		memcpy(buf,s.buf,stringSize);
 	this->isASCII = s.isASCII;
 	this->hasNull = s.hasNull;
 	this->numchars = s.numchars;
@@ -127,7 +141,7 @@ tiny_string& tiny_string::operator+=(const char* s)
 		//don't copy trailing \0
 		memcpy(buf,_buf_static,stringSize-1);
 	}
-	else if(type==DYNAMIC && addedLen!=0)
+	else if(type==DYNAMIC)
 		resizeBuffer(newStringSize);
 	//also copy \0 at the end
 	memcpy(buf+stringSize-1,s,addedLen+1);
@@ -150,10 +164,10 @@ tiny_string& tiny_string::operator+=(const tiny_string& r)
 		//don't copy trailing \0
 		memcpy(buf,_buf_static,stringSize-1);
 	}
-	else if(type==DYNAMIC && r.stringSize>1)
+	else if(type==DYNAMIC)
 		resizeBuffer(newStringSize);
-	//start position is where the \0 was
-	memcpy(buf+stringSize-1,r.buf,r.stringSize);
+	//start position is where the \0 was, r may be this string
+	memmove(buf+stringSize-1,r.buf,r.stringSize);
 	stringSize=newStringSize;
 	if (this->isASCII)
 		this->isASCII = r.isASCII;
@@ -290,29 +304,81 @@ bool tiny_string::endsWith(const char* o) const
  * returns index of character */
 uint32_t tiny_string::find(const tiny_string& needle, uint32_t start) const
 {
-	//TODO: omit copy into std::string
-	size_t bytestart = g_utf8_offset_to_pointer(buf,start) - buf;
-	size_t bytepos = std::string(*this).find(needle.raw_buf(),bytestart,needle.numBytes());
-	if(bytepos == std::string::npos)
+	if(start > numChars())
 		return npos;
-	else
-		return g_utf8_pointer_to_offset(buf,buf+bytepos);
+	const char* p = charPointer(start);
+	const char* end = buf+numBytes();
+	uint32_t n = needle.numBytes();
+	if(n == 0)
+		return start;
+	while(uint32_t(end-p) >= n)
+	{
+		p = (const char*)memchr(p,needle.buf[0],(end-p)-n+1);
+		if(!p)
+			break;
+		if(memcmp(p,needle.buf,n)==0)
+			return bytePosToIndex(p-buf);
+		p++;
+	}
+	return npos;
 }
 
 uint32_t tiny_string::rfind(const tiny_string& needle, uint32_t start) const
 {
-	//TODO: omit copy into std::string
-	size_t bytestart;
-	if(start == npos)
-		bytestart = std::string::npos;
-	else
-		bytestart = g_utf8_offset_to_pointer(buf,start) - buf;
-
-	size_t bytepos = std::string(*this).rfind(needle.raw_buf(),bytestart,needle.numBytes());
-	if(bytepos == std::string::npos)
+	uint32_t n = needle.numBytes();
+	if(n > numBytes())
 		return npos;
-	else
-		return g_utf8_pointer_to_offset(buf,buf+bytepos);
+	uint32_t bytestart = numBytes()-n;
+	if(start < numChars())
+		bytestart = std::min(bytestart,uint32_t(charPointer(start)-buf));
+	for(const char* p = buf+bytestart;;p--)
+	{
+		if(memcmp(p,needle.buf,n)==0)
+			return bytePosToIndex(p-buf);
+		if(p == buf)
+			break;
+	}
+	return npos;
+}
+
+const uint32_t* tiny_string::getCharIndex() const
+{
+	if(type != DYNAMIC || numchars < 2*CHARINDEX_STEP)
+		return nullptr;
+	dynamicbuffer* b = getDynamicBuffer();
+	uint32_t* index = b->charindex.load(std::memory_order_acquire);
+	if(index)
+		return index;
+	// the buffer is immutable while it's shared, so all strings sharing it can use the same index
+	index = new uint32_t[numchars/CHARINDEX_STEP+1];
+	const char* p = buf;
+	for(uint32_t i = 0; i <= numchars; i++)
+	{
+		if(i%CHARINDEX_STEP == 0)
+			index[i/CHARINDEX_STEP] = p-buf;
+		p = g_utf8_next_char(p);
+	}
+	uint32_t* expected = nullptr;
+	if(!b->charindex.compare_exchange_strong(expected,index))
+	{
+		// another thread was faster
+		delete[] index;
+		index = expected;
+	}
+	return index;
+}
+
+const char* tiny_string::charPointer(uint32_t idx) const
+{
+	if(isASCII)
+		return buf+idx;
+	const uint32_t* index = getCharIndex();
+	if(!index)
+		return g_utf8_offset_to_pointer(buf,idx);
+	const char* p = buf+index[idx/CHARINDEX_STEP];
+	for(uint32_t i = idx%CHARINDEX_STEP; i > 0; i--)
+		p = g_utf8_next_char(p);
+	return p;
 }
 
 void tiny_string::makePrivateCopy(const char* s)
@@ -328,27 +394,47 @@ void tiny_string::createBuffer(uint32_t s)
 {
 	type=DYNAMIC;
 	reportMemoryChange(s);
-	buf=new char[s];
+	dynamicbuffer* b=new (new char[sizeof(dynamicbuffer)+s]) dynamicbuffer;
+	b->refcount=1;
+	b->capacity=s;
+	b->charindex=nullptr;
+	buf=(char*)(b+1);
+}
+
+void tiny_string::releaseBuffer(dynamicbuffer* b) const
+{
+	if(ATOMIC_DECREMENT(b->refcount)==0)
+	{
+		reportMemoryChange(-(int32_t)b->capacity);
+		delete[] b->charindex.load();
+		b->~dynamicbuffer();
+		delete[] (char*)b;
+	}
 }
 
 void tiny_string::resizeBuffer(uint32_t s)
 {
 	assert(type==DYNAMIC);
-	char* oldBuf=buf;
-	reportMemoryChange(s-stringSize);
-	buf=new char[s];
 	assert(s >= stringSize);
+	dynamicbuffer* oldBuffer=getDynamicBuffer();
+	bool shared=oldBuffer->refcount!=1;
+	if(!shared && oldBuffer->capacity >= s)
+	{
+		// the string is modified in place
+		delete[] oldBuffer->charindex.exchange(nullptr);
+		return;
+	}
+	char* oldBuf=buf;
+	//grow appended strings geometrically, so that building a string piecewise is linear
+	createBuffer(shared ? s : std::max(s,oldBuffer->capacity+oldBuffer->capacity/2));
 	memcpy(buf,oldBuf,stringSize);
-	delete[] oldBuf;
+	releaseBuffer(oldBuffer);
 }
 
 void tiny_string::resetToStatic()
 {
 	if(type==DYNAMIC)
-	{
-		reportMemoryChange(-stringSize);
-		delete[] buf;
-	}
+		releaseBuffer(getDynamicBuffer());
 	stringSize=1;
 	_buf_static[0] = '\0';
 	buf=_buf_static;
@@ -412,8 +498,8 @@ tiny_string& tiny_string::replace(uint32_t pos1, uint32_t n1, const tiny_string&
 		n1 = numChars()-pos1;
 	if (isASCII)
 		return replace_bytes(pos1, n1, o);
-	uint32_t bytestart = g_utf8_offset_to_pointer(buf,pos1)-buf;
-	uint32_t byteend = g_utf8_offset_to_pointer(buf,pos1+n1)-buf;
+	uint32_t bytestart = charPointer(pos1)-buf;
+	uint32_t byteend = charPointer(pos1+n1)-buf;
 	return replace_bytes(bytestart, byteend-bytestart, o);
 }
 
@@ -450,8 +536,8 @@ tiny_string tiny_string::substr(uint32_t start, uint32_t len) const
 		len = numChars()-start;
 	if (isASCII)
 		return substr_bytes(start, len);
-	uint32_t bytestart = g_utf8_offset_to_pointer(buf,start) - buf;
-	uint32_t byteend = g_utf8_offset_to_pointer(buf,start+len) - buf;
+	uint32_t bytestart = charPointer(start) - buf;
+	uint32_t byteend = charPointer(start+len) - buf;
 	return substr_bytes(bytestart, byteend-bytestart);
 }
 
@@ -460,7 +546,7 @@ tiny_string tiny_string::substr(uint32_t start, const CharIterator& end) const
 	if (isASCII)
 		return substr_bytes(start, (end.buf_ptr - buf)-start);
 	assert_and_throw(start < numChars());
-	uint32_t bytestart = g_utf8_offset_to_pointer(buf,start) - buf;
+	uint32_t bytestart = charPointer(start) - buf;
 	uint32_t byteend = end.buf_ptr - buf;
 	return substr_bytes(bytestart, byteend-bytestart);
 }
@@ -1135,8 +1221,12 @@ uint32_t tiny_string::bytePosToIndex(uint32_t bytepos) const
 		return numChars();
 	if (isASCII)
 		return bytepos;
-
-	return g_utf8_pointer_to_offset(raw_buf(), raw_buf() + bytepos);
+	const uint32_t* index = getCharIndex();
+	if (!index)
+		return g_utf8_pointer_to_offset(raw_buf(), raw_buf() + bytepos);
+	// the last indexed character before bytepos
+	uint32_t i = std::upper_bound(index,index+numchars/CHARINDEX_STEP+1,bytepos)-index-1;
+	return i*CHARINDEX_STEP+g_utf8_pointer_to_offset(buf+index[i], buf+bytepos);
 }
 
 CharIterator tiny_string::begin()
@@ -88,9 +88,24 @@ class DLL_PUBLIC tiny_string
 {
 friend std::ostream& operator<<(std::ostream& s, const tiny_string& r);
 private:
-	enum TYPE { READONLY=0, STATIC, DYNAMIC };
+	/*
+	 * READONLY strings point to memory owned by someone else,
+	 * STATIC strings are stored in _buf_static,
+	 * DYNAMIC strings are stored in a refcounted heap buffer that is shared between copies
+	 */
+	enum TYPE : uint8_t { READONLY=0, STATIC, DYNAMIC };
 	/*must be at least 6 bytes for tiny_string(uint32_t c) constructor */
-	#define STATIC_SIZE 64
+	#define STATIC_SIZE 24
+	/* every CHARINDEX_STEP-th character of long non-ASCII strings has its byte position stored in the character index */
+	#define CHARINDEX_STEP 64
+	/* header in front of the characters of a DYNAMIC buffer, the buffer is only modified if refcount is 1 */
+	struct dynamicbuffer
+	{
+		ATOMIC_INT32(refcount);
+		uint32_t capacity;
+		/* character index, built on first indexed access */
+		std::atomic<uint32_t*> charindex;
+	};
 	char _buf_static[STATIC_SIZE];
 	char* buf;
 	/*
@@ -99,6 +114,7 @@ private:
 	uint32_t stringSize;
 	uint32_t numchars;
 	TYPE type;
+	dynamicbuffer* getDynamicBuffer() const { return ((dynamicbuffer*)buf)-1; }
 #ifdef MEMORY_USAGE_PROFILING
 	//Implemented in memory_support.cpp
 	DLL_PUBLIC void reportMemoryChange(int32_t change) const;
@@ -109,8 +125,13 @@ private:
 	//TODO: use static buffer again if reassigning to short string
 	void makePrivateCopy(const char* s);
 	void createBuffer(uint32_t s);
+	/* makes sure the buffer can hold s bytes and is not shared with other strings */
 	void resizeBuffer(uint32_t s);
+	void releaseBuffer(dynamicbuffer* b) const;
 	void resetToStatic();
+	const uint32_t* getCharIndex() const;
+	/* returns a pointer to the utf-8 character at index idx (idx may be numChars()) */
+	const char* charPointer(uint32_t idx) const;
 	void init();
 	bool isASCII:1;
 	bool hasNull:1;
@@ -192,7 +213,7 @@ public:
 	{
 		if (isASCII)
 			return buf[idx];
-		return g_utf8_get_char(g_utf8_offset_to_pointer(buf,idx));
+		return g_utf8_get_char(charPointer(idx));
 	}
 	/* start is an index of characters.
 	 * returns index of character */
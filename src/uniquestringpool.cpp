@@ -0,0 +1,146 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include "uniquestringpool.h"
+#include "exceptions.h"
+
+using namespace lightspark;
+
+UniqueStringPool::hashtable::hashtable(uint32_t size):mask(size-1)
+{
+	slots = new std::atomic<uint64_t>[size];
+	for (uint32_t i = 0; i < size; i++)
+		slots[i].store(0,std::memory_order_relaxed);
+}
+
+UniqueStringPool::hashtable::~hashtable()
+{
+	delete[] slots;
+}
+
+void UniqueStringPool::hashtable::insert(uint64_t entry)
+{
+	uint32_t i = uint32_t(entry>>32)&mask;
+	while (slots[i].load(std::memory_order_relaxed))
+		i = (i+1)&mask;
+	// release makes sure the string is visible to readers that find the slot
+	slots[i].store(entry,std::memory_order_release);
+}
+
+UniqueStringPool::UniqueStringPool():table(new hashtable(4096)),count(0)
+{
+	for (uint32_t i = 0; i < MAX_CHUNKS; i++)
+		chunks[i].store(nullptr,std::memory_order_relaxed);
+}
+
+UniqueStringPool::~UniqueStringPool()
+{
+	for (uint32_t i = 0; i < MAX_CHUNKS && chunks[i].load(); i++)
+		delete[] chunks[i].load();
+	delete table.load();
+	for (auto it = oldtables.begin(); it != oldtables.end(); it++)
+		delete *it;
+}
+
+uint32_t UniqueStringPool::hash(const tiny_string& s)
+{
+	// FNV-1a
+	uint32_t h = 2166136261u;
+	const uint8_t* p = (const uint8_t*)s.raw_buf();
+	const uint8_t* end = p+s.numBytes();
+	while (p != end)
+	{
+		h ^= *p++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+uint32_t UniqueStringPool::lookup(const hashtable* t, const tiny_string& s, uint32_t hash) const
+{
+	for (uint32_t i = hash&t->mask;;i = (i+1)&t->mask)
+	{
+		uint64_t entry = t->slots[i].load(std::memory_order_acquire);
+		if (!entry)
+			return UINT32_MAX;
+		if (uint32_t(entry>>32) == hash)
+		{
+			uint32_t id = uint32_t(entry)-1;
+			if (getString(id) == s)
+				return id;
+		}
+	}
+}
+
+uint32_t UniqueStringPool::append(const tiny_string& s, uint32_t hash, bool addtotable)
+{
+	uint32_t id = count.load(std::memory_order_relaxed);
+	uint32_t chunk = id>>CHUNK_BITS;
+	if (chunk >= MAX_CHUNKS)
+		throw RunTimeException("UniqueStringPool: too many strings");
+	tiny_string* strings = chunks[chunk].load(std::memory_order_relaxed);
+	if (!strings)
+	{
+		strings = new tiny_string[CHUNK_SIZE];
+		chunks[chunk].store(strings,std::memory_order_release);
+	}
+	strings[id&(CHUNK_SIZE-1)] = s;
+	count.store(id+1,std::memory_order_relaxed);
+	if (!addtotable)
+		return id;
+
+	hashtable* t = table.load(std::memory_order_relaxed);
+	if ((id+1)*2 > t->mask+1)
+	{
+		// rehash into a table twice as big, the old one is kept for lookups that are still running
+		hashtable* newtable = new hashtable((t->mask+1)*2);
+		for (uint32_t i = 0; i <= t->mask; i++)
+		{
+			uint64_t entry = t->slots[i].load(std::memory_order_relaxed);
+			if (entry)
+				newtable->insert(entry);
+		}
+		oldtables.push_back(t);
+		table.store(newtable,std::memory_order_release);
+		t = newtable;
+	}
+	t->insert((uint64_t(hash)<<32) | (id+1));
+	return id;
+}
+
+uint32_t UniqueStringPool::getId(const tiny_string& s)
+{
+	uint32_t h = hash(s);
+	uint32_t id = lookup(table.load(std::memory_order_acquire),s,h);
+	if (id != UINT32_MAX)
+		return id;
+	Locker l(writeMutex);
+	// the string may have been added while we were waiting for the lock
+	id = lookup(table.load(std::memory_order_relaxed),s,h);
+	if (id != UINT32_MAX)
+		return id;
+	return append(s,h,true);
+}
+
+uint32_t UniqueStringPool::add(const tiny_string& s)
+{
+	uint32_t h = hash(s);
+	Locker l(writeMutex);
+	return append(s,h,lookup(table.load(std::memory_order_relaxed),s,h) == UINT32_MAX);
+}
@@ -0,0 +1,80 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef UNIQUESTRINGPOOL_H
+#define UNIQUESTRINGPOOL_H 1
+
+#include "compat.h"
+#include <atomic>
+#include <vector>
+#include "threading.h"
+#include "tiny_string.h"
+
+namespace lightspark
+{
+
+/*
+ * Maps strings to unique ids and back.
+ * Lookups don't take any lock, only adding a new string does.
+ * Strings are stored in chunks that are never moved or freed while the pool exists,
+ * so references returned by getString() stay valid.
+ */
+class UniqueStringPool
+{
+private:
+	static const uint32_t CHUNK_BITS = 12;
+	static const uint32_t CHUNK_SIZE = 1<<CHUNK_BITS;
+	static const uint32_t MAX_CHUNKS = 1<<14;
+	/*
+	 * Open addressing hash table with linear probing.
+	 * Every slot contains the hash of the string in the upper 32 bits and id+1 in the lower 32 bits, 0 is an empty slot
+	 */
+	struct hashtable
+	{
+		uint32_t mask;
+		std::atomic<uint64_t>* slots;
+		hashtable(uint32_t size);
+		~hashtable();
+		void insert(uint64_t entry);
+	};
+	std::atomic<tiny_string*> chunks[MAX_CHUNKS];
+	std::atomic<hashtable*> table;
+	// tables replaced by bigger ones, they may still be read by concurrent lookups
+	std::vector<hashtable*> oldtables;
+	Mutex writeMutex;
+	std::atomic<uint32_t> count;
+	uint32_t lookup(const hashtable* t, const tiny_string& s, uint32_t hash) const;
+	uint32_t append(const tiny_string& s, uint32_t hash, bool addtotable);
+public:
+	UniqueStringPool();
+	~UniqueStringPool();
+	static uint32_t hash(const tiny_string& s);
+	/* returns the id of the string, the string is added if it's not in the pool yet */
+	uint32_t getId(const tiny_string& s);
+	/* adds the string with the next free id, even if it's already in the pool (used to forge the builtin strings) */
+	uint32_t add(const tiny_string& s);
+	FORCE_INLINE const tiny_string& getString(uint32_t id) const
+	{
+		assert(id < count.load(std::memory_order_relaxed));
+		return chunks[id>>CHUNK_BITS].load(std::memory_order_acquire)[id&(CHUNK_SIZE-1)];
+	}
+};
+
+}
+#endif /* UNIQUESTRINGPOOL_H */
@@ -0,0 +1,51 @@
+// Helper shared by the performance tests, every test calls it directly
+//
+// USAGE:
+// measure(name, f, iterations):
+// 	Call f iterations times and print the elapsed time
+// check(name, expected, actual):
+// 	Test expected === actual, the timings of a workload that computes wrong results are meaningless
+// checkRange(name, min, max, actual):
+// 	Test min <= actual <= max
+// quit():
+// 	Print the number of failed checks and quit
+//
+// OUTPUT:
+// '<name>: <time> ms' for every measurement, 'FAILED <name>' for every failed check
+
+package
+{
+	import flash.system.fscommand;
+	import flash.utils.getTimer;
+	public class PerformanceTest
+	{
+		private static var failures:uint = 0;
+		public static function measure(name:String, f:Function, iterations:int):void
+		{
+			var start:int = getTimer();
+			for (var i:int=0; i<iterations; i++) {
+				f();
+			}
+			trace(name + ": " + (getTimer() - start) + " ms");
+		}
+		public static function check(name:String, expected:*, actual:*):void
+		{
+			if (expected !== actual) {
+				failures++;
+				trace("FAILED " + name + ": expected " + expected + ", got " + actual);
+			}
+		}
+		public static function checkRange(name:String, min:Number, max:Number, actual:Number):void
+		{
+			if (!(actual >= min && actual <= max)) {
+				failures++;
+				trace("FAILED " + name + ": expected " + min + " to " + max + ", got " + actual);
+			}
+		}
+		public static function quit():void
+		{
+			trace(failures == 0 ? "All checks passed" : failures + " checks failed");
+			fscommand("quit");
+		}
+	}
+}